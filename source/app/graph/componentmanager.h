@@ -29,6 +29,7 @@
 #include <functional>
 #include <algorithm>
 #include <memory>
+#include <unordered_set>
 
 #include <QObject>
 #include <QtGlobal>
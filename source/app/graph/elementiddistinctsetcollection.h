@@ -370,6 +370,26 @@ public:
             _size--;
     }
 
+    // Moves all of the elements of other into this set in constant time,
+    // leaving other empty; both sets must share the same collection
+    void merge(ElementIdDistinctSet& other)
+    {
+        assert(_collection == other._collection);
+
+        if(other._head.isNull())
+            return;
+
+        if(_head.isNull())
+            _head = other._head;
+        else
+            _head = _collection->add(_head, other._head);
+
+        _size = (_size >= 0 && other._size >= 0) ? _size + other._size : -1;
+
+        other._head.setToNull();
+        other._size = 0;
+    }
+
     class iterator_base
     {
     public:
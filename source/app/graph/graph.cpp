@@ -70,6 +70,24 @@ std::vector<EdgeId> Node::edgeIds() const
     return edgeIds;
 }
 
+void Node::forEachInEdgeId(function_ref<void(EdgeId)> fn) const
+{
+    for(auto edgeId : _inEdgeIds)
+        fn(edgeId);
+}
+
+void Node::forEachOutEdgeId(function_ref<void(EdgeId)> fn) const
+{
+    for(auto edgeId : _outEdgeIds)
+        fn(edgeId);
+}
+
+void Node::forEachEdgeId(function_ref<void(EdgeId)> fn) const
+{
+    forEachInEdgeId(fn);
+    forEachOutEdgeId(fn);
+}
+
 Graph::Graph() :
     _nextNodeId(0), _nextEdgeId(0),
     _graphConsistencyChecker(*this)
@@ -357,14 +375,8 @@ bool Graph::componentManagementEnabled() const
 std::vector<NodeId> Graph::sourcesOf(NodeId nodeId) const
 {
     std::vector<NodeId> nodeIds;
-
-    const auto& node = nodeById(nodeId);
-
-    for(auto edgeId : node.inEdgeIds())
-    {
-        const auto& edge = edgeById(edgeId);
-        nodeIds.emplace_back(edge.oppositeId(nodeId));
-    }
+    nodeIds.reserve(static_cast<size_t>(nodeById(nodeId).inDegree()));
+    forEachSourceOf(nodeId, [&nodeIds](NodeId sourceId) { nodeIds.emplace_back(sourceId); });
 
     return nodeIds;
 }
@@ -372,14 +384,8 @@ std::vector<NodeId> Graph::sourcesOf(NodeId nodeId) const
 std::vector<NodeId> Graph::targetsOf(NodeId nodeId) const
 {
     std::vector<NodeId> nodeIds;
-
-    const auto& node = nodeById(nodeId);
-
-    for(auto edgeId : node.outEdgeIds())
-    {
-        const auto& edge = edgeById(edgeId);
-        nodeIds.emplace_back(edge.oppositeId(nodeId));
-    }
+    nodeIds.reserve(static_cast<size_t>(nodeById(nodeId).outDegree()));
+    forEachTargetOf(nodeId, [&nodeIds](NodeId targetId) { nodeIds.emplace_back(targetId); });
 
     return nodeIds;
 }
@@ -387,16 +393,34 @@ std::vector<NodeId> Graph::targetsOf(NodeId nodeId) const
 std::vector<NodeId> Graph::neighboursOf(NodeId nodeId) const
 {
     std::vector<NodeId> nodeIds;
+    nodeIds.reserve(static_cast<size_t>(nodeById(nodeId).degree()));
+    forEachNeighbourOf(nodeId, [&nodeIds](NodeId neighbourId) { nodeIds.emplace_back(neighbourId); });
 
-    const auto& node = nodeById(nodeId);
+    return nodeIds;
+}
 
-    for(auto edgeId : node.edgeIds())
+void Graph::forEachSourceOf(NodeId nodeId, function_ref<void(NodeId)> fn) const
+{
+    nodeById(nodeId).forEachInEdgeId([this, nodeId, &fn](EdgeId edgeId)
     {
-        const auto& edge = edgeById(edgeId);
-        nodeIds.emplace_back(edge.oppositeId(nodeId));
-    }
+        fn(edgeById(edgeId).oppositeId(nodeId));
+    });
+}
 
-    return nodeIds;
+void Graph::forEachTargetOf(NodeId nodeId, function_ref<void(NodeId)> fn) const
+{
+    nodeById(nodeId).forEachOutEdgeId([this, nodeId, &fn](EdgeId edgeId)
+    {
+        fn(edgeById(edgeId).oppositeId(nodeId));
+    });
+}
+
+void Graph::forEachNeighbourOf(NodeId nodeId, function_ref<void(NodeId)> fn) const
+{
+    nodeById(nodeId).forEachEdgeId([this, nodeId, &fn](EdgeId edgeId)
+    {
+        fn(edgeById(edgeId).oppositeId(nodeId));
+    });
 }
 
 void Graph::setPhase(const QString& phase) const
@@ -56,6 +56,10 @@ public:
     std::vector<EdgeId> inEdgeIds() const override;
     std::vector<EdgeId> outEdgeIds() const override;
     std::vector<EdgeId> edgeIds() const override;
+
+    void forEachInEdgeId(function_ref<void(EdgeId)> fn) const override;
+    void forEachOutEdgeId(function_ref<void(EdgeId)> fn) const override;
+    void forEachEdgeId(function_ref<void(EdgeId)> fn) const override;
 };
 
 class Edge : public IEdge
@@ -235,6 +239,10 @@ public:
     std::vector<NodeId> targetsOf(NodeId nodeId) const override;
     std::vector<NodeId> neighboursOf(NodeId nodeId) const override;
 
+    void forEachSourceOf(NodeId nodeId, function_ref<void(NodeId)> fn) const override;
+    void forEachTargetOf(NodeId nodeId, function_ref<void(NodeId)> fn) const override;
+    void forEachNeighbourOf(NodeId nodeId, function_ref<void(NodeId)> fn) const override;
+
     // Call this to ensure the Graph is in a consistent state
     // Usually it is called automatically and is generally only
     // necessary when accessing the Graph before changes have
@@ -74,6 +74,7 @@
 
 #include <QRegularExpression>
 
+#include <set>
 #include <utility>
 
 using NodeVisuals = NodeArray<ElementVisual>;
@@ -163,12 +164,82 @@ private:
     // corresponding visualisation
     bool _hasValidEdgeTextVisualisation = false;
 
+    struct CachedVisualisation
+    {
+        int _attributeValueVersion = -1;
+        ElementType _elementType = ElementType::None;
+        VisualisationsBuilder<NodeId>::Layer _nodeLayer;
+        VisualisationsBuilder<EdgeId>::Layer _edgeLayer;
+        VisualisationInfo _info;
+        bool _applied = false;
+    };
+
+    // Keyed on the visualisation config string, such that only the visualisations
+    // whose parameters or attribute values have changed need to be rebuilt
+    std::map<QString, CachedVisualisation> _visualisationCache;
+
+    // Versions are allocated monotonically, so a cached visualisation is out
+    // of date iff the version of its attribute differs from the one it was built with
+    int _lastAttributeValueVersion = 0;
+    int _baseAttributeValueVersion = 0;
+    std::map<QString, int> _attributeValueVersions;
+
+    int attributeValueVersion(const QString& name) const
+    {
+        auto attributeName = Attribute::parseAttributeName(name);
+
+        if(!u::contains(_attributeValueVersions, attributeName._name))
+            return _baseAttributeValueVersion;
+
+        return _attributeValueVersions.at(attributeName._name);
+    }
+
+    void attributeValuesChanged(const QString& name)
+    {
+        _attributeValueVersions[name] = ++_lastAttributeValueVersion;
+    }
+
+    void allAttributeValuesChanged()
+    {
+        _attributeValueVersions.clear();
+        _baseAttributeValueVersion = ++_lastAttributeValueVersion;
+    }
+
     NodeIdSet _selectedNodeIds;
     NodeIdSet _foundNodeIds;
     NodeIdSet _highlightedNodeIds;
 
     bool _nodesMaskActive = false;
 
+    void updateNodeVisualFlags(NodeId nodeId)
+    {
+        auto nodeIsSelected = u::contains(_selectedNodeIds, nodeId);
+
+        auto isNotFound = !_foundNodeIds.empty() && !u::contains(_foundNodeIds, nodeId);
+        auto isNotHighlighted = !_highlightedNodeIds.empty() && nodeIsSelected &&
+            !u::contains(_highlightedNodeIds, nodeId);
+
+        auto nodeUnhighlighted = (isNotFound && _nodesMaskActive) || isNotHighlighted;
+
+        auto& state = _nodeVisuals[nodeId]._state;
+        state.setState(VisualFlags::Selected, nodeIsSelected);
+        state.setState(VisualFlags::Unhighlighted, nodeUnhighlighted);
+    }
+
+    // Must be called after the flags of the edge's nodes are up to date
+    void updateEdgeVisualFlags(EdgeId edgeId)
+    {
+        const auto& edge = _transformedGraph.edgeById(edgeId);
+        const auto& sourceState = _nodeVisuals[edge.sourceId()]._state;
+        const auto& targetState = _nodeVisuals[edge.targetId()]._state;
+
+        auto& state = _edgeVisuals[edgeId]._state;
+        state.setState(VisualFlags::Selected,
+            sourceState.test(VisualFlags::Selected) || targetState.test(VisualFlags::Selected));
+        state.setState(VisualFlags::Unhighlighted,
+            sourceState.test(VisualFlags::Unhighlighted) || targetState.test(VisualFlags::Unhighlighted));
+    }
+
     bool _trackAttributeChanges = false;
     QStringList _trackedAddedAttributes;
     QStringList _trackedRemovedAttributes;
@@ -193,6 +264,12 @@ GraphModel::GraphModel(QString name, IPlugin* plugin) :
 
     connect(&_->_transformedGraph, &Graph::graphWillChange, this, &GraphModel::onTransformedGraphWillChange, Qt::DirectConnection);
     connect(&_->_transformedGraph, &Graph::graphChanged, this, &GraphModel::onTransformedGraphChanged, Qt::DirectConnection);
+    connect(&_->_transformedGraph, &TransformedGraph::attributeValuesChanged, this,
+    [this](const QStringList& attributeNames)
+    {
+        for(const auto& attributeName : attributeNames)
+            _->attributeValuesChanged(attributeName);
+    }, Qt::DirectConnection);
     connect(&_->_transformedGraph, &TransformedGraph::attributeValuesChanged, this,
         &GraphModel::attributeValuesChanged, Qt::DirectConnection);
 
@@ -278,6 +355,7 @@ GraphModel::GraphModel(QString name, IPlugin* plugin) :
     _->_graphTransformFactories.emplace(tr("%-NN"),                     std::make_unique<PercentNNTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Edge Reduction"),           std::make_unique<EdgeReductionTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Spanning Forest"),          std::make_unique<SpanningTreeTransformFactory>(this));
+    _->_graphTransformFactories.emplace(tr("Weighted Spanning Forest"), std::make_unique<WeightedSpanningTreeTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Attribute Synthesis"),      std::make_unique<AttributeSynthesisTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Combine Attributes"),       std::make_unique<CombineAttributesTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Remove Leaves"),            std::make_unique<RemoveLeavesTransformFactory>(this));
@@ -304,7 +382,10 @@ void GraphModel::removeDynamicAttributes()
     }
 
     for(const auto& attributeName : dynamicAttributeNames)
+    {
         _->_attributes.erase(attributeName);
+        _->attributeValuesChanged(attributeName);
+    }
 }
 
 QString GraphModel::normalisedAttributeName(QString attribute) const
@@ -595,14 +676,17 @@ bool GraphModel::visualisationIsValid(const QString& visualisation) const
 
 void GraphModel::buildVisualisations(const QStringList& visualisations)
 {
-    _->_mappedNodeVisuals.resetElements();
-    _->_mappedEdgeVisuals.resetElements();
     clearVisualisationInfos();
 
     _->_hasValidEdgeTextVisualisation = false;
 
-    VisualisationsBuilder<NodeId> nodeVisualisationsBuilder(graph(), _->_mappedNodeVisuals);
-    VisualisationsBuilder<EdgeId> edgeVisualisationsBuilder(graph(), _->_mappedEdgeVisuals);
+    VisualisationsBuilder<NodeId> nodeVisualisationsBuilder(graph());
+    VisualisationsBuilder<EdgeId> edgeVisualisationsBuilder(graph());
+
+    VisualisationsBuilder<NodeId>::Layers nodeLayers;
+    VisualisationsBuilder<EdgeId>::Layers edgeLayers;
+
+    std::set<QString> activeVisualisations;
 
     for(int index = 0; index < visualisations.size(); index++)
     {
@@ -620,11 +704,11 @@ void GraphModel::buildVisualisations(const QStringList& visualisations)
 
         const auto& attributeName = visualisationConfig._attributeName;
         const auto& channelName = visualisationConfig._channelName;
-        auto& info = _->_visualisationInfos[index];
 
         if(!attributeExists(attributeName))
         {
-            info.addAlert(AlertType::Error, tr("Attribute '%1' doesn't exist").arg(attributeName));
+            _->_visualisationInfos[index].addAlert(AlertType::Error,
+                tr("Attribute '%1' doesn't exist").arg(attributeName));
             continue;
         }
 
@@ -634,86 +718,124 @@ void GraphModel::buildVisualisations(const QStringList& visualisations)
         auto attribute = attributeValueByName(attributeName);
         auto& channel = _->_visualisationChannels.at(channelName);
 
-        channel->findErrors(attribute.elementType(), info);
-
         if(!channel->supports(attribute.valueType()))
         {
+            auto& info = _->_visualisationInfos[index];
+            channel->findErrors(attribute.elementType(), info);
             info.addAlert(AlertType::Error, tr("Visualisation doesn't support attribute type"));
             continue;
         }
 
-        channel->reset();
-
-        for(const auto& parameter : visualisationConfig._parameters)
-            channel->setParameter(parameter._name, parameter.valueAsString());
-
         if(attribute.elementType() == ElementType::Edge && channelName == QStringLiteral("Text"))
             _->_hasValidEdgeTextVisualisation = true;
 
-        if(attribute.valueType() == ValueType::String)
+        activeVisualisations.insert(visualisation);
+        auto& cached = _->_visualisationCache[visualisation];
+        auto attributeValueVersion = _->attributeValueVersion(attributeName);
+
+        if(cached._attributeValueVersion != attributeValueVersion)
         {
-            QCollator collator;
-            collator.setNumericMode(true);
+            cached._attributeValueVersion = attributeValueVersion;
+            cached._info = {};
 
-            auto sharedValues = attribute.sharedValues();
-            if(sharedValues.empty())
-            {
-                if(attribute.elementType() == ElementType::Node)
-                    sharedValues = attribute.findSharedValuesForElements(graph().nodeIds());
-                else if(attribute.elementType() == ElementType::Edge)
-                    sharedValues = attribute.findSharedValuesForElements(graph().edgeIds());
-            }
+            channel->reset();
+
+            for(const auto& parameter : visualisationConfig._parameters)
+                channel->setParameter(parameter._name, parameter.valueAsString());
 
-            if(!visualisationConfig.isFlagSet(QStringLiteral("assignByQuantity")))
+            if(attribute.valueType() == ValueType::String)
             {
-                // Sort in natural order so that e.g. "Thing 1" is always
-                // assigned a visualisation before "Thing 2"
-                std::sort(sharedValues.begin(), sharedValues.end(),
-                [&collator](const auto& a, const auto& b)
+                QCollator collator;
+                collator.setNumericMode(true);
+
+                auto sharedValues = attribute.sharedValues();
+                if(sharedValues.empty())
                 {
-                    return collator.compare(a._value, b._value) < 0;
-                });
-            }
-            else
-            {
-                // Shared values should already be sorted at this point,
-                // but resort anyway as in that case it'll be cheap and
-                // if it's not sorted (for whatever reason), we need it
-                // to be sorted
-                std::sort(sharedValues.begin(), sharedValues.end(),
-                [&collator](const auto& a, const auto& b)
+                    if(attribute.elementType() == ElementType::Node)
+                        sharedValues = attribute.findSharedValuesForElements(graph().nodeIds());
+                    else if(attribute.elementType() == ElementType::Edge)
+                        sharedValues = attribute.findSharedValuesForElements(graph().edgeIds());
+                }
+
+                if(!visualisationConfig.isFlagSet(QStringLiteral("assignByQuantity")))
                 {
-                    if(a._count == b._count)
+                    // Sort in natural order so that e.g. "Thing 1" is always
+                    // assigned a visualisation before "Thing 2"
+                    std::sort(sharedValues.begin(), sharedValues.end(),
+                    [&collator](const auto& a, const auto& b)
+                    {
                         return collator.compare(a._value, b._value) < 0;
-
-                    return a._count > b._count;
-                });
+                    });
+                }
+                else
+                {
+                    // Shared values should already be sorted at this point,
+                    // but resort anyway as in that case it'll be cheap and
+                    // if it's not sorted (for whatever reason), we need it
+                    // to be sorted
+                    std::sort(sharedValues.begin(), sharedValues.end(),
+                    [&collator](const auto& a, const auto& b)
+                    {
+                        if(a._count == b._count)
+                            return collator.compare(a._value, b._value) < 0;
+
+                        return a._count > b._count;
+                    });
+                }
+
+                for(const auto& sharedValue : sharedValues)
+                {
+                    channel->addValue(sharedValue._value);
+                    cached._info.addStringValue(sharedValue._value);
+                }
             }
 
-            for(const auto& sharedValue : sharedValues)
+            cached._elementType = attribute.elementType();
+            cached._nodeLayer = {};
+            cached._edgeLayer = {};
+
+            switch(attribute.elementType())
             {
-                channel->addValue(sharedValue._value);
-                info.addStringValue(sharedValue._value);
+            case ElementType::Node:
+                cached._applied = nodeVisualisationsBuilder.build(attribute, *channel,
+                    visualisationConfig, cached._nodeLayer, cached._info);
+                break;
+
+            case ElementType::Edge:
+                cached._applied = edgeVisualisationsBuilder.build(attribute, *channel,
+                    visualisationConfig, cached._edgeLayer, cached._info);
+                break;
+
+            default:
+                cached._applied = false;
+                break;
             }
         }
 
-        switch(attribute.elementType())
-        {
-        case ElementType::Node:
-            nodeVisualisationsBuilder.build(attribute, *channel, visualisationConfig, index, info);
-            break;
+        auto& info = _->_visualisationInfos[index];
+        info = cached._info;
+        channel->findErrors(attribute.elementType(), info);
 
-        case ElementType::Edge:
-            edgeVisualisationsBuilder.build(attribute, *channel, visualisationConfig, index, info);
-            break;
+        if(!cached._applied)
+            continue;
 
-        default:
-            break;
-        }
+        if(cached._elementType == ElementType::Node)
+            nodeLayers.emplace_back(index, &cached._nodeLayer);
+        else if(cached._elementType == ElementType::Edge)
+            edgeLayers.emplace_back(index, &cached._edgeLayer);
     }
 
-    nodeVisualisationsBuilder.findOverrideAlerts(_->_visualisationInfos);
-    edgeVisualisationsBuilder.findOverrideAlerts(_->_visualisationInfos);
+    // Discard anything that is no longer in use
+    for(auto it = _->_visualisationCache.begin(); it != _->_visualisationCache.end();)
+    {
+        if(!u::contains(activeVisualisations, it->first))
+            it = _->_visualisationCache.erase(it);
+        else
+            ++it;
+    }
+
+    nodeVisualisationsBuilder.composite(nodeLayers, _->_mappedNodeVisuals, _->_visualisationInfos);
+    edgeVisualisationsBuilder.composite(edgeLayers, _->_mappedEdgeVisuals, _->_visualisationInfos);
 
     updateVisuals();
 }
@@ -815,14 +937,52 @@ std::vector<QString> GraphModel::attributeNames(ElementType elementType) const
     return attributeNames;
 }
 
+struct AttributeStage
+{
+    const GraphModel* _graphModel = nullptr;
+    GraphModel::StagedAttributes* _stagedAttributes = nullptr;
+};
+
+static thread_local AttributeStage attributeStage;
+
+void GraphModel::stageCreatedAttributes(StagedAttributes* stagedAttributes)
+{
+    attributeStage._graphModel = stagedAttributes != nullptr ? this : nullptr;
+    attributeStage._stagedAttributes = stagedAttributes;
+}
+
+void GraphModel::addStagedAttributes(const StagedAttributes& stagedAttributes)
+{
+    // Names are made unique here rather than when staged, so they are the
+    // same as they would have been had the attributes been created directly
+    for(const auto& [name, attribute] : stagedAttributes)
+        createAttribute(name) = attribute;
+}
+
 Attribute& GraphModel::createAttribute(QString name, QString* assignedName)
 {
+    if(attributeStage._graphModel == this)
+    {
+        name.replace('.', '_');
+
+        if(assignedName != nullptr)
+            *assignedName = name;
+
+        auto& attribute = attributeStage._stagedAttributes->emplace_back(name, Attribute()).second;
+
+        if(_transformedGraphIsChanging)
+            attribute.setFlag(AttributeFlag::Dynamic);
+
+        return attribute;
+    }
+
     name = normalisedAttributeName(name);
 
     if(assignedName != nullptr)
         *assignedName = name;
 
     Attribute& attribute = _->_attributes[name];
+    _->attributeValuesChanged(name);
 
     // If we're creating an attribute during the graph transform, it's
     // a dynamically created attribute rather than a persistent one,
@@ -839,6 +999,9 @@ Attribute& GraphModel::createAttribute(QString name, QString* assignedName)
 void GraphModel::addAttributes(const std::map<QString, Attribute>& attributes)
 {
     _->_attributes.insert(attributes.begin(), attributes.end());
+
+    for(const auto& attribute : attributes)
+        _->attributeValuesChanged(attribute.first);
 }
 
 void GraphModel::removeAttribute(const QString& name)
@@ -847,6 +1010,7 @@ void GraphModel::removeAttribute(const QString& name)
         return;
 
     _->_attributes.erase(name);
+    _->attributeValuesChanged(name);
 
     if(_->_trackAttributeChanges)
         _->_trackedRemovedAttributes.append(name);
@@ -999,7 +1163,9 @@ void GraphModel::clearHighlightedNodes()
         return;
 
     _->_highlightedNodeIds.clear();
-    updateVisuals();
+
+    // Highlighting only affects selected nodes
+    updateVisualFlags(u::vectorFrom(_->_selectedNodeIds));
 }
 
 void GraphModel::highlightNodes(const NodeIdSet& nodeIds)
@@ -1008,7 +1174,7 @@ void GraphModel::highlightNodes(const NodeIdSet& nodeIds)
         return;
 
     _->_highlightedNodeIds = nodeIds;
-    updateVisuals();
+    updateVisualFlags(u::vectorFrom(_->_selectedNodeIds));
 }
 
 void GraphModel::enableVisualUpdates()
@@ -1042,11 +1208,6 @@ void GraphModel::updateVisuals()
     auto edgeSize       = u::pref("visuals/defaultEdgeSize").toFloat();
     auto meIndicators   = u::pref("visuals/showMultiElementIndicators").toBool();
 
-    // Clear all edge flags as we can't know what to
-    // change unless we have the previous state to hand
-    for(auto edgeId : graph().edgeIds())
-        _->_edgeVisuals[edgeId]._state.reset(VisualFlags::Selected, VisualFlags::Unhighlighted);
-
     for(auto nodeId : graph().nodeIds())
     {
         // Size
@@ -1074,29 +1235,7 @@ void GraphModel::updateVisuals()
         else
             _->_nodeVisuals[nodeId]._text = nodeName(nodeId);
 
-        auto nodeIsSelected = u::contains(_->_selectedNodeIds, nodeId);
-
-        _->_nodeVisuals[nodeId]._state.setState(VisualFlags::Selected, nodeIsSelected);
-
-        if(nodeIsSelected)
-        {
-            for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
-                _->_edgeVisuals[edgeId]._state.setState(VisualFlags::Selected, nodeIsSelected);
-        }
-
-        auto isNotFound = !_->_foundNodeIds.empty() && !u::contains(_->_foundNodeIds, nodeId);
-        auto isNotHighlighted = !_->_highlightedNodeIds.empty() && nodeIsSelected &&
-            !u::contains(_->_highlightedNodeIds, nodeId);
-
-        auto nodeUnhighlighted = (isNotFound && _->_nodesMaskActive) || isNotHighlighted;
-
-        _->_nodeVisuals[nodeId]._state.setState(VisualFlags::Unhighlighted, nodeUnhighlighted);
-
-        if(nodeUnhighlighted)
-        {
-            for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
-                _->_edgeVisuals[edgeId]._state.set(VisualFlags::Unhighlighted);
-        }
+        _->updateNodeVisualFlags(nodeId);
     }
 
     for(auto edgeId : graph().edgeIds())
@@ -1131,6 +1270,49 @@ void GraphModel::updateVisuals()
             _->_edgeVisuals[edgeId]._text = _->_mappedEdgeVisuals[edgeId]._text;
         else
             _->_edgeVisuals[edgeId]._text.clear();
+
+        _->updateEdgeVisualFlags(edgeId);
+    }
+
+    emit visualsChanged();
+}
+
+void GraphModel::updateVisualFlags()
+{
+    if(!_visualUpdatesEnabled)
+        return;
+
+    emit visualsWillChange();
+
+    for(auto nodeId : graph().nodeIds())
+        _->updateNodeVisualFlags(nodeId);
+
+    for(auto edgeId : graph().edgeIds())
+        _->updateEdgeVisualFlags(edgeId);
+
+    emit visualsChanged();
+}
+
+void GraphModel::updateVisualFlags(const std::vector<NodeId>& nodeIds)
+{
+    if(!_visualUpdatesEnabled || nodeIds.empty())
+        return;
+
+    emit visualsWillChange();
+
+    for(auto nodeId : nodeIds)
+    {
+        if(graph().containsNodeId(nodeId))
+            _->updateNodeVisualFlags(nodeId);
+    }
+
+    for(auto nodeId : nodeIds)
+    {
+        if(!graph().containsNodeId(nodeId))
+            continue;
+
+        for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
+            _->updateEdgeVisualFlags(edgeId);
     }
 
     emit visualsChanged();
@@ -1138,16 +1320,49 @@ void GraphModel::updateVisuals()
 
 void GraphModel::onSelectionChanged(const SelectionManager* selectionManager)
 {
-    _->_selectedNodeIds = selectionManager->selectedNodes();
-    _->_nodesMaskActive = selectionManager->nodesMaskActive();
-    clearHighlightedNodes();
-    updateVisuals();
+    auto selectedNodeIds = selectionManager->selectedNodes();
+    auto nodesMaskActive = selectionManager->nodesMaskActive();
+
+    // Changes to the mask or highlight state potentially affect every node,
+    // otherwise only those nodes whose selection state has changed need updating
+    bool allNodesAffected = !_->_highlightedNodeIds.empty() ||
+        (nodesMaskActive != _->_nodesMaskActive && !_->_foundNodeIds.empty());
+
+    std::vector<NodeId> changedNodeIds;
+    if(!allNodesAffected)
+        changedNodeIds = u::vectorFrom(symmetricDifference(_->_selectedNodeIds, selectedNodeIds));
+
+    _->_selectedNodeIds = std::move(selectedNodeIds);
+    _->_nodesMaskActive = nodesMaskActive;
+    _->_highlightedNodeIds.clear();
+
+    if(allNodesAffected)
+        updateVisualFlags();
+    else
+        updateVisualFlags(changedNodeIds);
 }
 
 void GraphModel::onFoundNodeIdsChanged(const SearchManager* searchManager)
 {
-    _->_foundNodeIds = searchManager->foundNodeIds();
-    updateVisuals();
+    auto foundNodeIds = searchManager->foundNodeIds();
+
+    // The found nodes only have a visual effect when the mask is active
+    if(!_->_nodesMaskActive)
+    {
+        _->_foundNodeIds = std::move(foundNodeIds);
+        return;
+    }
+
+    if(_->_foundNodeIds.empty() != foundNodeIds.empty())
+    {
+        _->_foundNodeIds = std::move(foundNodeIds);
+        updateVisualFlags();
+        return;
+    }
+
+    auto changedNodeIds = u::vectorFrom(symmetricDifference(_->_foundNodeIds, foundNodeIds));
+    _->_foundNodeIds = std::move(foundNodeIds);
+    updateVisualFlags(changedNodeIds);
 }
 
 void GraphModel::onPreferenceChanged(const QString& name, const QVariant&)
@@ -1173,10 +1388,15 @@ void GraphModel::onTransformedGraphWillChange(const Graph*)
     _transformedGraphIsChanging = true;
 }
 
-void GraphModel::onTransformedGraphChanged(const Graph*)
+void GraphModel::onTransformedGraphChanged(const Graph*, bool changeOccurred)
 {
     _transformedGraphIsChanging = false;
 
+    // The element IDs (and components) that cached visualisations
+    // were built from are no longer valid
+    if(changeOccurred)
+        _->allAttributeValuesChanged();
+
     auto attributeIdentities = _->currentAttributeIdentities();
 
     // Compare with previous attributes
@@ -33,8 +33,10 @@
 
 #include <memory>
 #include <map>
+#include <deque>
 #include <vector>
 #include <atomic>
+#include <utility>
 
 class GraphModelImpl;
 class Graph;
@@ -154,6 +156,12 @@ public:
 
     Attribute& createAttribute(QString name, QString* assignedName = nullptr) override;
 
+    // While set, attributes created on the calling thread are appended to stagedAttributes
+    // instead of being added to the model, so that they can be added later, in a known order
+    using StagedAttributes = std::deque<std::pair<QString, Attribute>>;
+    void stageCreatedAttributes(StagedAttributes* stagedAttributes);
+    void addStagedAttributes(const StagedAttributes& stagedAttributes);
+
     void addAttributes(const std::map<QString, Attribute>& attributes);
     void removeAttribute(const QString& name);
 
@@ -185,6 +193,11 @@ public:
     void enableVisualUpdates();
     void updateVisuals();
 
+private:
+    // Only updates the selection/highlight state of the visuals
+    void updateVisualFlags();
+    void updateVisualFlags(const std::vector<NodeId>& nodeIds);
+
 public slots:
     void onSelectionChanged(const SelectionManager* selectionManager);
     void onFoundNodeIdsChanged(const SearchManager* searchManager);
@@ -193,7 +206,7 @@ public slots:
 private slots:
     void onMutableGraphChanged(const Graph* graph);
     void onTransformedGraphWillChange(const Graph* graph);
-    void onTransformedGraphChanged(const Graph* graph);
+    void onTransformedGraphChanged(const Graph* graph, bool changeOccurred);
 
 signals:
     void visualsWillChange();
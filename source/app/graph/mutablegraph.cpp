@@ -19,7 +19,6 @@
 #include "mutablegraph.h"
 
 #include "graphcomponent.h"
-#include "componentmanager.h"
 
 #include "shared/utils/container.h"
 
@@ -54,6 +53,9 @@ void MutableGraph::clear()
     _e.clear();
     _e.resize(0);
 
+    _nextReservedNodeId.setToNull();
+    _nextReservedEdgeId.setToNull();
+
     Graph::clear();
 }
 
@@ -142,9 +144,30 @@ NodeId MutableGraph::addNode()
         return addNode(unusedNodeId);
     }
 
+    auto reservedNodeId = takeReservedNodeId();
+    if(!reservedNodeId.isNull())
+        return addNode(reservedNodeId);
+
     return addNode(nextNodeId());
 }
 
+NodeId MutableGraph::takeReservedNodeId()
+{
+    while(!_nextReservedNodeId.isNull())
+    {
+        auto nodeId = _nextReservedNodeId++;
+
+        if(_nextReservedNodeId >= nextNodeId())
+            _nextReservedNodeId.setToNull();
+
+        // It may have since been added explicitly
+        if(!containsNodeId(nodeId))
+            return nodeId;
+    }
+
+    return {};
+}
+
 Node& MutableGraph::nodeBy(NodeId nodeId)
 {
     return _n._nodes[static_cast<int>(nodeId)];
@@ -199,6 +222,29 @@ void MutableGraph::reserveNodeId(NodeId nodeId)
         _unusedNodeIds.push_back(unusedNodeId++);
 }
 
+void MutableGraph::reserve(int numNodes, int numEdges)
+{
+    // The new IDs are handed out in order by addNode/addEdge, once any unused
+    // ones are exhausted; the existing reserved range, if any, is extended
+    if(numNodes > 0)
+    {
+        if(_nextReservedNodeId.isNull())
+            _nextReservedNodeId = nextNodeId();
+
+        Graph::reserveNodeId(nextNodeId() + (numNodes - 1));
+        _n.resize(static_cast<int>(nextNodeId()));
+    }
+
+    if(numEdges > 0)
+    {
+        if(_nextReservedEdgeId.isNull())
+            _nextReservedEdgeId = nextEdgeId();
+
+        Graph::reserveEdgeId(nextEdgeId() + (numEdges - 1));
+        _e.resize(static_cast<int>(nextEdgeId()));
+    }
+}
+
 NodeId MutableGraph::addNode(NodeId nodeId)
 {
     Q_ASSERT(!nodeId.isNull());
@@ -322,9 +368,29 @@ EdgeId MutableGraph::addEdge(NodeId sourceId, NodeId targetId)
         return addEdge(unusedEdgeId, sourceId, targetId);
     }
 
+    auto reservedEdgeId = takeReservedEdgeId();
+    if(!reservedEdgeId.isNull())
+        return addEdge(reservedEdgeId, sourceId, targetId);
+
     return addEdge(nextEdgeId(), sourceId, targetId);
 }
 
+EdgeId MutableGraph::takeReservedEdgeId()
+{
+    while(!_nextReservedEdgeId.isNull())
+    {
+        auto edgeId = _nextReservedEdgeId++;
+
+        if(_nextReservedEdgeId >= nextEdgeId())
+            _nextReservedEdgeId.setToNull();
+
+        if(!containsEdgeId(edgeId))
+            return edgeId;
+    }
+
+    return {};
+}
+
 void MutableGraph::reserveEdgeId(EdgeId edgeId)
 {
     if(edgeId < nextEdgeId())
@@ -341,16 +407,19 @@ void MutableGraph::reserveEdgeId(EdgeId edgeId)
 
 NodeId MutableGraph::mergeNodes(NodeId nodeIdA, NodeId nodeIdB)
 {
+    _mergeGeneration++;
     return _n._mergedNodeIds.add(nodeIdA, nodeIdB);
 }
 
 EdgeId MutableGraph::mergeEdges(EdgeId edgeIdA, EdgeId edgeIdB)
 {
+    _mergeGeneration++;
     return _e._mergedEdgeIds.add(edgeIdA, edgeIdB);
 }
 
 NodeId MutableGraph::mergeNodes(const std::vector<NodeId>& nodeIds)
 {
+    _mergeGeneration++;
     auto setId = *std::min_element(nodeIds.begin(), nodeIds.end());
 
     for(auto nodeId : nodeIds)
@@ -361,6 +430,7 @@ NodeId MutableGraph::mergeNodes(const std::vector<NodeId>& nodeIds)
 
 EdgeId MutableGraph::mergeEdges(const std::vector<EdgeId>& edgeIds)
 {
+    _mergeGeneration++;
     auto setId = *std::min_element(edgeIds.begin(), edgeIds.end());
 
     for(auto edgeId : edgeIds)
@@ -492,34 +562,126 @@ void MutableGraph::contractEdges(const EdgeIdSet& edgeIds)
 
     beginTransaction();
 
-    // Divide into components, but ignore any edges that aren't being contracted,
-    // so that each component represents a set of nodes that will be merged
-    ComponentManager componentManager(*this, nullptr,
-    [&edgeIds](EdgeId edgeId)
+    // Union-find over the nodes at either end of the contracted edges; the root of
+    // each set is its lowest NodeId, which is the node the others are merged into
+    std::vector<NodeId> roots(static_cast<size_t>(nextNodeId()));
+    for(NodeId nodeId(0); nodeId < nextNodeId(); ++nodeId)
+        roots[static_cast<size_t>(nodeId)] = nodeId;
+
+    auto rootOf = [&roots](NodeId nodeId)
     {
-        return !u::contains(edgeIds, edgeId);
-    });
+        while(roots[static_cast<size_t>(nodeId)] != nodeId)
+        {
+            // Path halving
+            auto& parent = roots[static_cast<size_t>(nodeId)];
+            parent = roots[static_cast<size_t>(parent)];
+            nodeId = parent;
+        }
+
+        return nodeId;
+    };
 
-    removeEdges(edgeIds);
+    std::vector<bool> nodeTouched(roots.size(), false);
+    std::vector<NodeId> touchedNodeIds;
+    std::vector<EdgeId> removedEdgeIds;
+    removedEdgeIds.reserve(edgeIds.size());
 
-    for(auto componentId : componentManager.componentIds())
+    for(auto edgeId : edgeIds)
+    {
+        if(!containsEdgeId(edgeId))
+            continue;
+
+        const auto& edge = edgeBy(edgeId);
+
+        for(auto nodeId : {edge.sourceId(), edge.targetId()})
+        {
+            if(!nodeTouched[static_cast<size_t>(nodeId)])
+            {
+                nodeTouched[static_cast<size_t>(nodeId)] = true;
+                touchedNodeIds.push_back(nodeId);
+            }
+        }
+
+        auto [lowRootId, highRootId] = std::minmax(rootOf(edge.sourceId()), rootOf(edge.targetId()));
+        roots[static_cast<size_t>(highRootId)] = lowRootId;
+
+        removedEdgeIds.push_back(edgeId);
+    }
+
+    // The contracted edges themselves go; their signals are emitted at the end
+    bool wasBlocked = blockSignals(true);
+    for(auto edgeId : removedEdgeIds)
+        removeEdge(edgeId);
+    blockSignals(wasBlocked);
+
+    std::sort(touchedNodeIds.begin(), touchedNodeIds.end());
+
+    // Everything still attached to a node that is being merged away needs rewiring
+    std::vector<bool> edgeAffected(static_cast<size_t>(nextEdgeId()), false);
+    std::vector<EdgeId> affectedEdgeIds;
+    for(auto nodeId : touchedNodeIds)
+    {
+        if(rootOf(nodeId) == nodeId)
+            continue;
+
+        for(auto edgeId : edgeIdsForNodeId(nodeId))
+        {
+            if(!edgeAffected[static_cast<size_t>(edgeId)])
+            {
+                edgeAffected[static_cast<size_t>(edgeId)] = true;
+                affectedEdgeIds.push_back(edgeId);
+            }
+        }
+    }
+
+    // Detach the affected edges from their current connections...
+    for(auto edgeId : affectedEdgeIds)
+    {
+        const auto& edge = edgeBy(edgeId);
+        auto connectionIt = _e._connections.find(UndirectedEdge(edge.sourceId(), edge.targetId()));
+        Q_ASSERT(connectionIt != _e._connections.end());
+
+        connectionIt->second.remove(edgeId);
+        if(connectionIt->second.empty())
+            _e._connections.erase(connectionIt);
+    }
+
+    // ...point them at the roots...
+    for(auto edgeId : affectedEdgeIds)
     {
-        const auto* component = componentManager.componentById(componentId);
+        auto& edge = edgeBy(edgeId);
+        edge._sourceId = rootOf(edge._sourceId);
+        edge._targetId = rootOf(edge._targetId);
+    }
 
-        // Nothing to contract
-        if(component->numEdges() == 0)
+    // ...splice each merged node's edge lists onto its root's and build the merge sets...
+    _mergeGeneration++;
+    for(auto nodeId : touchedNodeIds)
+    {
+        auto rootId = rootOf(nodeId);
+        if(rootId == nodeId)
             continue;
 
-        const auto& nodeIds = component->nodeIds();
-        auto nodeId = *std::min_element(nodeIds.begin(), nodeIds.end());
+        auto& node = nodeBy(nodeId);
+        auto& rootNode = nodeBy(rootId);
+        rootNode._inEdgeIds.merge(node._inEdgeIds);
+        rootNode._outEdgeIds.merge(node._outEdgeIds);
 
-        moveEdgesTo(*this, nodeId,
-            inEdgeIdsForNodeIds(nodeIds).copy(),
-            outEdgeIdsForNodeIds(nodeIds).copy());
+        _n._mergedNodeIds.add(rootId, nodeId);
+    }
 
-        mergeNodes(nodeIds);
+    // ...and reattach them to their new connections
+    for(auto edgeId : affectedEdgeIds)
+    {
+        const auto& edge = edgeBy(edgeId);
+        auto& connection = _e._connections.try_emplace(
+            UndirectedEdge(edge.sourceId(), edge.targetId()), &_e._mergedEdgeIds).first->second;
+        connection.add(edgeId);
     }
 
+    for(auto edgeId : removedEdgeIds)
+        emit edgeRemoved(this, edgeId);
+
     _updateRequired = true;
     endTransaction();
 }
@@ -531,15 +693,19 @@ MutableGraph& MutableGraph::clone(const MutableGraph& other)
     // Store the differences between the graphs
     auto diff = diffTo(other);
 
+    _mergeGeneration++;
+
     _n             = other._n;
     _nodeIds       = other._nodeIds;
     _unusedNodeIds = other._unusedNodeIds;
+    _nextReservedNodeId = other._nextReservedNodeId;
     Graph::reserveNodeId(other.largestNodeId());
     _n.resize(static_cast<int>(nextNodeId()));
 
     _e             = other._e;
     _edgeIds       = other._edgeIds;
     _unusedEdgeIds = other._unusedEdgeIds;
+    _nextReservedEdgeId = other._nextReservedEdgeId;
     Graph::reserveEdgeId(other.largestEdgeId());
     _e.resize(static_cast<int>(nextEdgeId()));
 
@@ -670,7 +836,7 @@ bool MutableGraph::update()
             else if(typeOf(nodeId) == MultiElementType::Not)
                 _n._multiplicities[static_cast<int>(nodeId)] = 1;
         }
-        else
+        else if(_nextReservedNodeId.isNull() || nodeId < _nextReservedNodeId)
             _unusedNodeIds.emplace_back(nodeId);
     }
 
@@ -693,7 +859,7 @@ bool MutableGraph::update()
             else if(typeOf(edgeId) == MultiElementType::Not)
                 _e._multiplicities[static_cast<int>(edgeId)] = 1;
         }
-        else
+        else if(_nextReservedEdgeId.isNull() || edgeId < _nextReservedEdgeId)
             _unusedEdgeIds.emplace_back(edgeId);
     }
 
@@ -67,6 +67,10 @@ private:
     std::vector<NodeId> _nodeIds;
     std::deque<NodeId> _unusedNodeIds;
 
+    // The start of the range of IDs up to nextNodeId() that reserve() has set aside, or
+    // null if there is none; these are kept as a range, as there may be very many
+    NodeId _nextReservedNodeId;
+
     struct
     {
         std::vector<bool>           _edgeIdsInUse;
@@ -103,15 +107,22 @@ private:
 
     std::vector<EdgeId> _edgeIds;
     std::deque<EdgeId> _unusedEdgeIds;
+    EdgeId _nextReservedEdgeId;
 
     bool _updateRequired = false;
 
+    // Incremented whenever elements are merged or the graph is cloned wholesale,
+    // i.e. when a change occurs that can't be expressed as additions and removals
+    int _mergeGeneration = 0;
+
     Node& nodeBy(NodeId nodeId);
     const Node& nodeBy(NodeId nodeId) const;
+    NodeId takeReservedNodeId();
     void claimNodeId(NodeId nodeId);
     void releaseNodeId(NodeId nodeId);
     Edge& edgeBy(EdgeId edgeId);
     const Edge& edgeBy(EdgeId edgeId) const;
+    EdgeId takeReservedEdgeId();
     void claimEdgeId(EdgeId edgeId);
     void releaseEdgeId(EdgeId edgeId);
 
@@ -139,6 +150,7 @@ public:
     bool edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const override;
 
     void reserveNodeId(NodeId nodeId) override;
+    void reserve(int numNodes, int numEdges) override;
 
     NodeId addNode() override;
     NodeId addNode(NodeId nodeId) override;
@@ -207,6 +219,8 @@ public:
 
     Diff diffTo(const MutableGraph& other);
 
+    int mergeGeneration() const { return _mergeGeneration; }
+
     bool update() override;
 
 private:
@@ -20,80 +20,109 @@
 #define BARNESHUTTREE_H
 
 #include "spatialtree.h"
-#include "shared/utils/fixedsizestack.h"
 
 #include <QVector3D>
 
+#include <array>
 #include <functional>
-
-class AbstractBarnesHutTree : virtual public AbstractSpatialTree
-{
-public:
-    virtual QVector3D evaluateKernel(const NodeLayoutPositions& nodePositions, NodeId nodeId,
-        const std::function<QVector3D(int, const QVector3D&, float)>& kernel) const = 0;
-};
+#include <vector>
 
 template<size_t NumDimensions>
-class BarnesHutTree;
-
-template<size_t NumDimensions>
-struct BarnesHutSubVolume : SubVolume<BarnesHutTree<NumDimensions>, NumDimensions> { float _sSq = 0.0f; };
-
-template<size_t NumDimensions>
-class BarnesHutTree :
-    public SpatialTree<BarnesHutTree<NumDimensions>, NumDimensions, BarnesHutSubVolume<NumDimensions>>,
-    public AbstractBarnesHutTree
+class BarnesHutTree : public SpatialTree<NumDimensions>
 {
 private:
+    using Base = SpatialTree<NumDimensions>;
+    using Vector = std::array<float, NumDimensions>;
+
     static constexpr float E = 0.0001f;
     static constexpr float E2 = E * E;
 
     // Cycle through different epsilon vectors so that there is enough
     // variation that the forces don't get stuck in 2 or fewer dimensions
-    mutable size_t _di = 0;
-    QVector3D differenceEpsilon() const
+    static Vector differenceEpsilon(size_t seed)
     {
-        if constexpr(NumDimensions == 3)
-        {
-            static std::array<QVector3D, 6> vs =
-            {{
-                {   E, 0.0f, 0.0f},
-                {0.0f,    E, 0.0f},
-                {0.0f, 0.0f,    E},
-                {  -E, 0.0f, 0.0f},
-                {0.0f,   -E, 0.0f},
-                {0.0f, 0.0f,   -E},
-            }};
-
-            _di = (_di + 1) % vs.size();
-            return vs.at(_di);
-        }
-        else if constexpr(NumDimensions == 2)
-        {
-            static std::array<QVector3D, 4> vs =
-            {{
-                {   E, 0.0f, 0.0f},
-                {0.0f,    E, 0.0f},
-                {  -E, 0.0f, 0.0f},
-                {0.0f,   -E, 0.0f},
-            }};
-
-            _di = (_di + 1) % vs.size();
-            return vs.at(_di);
-        }
+        Vector v{};
+        v[(seed / 2) % NumDimensions] = (seed % 2) == 0 ? E : -E;
+
+        return v;
     }
 
     float _theta = 0.8f;
-    int _mass = 0;
-    QVector3D _centreOfMass;
 
-    void initialise(const NodeLayoutPositions& nodePositions, const std::vector<NodeId>& nodeIds) override
+    // Only set while building a tree whose nodes don't all have unit mass
+    std::function<float(NodeId)> _massOf;
+
+    // Per node, in the same order as nodeIds(); empty when every node has unit mass
+    std::vector<float> _nodeMass;
+
+    // Per cell, in the same order as cells()
+    std::vector<float> _mass;
+    std::array<std::vector<float>, NumDimensions> _centreOfMass;
+    std::vector<float> _sSq;
+
+    float nodeMass(size_t index) const
     {
-        _mass = static_cast<int>(nodeIds.size());
-        _centreOfMass = nodePositions.centreOfMass(nodeIds);
+        return !_nodeMass.empty() ? _nodeMass[index] : 1.0f;
+    }
+
+    void initialise() override
+    {
+        const auto& cells = this->cells();
+
+        _nodeMass.clear();
+        if(_massOf)
+        {
+            const auto& nodeIds = this->nodeIds();
+            _nodeMass.resize(nodeIds.size());
+
+            for(size_t j = 0; j < nodeIds.size(); j++)
+                _nodeMass[j] = _massOf(nodeIds[j]);
+        }
+
+        _mass.resize(cells.size());
+        _sSq.resize(cells.size());
+        for(auto& dimension : _centreOfMass)
+            dimension.resize(cells.size());
+
+        // Children always come after their parents, so
+        // iterating backwards aggregates from the bottom up
+        for(size_t i = cells.size(); i-- > 0;)
+        {
+            const auto& cell = cells[i];
+
+            const auto size = this->cellSize(cell._depth);
+            _sSq[i] = size * size;
+
+            Vector sum{};
+            float mass = 0.0f;
+
+            if(cell.leaf())
+            {
+                for(auto j = cell._first; j < cell._first + cell._count; j++)
+                {
+                    const auto m = nodeMass(j);
+
+                    for(size_t d = 0; d < NumDimensions; d++)
+                        sum[d] += this->positions(d)[j] * m;
+
+                    mass += m;
+                }
+            }
+            else
+            {
+                for(auto c = cell._firstChild; c < cell._firstChild + cell._numChildren; c++)
+                {
+                    for(size_t d = 0; d < NumDimensions; d++)
+                        sum[d] += _centreOfMass[d][c] * _mass[c];
 
-        for(auto& subVolume : this->_subVolumes)
-            subVolume._sSq = subVolume._boundingBox.maxLength() * subVolume._boundingBox.maxLength();
+                    mass += _mass[c];
+                }
+            }
+
+            _mass[i] = mass;
+            for(size_t d = 0; d < NumDimensions; d++)
+                _centreOfMass[d][i] = sum[d] / mass;
+        }
     }
 
 public:
@@ -104,64 +133,121 @@ public:
 
     void setTheta(float theta) { _theta = theta; }
 
-    QVector3D evaluateKernel(const NodeLayoutPositions& nodePositions, NodeId nodeId,
-        const std::function<QVector3D(int, const QVector3D&, float)>& kernel) const override
+    using Base::build;
+
+    // As above, but each node has the mass given by massOf, rather than unit mass
+    template<typename PositionFn, typename MassFn>
+    void build(const std::vector<NodeId>& nodeIds, const PositionFn& positionOf, const MassFn& massOf)
     {
-        const QVector3D& nodePosition = nodePositions.get(nodeId);
-        QVector3D result;
-        FixedSizeStack<const BarnesHutTree*> stack(this->_depthFirstTraversalStackSizeRequirement);
+        _massOf = massOf;
+        Base::build(nodeIds, positionOf);
+        _massOf = nullptr;
+    }
 
-        stack.push(this);
+    // Sums difference * kernel(mass, distanceSq) over the tree, where difference is the
+    // vector from the node at index (into nodeIds()) to each other node or cell's centre
+    // of mass; kernel is a template parameter so that it can be inlined
+    template<typename Kernel>
+    QVector3D evaluateKernel(size_t index, const Kernel& kernel) const
+    {
+        const auto& cells = this->cells();
 
-        while(!stack.empty())
-        {
-            const BarnesHutTree* subTree = stack.pop();
+        if(cells.empty())
+            return {};
+
+        Vector position;
+        for(size_t d = 0; d < NumDimensions; d++)
+            position[d] = this->positions(d)[index];
+
+        Vector result{};
 
-            for(int i = 0; i < subTree->_numInternalNodes; i++)
+        auto evaluateLeaf = [&](const typename Base::Cell& cell)
+        {
+            for(auto j = cell._first; j < cell._first + cell._count; j++)
             {
-                auto subVolume = subTree->_internalNodes.at(i);
+                if(j == index)
+                    continue;
+
+                Vector difference;
+                float distanceSq = 0.0f;
 
-                const QVector3D& centreOfMass = subVolume->_subTree->_centreOfMass;
-                QVector3D difference = (centreOfMass - nodePosition);
-                float distanceSq = difference.lengthSquared();
+                for(size_t d = 0; d < NumDimensions; d++)
+                {
+                    difference[d] = this->positions(d)[j] - position[d];
+                    distanceSq += difference[d] * difference[d];
+                }
 
                 if(distanceSq == 0.0f)
                 {
-                    difference = differenceEpsilon();
+                    difference = differenceEpsilon(index + j);
                     distanceSq = E2;
                 }
 
-                const float sOverD = subVolume->_sSq / distanceSq;
-
-                if(sOverD > _theta)
-                    stack.push(subVolume->_subTree.get());
-                else
-                    result += kernel(subVolume->_subTree->_mass, difference, distanceSq);
+                const float f = kernel(nodeMass(j), distanceSq);
+                for(size_t d = 0; d < NumDimensions; d++)
+                    result[d] += difference[d] * f;
             }
+        };
+
+        if(cells.front().leaf())
+            evaluateLeaf(cells.front());
+        else
+        {
+            std::array<uint32_t, Base::MaxTraversalStackSize> stack;
+            size_t stackSize = 0;
 
-            for(int i = 0; i < subTree->_numNonEmptyLeaves; i++)
+            stack[stackSize++] = 0;
+
+            while(stackSize > 0)
             {
-                auto subVolume = subTree->_nonEmptyLeaves.at(i);
+                const auto& cell = cells[stack[--stackSize]];
 
-                NodeId otherNodeId = subVolume->_nodeIds.front();
-                if(otherNodeId != nodeId)
+                for(auto c = cell._firstChild; c < cell._firstChild + cell._numChildren; c++)
                 {
-                    const QVector3D& otherNodePosition = nodePositions.get(otherNodeId);
-                    QVector3D difference = otherNodePosition - nodePosition;
-                    float distanceSq = difference.lengthSquared();
+                    const auto& child = cells[c];
+
+                    if(child.leaf())
+                    {
+                        evaluateLeaf(child);
+                        continue;
+                    }
+
+                    Vector difference;
+                    float distanceSq = 0.0f;
+
+                    for(size_t d = 0; d < NumDimensions; d++)
+                    {
+                        difference[d] = _centreOfMass[d][c] - position[d];
+                        distanceSq += difference[d] * difference[d];
+                    }
 
                     if(distanceSq == 0.0f)
                     {
-                        difference = differenceEpsilon();
+                        difference = differenceEpsilon(index + c);
                         distanceSq = E2;
                     }
 
-                    result += kernel(1, difference, distanceSq);
+                    const float sOverD = _sSq[c] / distanceSq;
+
+                    if(sOverD > _theta)
+                    {
+                        Q_ASSERT(stackSize < stack.size());
+                        stack[stackSize++] = c;
+                    }
+                    else
+                    {
+                        const float f = kernel(_mass[c], distanceSq);
+                        for(size_t d = 0; d < NumDimensions; d++)
+                            result[d] += difference[d] * f;
+                    }
                 }
             }
         }
 
-        return result;
+        if constexpr(NumDimensions == 3)
+            return {result[0], result[1], result[2]};
+        else
+            return {result[0], result[1], 0.0f};
     }
 };
 
@@ -24,6 +24,7 @@
 #include <QVector4D>
 
 #include <cmath>
+#include <queue>
 
 void FastInitialLayout::positionNode(QVector3D& offsetPosition, const QMatrix4x4& orientationMatrix,
                                      const QVector3D& parentNodePosition, NodeId childNodeId,
@@ -44,6 +45,7 @@ void FastInitialLayout::execute(bool, Dimensionality dimensionality)
     NodeArray<QVector3D> directionNodeVectors(graph);
 
     std::queue<NodeId> nodeQueue;
+    std::vector<EdgeId> edgeIds;
     nodeQueue.push(nodeIds().front());
     visitedNodes.set(nodeIds().front(), true);
 
@@ -55,7 +57,8 @@ void FastInitialLayout::execute(bool, Dimensionality dimensionality)
         auto parentNodeId = nodeQueue.front();
         nodeQueue.pop();
 
-        auto edgeIds = graph.nodeById(parentNodeId).edgeIds();
+        edgeIds.clear();
+        graph.nodeById(parentNodeId).forEachEdgeId([&edgeIds](EdgeId edgeId) { edgeIds.push_back(edgeId); });
         QVector3D parentNodePosition = positions().get(parentNodeId);
 
         QMatrix4x4 orientationMatrix;
@@ -27,6 +27,8 @@
 #include "shared/utils/preferences.h"
 #include "shared/utils/scopetimer.h"
 
+#include <algorithm>
+#include <utility>
 #include <cmath>
 
 template<typename T> float meanWeightedAvgBuffer(int start, int end, const T& buffer)
@@ -93,13 +95,60 @@ void ForceDirectedDisplacement::computeAndDamp()
     _previousLength = _previous.length();
 }
 
-// This is a fairly arbitrary function that was arrived at through experimentation. The parameters
-// shortRange and longRange affect the emphasis that the result places on local forces and global
-// forces, respectively.
-static float repulse(const float distanceSq, const float shortRange, const float longRange)
+void ForceDirectedLayout::updateAdjacency()
 {
-    return ((distanceSq * distanceSq * longRange) + shortRange) /
-        ((distanceSq * distanceSq * distanceSq) + 0.0001f);
+    if(_adjacencyNodeIds == nodeIds() && _adjacencyEdgeIds == edgeIds())
+        return;
+
+    _adjacencyNodeIds = nodeIds();
+    _adjacencyEdgeIds = edgeIds();
+
+    std::vector<std::pair<NodeId, int>> indices;
+    indices.reserve(nodeIds().size());
+
+    for(size_t i = 0; i < nodeIds().size(); i++)
+        indices.emplace_back(nodeIds().at(i), static_cast<int>(i));
+
+    std::sort(indices.begin(), indices.end());
+
+    auto indexOf = [&indices](NodeId nodeId)
+    {
+        auto it = std::lower_bound(indices.begin(), indices.end(), nodeId,
+            [](const auto& index, NodeId value) { return index.first < value; });
+
+        Q_ASSERT(it != indices.end() && it->first == nodeId);
+        return static_cast<size_t>(it->second);
+    };
+
+    const auto& graph = graphComponent().graph();
+
+    _adjacencyOffsets.assign(nodeIds().size() + 1, 0);
+
+    for(auto edgeId : edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        if(edge.isLoop())
+            continue;
+
+        _adjacencyOffsets[indexOf(edge.sourceId()) + 1]++;
+        _adjacencyOffsets[indexOf(edge.targetId()) + 1]++;
+    }
+
+    for(size_t i = 0; i < nodeIds().size(); i++)
+        _adjacencyOffsets[i + 1] += _adjacencyOffsets[i];
+
+    _adjacencyTargets.resize(static_cast<size_t>(_adjacencyOffsets.back()));
+    auto next = _adjacencyOffsets;
+
+    for(auto edgeId : edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        if(edge.isLoop())
+            continue;
+
+        _adjacencyTargets[static_cast<size_t>(next[indexOf(edge.sourceId())]++)] = edge.targetId();
+        _adjacencyTargets[static_cast<size_t>(next[indexOf(edge.targetId())]++)] = edge.sourceId();
+    }
 }
 
 void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensionality)
@@ -115,7 +164,8 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
             _displacements->at(nodeId)._previous = {};
     }
 
-    std::unique_ptr<AbstractBarnesHutTree> barnesHutTree;
+    BarnesHutTree2D barnesHutTree2D;
+    BarnesHutTree3D barnesHutTree3D;
 
     if(dimensionality == Dimensionality::ThreeDee)
     {
@@ -140,50 +190,63 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
             _hasBeenFlattened = false;
         }
 
-        barnesHutTree = std::make_unique<BarnesHutTree3D>();
+        barnesHutTree3D.build(graphComponent(), positions());
     }
     else if(dimensionality == Dimensionality::TwoDee)
     {
         _hasBeenFlattened = true;
-        barnesHutTree = std::make_unique<BarnesHutTree2D>();
+        barnesHutTree2D.build(graphComponent(), positions());
     }
 
-    barnesHutTree->build(graphComponent(), positions());
-
     const float SHORT_RANGE = _settings->value(QStringLiteral("ShortRangeRepulseTerm"));
     const float LONG_RANGE = 0.01f + _settings->value(QStringLiteral("LongRangeRepulseTerm"));
 
-    // Repulsive forces
-    auto repulsiveResults = concurrent_for(nodeIds().begin(), nodeIds().end(),
-    [this, &barnesHutTree, SHORT_RANGE, LONG_RANGE](NodeId nodeId)
+    auto kernel = [SHORT_RANGE, LONG_RANGE](float mass, float distanceSq)
     {
-        if(cancelled())
-            return;
+        return mass * repulse(distanceSq, SHORT_RANGE, LONG_RANGE);
+    };
+
+    // Repulsive forces; iterating in tree order means that nodes which
+    // are close to each other are processed close together in time
+    auto computeRepulsive = [this, &kernel](const auto& barnesHutTree)
+    {
+        const auto& treeNodeIds = barnesHutTree.nodeIds();
 
-        _displacements->at(nodeId)._repulsive -= barnesHutTree->evaluateKernel(positions(), nodeId,
-        [SHORT_RANGE, LONG_RANGE](int mass, const QVector3D& difference, float distanceSq)
+        return concurrent_for(treeNodeIds.begin(), treeNodeIds.end(),
+        [this, &barnesHutTree, &treeNodeIds, &kernel](std::vector<NodeId>::const_iterator it)
         {
-            return difference * (static_cast<float>(mass) * repulse(distanceSq, SHORT_RANGE, LONG_RANGE));
-        });
-    }, ThreadPool::NonBlocking);
+            if(cancelled())
+                return;
+
+            auto index = static_cast<size_t>(std::distance(treeNodeIds.begin(), it));
+            _displacements->at(*it)._repulsive -= barnesHutTree.evaluateKernel(index, kernel);
+        }, ThreadPool::NonBlocking);
+    };
+
+    auto repulsiveResults = dimensionality == Dimensionality::ThreeDee ?
+        computeRepulsive(barnesHutTree3D) : computeRepulsive(barnesHutTree2D);
 
-    // Attractive forces
-    auto attractiveResults = concurrent_for(edgeIds().begin(), edgeIds().end(),
-    [this](EdgeId edgeId)
+    updateAdjacency();
+
+    // Attractive forces; these are gathered per node, so that each
+    // displacement is only ever written to by a single thread
+    auto attractiveResults = concurrent_for(nodeIds().begin(), nodeIds().end(),
+    [this](std::vector<NodeId>::const_iterator it)
     {
         if(cancelled())
             return;
 
-        const IEdge& edge = graphComponent().graph().edgeById(edgeId);
-        if(!edge.isLoop())
-        {
-            const QVector3D difference = positions().get(edge.targetId()) - positions().get(edge.sourceId());
-            float distanceSq = difference.lengthSquared();
-            const float force = distanceSq * 0.001f;
+        const auto index = static_cast<size_t>(std::distance(nodeIds().begin(), it));
+        const QVector3D& position = positions().get(*it);
+        QVector3D attractive;
 
-            _displacements->at(edge.targetId())._attractive -= (force * difference);
-            _displacements->at(edge.sourceId())._attractive += (force * difference);
+        for(auto i = _adjacencyOffsets[index]; i < _adjacencyOffsets[index + 1]; i++)
+        {
+            const QVector3D difference = positions().get(_adjacencyTargets[static_cast<size_t>(i)]) - position;
+            attractive += attract(difference.lengthSquared()) * difference;
         }
+
+        _displacements->at(*it)._attractive += attractive;
     }, ThreadPool::NonBlocking);
 
     repulsiveResults.wait();
@@ -76,6 +76,15 @@ private:
 
     bool _hasBeenFlattened = false;
 
+    // The component's adjacency in compressed sparse row form, indexed by position in
+    // nodeIds(); it is rebuilt whenever the component's nodes or edges change
+    std::vector<NodeId> _adjacencyNodeIds;
+    std::vector<EdgeId> _adjacencyEdgeIds;
+    std::vector<int> _adjacencyOffsets;
+    std::vector<NodeId> _adjacencyTargets;
+
+    void updateAdjacency();
+
     void fineTuneChangeDetection();
     void oscillateChangeDetection();
     void initialChangeDetection();
@@ -97,12 +106,26 @@ public:
     void unfinish() override;
 
     void execute(bool firstIteration, Dimensionality dimensionality) override;
+
+    // This is a fairly arbitrary function that was arrived at through experimentation. The parameters
+    // shortRange and longRange affect the emphasis that the result places on local forces and global
+    // forces, respectively.
+    static float repulse(const float distanceSq, const float shortRange, const float longRange)
+    {
+        return ((distanceSq * distanceSq * longRange) + shortRange) /
+            ((distanceSq * distanceSq * distanceSq) + 0.0001f);
+    }
+
+    static float attract(const float distanceSq)
+    {
+        return distanceSq * 0.001f;
+    }
 };
 
 class ForceDirectedLayoutFactory : public LayoutFactory
 {
-private:
-    ForceDirectedDisplacements _displacements;
+protected:
+    ForceDirectedDisplacements _displacements; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
 
 public:
     explicit ForceDirectedLayoutFactory(GraphModel* graphModel);
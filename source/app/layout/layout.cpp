@@ -19,6 +19,7 @@
 #include "layout.h"
 #include "shared/utils/thread.h"
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 
 #include "graph/graph.h"
 #include "graph/graphmodel.h"
@@ -213,21 +214,60 @@ void LayoutThread::run()
     {
         u::setCurrentThreadName(QStringLiteral("Layout >"));
 
+        _scheduledLayouts.clear();
+        uint64_t totalCost = 0;
+        bool flatten = false;
+
         for(auto& [componentId, layout] : _layouts)
         {
             if(layoutIsFinished(*layout))
                 continue;
 
+            // If we're in 2D mode and the layout can handle it, flatten the positions
             if(_dimensionalityMode == Layout::Dimensionality::TwoDee &&
                (layout->dimensionality() & _dimensionalityMode))
             {
-                // If we're in 2D mode and the layout can handle it, flatten the positions
-                _nodeLayoutPositions.flatten();
+                flatten = true;
             }
 
-            layout->execute(!_executedAtLeastOnce.get(componentId), _dimensionalityMode);
-            _executedAtLeastOnce.set(componentId, true);
+            const auto& component = layout->graphComponent();
+            auto cost = static_cast<uint64_t>(component.numNodes() + component.numEdges());
+
+            _scheduledLayouts.push_back({layout.get(), componentId,
+                !_executedAtLeastOnce.get(componentId), cost});
+            totalCost += cost;
+        }
+
+        if(flatten)
+            _nodeLayoutPositions.flatten();
+
+        auto executeLayout = [this](const ScheduledLayout& scheduledLayout)
+        {
+            scheduledLayout._layout->execute(scheduledLayout._firstIteration, _dimensionalityMode);
+        };
+
+        // Components that cost at least a thread's share of the total are executed one at
+        // a time on this thread, where they're free to use the whole thread pool; the
+        // remainder are executed concurrently on the pool, where any internal
+        // concurrency they attempt is shared with whichever workers are idle
+        const auto concurrentCostThreshold = totalCost / S(ThreadPoolSingleton)->numThreads();
+        auto largeLayouts = std::partition(_scheduledLayouts.begin(), _scheduledLayouts.end(),
+            [concurrentCostThreshold](const auto& scheduledLayout)
+            { return scheduledLayout._cost < concurrentCostThreshold; });
+
+        if(largeLayouts != _scheduledLayouts.begin())
+        {
+            auto smallLayoutResults = concurrent_for(_scheduledLayouts.begin(), largeLayouts,
+                executeLayout, ThreadPool::NonBlocking);
+
+            std::for_each(largeLayouts, _scheduledLayouts.end(), executeLayout);
+            smallLayoutResults.wait();
         }
+        else
+            std::for_each(_scheduledLayouts.begin(), _scheduledLayouts.end(), executeLayout);
+
+        for(const auto& scheduledLayout : _scheduledLayouts)
+            _executedAtLeastOnce.set(scheduledLayout._componentId, true);
 
         {
             std::unique_lock<NodePositions> lock(_graphModel->nodePositions());
@@ -44,6 +44,7 @@
 #include <cstdint>
 #include <set>
 #include <map>
+#include <vector>
 
 struct LayoutSettingKeyValue
 {
@@ -187,6 +188,19 @@ private:
 
     std::unique_ptr<LayoutFactory> _layoutFactory;
     std::map<ComponentId, std::unique_ptr<Layout>> _layouts;
+
+    struct ScheduledLayout
+    {
+        Layout* _layout = nullptr;
+        ComponentId _componentId;
+        bool _firstIteration = false;
+        uint64_t _cost = 0;
+
+        uint64_t computeCostHint() const { return _cost; }
+    };
+
+    // The unfinished layouts for the current iteration
+    std::vector<ScheduledLayout> _scheduledLayouts;
     ComponentArray<bool> _executedAtLeastOnce;
 
     Layout::Dimensionality _dimensionalityMode =
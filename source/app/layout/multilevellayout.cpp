@@ -0,0 +1,441 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "multilevellayout.h"
+#include "barneshuttree.h"
+
+#include "graph/graph.h"
+#include "graph/graphmodel.h"
+
+#include "shared/utils/threadpool.h"
+#include "shared/utils/random.h"
+#include "shared/utils/scopetimer.h"
+
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+MultilevelLayout::MultilevelLayout(const IGraphComponent& graphComponent,
+                                   ForceDirectedDisplacements& displacements,
+                                   NodeLayoutPositions& positions,
+                                   Layout::Dimensionality dimensionalityMode,
+                                   const LayoutSettings* settings) :
+    Layout(graphComponent, positions, settings, Iterative::Yes,
+        Dimensionality::TwoOrThreeDee, 0.4f, 4),
+    _forceDirectedLayout(std::make_unique<ForceDirectedLayout>(graphComponent,
+        displacements, positions, dimensionalityMode, settings))
+{}
+
+static std::vector<NodeId> indexNodeIds(size_t numNodes)
+{
+    std::vector<NodeId> nodeIds(numNodes);
+
+    for(size_t i = 0; i < numNodes; i++)
+        nodeIds[i] = static_cast<int>(i);
+
+    return nodeIds;
+}
+
+static void setAdjacency(std::vector<int>& offsets, std::vector<int>& targets,
+    size_t numNodes, const std::vector<std::pair<int, int>>& edges)
+{
+    offsets.assign(numNodes + 1, 0);
+
+    for(const auto& edge : edges)
+        offsets[static_cast<size_t>(edge.first) + 1]++;
+
+    for(size_t i = 0; i < numNodes; i++)
+        offsets[i + 1] += offsets[i];
+
+    targets.resize(edges.size());
+    auto next = offsets;
+
+    for(const auto& [source, target] : edges)
+        targets[static_cast<size_t>(next[static_cast<size_t>(source)]++)] = target;
+}
+
+void MultilevelLayout::buildLevels(Dimensionality dimensionality)
+{
+    SCOPE_TIMER
+
+    _levels.clear();
+    _currentLevel = -1;
+    _iteration = 0;
+    _levelsNodeIds = nodeIds();
+
+    const auto& graph = graphComponent().graph();
+    const auto numNodes = nodeIds().size();
+
+    NodeArray<int> indices(graph);
+    for(size_t i = 0; i < numNodes; i++)
+        indices.set(nodeIds().at(i), static_cast<int>(i));
+
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(edgeIds().size() * 2);
+
+    for(auto edgeId : edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        if(edge.isLoop())
+            continue;
+
+        auto source = indices.get(edge.sourceId());
+        auto target = indices.get(edge.targetId());
+
+        edges.emplace_back(source, target);
+        edges.emplace_back(target, source);
+    }
+
+    Level level;
+    level._nodeIds = indexNodeIds(numNodes);
+    level._mass.assign(numNodes, 1);
+    setAdjacency(level._edgeOffsets, level._edgeTargets, numNodes, edges);
+    _levels.emplace_back(std::move(level));
+
+    while(_levels.back().numNodes() > MINIMUM_COARSEST_SIZE &&
+        _levels.size() < MAXIMUM_NUM_LEVELS && !cancelled())
+    {
+        if(!coarsen())
+            break;
+    }
+
+    if(_levels.size() < 2 || cancelled())
+    {
+        // Nothing to be gained, so leave it all to the ForceDirectedLayout
+        _levels.clear();
+        return;
+    }
+
+    auto& coarsest = _levels.back();
+    const float dimensions = dimensionality == Dimensionality::TwoDee ? 2.0f : 3.0f;
+    const float spread = INITIAL_SPREAD * std::pow(static_cast<float>(coarsest.numNodes()), 1.0f / dimensions);
+
+    coarsest._positions.resize(coarsest.numNodes());
+    coarsest._displacements.resize(coarsest.numNodes());
+
+    for(auto& position : coarsest._positions)
+    {
+        position = u::randQVector3D(-spread, spread);
+
+        if(dimensionality == Dimensionality::TwoDee)
+            position.setZ(0.0f);
+    }
+
+    _currentLevel = static_cast<int>(_levels.size()) - 1;
+    updateAncestors();
+    updatePositions();
+}
+
+// Combines pairs of adjacent nodes, preferring to match a node with its lightest
+// neighbour so that the masses of the coarse nodes remain reasonably balanced
+bool MultilevelLayout::coarsen()
+{
+    const auto& fine = _levels.back();
+    const auto numFineNodes = fine.numNodes();
+
+    std::vector<int> parents(numFineNodes, -1);
+    int numCoarseNodes = 0;
+
+    for(size_t u = 0; u < numFineNodes; u++)
+    {
+        if(parents[u] >= 0)
+            continue;
+
+        int match = -1;
+
+        for(auto e = fine._edgeOffsets[u]; e < fine._edgeOffsets[u + 1]; e++)
+        {
+            auto v = fine._edgeTargets[static_cast<size_t>(e)];
+
+            if(parents[static_cast<size_t>(v)] >= 0)
+                continue;
+
+            if(match < 0 || fine._mass[static_cast<size_t>(v)] < fine._mass[static_cast<size_t>(match)])
+                match = v;
+        }
+
+        if(match < 0)
+            continue;
+
+        parents[u] = numCoarseNodes;
+        parents[static_cast<size_t>(match)] = numCoarseNodes;
+        numCoarseNodes++;
+    }
+
+    for(size_t u = 0; u < numFineNodes; u++)
+    {
+        if(parents[u] >= 0)
+            continue;
+
+        const auto begin = fine._edgeTargets.begin() + fine._edgeOffsets[u];
+        const auto end = fine._edgeTargets.begin() + fine._edgeOffsets[u + 1];
+
+        // Nodes whose only neighbour has already been matched are merged into
+        // the neighbour's coarse node; this allows star-like structures, which
+        // otherwise barely coarsen, to collapse
+        if(begin != end && std::all_of(begin, end, [begin](int v) { return v == *begin; }))
+            parents[u] = parents[static_cast<size_t>(*begin)];
+        else
+            parents[u] = numCoarseNodes++;
+    }
+
+    const auto numCoarseNodesSize = static_cast<size_t>(numCoarseNodes);
+    if(static_cast<float>(numCoarseNodesSize) > MINIMUM_COARSENING_RATIO * static_cast<float>(numFineNodes))
+        return false;
+
+    Level coarse;
+    coarse._nodeIds = indexNodeIds(numCoarseNodesSize);
+    coarse._mass.assign(numCoarseNodesSize, 0);
+
+    for(size_t u = 0; u < numFineNodes; u++)
+        coarse._mass[static_cast<size_t>(parents[u])] += fine._mass[u];
+
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(fine._edgeTargets.size());
+
+    for(size_t u = 0; u < numFineNodes; u++)
+    {
+        for(auto e = fine._edgeOffsets[u]; e < fine._edgeOffsets[u + 1]; e++)
+        {
+            auto source = parents[u];
+            auto target = parents[static_cast<size_t>(fine._edgeTargets[static_cast<size_t>(e)])];
+
+            if(source != target)
+                edges.emplace_back(source, target);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    setAdjacency(coarse._edgeOffsets, coarse._edgeTargets, numCoarseNodesSize, edges);
+
+    _levels.back()._parents = std::move(parents);
+    _levels.emplace_back(std::move(coarse));
+
+    return true;
+}
+
+void MultilevelLayout::iterate(Level& level, Dimensionality dimensionality)
+{
+    const float SHORT_RANGE = _settings->value(QStringLiteral("ShortRangeRepulseTerm"));
+    const float LONG_RANGE = 0.01f + _settings->value(QStringLiteral("LongRangeRepulseTerm"));
+
+    auto kernel = [SHORT_RANGE, LONG_RANGE](float mass, float distanceSq)
+    {
+        return mass * ForceDirectedLayout::repulse(distanceSq, SHORT_RANGE, LONG_RANGE);
+    };
+
+    auto positionOf = [&level](NodeId nodeId) { return level._positions[static_cast<size_t>(static_cast<int>(nodeId))]; };
+
+    // Coarse nodes repel with the combined mass of the nodes they stand for
+    auto massOf = [&level](NodeId nodeId) { return static_cast<float>(level._mass[static_cast<size_t>(static_cast<int>(nodeId))]); };
+
+    // Each node only ever writes to its own displacement, so no synchronisation is needed
+    auto computeDisplacements = [this, &level, &kernel](const auto& barnesHutTree)
+    {
+        const auto& treeNodeIds = barnesHutTree.nodeIds();
+
+        concurrent_for(treeNodeIds.begin(), treeNodeIds.end(),
+        [this, &level, &kernel, &barnesHutTree, &treeNodeIds](std::vector<NodeId>::const_iterator it)
+        {
+            if(cancelled())
+                return;
+
+            const auto index = static_cast<size_t>(std::distance(treeNodeIds.begin(), it));
+            const auto u = static_cast<size_t>(static_cast<int>(*it));
+            auto& displacement = level._displacements[u];
+
+            displacement._repulsive -= barnesHutTree.evaluateKernel(index, kernel);
+
+            for(auto e = level._edgeOffsets[u]; e < level._edgeOffsets[u + 1]; e++)
+            {
+                const auto v = static_cast<size_t>(level._edgeTargets[static_cast<size_t>(e)]);
+                const QVector3D difference = level._positions[v] - level._positions[u];
+
+                displacement._attractive += ForceDirectedLayout::attract(difference.lengthSquared()) * difference;
+            }
+
+            displacement.computeAndDamp();
+        });
+    };
+
+    if(dimensionality == Dimensionality::ThreeDee)
+    {
+        BarnesHutTree3D barnesHutTree;
+        barnesHutTree.build(level._nodeIds, positionOf, massOf);
+        computeDisplacements(barnesHutTree);
+    }
+    else
+    {
+        BarnesHutTree2D barnesHutTree;
+        barnesHutTree.build(level._nodeIds, positionOf, massOf);
+        computeDisplacements(barnesHutTree);
+    }
+
+    if(cancelled())
+        return;
+
+    for(size_t u = 0; u < level.numNodes(); u++)
+    {
+        auto& position = level._positions[u];
+        position += level._displacements[u]._next;
+
+        if(dimensionality == Dimensionality::TwoDee)
+            position.setZ(0.0f);
+    }
+}
+
+void MultilevelLayout::interpolate(const Level& coarse, Level& fine, Dimensionality dimensionality)
+{
+    // The forces have a natural length scale, so the coarse layout is expanded
+    // to make room for the extra nodes before they are pushed apart
+    const float dimensions = dimensionality == Dimensionality::TwoDee ? 2.0f : 3.0f;
+    const float ratio = static_cast<float>(fine.numNodes()) / static_cast<float>(coarse.numNodes());
+    const float scale = std::pow(ratio, 1.0f / dimensions);
+
+    fine._positions.resize(fine.numNodes());
+    fine._displacements.assign(fine.numNodes(), {});
+
+    for(size_t u = 0; u < fine.numNodes(); u++)
+    {
+        auto jitter = u::randQVector3D(-INTERPOLATION_JITTER, INTERPOLATION_JITTER);
+
+        if(dimensionality == Dimensionality::TwoDee)
+            jitter.setZ(0.0f);
+
+        fine._positions[u] = (coarse._positions[static_cast<size_t>(fine._parents[u])] * scale) + jitter;
+    }
+}
+
+void MultilevelLayout::updateAncestors()
+{
+    _ancestors.resize(_levelsNodeIds.size());
+
+    for(size_t i = 0; i < _ancestors.size(); i++)
+    {
+        auto index = static_cast<int>(i);
+
+        for(size_t l = 0; l < static_cast<size_t>(_currentLevel); l++)
+            index = _levels[l]._parents[static_cast<size_t>(index)];
+
+        _ancestors[i] = index;
+    }
+}
+
+// Places each node at the position of its ancestor in the current level
+void MultilevelLayout::updatePositions()
+{
+    const auto& level = _levels.at(static_cast<size_t>(_currentLevel));
+
+    for(size_t i = 0; i < _levelsNodeIds.size(); i++)
+        positions().set(_levelsNodeIds[i], level._positions[static_cast<size_t>(_ancestors[i])]);
+}
+
+void MultilevelLayout::cancel()
+{
+    Layout::cancel();
+    _forceDirectedLayout->cancel();
+}
+
+void MultilevelLayout::uncancel()
+{
+    Layout::uncancel();
+    _forceDirectedLayout->uncancel();
+}
+
+bool MultilevelLayout::finished() const
+{
+    return _currentLevel < 0 && _forceDirectedLayout->finished();
+}
+
+void MultilevelLayout::unfinish()
+{
+    _forceDirectedLayout->unfinish();
+}
+
+void MultilevelLayout::execute(bool firstIteration, Dimensionality dimensionality)
+{
+    SCOPE_TIMER_MULTISAMPLES(50)
+
+    if(firstIteration)
+        buildLevels(dimensionality);
+    else if(_currentLevel >= 0 && nodeIds() != _levelsNodeIds)
+    {
+        // The component has changed since the levels were built, so they no longer
+        // correspond to its nodes; leave the remainder to the ForceDirectedLayout
+        _levels.clear();
+        _ancestors.clear();
+        _currentLevel = -1;
+    }
+
+    if(_currentLevel < 0)
+    {
+        // Either the hierarchy has been fully refined, or there never was one
+        _forceDirectedLayout->execute(firstIteration && _levels.empty(), dimensionality);
+        return;
+    }
+
+    auto& level = _levels.at(static_cast<size_t>(_currentLevel));
+    const bool coarsest = static_cast<size_t>(_currentLevel) == _levels.size() - 1;
+
+    iterate(level, dimensionality);
+
+    if(cancelled())
+        return;
+
+    if(++_iteration < (coarsest ? COARSEST_LEVEL_ITERATIONS : LEVEL_ITERATIONS))
+    {
+        updatePositions();
+        return;
+    }
+
+    _iteration = 0;
+    auto& fine = _levels.at(static_cast<size_t>(_currentLevel) - 1);
+    interpolate(level, fine, dimensionality);
+
+    // The current level is always the coarsest remaining, so it's no longer needed
+    _levels.pop_back();
+    _currentLevel--;
+
+    if(_currentLevel > 0)
+    {
+        updateAncestors();
+        updatePositions();
+        return;
+    }
+
+    // The finest level corresponds directly to the component
+    for(size_t i = 0; i < _levelsNodeIds.size(); i++)
+        positions().set(_levelsNodeIds[i], fine._positions[i]);
+
+    _levels.clear();
+    _ancestors.clear();
+    _currentLevel = -1;
+}
+
+std::unique_ptr<Layout> MultilevelForceDirectedLayoutFactory::create(ComponentId componentId,
+    NodeLayoutPositions& nodePositions, Layout::Dimensionality dimensionalityMode)
+{
+    const auto* component = _graphModel->graph().componentById(componentId);
+
+    if(component->numNodes() < MINIMUM_MULTILEVEL_COMPONENT_SIZE)
+        return ForceDirectedLayoutFactory::create(componentId, nodePositions, dimensionalityMode);
+
+    return std::make_unique<MultilevelLayout>(*component, _displacements,
+        nodePositions, dimensionalityMode, &_layoutSettings);
+}
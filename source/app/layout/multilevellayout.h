@@ -0,0 +1,123 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTILEVELLAYOUT_H
+#define MULTILEVELLAYOUT_H
+
+#include "layout.h"
+#include "forcedirectedlayout.h"
+
+#include <QVector3D>
+
+#include <vector>
+#include <memory>
+
+// A multilevel force directed layout, in the style of sfdp/FM³. The component is
+// repeatedly coarsened by edge matching, the coarsest level is laid out, then each
+// finer level is interpolated from the one above it and refined using the same
+// forces as ForceDirectedLayout. Once the finest level is reached, the remaining
+// iterations are handed over to a ForceDirectedLayout, which decides when to stop.
+class MultilevelLayout : public Layout
+{
+    Q_OBJECT
+private:
+    static const size_t MINIMUM_COARSEST_SIZE = 100;
+    static const size_t MAXIMUM_NUM_LEVELS = 32;
+    static const int COARSEST_LEVEL_ITERATIONS = 200;
+    static const int LEVEL_ITERATIONS = 50;
+
+    // If a round of coarsening doesn't reduce the number of nodes
+    // by at least this factor, there is no point in continuing
+    static constexpr float MINIMUM_COARSENING_RATIO = 0.8f;
+
+    // Roughly the natural edge length that results from the forces
+    static constexpr float INITIAL_SPREAD = 10.0f;
+    static constexpr float INTERPOLATION_JITTER = 1.0f;
+
+    struct Level
+    {
+        // Nodes are referred to by their index, in the form of NodeIds
+        std::vector<NodeId> _nodeIds;
+        std::vector<int> _mass;
+
+        // Adjacency, in compressed sparse row form
+        std::vector<int> _edgeOffsets;
+        std::vector<int> _edgeTargets;
+
+        // The index of each node's parent, in the next coarsest level
+        std::vector<int> _parents;
+
+        std::vector<QVector3D> _positions;
+        std::vector<ForceDirectedDisplacement> _displacements;
+
+        size_t numNodes() const { return _nodeIds.size(); }
+    };
+
+    std::vector<Level> _levels;
+    int _currentLevel = -1;
+    int _iteration = 0;
+
+    // The component's nodes at the time the levels were built
+    std::vector<NodeId> _levelsNodeIds;
+
+    // For each of the component's nodes, the index of its ancestor in the current level
+    std::vector<int> _ancestors;
+
+    std::unique_ptr<ForceDirectedLayout> _forceDirectedLayout;
+
+    void buildLevels(Dimensionality dimensionality);
+    bool coarsen();
+    void iterate(Level& level, Dimensionality dimensionality);
+    void interpolate(const Level& coarse, Level& fine, Dimensionality dimensionality);
+    void updateAncestors();
+    void updatePositions();
+
+public:
+    MultilevelLayout(const IGraphComponent& graphComponent,
+                     ForceDirectedDisplacements& displacements,
+                     NodeLayoutPositions& positions,
+                     Layout::Dimensionality dimensionalityMode,
+                     const LayoutSettings* settings);
+
+    void cancel() override;
+    void uncancel() override;
+
+    bool finished() const override;
+    void unfinish() override;
+
+    void execute(bool firstIteration, Dimensionality dimensionality) override;
+};
+
+class MultilevelForceDirectedLayoutFactory : public ForceDirectedLayoutFactory
+{
+private:
+    // Components smaller than this converge quickly enough without a hierarchy
+    static const int MINIMUM_MULTILEVEL_COMPONENT_SIZE = 1000;
+
+public:
+    explicit MultilevelForceDirectedLayoutFactory(GraphModel* graphModel) :
+        ForceDirectedLayoutFactory(graphModel)
+    {}
+
+    QString name() const override { return QStringLiteral("MultilevelForceDirected"); }
+    QString displayName() const override { return QObject::tr("Multilevel Force Directed"); }
+    std::unique_ptr<Layout> create(ComponentId componentId, NodeLayoutPositions& nodePositions,
+        Layout::Dimensionality dimensionalityMode) override;
+};
+
+#endif // MULTILEVELLAYOUT_H
@@ -20,315 +20,252 @@
 #define SPATIALTREE_H
 
 #include "shared/graph/igraphcomponent.h"
-#include "maths/boundingbox.h"
 #include "nodepositions.h"
 #include "shared/utils/scopetimer.h"
 #include "shared/utils/threadpool.h"
 
 #include <QVector3D>
-#include <QColor>
 
-#include <functional>
 #include <vector>
-#include <memory>
-#include <stack>
 #include <array>
-#include <cstdlib>
-
-class AbstractSpatialTree
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+// A pointerless quadtree (NumDimensions == 2) or octree (NumDimensions == 3).
+// The points are sorted by their Morton code, so that every cell of the tree covers
+// a contiguous range of them, and the cells themselves are stored breadth first
+// in a single array, with the children of each cell adjacent to each other.
+template<size_t NumDimensions>
+class SpatialTree
 {
+    static_assert(NumDimensions == 2 || NumDimensions == 3, "SpatialTree must be 2D or 3D");
+
 public:
-    virtual ~AbstractSpatialTree() = default;
-    virtual void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) = 0;
-};
+    static constexpr size_t NumSubVolumes = size_t(1) << NumDimensions;
 
-template<size_t NumDimensions>
-using BoundingBox = typename std::conditional_t<NumDimensions == 3,
-    BoundingBox3D, typename std::conditional_t<NumDimensions == 2,
-    BoundingBox2D, void>>;
+    // The number of bits per dimension in a Morton code, and
+    // hence the maximum depth to which the tree can be divided
+    static constexpr int MaxDepth = 64 / NumDimensions;
 
-template<typename TreeType, size_t NumDimensions>
-struct SubVolume
-{
-    BoundingBox<NumDimensions> _boundingBox;
-    std::vector<NodeId> _nodeIds;
-    std::unique_ptr<TreeType> _subTree;
-    bool _leaf = true;
-    bool _empty = true;
-
-    // Floating point precision means that it becomes impossible to
-    // divide a bounding box beyond a certain minimum size. We don't
-    // want to allow that to happen, obviously, so this is a means
-    // to detect whether it would and avoid subdivision if so
-    bool divisible() const
+    struct Cell
     {
-        const auto cx = _boundingBox.centre().x();
-        const auto xh = _boundingBox.xLength() * 0.5f;
+        uint32_t _first = 0;
+        uint32_t _count = 0;
+        uint32_t _firstChild = 0;
+        uint32_t _numChildren = 0;
+        int _depth = 0;
+
+        bool leaf() const { return _numChildren == 0; }
+    };
+
+private:
+    std::vector<NodeId> _nodeIds;
+    std::vector<uint64_t> _codes;
+    std::vector<Cell> _cells;
 
-        if(cx + xh == cx || cx - xh == cx)
-            return false;
+    QVector3D _min;
+    QVector3D _extent;
 
-        const auto cy = _boundingBox.centre().y();
-        const auto yh = _boundingBox.yLength() * 0.5f;
+    unsigned int _maxNodesPerLeaf = 1;
 
-        if(cy + yh == cy || cy - yh == cy)
-            return false;
+    // Positions, in the same order as _nodeIds
+    std::array<std::vector<float>, NumDimensions> _positions;
 
+    static uint64_t spreadBits(uint64_t v)
+    {
         if constexpr(NumDimensions == 3)
         {
-            const auto cz = _boundingBox.centre().z();
-            const auto zh = _boundingBox.zLength() * 0.5f;
-
-            if(cz + zh == cz || cz - zh == cz)
-                return false; // NOLINT
+            v &= 0x1fffff;
+            v = (v | (v << 32)) & 0x001f00000000ffff;
+            v = (v | (v << 16)) & 0x001f0000ff0000ff;
+            v = (v | (v <<  8)) & 0x100f00f00f00f00f;
+            v = (v | (v <<  4)) & 0x10c30c30c30c30c3;
+            v = (v | (v <<  2)) & 0x1249249249249249;
+        }
+        else
+        {
+            v &= 0xffffffff;
+            v = (v | (v << 16)) & 0x0000ffff0000ffff;
+            v = (v | (v <<  8)) & 0x00ff00ff00ff00ff;
+            v = (v | (v <<  4)) & 0x0f0f0f0f0f0f0f0f;
+            v = (v | (v <<  2)) & 0x3333333333333333;
+            v = (v | (v <<  1)) & 0x5555555555555555;
         }
 
-        return true;
+        return v;
     }
-};
 
-// Use the CRT pattern so we can create instances of subclasses by default constructor
-template<typename TreeType, size_t NumDimensions, typename SubVolumeType = SubVolume<TreeType, NumDimensions>>
-class SpatialTree : virtual public AbstractSpatialTree
-{
-private:
-    static constexpr size_t NumSubVolumes()
+    uint64_t mortonCode(const QVector3D& position) const
     {
-        size_t v = 1;
+        const auto maxQuantised = static_cast<double>((uint64_t(1) << MaxDepth) - 1);
+        uint64_t code = 0;
 
-        for(auto i = 0ul; i < NumDimensions; i++)
-            v *= 2;
+        for(size_t d = 0; d < NumDimensions; d++)
+        {
+            const auto i = static_cast<int>(d);
+            double normalised = _extent[i] > 0.0f ?
+                static_cast<double>(position[i] - _min[i]) / _extent[i] : 0.0;
 
-        return v;
-    }
+            auto quantised = static_cast<uint64_t>(std::clamp(normalised * maxQuantised, 0.0, maxQuantised));
+            code |= spreadBits(quantised) << d;
+        }
 
-    BoundingBox<NumDimensions> _boundingBox;
+        return code;
+    }
 
-protected:
-    size_t _depthFirstTraversalStackSizeRequirement = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    std::array<SubVolumeType, NumSubVolumes()> _subVolumes = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    // The index of the sub-volume that a code falls in, at a given depth
+    static size_t digit(uint64_t code, int depth)
+    {
+        const int shift = static_cast<int>(NumDimensions) * (MaxDepth - depth - 1);
+        return static_cast<size_t>((code >> shift) & (NumSubVolumes - 1));
+    }
 
-    std::array<const SubVolumeType*, NumSubVolumes()> _nonEmptyLeaves = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    int _numNonEmptyLeaves = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    Cell makeCell(uint32_t first, uint32_t count) const
+    {
+        Cell cell;
+        cell._first = first;
+        cell._count = count;
 
-    std::array<const SubVolumeType*, NumSubVolumes()> _internalNodes = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    int _numInternalNodes = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+        // The codes are sorted, so the first and last have
+        // the shortest common prefix of any in the range
+        const auto firstCode = _codes[first];
+        const auto lastCode = _codes[first + count - 1];
 
-private:
-    unsigned int _maxNodesPerLeaf = 1;
+        while(cell._depth < MaxDepth && digit(firstCode, cell._depth) == digit(lastCode, cell._depth))
+            cell._depth++;
 
-    // Temporary data structure used in the creation of the tree
-    struct NewTree
-    {
-        SpatialTree* _tree;
-        std::vector<NodeId> _nodeIds;
+        return cell;
+    }
 
-        NewTree(SpatialTree* tree, const std::vector<NodeId>& nodeIds) noexcept : // NOLINT
-            _tree(tree), _nodeIds(nodeIds)
-        {}
+protected:
+    void setMaxNodesPerLeaf(unsigned int maxNodesPerLeaf) { _maxNodesPerLeaf = maxNodesPerLeaf; }
 
-        NewTree(SpatialTree* tree, std::vector<NodeId>&& nodeIds) noexcept :
-            _tree(tree), _nodeIds(std::move(nodeIds))
-        {}
+    // Called once the structure of the tree is known
+    virtual void initialise() {}
 
-        NewTree(const NewTree& other) = default;
-        NewTree& operator=(const NewTree& other) = default;
-        NewTree(NewTree&& other) = default; // NOLINT
-        NewTree& operator=(NewTree&& other) = default; // NOLINT
-    };
+public:
+    virtual ~SpatialTree() = default;
 
-    void initialiseSubVolumes()
+    void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions)
     {
-        const auto cx = _boundingBox.centre().x();
-        const auto cy = _boundingBox.centre().y();
-        const auto xh = _boundingBox.xLength() * 0.5f;
-        const auto yh = _boundingBox.yLength() * 0.5f;
-
-        if constexpr(NumDimensions == 3)
-        {
-            const auto cz = _boundingBox.centre().z();
-            const auto zh = _boundingBox.zLength() * 0.5f;
-
-            // clang-format off
-            _subVolumes[0]._boundingBox = {{cx - xh, cy - yh, cz - zh}, {cx,      cy,      cz     }};
-            _subVolumes[1]._boundingBox = {{cx,      cy - yh, cz - zh}, {cx + xh, cy,      cz     }};
-            _subVolumes[2]._boundingBox = {{cx - xh, cy,      cz - zh}, {cx,      cy + yh, cz     }};
-            _subVolumes[3]._boundingBox = {{cx,      cy,      cz - zh}, {cx + xh, cy + yh, cz     }};
-
-            _subVolumes[4]._boundingBox = {{cx - xh, cy - yh, cz     }, {cx,      cy,      cz + zh}};
-            _subVolumes[5]._boundingBox = {{cx,      cy - yh, cz     }, {cx + xh, cy,      cz + zh}};
-            _subVolumes[6]._boundingBox = {{cx - xh, cy,      cz     }, {cx,      cy + yh, cz + zh}};
-            _subVolumes[7]._boundingBox = {{cx,      cy,      cz     }, {cx + xh, cy + yh, cz + zh}};
-            // clang-format on
-        }
-        else if constexpr(NumDimensions == 2)
-        {
-            // clang-format off
-            _subVolumes[0]._boundingBox = {{cx - xh, cy - yh}, {cx,      cy,    }};
-            _subVolumes[1]._boundingBox = {{cx,      cy - yh}, {cx + xh, cy,    }};
-            _subVolumes[2]._boundingBox = {{cx - xh, cy,    }, {cx,      cy + yh}};
-            _subVolumes[3]._boundingBox = {{cx,      cy,    }, {cx + xh, cy + yh}};
-            // clang-format on
-        }
-
-        for(auto& subVolume : _subVolumes)
-            Q_ASSERT(subVolume._boundingBox.valid());
+        build(graph.nodeIds(), [&nodePositions](NodeId nodeId) { return nodePositions.get(nodeId); });
     }
 
-    void distributeNodesOverSubVolumes(const NodeLayoutPositions& nodePositions, const std::vector<NodeId>& nodeIds)
+    // Build from an arbitrary set of NodeIds, whose positions are given by positionOf
+    template<typename PositionFn>
+    void build(const std::vector<NodeId>& nodeIds, const PositionFn& positionOf)
     {
-        initialiseSubVolumes();
+        SCOPE_TIMER_MULTISAMPLES(50)
 
-        bool distinctPositions = false;
-        QVector3D lastPosition = nodePositions.get(nodeIds[0]);
+        const auto numNodes = nodeIds.size();
 
-        // Distribute NodeIds over SubVolumes
-        for(NodeId nodeId : nodeIds)
-        {
-            const QVector3D& nodePosition = nodePositions.get(nodeId);
-            SubVolumeType& subVolume = subVolumeForPoint(nodePosition);
+        _cells.clear();
 
-            subVolume._nodeIds.push_back(nodeId);
+        if(numNodes == 0)
+            return;
 
-            if(!distinctPositions)
-            {
-                if(nodePosition != lastPosition)
-                    distinctPositions = true;
-                else
-                    lastPosition = nodePosition;
-            }
-        }
+        QVector3D min = positionOf(nodeIds.front());
+        QVector3D max = min;
 
-        // Decide if the SubVolumes need further sub-division
-        for(auto& subVolume : _subVolumes)
+        for(auto nodeId : nodeIds)
         {
-            if(subVolume._nodeIds.empty())
-                continue;
+            const QVector3D position = positionOf(nodeId);
 
-            if(subVolume._nodeIds.size() > _maxNodesPerLeaf &&
-               subVolume.divisible() && distinctPositions)
-            {
-                // Subdivide
-                subVolume._subTree = std::make_unique<TreeType>();
-                subVolume._subTree->_boundingBox = subVolume._boundingBox;
-
-                subVolume._leaf = false;
-                _internalNodes.at(_numInternalNodes++) = &subVolume;
-            }
-            else
+            for(int d = 0; d < 3; d++)
             {
-                subVolume._empty = false;
-                _nonEmptyLeaves.at(_numNonEmptyLeaves++) = &subVolume;
+                min[d] = std::min(min[d], position[d]);
+                max[d] = std::max(max[d], position[d]);
             }
         }
-    }
 
-    // The second parameter and superset of _subVolumes[x]._nodeIds are the
-    // same, at the point when this is called
-    virtual void initialise(const NodeLayoutPositions&, const std::vector<NodeId>&) {}
+        _min = min;
+        _extent = max - min;
 
-    void build(const std::vector<NodeId>& nodeIds, const NodeLayoutPositions& nodePositions)
-    {
-        SCOPE_TIMER_MULTISAMPLES(50)
+        std::vector<std::pair<uint64_t, NodeId>> sortedNodeIds(numNodes);
 
-        std::vector<NewTree> newTrees;
-        newTrees.emplace_back(this, nodeIds);
-
-        while(!newTrees.empty())
+        concurrent_for(nodeIds.begin(), nodeIds.end(),
+        [&](std::vector<NodeId>::const_iterator it)
         {
-            auto results = concurrent_for(newTrees.begin(), newTrees.end(),
-            [&nodePositions](typename std::vector<NewTree>::iterator it)
-            {
-                auto* subTree = it->_tree;
-                const auto& nodeIdsToDistribute = it->_nodeIds;
+            auto index = static_cast<size_t>(std::distance(nodeIds.begin(), it));
+            sortedNodeIds[index] = {mortonCode(positionOf(*it)), *it};
+        });
 
-                subTree->distributeNodesOverSubVolumes(nodePositions, nodeIdsToDistribute);
+        std::sort(sortedNodeIds.begin(), sortedNodeIds.end());
 
-                std::vector<NewTree> newChildTrees;
-                for(int i = 0; i < subTree->_numInternalNodes; i++)
-                {
-                    const auto* subVolume = subTree->_internalNodes.at(i);
-                    newChildTrees.emplace_back(subVolume->_subTree.get(),
-                        std::move(subVolume->_nodeIds));
-                }
+        _nodeIds.resize(numNodes);
+        _codes.resize(numNodes);
+        for(auto& dimension : _positions)
+            dimension.resize(numNodes);
 
-                subTree->initialise(nodePositions, nodeIdsToDistribute);
+        for(size_t i = 0; i < numNodes; i++)
+        {
+            const auto& [code, nodeId] = sortedNodeIds[i];
+            const QVector3D position = positionOf(nodeId);
 
-                return newChildTrees;
-            });
+            _nodeIds[i] = nodeId;
+            _codes[i] = code;
 
-            // subTrees has now been processsed, but may have resulted in more subTrees
-            newTrees.clear();
-            newTrees.insert(newTrees.end(), std::make_move_iterator(results.begin()),
-                std::make_move_iterator(results.end()));
+            for(size_t d = 0; d < NumDimensions; d++)
+                _positions[d][i] = position[static_cast<int>(d)];
         }
 
-        std::stack<const SpatialTree*> stack;
-        stack.push(this);
-        _depthFirstTraversalStackSizeRequirement = 1;
-        while(!stack.empty())
-        {
-            const SpatialTree* subTree = stack.top();
-            stack.pop();
+        // Breadth first, so that the children of a cell are always contiguous and
+        // always come after their parent; cells that would only have a single child
+        // are skipped over, by virtue of makeCell finding the deepest common cell
+        _cells.emplace_back(makeCell(0, static_cast<uint32_t>(numNodes)));
 
-            for(int i = 0; i < subTree->_numInternalNodes; i++)
-            {
-                const auto* subVolume = subTree->_internalNodes.at(i);
-                stack.push(subVolume->_subTree.get());
-                _depthFirstTraversalStackSizeRequirement =
-                    std::max(_depthFirstTraversalStackSizeRequirement, stack.size());
-            }
-        }
-    }
+        for(size_t i = 0; i < _cells.size(); i++)
+        {
+            const auto cell = _cells[i];
 
-    SubVolumeType& subVolumeForPoint(const QVector3D& point)
-    {
-        size_t i = 0;
-        QVector3D diff = point - _boundingBox.centre();
+            if(cell._count <= _maxNodesPerLeaf || cell._depth >= MaxDepth)
+                continue;
 
-        if constexpr(NumDimensions == 3)
-        {
-            if(diff.z() >= 0.0f)
-                i += 4;
-        }
+            auto firstChild = static_cast<uint32_t>(_cells.size());
+            auto childFirst = cell._first;
+            const auto end = cell._first + cell._count;
 
-        if(diff.y() >= 0.0f)
-            i += 2;
+            while(childFirst < end)
+            {
+                const auto childDigit = digit(_codes[childFirst], cell._depth);
+                auto childEnd = childFirst + 1;
 
-        if(diff.x() >= 0.0f)
-            i += 1;
+                while(childEnd < end && digit(_codes[childEnd], cell._depth) == childDigit)
+                    childEnd++;
 
-        Q_ASSERT(i < NumSubVolumes());
-        SubVolumeType& subVolume = _subVolumes.at(i);
+                _cells.emplace_back(makeCell(childFirst, childEnd - childFirst));
+                childFirst = childEnd;
+            }
 
-        if(!subVolume._leaf)
-            return subVolume._subTree->subVolumeForPoint(point);
+            _cells[i]._firstChild = firstChild;
+            _cells[i]._numChildren = static_cast<uint32_t>(_cells.size()) - firstChild;
+        }
 
-        return subVolume;
+        initialise();
     }
 
-    const SubVolumeType& subVolumeForPoint(const QVector3D& point) const
-    {
-        return subVolumeForPoint(point);
-    }
+    const std::vector<Cell>& cells() const { return _cells; }
 
-protected:
-    void setMaxNodesPerLeaf(unsigned int maxNodesPerLeaf) { _maxNodesPerLeaf = maxNodesPerLeaf; }
+    // The NodeIds in the order in which they appear in the tree
+    const std::vector<NodeId>& nodeIds() const { return _nodeIds; }
+    size_t numNodes() const { return _nodeIds.size(); }
 
-public:
-    void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) override
+    const std::vector<float>& positions(size_t dimension) const { return _positions.at(dimension); }
+
+    // The length of the longest side of a cell at the given depth
+    float cellSize(int depth) const
     {
-        if constexpr(NumDimensions == 2)
-        {
-            auto boundingBox3D = nodePositions.boundingBox(graph.nodeIds());
-            _boundingBox = {boundingBox3D.min().toVector2D(), boundingBox3D.max().toVector2D()};
-        }
-        else if constexpr(NumDimensions == 3)
-            _boundingBox = nodePositions.boundingBox(graph.nodeIds());
+        float maxExtent = std::max(_extent.x(), _extent.y());
 
-        Q_ASSERT(_boundingBox.valid());
-        build(graph.nodeIds(), nodePositions);
+        if constexpr(NumDimensions == 3)
+            maxExtent = std::max(maxExtent, _extent.z());
+
+        return maxExtent / static_cast<float>(uint64_t(1) << depth);
     }
+
+    // A stack of this size is sufficient for a depth first traversal
+    static constexpr size_t MaxTraversalStackSize = (MaxDepth + 1) * NumSubVolumes;
 };
 
 #endif // SPATIALTREE_H
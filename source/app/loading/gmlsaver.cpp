@@ -18,28 +18,60 @@
 
 #include "gmlsaver.h"
 
+#include "loading/recordwriter.h"
 #include "shared/graph/imutablegraph.h"
 #include "ui/document.h"
 
-#include <QFile>
+#include <QByteArray>
 #include <QRegularExpression>
-#include <QTextStream>
 
-bool GMLSaver::save()
-{
-    QFile file(_url.toLocalFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text);
-    int level = 0;
-
-    size_t numElements = _graphModel->attributeNames().size() +
-                       static_cast<size_t>(_graphModel->graph().numNodes()) +
-                       static_cast<size_t>(_graphModel->graph().numEdges());
-    size_t runningCount = 0;
+#include <cmath>
+#include <map>
+#include <vector>
 
-    auto escape = [](const QString& string)
+namespace
+{
+struct GMLAttribute
+{
+    const IAttribute* _attribute = nullptr;
+    QByteArray _name;
+};
+} // namespace
+
+template<typename E>
+static void appendAttributes(QByteArray& record, const QByteArray& indent,
+    const std::vector<GMLAttribute>& attributes, E elementId)
+{
+    for(const auto& [attribute, name] : attributes)
     {
-        return string.toHtmlEscaped();
-    };
+        if(attribute->valueType() == ValueType::String)
+        {
+            record.append(indent);
+            record.append(name);
+            record.append(" \"");
+            record.append(attribute->stringValueOf(elementId).toHtmlEscaped().toUtf8());
+            record.append("\"\n");
+        }
+        else if(attribute->valueType() & ValueType::Numerical)
+        {
+            auto value = attribute->numericValueOf(elementId);
+            if(!std::isnan(value))
+            {
+                record.append(indent);
+                record.append(name);
+                record.append(' ');
+                record.append(QByteArray::number(value));
+                record.append('\n');
+            }
+        }
+    }
+}
+
+bool GMLSaver::save()
+{
+    RecordWriter writer(_url.toLocalFile());
+    if(!writer.open())
+        return false;
 
     std::map<QString, QString> alphanumAttributeNames;
     _graphModel->mutableGraph().setPhase(QObject::tr("Attributes"));
@@ -67,74 +99,77 @@ bool GMLSaver::save()
         }
 
         alphanumAttributeNames[nodeAttributeName] = cleanName;
-
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
     }
 
-    QTextStream stream(&file);
-    stream << "graph\n[\n";
-    level++;
-
-    auto attributes = [&](auto elementId, const std::vector<QString>& attributeNames)
+    auto gmlAttributes = [&](ElementType elementType)
     {
-        for(const auto& attributeName : attributeNames)
+        std::vector<GMLAttribute> attributes;
+
+        for(const auto& attributeName : _graphModel->attributeNames(elementType))
         {
             const auto* attribute = _graphModel->attributeByName(attributeName);
             if(attribute->hasParameter())
                 continue;
 
-            if(attribute->valueType() == ValueType::String)
-            {
-                QString escapedValue = escape(attribute->stringValueOf(elementId));
-                stream << indent(level) << alphanumAttributeNames[attributeName] << " "
-                       << QStringLiteral(R"("%1")").arg(escapedValue) << "\n";
-            }
-            else if(attribute->valueType() & ValueType::Numerical)
-            {
-                auto value = attribute->numericValueOf(elementId);
-                if(!std::isnan(value))
-                {
-                    stream << indent(level) << alphanumAttributeNames[attributeName] << " "
-                           << value << "\n";
-                }
-            }
+            attributes.push_back({attribute, alphanumAttributeNames[attributeName].toUtf8()});
         }
+
+        return attributes;
     };
 
+    auto nodeAttributes = gmlAttributes(ElementType::Node);
+    auto edgeAttributes = gmlAttributes(ElementType::Edge);
+
+    const auto outerIndent = indent(1).toUtf8();
+    const auto innerIndent = indent(2).toUtf8();
+
+    writer.write("graph\n[\n");
+
+    const auto& nodeIds = _graphModel->graph().nodeIds();
+    const auto& edgeIds = _graphModel->graph().edgeIds();
+
     _graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
-    for(auto nodeId : _graphModel->graph().nodeIds())
+    writer.writeRecords(nodeIds.size(), [&](size_t index, QByteArray& record)
     {
-        QString nodeName = escape(_graphModel->nodeName(nodeId));
-        stream << indent(level) << "node\n[\n";
-        level++;
-        stream << indent(level) << "id " << static_cast<int>(nodeId) << "\n";
-        QString labelString = QStringLiteral(R"("%1")").arg(nodeName);
-        stream << indent(level) << "label " << labelString << "\n";
-        attributes(nodeId, _graphModel->attributeNames(ElementType::Node));
-        stream << indent(--level) << "]\n"; // node
-
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
-    }
+        auto nodeId = nodeIds.at(index);
+
+        record.append(outerIndent);
+        record.append("node\n[\n");
+        record.append(innerIndent);
+        record.append("id ");
+        record.append(QByteArray::number(static_cast<int>(nodeId)));
+        record.append('\n');
+        record.append(innerIndent);
+        record.append("label \"");
+        record.append(_graphModel->nodeName(nodeId).toHtmlEscaped().toUtf8());
+        record.append("\"\n");
+        appendAttributes(record, innerIndent, nodeAttributes, nodeId);
+        record.append(outerIndent);
+        record.append("]\n"); // node
+    }, *this, *this);
 
     _graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
-    for(auto edgeId : _graphModel->graph().edgeIds())
+    writer.writeRecords(edgeIds.size(), [&](size_t index, QByteArray& record)
     {
+        auto edgeId = edgeIds.at(index);
         const auto& edge = _graphModel->graph().edgeById(edgeId);
 
-        stream << indent(level) << "edge\n[\n";
-        level++;
-        stream << indent(level) << "source " << static_cast<int>(edge.sourceId()) << "\n";
-        stream << indent(level) << "target " << static_cast<int>(edge.targetId()) << "\n";
-        attributes(edgeId, _graphModel->attributeNames(ElementType::Edge));
-        stream << indent(--level) << "]\n"; // edge
-
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
-    }
-
-    stream << indent(--level) << "]\n"; // graph
-
-    return true;
+        record.append(outerIndent);
+        record.append("edge\n[\n");
+        record.append(innerIndent);
+        record.append("source ");
+        record.append(QByteArray::number(static_cast<int>(edge.sourceId())));
+        record.append('\n');
+        record.append(innerIndent);
+        record.append("target ");
+        record.append(QByteArray::number(static_cast<int>(edge.targetId())));
+        record.append('\n');
+        appendAttributes(record, innerIndent, edgeAttributes, edgeId);
+        record.append(outerIndent);
+        record.append("]\n"); // edge
+    }, *this, *this);
+
+    writer.write("]\n"); // graph
+
+    return writer.close() && !cancelled();
 }
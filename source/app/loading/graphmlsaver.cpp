@@ -21,14 +21,67 @@
 #include "graph/graph.h"
 #include "graph/graphmodel.h"
 #include "layout/nodepositions.h"
+#include "loading/recordwriter.h"
 #include "shared/attributes/iattribute.h"
 #include "shared/graph/imutablegraph.h"
 #include "ui/document.h"
 
-#include <QFile>
+#include <QByteArray>
 #include <QString>
 #include <QUrl>
-#include <QXmlStreamWriter>
+
+#include <map>
+#include <vector>
+
+static QByteArray xmlEscaped(const QString& string)
+{
+    auto utf8 = string.toUtf8();
+
+    // Multibyte UTF-8 sequences never contain ASCII, so it's safe to escape byte-wise
+    QByteArray escaped;
+    escaped.reserve(utf8.size());
+
+    for(auto c : utf8)
+    {
+        switch(c)
+        {
+        case '<':  escaped.append("&lt;"); break;
+        case '>':  escaped.append("&gt;"); break;
+        case '&':  escaped.append("&amp;"); break;
+        case '"':  escaped.append("&quot;"); break;
+        default:   escaped.append(c); break;
+        }
+    }
+
+    return escaped;
+}
+
+namespace
+{
+struct DataKey
+{
+    const IAttribute* _attribute = nullptr;
+    QByteArray _openTag;
+};
+} // namespace
+
+template<typename E>
+static void appendData(QByteArray& record, const std::vector<DataKey>& dataKeys, E elementId)
+{
+    for(const auto& dataKey : dataKeys)
+    {
+        record.append(dataKey._openTag);
+
+        switch(dataKey._attribute->valueType())
+        {
+        case ValueType::Int:   record.append(QByteArray::number(dataKey._attribute->intValueOf(elementId))); break;
+        case ValueType::Float: record.append(QByteArray::number(dataKey._attribute->floatValueOf(elementId))); break;
+        default:               record.append(xmlEscaped(dataKey._attribute->stringValueOf(elementId))); break;
+        }
+
+        record.append("</data>\n");
+    }
+}
 
 bool GraphMLSaver::save()
 {
@@ -38,156 +91,114 @@ bool GraphMLSaver::save()
     if(graphModel == nullptr)
         return false;
 
-    QFile file(_url.toLocalFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text);
-
-    size_t numElements = _graphModel->attributeNames().size() +
-                       static_cast<size_t>(_graphModel->graph().numNodes()) +
-                       static_cast<size_t>(_graphModel->graph().numEdges());
-    size_t runningCount = 0;
-
-    QXmlStreamWriter stream(&file);
-    stream.setAutoFormatting(true);
+    RecordWriter writer(_url.toLocalFile());
+    if(!writer.open())
+        return false;
 
-    stream.writeStartElement(QStringLiteral("graphml"));
-    stream.writeStartElement(QStringLiteral("graph"));
-    stream.writeAttribute(QStringLiteral("edgedefault"), QStringLiteral("directed"));
+    writer.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    writer.write("<graphml>\n");
+    writer.write("    <graph edgedefault=\"directed\">\n");
 
     // Add position attribute keys
-    stream.writeStartElement(QStringLiteral("key"));
-    stream.writeAttribute(QStringLiteral("id"), QStringLiteral("x"));
-    stream.writeAttribute(QStringLiteral("attr.name"), QStringLiteral("x"));
-    stream.writeAttribute(QStringLiteral("attr.type"), QStringLiteral("float"));
-    stream.writeAttribute(QStringLiteral("for"), QStringLiteral("node"));
-    stream.writeEndElement();
-
-    stream.writeStartElement(QStringLiteral("key"));
-    stream.writeAttribute(QStringLiteral("id"), QStringLiteral("y"));
-    stream.writeAttribute(QStringLiteral("attr.name"), QStringLiteral("y"));
-    stream.writeAttribute(QStringLiteral("attr.type"), QStringLiteral("float"));
-    stream.writeAttribute(QStringLiteral("for"), QStringLiteral("node"));
-    stream.writeEndElement();
-
-    stream.writeStartElement(QStringLiteral("key"));
-    stream.writeAttribute(QStringLiteral("id"), QStringLiteral("z"));
-    stream.writeAttribute(QStringLiteral("attr.name"), QStringLiteral("z"));
-    stream.writeAttribute(QStringLiteral("attr.type"), QStringLiteral("float"));
-    stream.writeAttribute(QStringLiteral("for"), QStringLiteral("node"));
-    stream.writeEndElement();
+    for(const auto* axis : {"x", "y", "z"})
+    {
+        writer.write(QByteArrayLiteral("        <key id=\"") + axis + "\" attr.name=\"" + axis +
+            "\" attr.type=\"float\" for=\"node\"/>\n");
+    }
 
     // Add attribute keys
     _graphModel->mutableGraph().setPhase(QObject::tr("Attributes"));
     int keyId = 0;
-    std::map<QString, QString> idToAttribute;
-    std::map<QString, QString> attributeToId;
+    std::vector<DataKey> nodeDataKeys;
+    std::vector<DataKey> edgeDataKeys;
     for(const auto& attributeName : _graphModel->attributeNames())
     {
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
-
         const auto* attribute = _graphModel->attributeByName(attributeName);
         if(attribute->hasParameter())
             continue;
 
-        stream.writeStartElement(QStringLiteral("key"));
-        stream.writeAttribute(QStringLiteral("id"), QStringLiteral("d%1").arg(keyId));
-        idToAttribute[QStringLiteral("d%1").arg(keyId)] = attributeName;
-        attributeToId[attributeName] = QStringLiteral("d%1").arg(keyId);
+        auto id = QByteArrayLiteral("d") + QByteArray::number(keyId++);
+        QByteArray key = "        <key id=\"" + id + "\"";
 
         if(attribute->elementType() == ElementType::Node)
-            stream.writeAttribute(QStringLiteral("for"), QStringLiteral("node"));
+            key += " for=\"node\"";
         if(attribute->elementType() == ElementType::Edge)
-            stream.writeAttribute(QStringLiteral("for"), QStringLiteral("edge"));
+            key += " for=\"edge\"";
 
-        stream.writeAttribute(QStringLiteral("attr.name"), attributeName);
+        key += " attr.name=\"" + xmlEscaped(attributeName) + "\"";
 
-        QString valueTypeToString;
+        QByteArray valueTypeToString;
         switch(attribute->valueType())
         {
-        case ValueType::Int: valueTypeToString = QStringLiteral("int"); break;
-        case ValueType::Float: valueTypeToString = QStringLiteral("float"); break;
-        case ValueType::String: valueTypeToString = QStringLiteral("string"); break;
-        case ValueType::Numerical: valueTypeToString = QStringLiteral("float"); break;
-        default: valueTypeToString = QStringLiteral("string"); break;
+        case ValueType::Int: valueTypeToString = "int"; break;
+        case ValueType::Float: valueTypeToString = "float"; break;
+        case ValueType::String: valueTypeToString = "string"; break;
+        case ValueType::Numerical: valueTypeToString = "float"; break;
+        default: valueTypeToString = "string"; break;
         }
-        stream.writeAttribute(QStringLiteral("attr.type"), valueTypeToString);
-        stream.writeEndElement();
-        keyId++;
+        key += " attr.type=\"" + valueTypeToString + "\"/>\n";
+        writer.write(key);
+
+        DataKey dataKey{attribute, "            <data key=\"" + id + "\">"};
+
+        if(attribute->elementType() == ElementType::Node)
+            nodeDataKeys.emplace_back(dataKey);
+        else if(attribute->elementType() == ElementType::Edge)
+            edgeDataKeys.emplace_back(dataKey);
     }
 
-    std::unique_lock<NodePositions> lock(graphModel->nodePositions());
+    const auto& nodeIds = _graphModel->graph().nodeIds();
+    const auto& edgeIds = _graphModel->graph().edgeIds();
+
+    // Take a copy of the positions, so that they're not locked while formatting in parallel
+    auto positions = graphModel->nodePositions().get(nodeIds);
 
     _graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
-    for(auto nodeId : _graphModel->graph().nodeIds())
+    writer.writeRecords(nodeIds.size(), [&](size_t index, QByteArray& record)
     {
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
+        auto nodeId = nodeIds.at(index);
 
-        stream.writeStartElement(QStringLiteral("node"));
-        stream.writeAttribute(QStringLiteral("id"), QStringLiteral("n%1").arg(static_cast<int>(nodeId)));
-        for(const auto& nodeAttributeName : _graphModel->attributeNames(ElementType::Node))
-        {
-            const auto* attribute = _graphModel->attributeByName(nodeAttributeName);
-            if(attribute->hasParameter())
-                continue;
-
-            stream.writeStartElement(QStringLiteral("data"));
-            stream.writeAttribute(QStringLiteral("key"), attributeToId.at(nodeAttributeName));
-            stream.writeCharacters(attribute->stringValueOf(nodeId).toHtmlEscaped());
-            stream.writeEndElement();
-        }
+        record.append("        <node id=\"n");
+        record.append(QByteArray::number(static_cast<int>(nodeId)));
+        record.append("\">\n");
 
-        stream.writeStartElement(QStringLiteral("desc"));
-        stream.writeCharacters(_graphModel->nodeName(nodeId).toHtmlEscaped());
-        stream.writeEndElement();
-
-        const auto& pos = graphModel->nodePositions().get(nodeId);
-        stream.writeStartElement(QStringLiteral("data"));
-        stream.writeAttribute(QStringLiteral("key"), QStringLiteral("x"));
-        stream.writeCharacters(QString::number(static_cast<double>(pos.x())));
-        stream.writeEndElement();
-        stream.writeStartElement(QStringLiteral("data"));
-        stream.writeAttribute(QStringLiteral("key"), QStringLiteral("y"));
-        stream.writeCharacters(QString::number(static_cast<double>(pos.y())));
-        stream.writeEndElement();
-        stream.writeStartElement(QStringLiteral("data"));
-        stream.writeAttribute(QStringLiteral("key"), QStringLiteral("z"));
-        stream.writeCharacters(QString::number(static_cast<double>(pos.z())));
-        stream.writeEndElement();
-
-        stream.writeEndElement();
-    }
+        appendData(record, nodeDataKeys, nodeId);
+
+        record.append("            <desc>");
+        record.append(xmlEscaped(_graphModel->nodeName(nodeId)));
+        record.append("</desc>\n");
+
+        const auto& position = positions.at(index);
+        record.append("            <data key=\"x\">");
+        record.append(QByteArray::number(static_cast<double>(position.x())));
+        record.append("</data>\n            <data key=\"y\">");
+        record.append(QByteArray::number(static_cast<double>(position.y())));
+        record.append("</data>\n            <data key=\"z\">");
+        record.append(QByteArray::number(static_cast<double>(position.z())));
+        record.append("</data>\n        </node>\n");
+    }, *this, *this);
 
     _graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
-    int edgeCount = 0;
-    for(auto edgeId : _graphModel->graph().edgeIds())
+    writer.writeRecords(edgeIds.size(), [&](size_t index, QByteArray& record)
     {
-        runningCount++;
-        setProgress(static_cast<int>(runningCount * 100 / numElements));
-
+        auto edgeId = edgeIds.at(index);
         const auto& edge = _graphModel->graph().edgeById(edgeId);
-        stream.writeStartElement(QStringLiteral("edge"));
-        stream.writeAttribute(QStringLiteral("id"), QStringLiteral("e%1").arg(edgeCount++));
-        stream.writeAttribute(QStringLiteral("source"),
-                              QStringLiteral("n%1").arg(static_cast<int>(edge.sourceId())));
-        stream.writeAttribute(QStringLiteral("target"),
-                              QStringLiteral("n%1").arg(static_cast<int>(edge.targetId())));
-        for(const auto& edgeAttributeName : _graphModel->attributeNames(ElementType::Edge))
-        {
-            const auto* attribute = _graphModel->attributeByName(edgeAttributeName);
-            if(attribute->hasParameter())
-                continue;
-
-            stream.writeStartElement(QStringLiteral("data"));
-            stream.writeAttribute(QStringLiteral("key"), attributeToId.at(edgeAttributeName));
-            stream.writeCharacters(attribute->stringValueOf(edgeId).toHtmlEscaped());
-            stream.writeEndElement();
-        }
-        stream.writeEndElement(); // edge
-    }
-    stream.writeEndElement(); // graph
-    stream.writeEndElement(); // graphml
 
-    stream.writeEndDocument();
-    return true;
+        record.append("        <edge id=\"e");
+        record.append(QByteArray::number(static_cast<qulonglong>(index)));
+        record.append("\" source=\"n");
+        record.append(QByteArray::number(static_cast<int>(edge.sourceId())));
+        record.append("\" target=\"n");
+        record.append(QByteArray::number(static_cast<int>(edge.targetId())));
+        record.append("\">\n");
+
+        appendData(record, edgeDataKeys, edgeId);
+
+        record.append("        </edge>\n");
+    }, *this, *this);
+
+    writer.write("    </graph>\n");
+    writer.write("</graphml>\n");
+
+    return writer.close() && !cancelled();
 }
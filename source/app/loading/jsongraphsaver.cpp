@@ -19,6 +19,7 @@
 #include "jsongraphsaver.h"
 
 #include "nativesaver.h"
+#include "loading/recordwriter.h"
 #include "shared/attributes/iattribute.h"
 #include "shared/graph/igraph.h"
 #include "shared/graph/igraphmodel.h"
@@ -27,75 +28,175 @@
 
 #include <json_helper.h>
 
-#include <QDebug>
-#include <QFile>
+#include <QByteArray>
+#include <QLocale>
 
-bool JSONGraphSaver::save()
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static QByteArray jsonEscaped(const QString& string)
 {
-    json fileObject;
-    fileObject["graph"] = graphAsJson(_graphModel->graph(), *this);
-    setProgress(-1);
+    auto utf8 = string.toUtf8();
 
-    int numElements = _graphModel->graph().numNodes() + _graphModel->graph().numEdges();
-    int runningCount = 0;
+    QByteArray escaped;
+    escaped.reserve(utf8.size() + 2);
+    escaped.append('"');
 
-    // Node Attributes
-    _graphModel->mutableGraph().setPhase(QObject::tr("Node Attributes"));
-    for(auto& node : fileObject["graph"]["nodes"])
+    for(auto c : utf8)
     {
-        NodeId nodeId = std::stoi(node["id"].get<std::string>());
-        for(const auto& nodeAttributeName : _graphModel->attributeNames(ElementType::Node))
+        switch(c)
         {
-            const auto* attribute = _graphModel->attributeByName(nodeAttributeName);
-            if(attribute->hasParameter())
-                continue;
+        case '"':  escaped.append("\\\""); break;
+        case '\\': escaped.append("\\\\"); break;
+        case '\b': escaped.append("\\b"); break;
+        case '\f': escaped.append("\\f"); break;
+        case '\n': escaped.append("\\n"); break;
+        case '\r': escaped.append("\\r"); break;
+        case '\t': escaped.append("\\t"); break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20)
+            {
+                escaped.append("\\u00");
+                escaped.append(QByteArray::number(static_cast<int>(c), 16).rightJustified(2, '0'));
+            }
+            else
+                escaped.append(c);
+
+            break;
+        }
+    }
 
-            auto byteArray = nodeAttributeName.toUtf8();
-            const auto* name = byteArray.constData();
+    escaped.append('"');
 
-            if(attribute->valueType() == ValueType::String)
-                node["metadata"][name] = attribute->stringValueOf(nodeId);
-            else if(attribute->valueType() == ValueType::Int)
-                node["metadata"][name] = attribute->intValueOf(nodeId);
-            else if(attribute->valueType() == ValueType::Float)
-                node["metadata"][name] = attribute->floatValueOf(nodeId);
-        }
+    return escaped;
+}
+
+namespace
+{
+struct JSONAttribute
+{
+    const IAttribute* _attribute = nullptr;
+    QByteArray _key;
+};
+} // namespace
 
-        runningCount++;
-        setProgress(runningCount * 100 / numElements);
+template<typename E>
+static void appendMetadata(QByteArray& record, const std::vector<JSONAttribute>& attributes, E elementId)
+{
+    if(attributes.empty())
+        return;
+
+    record.append(",\"metadata\":{");
+
+    for(size_t i = 0; i < attributes.size(); i++)
+    {
+        const auto& [attribute, key] = attributes.at(i);
+
+        if(i > 0)
+            record.append(',');
+
+        record.append(key);
+        record.append(':');
+
+        if(attribute->valueType() == ValueType::String)
+            record.append(jsonEscaped(attribute->stringValueOf(elementId)));
+        else if(attribute->valueType() == ValueType::Int)
+            record.append(QByteArray::number(attribute->intValueOf(elementId)));
+        else
+        {
+            auto value = attribute->floatValueOf(elementId);
+
+            if(std::isfinite(value))
+                record.append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+            else
+                record.append("null");
+        }
     }
 
-    // Edge Attributes
-    _graphModel->mutableGraph().setPhase(QObject::tr("Edge Attributes"));
-    for(auto& edge : fileObject["graph"]["edges"])
+    record.append('}');
+}
+
+bool JSONGraphSaver::save()
+{
+    RecordWriter writer(_url.toLocalFile());
+    if(!writer.open())
+        return false;
+
+    // The keys are written in sorted order, as they would be by json::dump
+    auto jsonAttributes = [this](ElementType elementType)
     {
-        EdgeId edgeId = std::stoi(edge["id"].get<std::string>());
-        for(const auto& edgeAttributeName : _graphModel->attributeNames(ElementType::Edge))
+        std::vector<JSONAttribute> attributes;
+
+        for(const auto& attributeName : _graphModel->attributeNames(elementType))
         {
-            const auto* attribute = _graphModel->attributeByName(edgeAttributeName);
+            const auto* attribute = _graphModel->attributeByName(attributeName);
             if(attribute->hasParameter())
                 continue;
 
-            auto byteArray = edgeAttributeName.toUtf8();
-            const auto* name = byteArray.constData();
-
-            if(attribute->valueType() == ValueType::String)
-                edge["metadata"][name] = attribute->stringValueOf(edgeId);
-            else if(attribute->valueType() == ValueType::Int)
-                edge["metadata"][name] = attribute->intValueOf(edgeId);
-            else if(attribute->valueType() == ValueType::Float)
-                edge["metadata"][name] = attribute->floatValueOf(edgeId);
+            if(attribute->valueType() == ValueType::String ||
+                attribute->valueType() == ValueType::Int ||
+                attribute->valueType() == ValueType::Float)
+            {
+                attributes.push_back({attribute, jsonEscaped(attributeName)});
+            }
         }
 
-        runningCount++;
-        setProgress(runningCount * 100 / numElements);
-    }
+        std::sort(attributes.begin(), attributes.end(),
+            [](const auto& a, const auto& b) { return a._key < b._key; });
+
+        return attributes;
+    };
+
+    auto nodeAttributes = jsonAttributes(ElementType::Node);
+    auto edgeAttributes = jsonAttributes(ElementType::Edge);
+
+    const auto& graph = _graphModel->graph();
+    const auto& nodeIds = graph.nodeIds();
+    const auto& edgeIds = graph.edgeIds();
+
+    writer.write(R"({"graph":{"directed":true,"edges":[)");
+
+    _graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
+    writer.writeRecords(edgeIds.size(), [&](size_t index, QByteArray& record)
+    {
+        auto edgeId = edgeIds.at(index);
+        const auto& edge = graph.edgeById(edgeId);
+
+        if(index > 0)
+            record.append(',');
+
+        record.append(R"({"id":")");
+        record.append(QByteArray::number(static_cast<int>(edgeId)));
+        record.append('"');
+        appendMetadata(record, edgeAttributes, edgeId);
+        record.append(R"(,"source":")");
+        record.append(QByteArray::number(static_cast<int>(edge.sourceId())));
+        record.append(R"(","target":")");
+        record.append(QByteArray::number(static_cast<int>(edge.targetId())));
+        record.append(R"("})");
+    }, *this, *this);
+
+    writer.write(R"(],"nodes":[)");
+
+    _graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
+    writer.writeRecords(nodeIds.size(), [&](size_t index, QByteArray& record)
+    {
+        auto nodeId = nodeIds.at(index);
+
+        if(index > 0)
+            record.append(',');
+
+        record.append(R"({"id":")");
+        record.append(QByteArray::number(static_cast<int>(nodeId)));
+        record.append('"');
+        appendMetadata(record, nodeAttributes, nodeId);
+        record.append('}');
+    }, *this, *this);
+
+    writer.write("]}}");
 
-    QFile file(_url.toLocalFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text);
-    file.write(QByteArray::fromStdString(fileObject.dump()));
-    file.close();
-    return true;
+    return writer.close() && !cancelled();
 }
 
 json JSONGraphSaver::graphAsJson(const IGraph& graph, Progressable& progressable)
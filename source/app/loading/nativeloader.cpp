@@ -27,8 +27,8 @@
 #include "shared/plugins/iplugin.h"
 #include "shared/utils/scope_exit.h"
 #include "shared/utils/container.h"
-#include "shared/loading/progress_iterator.h"
 #include "shared/loading/jsongraphparser.h"
+#include "shared/loading/jsonstreamreader.h"
 
 #include <QString>
 #include <QDataStream>
@@ -283,34 +283,52 @@ bool Loader::parse(const QUrl& url, IGraphModel* igraphModel)
 
     graphModel->mutableGraph().setPhase(QObject::tr("Parsing"));
 
-    auto jsonArray = parseJsonFrom(byteArray, this);
+    const auto* begin = byteArray.constData();
+    JsonStreamReader reader(begin, begin + byteArray.size());
 
-    if(cancelled())
+    // The document is an array of two objects: the header, which has already been
+    // parsed, and the body, whose values are parsed one at a time, with the graph
+    // itself being read directly into the graph model, so that the document as a
+    // whole is never held as a DOM
+    if(!reader.beginArray() || !reader.nextElement() ||
+        !reader.nextIsObject() || !reader.skipValue())
+    {
         return false;
+    }
 
-    if(jsonArray.is_null() || !jsonArray.is_array())
+    if(!reader.nextElement() || !reader.nextIsObject() || !reader.beginObject())
         return false;
 
-    if(jsonArray.size() != 2)
-        return false;
+    json jsonBody = json::object();
+    bool graphFound = false;
+    std::string key;
 
-    auto allObjects = std::all_of(jsonArray.begin(), jsonArray.end(),
-    [](const auto& i)
+    while(reader.nextKey(key))
     {
-       return i.is_object();
-    });
+        if(key == "graph")
+        {
+            if(!reader.nextIsObject())
+                return false;
 
-    if(!allObjects)
-        return false;
+            if(!JsonGraphParser::parseGraphObject(reader, graphModel, *this, true))
+                return false;
 
-    auto jsonBody = jsonArray.at(1);
+            graphFound = true;
+        }
+        else
+            jsonBody[key] = reader.readValue();
 
-    if(!u::contains(jsonBody, "graph") || !jsonBody["graph"].is_object())
-        return false;
+        if(cancelled() || reader.failed())
+            return false;
 
-    const auto& jsonGraph = jsonBody["graph"];
+        setProgress(static_cast<int>((reader.offset() * 100) / reader.size()));
+    }
+
+    // There should be nothing beyond the body
+    if(reader.nextElement() || reader.failed() || !reader.atEnd())
+        return false;
 
-    if(!JsonGraphParser::parseGraphObject(jsonGraph, graphModel, *this, true))
+    if(!graphFound)
         return false;
 
     setProgress(-1);
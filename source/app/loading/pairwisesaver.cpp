@@ -18,62 +18,61 @@
 
 #include "pairwisesaver.h"
 
+#include "loading/recordwriter.h"
 #include "shared/attributes/iattribute.h"
 #include "shared/graph/igraph.h"
 #include "shared/graph/igraphmodel.h"
 #include "shared/graph/imutablegraph.h"
 #include "ui/document.h"
 
-#include <QFile>
-#include <QRegularExpression>
+#include <QByteArray>
 #include <QString>
-#include <QTextStream>
 
 bool PairwiseSaver::save()
 {
-    QFile file(_url.toLocalFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text);
+    RecordWriter writer(_url.toLocalFile());
+    if(!writer.open())
+        return false;
 
-    QTextStream stream(&file);
-    int edgeCount = _graphModel->graph().numEdges();
-    int runningCount = 0;
-
-    auto escape = [](QString string)
+    auto quotedName = [this](NodeId nodeId)
     {
-        string.replace(QStringLiteral(R"(")"), QStringLiteral(R"(\")"));
-        return string;
+        auto name = _graphModel->nodeName(nodeId);
+
+        if(name.isEmpty())
+            name = QString::number(static_cast<int>(nodeId));
+        else
+            name.replace(QStringLiteral(R"(")"), QStringLiteral(R"(\")"));
+
+        return '"' + name.toUtf8() + '"';
     };
 
+    const IAttribute* edgeWeightAttribute = nullptr;
+    if(_graphModel->attributeExists(QStringLiteral("Edge Weight")) &&
+       _graphModel->attributeByName(QStringLiteral("Edge Weight"))->valueType() & ValueType::Numerical)
+    {
+        edgeWeightAttribute = _graphModel->attributeByName(QStringLiteral("Edge Weight"));
+    }
+
+    const auto& edgeIds = _graphModel->graph().edgeIds();
+
     _graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
-    for(auto edgeId : _graphModel->graph().edgeIds())
+    writer.writeRecords(edgeIds.size(), [&](size_t index, QByteArray& record)
     {
+        auto edgeId = edgeIds.at(index);
         const auto& edge = _graphModel->graph().edgeById(edgeId);
-        auto sourceName = escape(_graphModel->nodeName(edge.sourceId()));
-        auto targetName = escape(_graphModel->nodeName(edge.targetId()));
-
-        if(sourceName.isEmpty())
-            sourceName = QString::number(static_cast<int>(edge.sourceId()));
 
-        if(targetName.isEmpty())
-            targetName = QString::number(static_cast<int>(edge.targetId()));
+        record.append(quotedName(edge.sourceId()));
+        record.append(' ');
+        record.append(quotedName(edge.targetId()));
 
-        if(_graphModel->attributeExists(QStringLiteral("Edge Weight")) &&
-           _graphModel->attributeByName(QStringLiteral("Edge Weight"))->valueType() & ValueType::Numerical)
-        {
-            const auto* attribute = _graphModel->attributeByName(QStringLiteral("Edge Weight"));
-            stream << QStringLiteral(R"("%1")").arg(sourceName) << " "
-                   << QStringLiteral(R"("%1")").arg(targetName) << " " << attribute->floatValueOf(edgeId)
-                   << "\n";
-        }
-        else
+        if(edgeWeightAttribute != nullptr)
         {
-            stream << QStringLiteral(R"("%1")").arg(sourceName) << " "
-                   << QStringLiteral(R"("%1")").arg(targetName) << "\n";
+            record.append(' ');
+            record.append(QByteArray::number(edgeWeightAttribute->floatValueOf(edgeId)));
         }
 
-        runningCount++;
-        setProgress(runningCount * 100 / edgeCount);
-    }
+        record.append('\n');
+    }, *this, *this);
 
-    return true;
+    return writer.close() && !cancelled();
 }
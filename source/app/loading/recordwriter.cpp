@@ -0,0 +1,135 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recordwriter.h"
+
+#include <zlib.h>
+
+static const int BufferSize = 1 << 20;
+
+RecordWriter::RecordWriter(const QString& filePath) :
+    _file(filePath)
+{
+    if(filePath.endsWith(QStringLiteral(".gz"), Qt::CaseInsensitive))
+        _zstream = std::make_unique<z_stream>();
+}
+
+RecordWriter::~RecordWriter()
+{
+    close();
+}
+
+bool RecordWriter::open()
+{
+    _buffer.reserve(BufferSize);
+
+    if(_zstream != nullptr)
+    {
+        auto ret = deflateInit2(_zstream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                MAX_WBITS + 16, // 16 means write gzip header/trailer
+                                8, Z_DEFAULT_STRATEGY);
+        if(ret != Z_OK)
+        {
+            _zstream = nullptr;
+            return false;
+        }
+
+        return _file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+
+    return _file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+}
+
+bool RecordWriter::close()
+{
+    if(!_file.isOpen())
+        return !_failed;
+
+    flush(true);
+
+    if(_zstream != nullptr)
+    {
+        deflateEnd(_zstream.get());
+        _zstream = nullptr;
+    }
+
+    _file.close();
+
+    return !_failed;
+}
+
+void RecordWriter::write(const QByteArray& bytes)
+{
+    _buffer.append(bytes);
+
+    if(_buffer.size() >= BufferSize)
+        flush();
+}
+
+void RecordWriter::write(const char* bytes)
+{
+    _buffer.append(bytes);
+
+    if(_buffer.size() >= BufferSize)
+        flush();
+}
+
+bool RecordWriter::flush(bool finish)
+{
+    if(_failed)
+        return false;
+
+    if(_zstream == nullptr)
+    {
+        if(_file.write(_buffer) != _buffer.size())
+            _failed = true;
+
+        _buffer.resize(0);
+        return !_failed;
+    }
+
+    const int ChunkSize = 1 << 14;
+    std::vector<unsigned char> outBuffer(ChunkSize);
+
+    _zstream->avail_in = static_cast<uInt>(_buffer.size());
+    _zstream->next_in = reinterpret_cast<z_const Bytef*>(_buffer.constData());
+    auto mode = finish ? Z_FINISH : Z_NO_FLUSH;
+
+    do
+    {
+        _zstream->avail_out = ChunkSize;
+        _zstream->next_out = static_cast<Bytef*>(outBuffer.data());
+
+        if(deflate(_zstream.get(), mode) == Z_STREAM_ERROR)
+        {
+            _failed = true;
+            break;
+        }
+
+        auto numBytes = ChunkSize - static_cast<int>(_zstream->avail_out);
+        if(_file.write(reinterpret_cast<const char*>(outBuffer.data()), numBytes) != numBytes) // NOLINT
+        {
+            _failed = true;
+            break;
+        }
+
+    } while(_zstream->avail_out == 0);
+
+    _buffer.resize(0);
+    return !_failed;
+}
@@ -0,0 +1,108 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDWRITER_H
+#define RECORDWRITER_H
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/progressable.h"
+#include "shared/utils/threadpool.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+struct z_stream_s;
+
+// Writes to a file through a buffer, gzip compressing the output on the fly if the
+// file name ends with .gz; records can be formatted in parallel, but are always
+// written in order and only a bounded number of them are held in memory at once
+class RecordWriter
+{
+private:
+    QFile _file;
+    QByteArray _buffer;
+    std::unique_ptr<z_stream_s> _zstream;
+    bool _failed = false;
+
+    bool flush(bool finish = false);
+
+public:
+    explicit RecordWriter(const QString& filePath);
+    ~RecordWriter();
+
+    bool open();
+    bool close();
+
+    void write(const QByteArray& bytes);
+    void write(const char* bytes);
+
+    // Calls formatFn(index, QByteArray&) for each index in [0, numRecords), in parallel
+    template<typename Fn>
+    bool writeRecords(size_t numRecords, Fn&& formatFn,
+        Progressable& progressable, const Cancellable& cancellable)
+    {
+        const size_t ChunkSize = 1 << 12;
+        const size_t ChunksPerBatch = 4 * std::max(std::thread::hardware_concurrency(), 1u);
+
+        auto numChunks = (numRecords + ChunkSize - 1) / ChunkSize;
+
+        std::vector<size_t> chunkIndices(std::min(numChunks, ChunksPerBatch));
+        std::vector<QByteArray> chunks(chunkIndices.size());
+
+        for(size_t firstChunk = 0; firstChunk < numChunks; firstChunk += ChunksPerBatch)
+        {
+            if(cancellable.cancelled())
+                return false;
+
+            auto lastChunk = std::min(firstChunk + ChunksPerBatch, numChunks);
+            chunkIndices.resize(lastChunk - firstChunk);
+            std::iota(chunkIndices.begin(), chunkIndices.end(), firstChunk);
+
+            concurrent_for(chunkIndices.cbegin(), chunkIndices.cend(),
+            [&](size_t chunkIndex)
+            {
+                auto& chunk = chunks.at(chunkIndex - firstChunk);
+                chunk.clear();
+
+                auto first = chunkIndex * ChunkSize;
+                auto last = std::min(first + ChunkSize, numRecords);
+
+                for(auto i = first; i < last; i++)
+                    formatFn(i, chunk);
+            });
+
+            for(size_t i = 0; i < chunkIndices.size(); i++)
+                write(chunks.at(i));
+
+            progressable.setProgress(static_cast<int>((lastChunk * 100) / numChunks));
+        }
+
+        progressable.setProgress(-1);
+
+        return !_failed;
+    }
+};
+
+#endif // RECORDWRITER_H
@@ -226,11 +226,13 @@ int start(int argc, char *argv[])
     u::definePref(QStringLiteral("visuals/transitionTime"),                 1.0);
 
     u::definePref(QStringLiteral("visuals/disableMultisampling"),           false);
+    u::definePref(QStringLiteral("visuals/softwareScreenshots"),            false);
 
     u::definePref(QStringLiteral("misc/maxUndoLevels"),                     25);
 
     u::definePref(QStringLiteral("misc/showGraphMetrics"),                  false);
     u::definePref(QStringLiteral("misc/showLayoutSettings"),                false);
+    u::definePref(QStringLiteral("misc/multilevelLayout"),                  false);
 
     u::definePref(QStringLiteral("misc/focusFoundNodes"),                   true);
     u::definePref(QStringLiteral("misc/focusFoundComponents"),              true);
@@ -242,6 +244,9 @@ int start(int argc, char *argv[])
 
     u::definePref(QStringLiteral("misc/autoBackgroundUpdateCheck"),         true);
 
+    u::definePref(QStringLiteral("misc/persistentTransformCache"),          false);
+    u::definePref(QStringLiteral("misc/persistentTransformCacheSize"),      1024); // MiB
+
     u::definePref(QStringLiteral("screenshot/width"),                       1920);
     u::definePref(QStringLiteral("screenshot/height"),                      1080);
     u::definePref(QStringLiteral("screenshot/path"),
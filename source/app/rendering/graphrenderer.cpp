@@ -38,6 +38,7 @@
 
 #include "shadertools.h"
 #include "screenshotrenderer.h"
+#include "softwarerenderer.h"
 
 #include <QObject>
 #include <QOpenGLFramebufferObjectFormat>
@@ -103,6 +104,18 @@ GraphRenderer::GraphRenderer(GraphModel* graphModel,
     connect(_screenshotRenderer.get(), &ScreenshotRenderer::screenshotComplete, this, &GraphRenderer::screenshotComplete);
     connect(_screenshotRenderer.get(), &ScreenshotRenderer::previewComplete, this, &GraphRenderer::previewComplete);
 
+    _softwareRenderer = std::make_unique<SoftwareRenderer>();
+    connect(_softwareRenderer.get(), &SoftwareRenderer::screenshotComplete, this, &GraphRenderer::screenshotComplete);
+    connect(_softwareRenderer.get(), &SoftwareRenderer::previewComplete, this, &GraphRenderer::previewComplete);
+
+    // Rendering large screenshots through a software OpenGL implementation is
+    // extremely slow, so in that case use our own CPU renderer instead
+    const auto* glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER)); // NOLINT
+    _softwareOpenGL = glRenderer != nullptr && (
+        QString(glRenderer).contains(QStringLiteral("llvmpipe"), Qt::CaseInsensitive) ||
+        QString(glRenderer).contains(QStringLiteral("softpipe"), Qt::CaseInsensitive) ||
+        QString(glRenderer).contains(QStringLiteral("SwiftShader"), Qt::CaseInsensitive));
+
     connect(&_preferencesWatcher, &PreferencesWatcher::preferenceChanged,
         this, &GraphRenderer::onPreferenceChanged, Qt::DirectConnection);
 
@@ -391,14 +404,25 @@ void GraphRenderer::updateGPUData(GraphRenderer::When when)
         updateGPUDataIfRequired();
 }
 
+bool GraphRenderer::softwareScreenshots() const
+{
+    return _softwareOpenGL || u::pref("visuals/softwareScreenshots").toBool();
+}
+
 void GraphRenderer::onPreviewRequested(int width, int height, bool fillSize)
 {
-    _screenshotRenderer->requestPreview(*this, width, height, fillSize);
+    if(softwareScreenshots())
+        _softwareRenderer->requestPreview(*this, width, height, fillSize);
+    else
+        _screenshotRenderer->requestPreview(*this, width, height, fillSize);
 }
 
 void GraphRenderer::onScreenshotRequested(int width, int height, const QString& path, int dpi, bool fillSize)
 {
-    _screenshotRenderer->requestScreenshot(*this, width, height, path, dpi, fillSize);
+    if(softwareScreenshots())
+        _softwareRenderer->requestScreenshot(*this, width, height, path, dpi, fillSize);
+    else
+        _screenshotRenderer->requestScreenshot(*this, width, height, path, dpi, fillSize);
 }
 
 void GraphRenderer::updateComponentGPUData()
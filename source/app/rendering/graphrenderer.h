@@ -98,6 +98,7 @@ class GraphRenderer :
 
     friend class GraphComponentRenderer;
     friend class ScreenshotRenderer;
+    friend class SoftwareRenderer;
     friend void initialiseFromGraph<GraphRenderer>(const Graph*, GraphRenderer&);
 
 public:
@@ -248,6 +249,12 @@ private:
 
     PerformanceCounter _performanceCounter;
     std::unique_ptr<ScreenshotRenderer> _screenshotRenderer;
+    std::unique_ptr<SoftwareRenderer> _softwareRenderer;
+
+    // True when the OpenGL implementation is itself a software rasteriser
+    bool _softwareOpenGL = false;
+
+    bool softwareScreenshots() const;
 
     GLuint sdfTexture() const override;
     GLuint sdfTextureOffscreen() const;
@@ -143,6 +143,7 @@ struct GPUGraphData : OpenGLFunctions
 class GraphRendererCore : public OpenGLFunctions
 {
     friend class ScreenshotRenderer;
+    friend class SoftwareRenderer;
 
 public:
     GraphRendererCore();
@@ -0,0 +1,1026 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "softwarerenderer.h"
+
+#include "graphrenderer.h"
+
+#include "shared/utils/threadpool.h"
+#include "shared/utils/preferences.h"
+#include "shared/utils/constants.h"
+
+#include <QVector3D>
+#include <QVector4D>
+#include <QMatrix4x4>
+#include <QBuffer>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <mutex>
+
+// Each tile is rendered independently, and supersampled to match the
+// multisampling the OpenGL renderer uses
+static const int TILE_SIZE = 64;
+static const int SAMPLES_PER_AXIS = 2;
+static const int NUM_SAMPLES = SAMPLES_PER_AXIS * SAMPLES_PER_AXIS;
+static const int TILE_SAMPLE_SIZE = TILE_SIZE * SAMPLES_PER_AXIS;
+
+// These match the edge vertex shader
+static const float MAX_ARROW_HEAD_LENGTH = 0.25f;
+static const float ARROW_HEAD_LENGTH_SCALE = 4.0f;
+static const float ARROW_HEAD_RADIUS_SCALE = 2.0f;
+
+// These match the graph fragment shaders
+static const float NODE_DOT_SIZE = 0.2f;
+static const float EDGE_STRIPE_BOUNDS = 0.375f;
+
+namespace
+{
+struct ComponentTransform
+{
+    QMatrix4x4 _modelViewMatrix;
+    QMatrix4x4 _projectionMatrix;
+    QMatrix4x4 _inverseProjectionMatrix;
+    float _lightOffset = 0.0f;
+    float _lightScale = 0.0f;
+    bool _orthographic = false;
+};
+
+struct Ray
+{
+    QVector3D _origin;
+    QVector3D _direction;
+};
+
+struct Light
+{
+    QVector3D _position;
+    QVector3D _color;
+};
+
+struct Material
+{
+    QVector3D _ka{0.02f, 0.02f, 0.02f};
+    QVector3D _ks{1.0f, 1.0f, 1.0f};
+    float _shininess = 50.0f;
+};
+
+// Inclusive pixel bounds
+struct Bounds
+{
+    int _left = 0;
+    int _top = 0;
+    int _right = -1;
+    int _bottom = -1;
+
+    bool empty() const { return _right < _left || _bottom < _top; }
+};
+
+struct NodePrimitive
+{
+    int _component = -1;
+    Bounds _bounds;
+    QVector3D _centre;
+    float _radius = 0.0f;
+    QVector3D _forward;
+    QVector3D _right;
+    QVector3D _up;
+    QVector3D _outerColor;
+    QVector3D _innerColor;
+};
+
+struct EdgePrimitive
+{
+    int _component = -1;
+    Bounds _bounds;
+    QVector3D _source;
+    QVector3D _shaftEnd;
+    float _radius = 0.0f;
+    QVector3D _direction;
+    float _sourceSize = 0.0f;
+    float _lengthMinusNodeRadii = 0.0f;
+
+    bool _hasArrowHead = false;
+    QVector3D _arrowTip;
+    float _arrowHeadLength = 0.0f;
+    float _arrowHeadRadius = 0.0f;
+
+    QVector3D _outerColor;
+    QVector3D _innerColor;
+};
+
+struct GlyphPrimitive
+{
+    int _component = -1;
+    Bounds _bounds;
+    QVector3D _origin;
+    float _width = 0.0f;
+    float _height = 0.0f;
+
+    int _layer = -1;
+    float _u = 0.0f;
+    float _v = 0.0f;
+    float _uSize = 0.0f;
+    float _vSize = 0.0f;
+
+    QVector3D _color;
+};
+
+struct PreparedLayer
+{
+    std::vector<NodePrimitive> _nodes;
+    std::vector<EdgePrimitive> _edges;
+    std::vector<GlyphPrimitive> _glyphs;
+
+    struct Bin
+    {
+        std::vector<int> _nodes;
+        std::vector<int> _edges;
+        std::vector<int> _glyphs;
+
+        bool empty() const { return _nodes.empty() && _edges.empty() && _glyphs.empty(); }
+    };
+
+    std::vector<Bin> _bins;
+
+    float _alpha = 0.0f;
+    bool _clearDepth = false;
+    bool _disableAlphaBlending = false;
+};
+
+struct Sample
+{
+    QVector4D _color;
+    float _depth = 0.0f;
+};
+} // namespace
+
+static QVector3D toVector3D(const float v[3])
+{
+    return {v[0], v[1], v[2]};
+}
+
+// The bounds in pixels of an axis aligned view space box
+static Bounds screenBounds(const QVector3D& min, const QVector3D& max,
+    const QMatrix4x4& projectionMatrix, QSize size)
+{
+    const Bounds fullBounds{0, 0, size.width() - 1, size.height() - 1};
+
+    float left = std::numeric_limits<float>::max();
+    float right = std::numeric_limits<float>::lowest();
+    float top = std::numeric_limits<float>::max();
+    float bottom = std::numeric_limits<float>::lowest();
+    int numBehind = 0;
+
+    for(int i = 0; i < 8; i++)
+    {
+        QVector4D corner((i & 1) ? max.x() : min.x(),
+            (i & 2) ? max.y() : min.y(),
+            (i & 4) ? max.z() : min.z(), 1.0f);
+
+        auto clip = projectionMatrix * corner;
+
+        if(clip.w() <= std::numeric_limits<float>::epsilon())
+        {
+            numBehind++;
+            continue;
+        }
+
+        auto x = ((clip.x() / clip.w()) + 1.0f) * 0.5f * static_cast<float>(size.width());
+        auto y = (1.0f - (clip.y() / clip.w())) * 0.5f * static_cast<float>(size.height());
+
+        left = std::min(left, x);
+        right = std::max(right, x);
+        top = std::min(top, y);
+        bottom = std::max(bottom, y);
+    }
+
+    if(numBehind == 8)
+        return {};
+
+    // Part of the box is behind the camera, so assume it covers everything
+    if(numBehind > 0)
+        return fullBounds;
+
+    // Clamp before converting, as points close to the camera plane can project a long way off screen
+    auto width = static_cast<float>(size.width());
+    auto height = static_cast<float>(size.height());
+
+    Bounds bounds;
+    bounds._left = static_cast<int>(std::floor(std::clamp(left, 0.0f, width)));
+    bounds._top = static_cast<int>(std::floor(std::clamp(top, 0.0f, height)));
+    bounds._right = std::min(size.width() - 1, static_cast<int>(std::ceil(std::clamp(right, -1.0f, width))));
+    bounds._bottom = std::min(size.height() - 1, static_cast<int>(std::ceil(std::clamp(bottom, -1.0f, height))));
+
+    return bounds;
+}
+
+static float rayIntersectsSphere(const Ray& ray, const QVector3D& centre, float radius)
+{
+    auto oc = ray._origin - centre;
+    auto b = QVector3D::dotProduct(oc, ray._direction);
+    auto c = QVector3D::dotProduct(oc, oc) - (radius * radius);
+    auto h = (b * b) - c;
+
+    if(h < 0.0f)
+        return -1.0f;
+
+    h = std::sqrt(h);
+    auto t = -b - h;
+
+    return t >= 0.0f ? t : -b + h;
+}
+
+// An uncapped cylinder from a to b; y is set to the normalised distance along the axis
+static float rayIntersectsCylinder(const Ray& ray, const QVector3D& a, const QVector3D& b,
+    float radius, float& y)
+{
+    auto ba = b - a;
+    auto oc = ray._origin - a;
+
+    auto baba = QVector3D::dotProduct(ba, ba);
+    auto bard = QVector3D::dotProduct(ba, ray._direction);
+    auto baoc = QVector3D::dotProduct(ba, oc);
+
+    auto k2 = baba - (bard * bard);
+    if(k2 <= std::numeric_limits<float>::epsilon())
+        return -1.0f;
+
+    auto k1 = (baba * QVector3D::dotProduct(oc, ray._direction)) - (baoc * bard);
+    auto k0 = (baba * QVector3D::dotProduct(oc, oc)) - (baoc * baoc) - (radius * radius * baba);
+    auto h = (k1 * k1) - (k2 * k0);
+
+    if(h < 0.0f)
+        return -1.0f;
+
+    h = std::sqrt(h);
+
+    for(auto t : {(-k1 - h) / k2, (-k1 + h) / k2})
+    {
+        auto axial = baoc + (t * bard);
+        if(t >= 0.0f && axial >= 0.0f && axial <= baba)
+        {
+            y = axial / baba;
+            return t;
+        }
+    }
+
+    return -1.0f;
+}
+
+// An uncapped cone with its tip at tip, pointing in the opposite direction to axis
+static float rayIntersectsCone(const Ray& ray, const QVector3D& tip, const QVector3D& axis,
+    float length, float radius)
+{
+    auto cosSquared = (length * length) / ((length * length) + (radius * radius));
+    auto co = ray._origin - tip;
+
+    auto dv = QVector3D::dotProduct(ray._direction, axis);
+    auto cov = QVector3D::dotProduct(co, axis);
+
+    auto a = (dv * dv) - cosSquared;
+    auto b = 2.0f * ((dv * cov) - (QVector3D::dotProduct(ray._direction, co) * cosSquared));
+    auto c = (cov * cov) - (QVector3D::dotProduct(co, co) * cosSquared);
+
+    if(std::abs(a) <= std::numeric_limits<float>::epsilon())
+        return -1.0f;
+
+    auto h = (b * b) - (4.0f * a * c);
+    if(h < 0.0f)
+        return -1.0f;
+
+    h = std::sqrt(h);
+    auto t0 = (-b - h) / (2.0f * a);
+    auto t1 = (-b + h) / (2.0f * a);
+
+    if(t0 > t1)
+        std::swap(t0, t1);
+
+    for(auto t : {t0, t1})
+    {
+        auto axial = cov + (t * dv);
+        if(t >= 0.0f && axial >= 0.0f && axial <= length)
+            return t;
+    }
+
+    return -1.0f;
+}
+
+static QVector3D reflect(const QVector3D& i, const QVector3D& n)
+{
+    return i - (2.0f * QVector3D::dotProduct(n, i) * n);
+}
+
+static QVector3D adsModel(const std::vector<Light>& lights, const Material& material,
+    const ComponentTransform& transform, const QVector3D& position, const QVector3D& normal,
+    const QVector3D& diffuseColor)
+{
+    QVector3D result;
+    auto v = (-position).normalized();
+
+    for(const auto& light : lights)
+    {
+        auto lightPosition = light._position * transform._lightScale;
+        lightPosition.setZ(lightPosition.z() - transform._lightOffset);
+
+        auto s = (lightPosition - position).normalized();
+        auto r = reflect(-s, normal);
+        auto sDotN = QVector3D::dotProduct(s, normal);
+
+        auto diffuse = std::max(sDotN, 0.0f);
+
+        float specular = 0.0f;
+        if(sDotN > 0.0f)
+            specular = std::pow(std::max(QVector3D::dotProduct(r, v), 0.0f), material._shininess);
+
+        result += light._color * (material._ka + (diffuseColor * diffuse) + (material._ks * specular));
+    }
+
+    return result;
+}
+
+static float sampleAlpha(const SoftwareRenderer::GlyphImage& image, float u, float v)
+{
+    auto x = (u * static_cast<float>(image._width)) - 0.5f;
+    auto y = (v * static_cast<float>(image._height)) - 0.5f;
+
+    auto x0 = static_cast<int>(std::floor(x));
+    auto y0 = static_cast<int>(std::floor(y));
+    auto fx = x - static_cast<float>(x0);
+    auto fy = y - static_cast<float>(y0);
+
+    auto texel = [&image](int tx, int ty)
+    {
+        tx = std::clamp(tx, 0, image._width - 1);
+        ty = std::clamp(ty, 0, image._height - 1);
+
+        return static_cast<float>(image._alpha[(static_cast<size_t>(ty) * image._width) + tx]) / 255.0f;
+    };
+
+    auto top = (texel(x0, y0) * (1.0f - fx)) + (texel(x0 + 1, y0) * fx);
+    auto bottom = (texel(x0, y0 + 1) * (1.0f - fx)) + (texel(x0 + 1, y0 + 1) * fx);
+
+    return (top * (1.0f - fy)) + (bottom * fy);
+}
+
+void SoftwareRenderer::copyState(const GraphRenderer& renderer)
+{
+    std::vector<Layer> layers;
+
+    for(const auto& gpuGraphData : renderer._gpuGraphData)
+    {
+        if(gpuGraphData.invisible())
+            continue;
+
+        Layer layer;
+        layer._nodeData = gpuGraphData._nodeData;
+        layer._edgeData = gpuGraphData._edgeData;
+        layer._glyphData = gpuGraphData._glyphData;
+        layer._componentAlpha = gpuGraphData._componentAlpha;
+        layer._unhighlightAlpha = gpuGraphData._unhighlightAlpha;
+        layer._isOverlay = gpuGraphData._isOverlay;
+
+        layers.emplace_back(std::move(layer));
+    }
+
+    setLayers(std::move(layers));
+
+    std::vector<GraphComponentRenderer::CameraAndLighting> cameraAndLightings;
+
+    for(const auto& componentRendererRef : renderer.componentRenderers())
+    {
+        const GraphComponentRenderer* componentRenderer = componentRendererRef;
+
+        // Skip invisible components
+        if(!componentRenderer->visible())
+            continue;
+
+        // This order MUST match graphrenderer component order!
+        cameraAndLightings.emplace_back(*componentRenderer->cameraAndLighting());
+    }
+
+    setComponentCameraAndLightings(std::move(cameraAndLightings));
+
+    {
+        std::unique_lock<std::recursive_mutex> lock(renderer._glyphMap->mutex());
+        setGlyphImages(renderer._glyphMap->images());
+    }
+
+    _viewportSize = {renderer.width(), renderer.height()};
+    _shading = renderer.shading();
+    _backgroundColor = u::pref("visuals/backgroundColor").value<QColor>();
+    _textScale = u::pref("visuals/textSize").toFloat();
+}
+
+void SoftwareRenderer::setLayers(std::vector<Layer> layers)
+{
+    _layers = std::move(layers);
+
+    // Render opaque layers first, then in order of decreasing alpha,
+    // leaving any overlay until last; see GraphRendererCore::gpuGraphDataRenderOrder
+    std::stable_sort(_layers.begin(), _layers.end(), [](const auto& a, const auto& b)
+    {
+        if(a._isOverlay != b._isOverlay)
+            return b._isOverlay;
+
+        if(a._componentAlpha == b._componentAlpha)
+            return a._unhighlightAlpha > b._unhighlightAlpha;
+
+        return a._componentAlpha > b._componentAlpha;
+    });
+
+    _layers.erase(std::remove_if(_layers.begin(), _layers.end(), [](const auto& layer)
+    {
+        return layer.alpha() <= 0.0f || layer.empty();
+    }), _layers.end());
+}
+
+void SoftwareRenderer::setComponentCameraAndLightings(
+    std::vector<GraphComponentRenderer::CameraAndLighting> cameraAndLightings)
+{
+    _componentCameraAndLightings = std::move(cameraAndLightings);
+}
+
+void SoftwareRenderer::setGlyphImages(const std::vector<QImage>& images)
+{
+    _glyphImages.clear();
+    _glyphImages.resize(images.size());
+
+    // Only the coverage is needed, and extracting it up front
+    // avoids repeatedly converting pixels while rasterising
+    for(size_t i = 0; i < images.size(); i++)
+    {
+        auto image = images.at(i).convertToFormat(QImage::Format_ARGB32);
+        auto& glyphImage = _glyphImages.at(i);
+
+        glyphImage._width = image.width();
+        glyphImage._height = image.height();
+        glyphImage._alpha.resize(static_cast<size_t>(image.width()) * image.height());
+
+        for(int y = 0; y < image.height(); y++)
+        {
+            const auto* line = reinterpret_cast<const QRgb*>(image.constScanLine(y)); // NOLINT
+            auto* alpha = &glyphImage._alpha.at(static_cast<size_t>(y) * image.width());
+
+            for(int x = 0; x < image.width(); x++)
+                alpha[x] = static_cast<uint8_t>(qAlpha(line[x]));
+        }
+    }
+}
+
+QImage SoftwareRenderer::render(QSize size) const
+{
+    QImage image(size, QImage::Format_RGB32);
+
+    if(size.isEmpty())
+        return image;
+
+    image.fill(_backgroundColor);
+
+    if(_viewportSize.isEmpty())
+        return image;
+
+    // We always scale to the Y axis
+    double scale = static_cast<double>(size.height()) / _viewportSize.height();
+
+    std::vector<ComponentTransform> transforms;
+    transforms.reserve(_componentCameraAndLightings.size());
+
+    for(const auto& componentCameraAndLighting : _componentCameraAndLightings)
+    {
+        const Camera& componentCamera = componentCameraAndLighting._camera;
+        QRectF componentViewport(
+            componentCamera.viewport().topLeft() * scale,
+            componentCamera.viewport().size() * scale);
+
+        ComponentTransform transform;
+        transform._modelViewMatrix = componentCamera.viewMatrix();
+        transform._projectionMatrix = GraphComponentRenderer::subViewportMatrix(componentViewport,
+            QRect({0, 0}, size)) * componentCamera.projectionMatrix();
+        transform._inverseProjectionMatrix = transform._projectionMatrix.inverted();
+        transform._lightOffset = componentCamera.distance();
+        transform._lightScale = componentCameraAndLighting._lightScale;
+        transform._orthographic = transform._projectionMatrix(3, 3) != 0.0f;
+
+        transforms.emplace_back(transform);
+    }
+
+    auto validComponent = [&transforms](int component)
+    {
+        return component >= 0 && component < static_cast<int>(transforms.size());
+    };
+
+    const int tilesX = (size.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (size.height() + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t numTiles = static_cast<size_t>(tilesX) * tilesY;
+
+    auto forEachIndex = [](size_t count, auto&& f)
+    {
+        if(count == 0)
+            return;
+
+        std::vector<size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        concurrent_for(indices.begin(), indices.end(), f);
+    };
+
+    // Transform everything into view space, and bin it by its screen bounds
+    std::vector<PreparedLayer> preparedLayers(_layers.size());
+
+    for(size_t layerIndex = 0; layerIndex < _layers.size(); layerIndex++)
+    {
+        const auto& layer = _layers.at(layerIndex);
+        auto& preparedLayer = preparedLayers.at(layerIndex);
+
+        preparedLayer._alpha = layer.alpha();
+        preparedLayer._clearDepth = layer._unhighlightAlpha >= 1.0f;
+        preparedLayer._disableAlphaBlending = _shading == Shading::Flat && !layer._isOverlay;
+
+        preparedLayer._nodes.resize(layer._nodeData.size());
+        preparedLayer._edges.resize(layer._edgeData.size());
+        preparedLayer._glyphs.resize(layer._glyphData.size());
+
+        forEachIndex(layer._nodeData.size(), [&](size_t i)
+        {
+            const auto& nodeData = layer._nodeData.at(i);
+            if(!validComponent(nodeData._component) || nodeData._size <= 0.0f)
+                return;
+
+            const auto& transform = transforms.at(static_cast<size_t>(nodeData._component));
+            auto& node = preparedLayer._nodes.at(i);
+
+            node._component = nodeData._component;
+            node._centre = transform._modelViewMatrix.map(toVector3D(nodeData._position));
+            node._radius = nodeData._size;
+            node._outerColor = toVector3D(nodeData._outerColor);
+            node._innerColor = toVector3D(nodeData._innerColor);
+
+            // Keep the node's centre dot facing the camera
+            node._forward = transform._orthographic ? QVector3D(0.0f, 0.0f, 1.0f) : (-node._centre).normalized();
+            node._right = QVector3D::crossProduct(node._forward, {0.0f, 1.0f, 0.0f}).normalized();
+            node._up = QVector3D::crossProduct(node._forward, node._right);
+
+            QVector3D extent(node._radius, node._radius, node._radius);
+            node._bounds = screenBounds(node._centre - extent, node._centre + extent,
+                transform._projectionMatrix, size);
+        });
+
+        forEachIndex(layer._edgeData.size(), [&](size_t i)
+        {
+            const auto& edgeData = layer._edgeData.at(i);
+            if(!validComponent(edgeData._component) || edgeData._size <= 0.0f)
+                return;
+
+            const auto& transform = transforms.at(static_cast<size_t>(edgeData._component));
+            auto& edge = preparedLayer._edges.at(i);
+
+            auto source = transform._modelViewMatrix.map(toVector3D(edgeData._sourcePosition));
+            auto target = transform._modelViewMatrix.map(toVector3D(edgeData._targetPosition));
+            auto length = source.distanceToPoint(target);
+
+            if(length <= 0.0f)
+                return;
+
+            edge._component = edgeData._component;
+            edge._source = source;
+            edge._shaftEnd = target;
+            edge._radius = edgeData._size;
+            edge._direction = (target - source) / length;
+            edge._sourceSize = edgeData._sourceSize;
+            edge._lengthMinusNodeRadii = length - (edgeData._sourceSize + edgeData._targetSize);
+            edge._outerColor = toVector3D(edgeData._outerColor);
+            edge._innerColor = toVector3D(edgeData._innerColor);
+
+            float maxRadius = edge._radius;
+
+            if(edgeData._edgeType == static_cast<int>(EdgeVisualType::Arrow))
+            {
+                edge._hasArrowHead = true;
+                edge._arrowTip = target - (edge._direction * edgeData._targetSize);
+                edge._arrowHeadLength = std::min(edge._radius * ARROW_HEAD_LENGTH_SCALE,
+                    length * MAX_ARROW_HEAD_LENGTH);
+                edge._arrowHeadRadius = edge._radius * ARROW_HEAD_RADIUS_SCALE;
+                edge._shaftEnd = edge._arrowTip - (edge._direction * edge._arrowHeadLength);
+
+                maxRadius = edge._arrowHeadRadius;
+            }
+
+            QVector3D extent(maxRadius, maxRadius, maxRadius);
+            auto min = QVector3D(std::min(source.x(), target.x()), std::min(source.y(), target.y()),
+                std::min(source.z(), target.z())) - extent;
+            auto max = QVector3D(std::max(source.x(), target.x()), std::max(source.y(), target.y()),
+                std::max(source.z(), target.z())) + extent;
+
+            edge._bounds = screenBounds(min, max, transform._projectionMatrix, size);
+        });
+
+        forEachIndex(layer._glyphData.size(), [&](size_t i)
+        {
+            const auto& glyphData = layer._glyphData.at(i);
+            if(!validComponent(glyphData._component) || glyphData._textureLayer < 0 ||
+                glyphData._textureLayer >= static_cast<int>(_glyphImages.size()))
+            {
+                return;
+            }
+
+            const auto& transform = transforms.at(static_cast<size_t>(glyphData._component));
+            auto& glyph = preparedLayer._glyphs.at(i);
+
+            // Glyphs are billboards, so in view space they're simply axis aligned rectangles
+            glyph._component = glyphData._component;
+            glyph._origin = transform._modelViewMatrix.map(toVector3D(glyphData._basePosition)) +
+                QVector3D(glyphData._glyphOffset[0], glyphData._glyphOffset[1], 0.0f);
+            glyph._width = glyphData._glyphSize[0] * _textScale;
+            glyph._height = glyphData._glyphSize[1] * _textScale;
+            glyph._layer = glyphData._textureLayer;
+            glyph._u = glyphData._textureCoord[0];
+            glyph._v = glyphData._textureCoord[1];
+            glyph._uSize = glyphData._glyphSize[0];
+            glyph._vSize = glyphData._glyphSize[1];
+            glyph._color = toVector3D(glyphData._color);
+
+            glyph._bounds = screenBounds(glyph._origin,
+                glyph._origin + QVector3D(glyph._width, glyph._height, 0.0f),
+                transform._projectionMatrix, size);
+        });
+
+        preparedLayer._bins.resize(numTiles);
+
+        auto bin = [&](const auto& primitives, std::vector<int> PreparedLayer::Bin::* list)
+        {
+            for(size_t i = 0; i < primitives.size(); i++)
+            {
+                const auto& b = primitives.at(i)._bounds;
+                if(b.empty())
+                    continue;
+
+                for(int tileY = b._top / TILE_SIZE; tileY <= b._bottom / TILE_SIZE; tileY++)
+                {
+                    for(int tileX = b._left / TILE_SIZE; tileX <= b._right / TILE_SIZE; tileX++)
+                    {
+                        auto& tileBin = preparedLayer._bins.at((static_cast<size_t>(tileY) * tilesX) + tileX);
+                        (tileBin.*list).push_back(static_cast<int>(i));
+                    }
+                }
+            }
+        };
+
+        bin(preparedLayer._nodes, &PreparedLayer::Bin::_nodes);
+        bin(preparedLayer._edges, &PreparedLayer::Bin::_edges);
+        bin(preparedLayer._glyphs, &PreparedLayer::Bin::_glyphs);
+    }
+
+    // See GraphRendererCore::setShaderLightingParameters
+    const std::vector<Light> lights =
+    {
+        {{-0.707f,  0.0f,    0.707f}, QVector3D(100, 100, 100) / 255.0f},
+        {{ 0.0f,    0.0f,    1.0f  }, QVector3D(150, 150, 150) / 255.0f},
+        {{ 0.707f, -0.707f,  0.0f  }, QVector3D(100, 100, 100) / 255.0f},
+    };
+
+    const Material material;
+    const bool flat = _shading == Shading::Flat;
+
+    auto shade = [&](const ComponentTransform& transform, const QVector3D& position,
+        const QVector3D& normal, const QVector3D& color)
+    {
+        if(flat)
+            return color;
+
+        return adsModel(lights, material, transform, position, normal, color);
+    };
+
+    const QVector3D backgroundColor(static_cast<float>(_backgroundColor.redF()),
+        static_cast<float>(_backgroundColor.greenF()),
+        static_cast<float>(_backgroundColor.blueF()));
+
+    // Each tile writes to a disjoint part of the image, so it can be written to concurrently
+    auto* imageBits = image.bits();
+    const auto bytesPerLine = static_cast<size_t>(image.bytesPerLine());
+
+    forEachIndex(numTiles, [&](size_t tileIndex)
+    {
+        const int tileLeft = static_cast<int>(tileIndex % tilesX) * TILE_SIZE;
+        const int tileTop = static_cast<int>(tileIndex / tilesX) * TILE_SIZE;
+        const int tileWidth = std::min(TILE_SIZE, size.width() - tileLeft);
+        const int tileHeight = std::min(TILE_SIZE, size.height() - tileTop);
+        const Bounds tileBounds{tileLeft, tileTop, tileLeft + tileWidth - 1, tileTop + tileHeight - 1};
+
+        std::vector<Sample> samples(static_cast<size_t>(TILE_SAMPLE_SIZE) * TILE_SAMPLE_SIZE);
+        std::vector<QVector3D> pixels(static_cast<size_t>(TILE_SIZE) * TILE_SIZE, backgroundColor);
+
+        auto clearDepth = [&samples]
+        {
+            for(auto& sample : samples)
+                sample._depth = std::numeric_limits<float>::max();
+        };
+
+        clearDepth();
+
+        // Calls f for every sample within both b and this tile, with the corresponding view space ray
+        auto forEachSample = [&](const Bounds& b, const ComponentTransform& transform, auto&& f)
+        {
+            auto left = std::max(b._left, tileBounds._left);
+            auto right = std::min(b._right, tileBounds._right);
+            auto top = std::max(b._top, tileBounds._top);
+            auto bottom = std::min(b._bottom, tileBounds._bottom);
+
+            for(int y = top * SAMPLES_PER_AXIS; y < (bottom + 1) * SAMPLES_PER_AXIS; y++)
+            {
+                auto ndcY = 1.0f - (((static_cast<float>(y) + 0.5f) /
+                    static_cast<float>(size.height() * SAMPLES_PER_AXIS)) * 2.0f);
+
+                for(int x = left * SAMPLES_PER_AXIS; x < (right + 1) * SAMPLES_PER_AXIS; x++)
+                {
+                    auto ndcX = (((static_cast<float>(x) + 0.5f) /
+                        static_cast<float>(size.width() * SAMPLES_PER_AXIS)) * 2.0f) - 1.0f;
+
+                    auto nearPoint = transform._inverseProjectionMatrix.map(QVector3D(ndcX, ndcY, -1.0f));
+                    auto farPoint = transform._inverseProjectionMatrix.map(QVector3D(ndcX, ndcY, 1.0f));
+
+                    Ray ray{nearPoint, (farPoint - nearPoint).normalized()};
+
+                    auto sampleX = x - (tileLeft * SAMPLES_PER_AXIS);
+                    auto sampleY = y - (tileTop * SAMPLES_PER_AXIS);
+                    f(ray, samples.at((static_cast<size_t>(sampleY) * TILE_SAMPLE_SIZE) + sampleX));
+                }
+            }
+        };
+
+        // Returns the depth of a view space position, if it lies within the view volume
+        auto depthOf = [](const ComponentTransform& transform, const QVector3D& position, float& depth)
+        {
+            depth = transform._projectionMatrix.map(position).z();
+            return depth >= -1.0f && depth <= 1.0f;
+        };
+
+        for(const auto& preparedLayer : preparedLayers)
+        {
+            // Subsequent layers of unhighlighted elements use the existing depth information
+            if(preparedLayer._clearDepth)
+                clearDepth();
+
+            const auto& tileBin = preparedLayer._bins.at(tileIndex);
+            if(tileBin.empty())
+                continue;
+
+            for(auto& sample : samples)
+                sample._color = {};
+
+            for(auto i : tileBin._nodes)
+            {
+                const auto& node = preparedLayer._nodes.at(static_cast<size_t>(i));
+                const auto& transform = transforms.at(static_cast<size_t>(node._component));
+
+                forEachSample(node._bounds, transform, [&](const Ray& ray, Sample& sample)
+                {
+                    auto t = rayIntersectsSphere(ray, node._centre, node._radius);
+                    if(t < 0.0f)
+                        return;
+
+                    auto position = ray._origin + (ray._direction * t);
+
+                    float depth = 0.0f;
+                    if(!depthOf(transform, position, depth) || depth >= sample._depth)
+                        return;
+
+                    auto normal = (position - node._centre) / node._radius;
+
+                    // Map the normal onto the camera facing hemisphere, as the vertex shader does
+                    auto uvX = (2.0f * std::asin(std::clamp(QVector3D::dotProduct(normal, node._right), -1.0f, 1.0f))) / Constants::Pi();
+                    auto uvY = (2.0f * std::asin(std::clamp(QVector3D::dotProduct(normal, node._up), -1.0f, 1.0f))) / Constants::Pi();
+                    auto onFrontFace = QVector3D::dotProduct(normal, node._forward) > 0.0f;
+                    auto inDot = onFrontFace && std::sqrt((uvX * uvX) + (uvY * uvY)) < NODE_DOT_SIZE;
+
+                    const auto& color = inDot ? node._innerColor : node._outerColor;
+
+                    sample._color = QVector4D(shade(transform, position, normal, color), 1.0f);
+                    sample._depth = depth;
+                });
+            }
+
+            for(auto i : tileBin._edges)
+            {
+                const auto& edge = preparedLayer._edges.at(static_cast<size_t>(i));
+                const auto& transform = transforms.at(static_cast<size_t>(edge._component));
+
+                forEachSample(edge._bounds, transform, [&](const Ray& ray, Sample& sample)
+                {
+                    float y = 0.0f;
+                    auto t = rayIntersectsCylinder(ray, edge._source, edge._shaftEnd, edge._radius, y);
+                    QVector3D normal;
+                    QVector3D position;
+
+                    if(t >= 0.0f)
+                    {
+                        position = ray._origin + (ray._direction * t);
+                        auto axisPoint = edge._source + ((edge._shaftEnd - edge._source) * y);
+                        normal = (position - axisPoint) / edge._radius;
+                    }
+
+                    if(edge._hasArrowHead)
+                    {
+                        auto coneT = rayIntersectsCone(ray, edge._arrowTip, -edge._direction,
+                            edge._arrowHeadLength, edge._arrowHeadRadius);
+
+                        if(coneT >= 0.0f && (t < 0.0f || coneT < t))
+                        {
+                            t = coneT;
+                            position = ray._origin + (ray._direction * t);
+
+                            auto p = position - edge._arrowTip;
+                            auto cosSquared = (edge._arrowHeadLength * edge._arrowHeadLength) /
+                                ((edge._arrowHeadLength * edge._arrowHeadLength) +
+                                (edge._arrowHeadRadius * edge._arrowHeadRadius));
+                            normal = ((p * cosSquared) + (edge._direction *
+                                QVector3D::dotProduct(p, -edge._direction))).normalized();
+                        }
+                    }
+
+                    if(t < 0.0f)
+                        return;
+
+                    float depth = 0.0f;
+                    if(!depthOf(transform, position, depth) || depth >= sample._depth)
+                        return;
+
+                    auto distanceAlongEdge = QVector3D::dotProduct(position - edge._source, edge._direction);
+                    auto v = edge._lengthMinusNodeRadii > 0.0f ?
+                        (distanceAlongEdge - edge._sourceSize) / edge._lengthMinusNodeRadii : 0.0f;
+                    auto inStripe = v >= EDGE_STRIPE_BOUNDS && v <= 1.0f - EDGE_STRIPE_BOUNDS;
+
+                    const auto& color = inStripe ? edge._innerColor : edge._outerColor;
+
+                    sample._color = QVector4D(shade(transform, position, normal, color), 1.0f);
+                    sample._depth = depth;
+                });
+            }
+
+            // Text is rendered on top, without depth testing, blended in order
+            for(auto i : tileBin._glyphs)
+            {
+                const auto& glyph = preparedLayer._glyphs.at(static_cast<size_t>(i));
+                const auto& transform = transforms.at(static_cast<size_t>(glyph._component));
+                const auto& glyphImage = _glyphImages.at(static_cast<size_t>(glyph._layer));
+
+                forEachSample(glyph._bounds, transform, [&](const Ray& ray, Sample& sample)
+                {
+                    if(std::abs(ray._direction.z()) <= std::numeric_limits<float>::epsilon())
+                        return;
+
+                    auto t = (glyph._origin.z() - ray._origin.z()) / ray._direction.z();
+                    if(t < 0.0f)
+                        return;
+
+                    auto position = ray._origin + (ray._direction * t);
+                    auto s = (position.x() - glyph._origin.x()) / glyph._width;
+                    auto r = (position.y() - glyph._origin.y()) / glyph._height;
+
+                    if(s < 0.0f || s > 1.0f || r < 0.0f || r > 1.0f)
+                        return;
+
+                    // The glyph's v coordinate is measured from the top of the image
+                    auto alpha = sampleAlpha(glyphImage, glyph._u + (s * glyph._uSize),
+                        glyph._v - (r * glyph._vSize));
+
+                    if(alpha <= 0.0f)
+                        return;
+
+                    sample._color = (QVector4D(glyph._color, 1.0f) * alpha) + (sample._color * (1.0f - alpha));
+                });
+            }
+
+            // Resolve the samples and composite the layer
+            for(int y = 0; y < tileHeight; y++)
+            {
+                for(int x = 0; x < tileWidth; x++)
+                {
+                    QVector3D rgb;
+                    float alpha = 0.0f;
+                    int numCovered = 0;
+
+                    for(int sy = 0; sy < SAMPLES_PER_AXIS; sy++)
+                    {
+                        for(int sx = 0; sx < SAMPLES_PER_AXIS; sx++)
+                        {
+                            const auto& sample = samples.at((static_cast<size_t>((y * SAMPLES_PER_AXIS) + sy) *
+                                TILE_SAMPLE_SIZE) + (x * SAMPLES_PER_AXIS) + sx);
+
+                            if(sample._color.w() > 0.0f)
+                            {
+                                rgb += sample._color.toVector3D() / sample._color.w();
+                                alpha += sample._color.w() / static_cast<float>(NUM_SAMPLES);
+                                numCovered++;
+                            }
+                        }
+                    }
+
+                    if(numCovered == 0)
+                        continue;
+
+                    if(preparedLayer._disableAlphaBlending)
+                        alpha = 1.0f;
+
+                    alpha *= preparedLayer._alpha;
+
+                    auto& pixel = pixels.at((static_cast<size_t>(y) * TILE_SIZE) + x);
+                    pixel = (pixel * (1.0f - alpha)) + ((rgb / static_cast<float>(numCovered)) * alpha);
+                }
+            }
+        }
+
+        for(int y = 0; y < tileHeight; y++)
+        {
+            auto* line = reinterpret_cast<QRgb*>(imageBits + (static_cast<size_t>(tileTop + y) * bytesPerLine)); // NOLINT
+
+            for(int x = 0; x < tileWidth; x++)
+            {
+                const auto& pixel = pixels.at((static_cast<size_t>(y) * TILE_SIZE) + x);
+
+                auto component = [](float value)
+                {
+                    return static_cast<int>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+                };
+
+                line[tileLeft + x] = qRgb(component(pixel.x()), component(pixel.y()), component(pixel.z()));
+            }
+        }
+    });
+
+    return image;
+}
+
+static QSize screenshotSizeFor(QSize viewportSize, int width, int height, bool fillSize)
+{
+    QSize screenshotSize(width, height);
+
+    if(fillSize || viewportSize.isEmpty())
+        return screenshotSize;
+
+    float viewportAspectRatio = static_cast<float>(viewportSize.width()) /
+        static_cast<float>(viewportSize.height());
+
+    screenshotSize.setHeight(static_cast<int>(static_cast<float>(width) / viewportAspectRatio));
+    if(screenshotSize.height() > height)
+    {
+        screenshotSize.setWidth(static_cast<int>(static_cast<float>(height) * viewportAspectRatio));
+        screenshotSize.setHeight(height);
+    }
+
+    return screenshotSize;
+}
+
+void SoftwareRenderer::requestPreview(const GraphRenderer& renderer, int width, int height, bool fillSize)
+{
+    copyState(renderer);
+
+    QSize previewSize(width, height);
+
+    // Unlike screenshots, previews are not constrained by their height
+    if(!fillSize && !_viewportSize.isEmpty())
+    {
+        float viewportAspectRatio = static_cast<float>(_viewportSize.width()) /
+            static_cast<float>(_viewportSize.height());
+        previewSize.setHeight(static_cast<int>(static_cast<float>(width) / viewportAspectRatio));
+    }
+
+    auto image = render(previewSize);
+
+    QByteArray byteArray;
+    QBuffer buffer(&byteArray);
+    image.save(&buffer, "PNG");
+
+    // QML Can't load raw QImages so as a hack we just base64 encode a png
+    emit previewComplete(QString::fromLatin1(byteArray.toBase64().data()));
+}
+
+void SoftwareRenderer::requestScreenshot(const GraphRenderer& renderer, int width, int height,
+                                         const QString& path, int dpi, bool fillSize)
+{
+    copyState(renderer);
+
+    auto image = render(screenshotSizeFor(_viewportSize, width, height, fillSize));
+
+    const int DOTS_PER_METER = static_cast<int>(dpi * 39.3700787);
+    image.setDotsPerMeterX(DOTS_PER_METER);
+    image.setDotsPerMeterY(DOTS_PER_METER);
+    emit screenshotComplete(image, path);
+}
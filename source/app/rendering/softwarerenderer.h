@@ -0,0 +1,106 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include "graphrenderercore.h"
+#include "graphcomponentrenderer.h"
+#include "shading.h"
+
+#include <QObject>
+#include <QImage>
+#include <QColor>
+#include <QSize>
+#include <QString>
+
+#include <vector>
+#include <cstdint>
+
+class GraphRenderer;
+
+// Renders the same instance data as ScreenshotRenderer, but entirely on the CPU,
+// so that it works without an OpenGL context, or when the only one available is
+// a slow software implementation. The output is divided into tiles; each layer's
+// elements are binned by their screen space bounds and the tiles then rasterised
+// in parallel. Nodes and edges are ray traced as sphere, cylinder and cone
+// impostors, so the output is exact at any resolution.
+class SoftwareRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Layer
+    {
+        std::vector<GPUGraphData::NodeData> _nodeData;
+        std::vector<GPUGraphData::EdgeData> _edgeData;
+        std::vector<GPUGraphData::GlyphData> _glyphData;
+
+        float _componentAlpha = 0.0f;
+        float _unhighlightAlpha = 0.0f;
+        bool _isOverlay = false;
+
+        float alpha() const { return _componentAlpha * _unhighlightAlpha; }
+        bool empty() const { return _nodeData.empty() && _edgeData.empty() && _glyphData.empty(); }
+    };
+
+    struct GlyphImage
+    {
+        int _width = 0;
+        int _height = 0;
+        std::vector<uint8_t> _alpha;
+    };
+
+    SoftwareRenderer() = default;
+
+    // Copy everything required to render from a GraphRenderer; this must be called
+    // from the render thread, but no OpenGL calls are made
+    void copyState(const GraphRenderer& renderer);
+
+    // Alternatively, the state can be set directly
+    void setLayers(std::vector<Layer> layers);
+    void setComponentCameraAndLightings(std::vector<GraphComponentRenderer::CameraAndLighting> cameraAndLightings);
+    void setGlyphImages(const std::vector<QImage>& images);
+    void setViewportSize(QSize viewportSize) { _viewportSize = viewportSize; }
+    void setShading(Shading shading) { _shading = shading; }
+    void setBackgroundColor(const QColor& backgroundColor) { _backgroundColor = backgroundColor; }
+    void setTextScale(float textScale) { _textScale = textScale; }
+
+    QImage render(QSize size) const;
+
+    void requestPreview(const GraphRenderer& renderer, int width, int height, bool fillSize);
+    void requestScreenshot(const GraphRenderer& renderer, int width, int height, const QString& path, int dpi,
+                           bool fillSize);
+
+private:
+    std::vector<Layer> _layers;
+    std::vector<GraphComponentRenderer::CameraAndLighting> _componentCameraAndLightings;
+    std::vector<GlyphImage> _glyphImages;
+
+    QSize _viewportSize;
+    Shading _shading = Shading::Smooth;
+    QColor _backgroundColor;
+    float _textScale = 1.0f;
+
+signals:
+    // These match the equivalent ScreenshotRenderer signals
+    void previewComplete(QString previewBase64) const;
+    void screenshotComplete(const QImage& screenshot, const QString& path) const;
+};
+
+#endif // SOFTWARERENDERER_H
@@ -87,6 +87,23 @@ bool GraphTransform::applyAndUpdate(TransformedGraph& target, const GraphModel&
     return anyChange;
 }
 
+void GraphTransform::applyConcurrently(TransformedGraph& target, const GraphModel& graphModel) const
+{
+    Q_ASSERT(createsAttributesOnly() && !repeating());
+
+    // The graph doesn't change, so unlike applyAndUpdate, there is no
+    // need to update it, which would otherwise race with other transforms
+    auto attributeNames = config().referencedAttributeNames();
+
+    if(hasUnknownAttributes(attributeNames, graphModel, *this))
+        return;
+
+    if(hasInvalidAttributes(attributeNames, graphModel, *this))
+        return;
+
+    apply(target);
+}
+
 GraphTransformAttributeParameter GraphTransformFactory::attributeParameter(const QString& parameterName) const
 {
     const auto& p = attributeParameters();
@@ -54,6 +54,11 @@ public:
     virtual void apply(TransformedGraph&) const {}
     bool applyAndUpdate(TransformedGraph& target, const GraphModel& graphModel) const;
 
+    // Transforms that leave the graph unchanged, and only create attributes,
+    // may be applied concurrently with each other
+    virtual bool createsAttributesOnly() const { return false; }
+    void applyConcurrently(TransformedGraph& target, const GraphModel& graphModel) const;
+
     bool repeating() const { return _repeating; }
     void setRepeating(bool repeating) { _repeating = repeating; }
 
@@ -0,0 +1,454 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "persistenttransformcache.h"
+
+#include "application.h"
+#include "graph/graph.h"
+#include "graph/graphmodel.h"
+#include "graph/mutablegraph.h"
+#include "transform/graphtransformconfig.h"
+
+#include "shared/utils/preferences.h"
+
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDebug>
+
+#include <memory>
+#include <type_traits>
+
+// Bump this whenever the file format or the way keys are computed changes
+static const int VERSION = 1;
+static const char* const MAGIC = "GraphiaTransformCache";
+
+static void addToHash(QCryptographicHash& hash, qint64 value)
+{
+    hash.addData(reinterpret_cast<const char*>(&value), static_cast<int>(sizeof(value)));
+}
+
+static void addToHash(QCryptographicHash& hash, const QString& value)
+{
+    auto utf8 = value.toUtf8();
+    addToHash(hash, utf8.size());
+    hash.addData(utf8);
+}
+
+template<typename E>
+static void addValuesToHash(QCryptographicHash& hash, const Attribute& attribute, const std::vector<E>& elementIds)
+{
+    addToHash(hash, static_cast<qint64>(elementIds.size()));
+    for(auto elementId : elementIds)
+    {
+        addToHash(hash, static_cast<int>(elementId));
+        addToHash(hash, attribute.valueMissingOf(elementId) ? 1 : 0);
+        addToHash(hash, attribute.stringValueOf(elementId));
+    }
+}
+
+PersistentTransformCache::PersistentTransformCache() :
+    _directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+        QStringLiteral("/TransformCache")),
+    _maximumSize(u::pref(QStringLiteral("misc/persistentTransformCacheSize")).toLongLong() * 1024 * 1024)
+{}
+
+bool PersistentTransformCache::enabled()
+{
+    return u::pref(QStringLiteral("misc/persistentTransformCache")).toBool();
+}
+
+void PersistentTransformCache::reset(const MutableGraph& source)
+{
+    _keyValid = enabled();
+    _loading = _keyValid;
+    _key.clear();
+
+    if(!_keyValid)
+        return;
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addToHash(hash, VERSION);
+
+    // Transform implementations may change between releases
+    addToHash(hash, Application::version());
+
+    addToHash(hash, static_cast<qint64>(source.nodeIds().size()));
+    for(auto nodeId : source.nodeIds())
+        addToHash(hash, static_cast<int>(nodeId));
+
+    addToHash(hash, static_cast<qint64>(source.edgeIds().size()));
+    for(auto edgeId : source.edgeIds())
+    {
+        const auto& edge = source.edgeById(edgeId);
+        addToHash(hash, static_cast<int>(edgeId));
+        addToHash(hash, static_cast<int>(edge.sourceId()));
+        addToHash(hash, static_cast<int>(edge.targetId()));
+    }
+
+    _key = hash.result();
+}
+
+void PersistentTransformCache::advance(const GraphTransformConfig& config,
+    const GraphModel& graphModel, const Graph& graph)
+{
+    if(!_keyValid)
+        return;
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(_key);
+    addToHash(hash, config.asString());
+
+    // The result of a transform depends on the values of the attributes it
+    // references, as well as its config, so these are part of the key too
+    for(const auto& attributeName : config.referencedAttributeNames())
+    {
+        addToHash(hash, attributeName);
+
+        const auto* attribute = graphModel.attributeByName(attributeName);
+        if(attribute == nullptr)
+            continue;
+
+        switch(attribute->elementType())
+        {
+        case ElementType::Node: addValuesToHash(hash, *attribute, graph.nodeIds()); break;
+        case ElementType::Edge: addValuesToHash(hash, *attribute, graph.edgeIds()); break;
+
+        default:
+            // Component values depend on the component manager, which we can't key
+            _keyValid = false;
+            _loading = false;
+            return;
+        }
+    }
+
+    _key = hash.result();
+}
+
+QString PersistentTransformCache::filePath() const
+{
+    return QStringLiteral("%1/%2.gtc").arg(_directory, QString::fromLatin1(_key.toHex()));
+}
+
+template<typename E>
+static void writeValues(QDataStream& stream, const Attribute& attribute, const std::vector<E>& elementIds)
+{
+    stream << static_cast<quint32>(elementIds.size());
+    for(auto elementId : elementIds)
+    {
+        stream << static_cast<qint32>(elementId) << attribute.valueMissingOf(elementId);
+
+        switch(attribute.valueType())
+        {
+        case ValueType::Int:    stream << static_cast<qint32>(attribute.intValueOf(elementId)); break;
+        case ValueType::Float:  stream << attribute.floatValueOf(elementId); break;
+        default:                stream << attribute.stringValueOf(elementId); break;
+        }
+    }
+}
+
+template<typename T>
+struct LoadedValues
+{
+    std::vector<T> _values;
+    std::vector<bool> _missing;
+};
+
+template<typename T, typename E>
+static bool readTypedValues(QDataStream& stream, Attribute& attribute, int idLimit)
+{
+    auto values = std::make_shared<LoadedValues<T>>();
+    bool anyMissing = false;
+
+    quint32 size = 0;
+    stream >> size;
+
+    for(quint32 i = 0; i < size && stream.status() == QDataStream::Ok; i++)
+    {
+        qint32 id = -1;
+        bool missing = false;
+        T value{};
+
+        stream >> id >> missing >> value;
+
+        if(id < 0 || id >= idLimit)
+            return false;
+
+        auto index = static_cast<size_t>(id);
+        if(index >= values->_values.size())
+        {
+            values->_values.resize(index + 1);
+            values->_missing.resize(index + 1, true);
+        }
+
+        values->_values[index] = value;
+        values->_missing[index] = missing;
+        anyMissing = anyMissing || missing;
+    }
+
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    std::function<T(E)> valueFn = [values](E elementId)
+    {
+        auto index = static_cast<size_t>(static_cast<int>(elementId));
+        return index < values->_values.size() ? values->_values[index] : T{};
+    };
+
+    if constexpr(std::is_same_v<T, int>)
+        attribute.setIntValueFn(valueFn);
+    else if constexpr(std::is_same_v<T, double>)
+        attribute.setFloatValueFn(valueFn);
+    else
+        attribute.setStringValueFn(valueFn);
+
+    if(anyMissing)
+    {
+        std::function<bool(E)> missingFn = [values](E elementId)
+        {
+            auto index = static_cast<size_t>(static_cast<int>(elementId));
+            return index >= values->_missing.size() || values->_missing[index];
+        };
+
+        attribute.setValueMissingFn(missingFn);
+    }
+
+    return true;
+}
+
+template<typename E>
+static bool readValues(QDataStream& stream, Attribute& attribute, ValueType valueType, int idLimit)
+{
+    switch(valueType)
+    {
+    case ValueType::Int:    return readTypedValues<int, E>(stream, attribute, idLimit);
+    case ValueType::Float:  return readTypedValues<double, E>(stream, attribute, idLimit);
+    case ValueType::String: return readTypedValues<QString, E>(stream, attribute, idLimit);
+    default: break;
+    }
+
+    return false;
+}
+
+bool PersistentTransformCache::load(TransformCache::Result& result, const IGraph& graph) const
+{
+    if(!_loading || !_keyValid)
+        return false;
+
+    QFile file(filePath());
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream fileStream(&file);
+    QByteArray magic;
+    QByteArray compressedPayload;
+    fileStream >> magic >> compressedPayload;
+
+    if(fileStream.status() != QDataStream::Ok || magic != MAGIC)
+        return false;
+
+    auto payload = qUncompress(compressedPayload);
+    QDataStream stream(payload);
+
+    bool hasDelta = false;
+    stream >> hasDelta;
+
+    std::shared_ptr<GraphDelta> delta;
+    if(hasDelta)
+    {
+        delta = std::make_shared<GraphDelta>();
+        stream >> *delta;
+
+        if(stream.status() != QDataStream::Ok || !delta->validFor(graph))
+        {
+            qDebug() << "PersistentTransformCache: ignoring inapplicable cache file" << file.fileName();
+            return false;
+        }
+    }
+
+    // Attribute values may only refer to elements that exist once the delta is applied
+    const auto nodeIdLimit = static_cast<int>(graph.nextNodeId()) +
+        static_cast<int>(delta != nullptr ? delta->numNodesAdded() : 0);
+    const auto edgeIdLimit = static_cast<int>(graph.nextEdgeId()) +
+        static_cast<int>(delta != nullptr ? delta->numEdgesAdded() : 0);
+
+    quint32 numAttributes = 0;
+    stream >> numAttributes;
+
+    std::map<QString, Attribute> newAttributes;
+    for(quint32 i = 0; i < numAttributes && stream.status() == QDataStream::Ok; i++)
+    {
+        QString name;
+        qint32 elementType = 0;
+        qint32 valueType = 0;
+        qint32 flags = 0;
+        bool userDefined = false;
+        QString description;
+        bool hasMin = false;
+        bool hasMax = false;
+        double min = 0.0;
+        double max = 0.0;
+
+        stream >> name >> elementType >> valueType >> flags >> userDefined >>
+            description >> hasMin >> min >> hasMax >> max;
+
+        Attribute attribute;
+        bool valuesRead = false;
+
+        switch(static_cast<ElementType>(elementType))
+        {
+        case ElementType::Node:
+            valuesRead = readValues<NodeId>(stream, attribute, static_cast<ValueType>(valueType), nodeIdLimit);
+            break;
+
+        case ElementType::Edge:
+            valuesRead = readValues<EdgeId>(stream, attribute, static_cast<ValueType>(valueType), edgeIdLimit);
+            break;
+
+        default: break;
+        }
+
+        if(!valuesRead)
+            return false;
+
+        attribute.setUserDefined(userDefined);
+        attribute.setDescription(description);
+
+        // Explicit ranges are restored here; automatic ones are recalculated on use
+        if(attribute.valueType() == ValueType::Int)
+        {
+            if(hasMin) attribute.intRange().setMin(static_cast<int>(min));
+            if(hasMax) attribute.intRange().setMax(static_cast<int>(max));
+        }
+        else if(attribute.valueType() == ValueType::Float)
+        {
+            if(hasMin) attribute.floatRange().setMin(min);
+            if(hasMax) attribute.floatRange().setMax(max);
+        }
+
+        attribute.setFlag(static_cast<AttributeFlag>(flags));
+
+        newAttributes.emplace(name, attribute);
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qDebug() << "PersistentTransformCache: ignoring corrupt cache file" << file.fileName();
+        return false;
+    }
+
+    file.close();
+
+    // Touch the file so that eviction favours the least recently used
+    QFile touchFile(filePath());
+    if(touchFile.open(QIODevice::ReadWrite))
+        touchFile.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    result._delta = std::move(delta);
+    result._newAttributes = std::move(newAttributes);
+
+    return true;
+}
+
+void PersistentTransformCache::save(const TransformCache::Result& result, const Graph& graph) const
+{
+    if(!_keyValid || _maximumSize <= 0)
+        return;
+
+    // A complete copy of the graph is too costly to be worth persisting
+    if(result._graph != nullptr)
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+
+    stream << (result._delta != nullptr);
+    if(result._delta != nullptr)
+        stream << *result._delta;
+
+    stream << static_cast<quint32>(result._newAttributes.size());
+    for(const auto& [name, attribute] : result._newAttributes)
+    {
+        // Parameterised and component attributes are computed on demand, so there
+        // are no fixed values to persist
+        if(attribute.hasParameter() || (attribute.elementType() != ElementType::Node &&
+            attribute.elementType() != ElementType::Edge))
+        {
+            return;
+        }
+
+        const auto& range = attribute.numericRange();
+        bool explicitRange = !attribute.testFlag(AttributeFlag::AutoRange);
+
+        stream << name <<
+            static_cast<qint32>(attribute.elementType()) <<
+            static_cast<qint32>(attribute.valueType()) <<
+            static_cast<qint32>(attribute.flags()) <<
+            attribute.userDefined() <<
+            attribute.description() <<
+            (explicitRange && range.hasMin()) << (range.hasMin() ? range.min() : 0.0) <<
+            (explicitRange && range.hasMax()) << (range.hasMax() ? range.max() : 0.0);
+
+        if(attribute.elementType() == ElementType::Node)
+            writeValues(stream, attribute, graph.nodeIds());
+        else
+            writeValues(stream, attribute, graph.edgeIds());
+    }
+
+    if(!QDir().mkpath(_directory))
+        return;
+
+    QSaveFile file(filePath());
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream fileStream(&file);
+    fileStream << QByteArray(MAGIC) << qCompress(payload);
+
+    if(!file.commit())
+    {
+        qDebug() << "PersistentTransformCache: failed to write" << file.fileName();
+        return;
+    }
+
+    evict();
+}
+
+void PersistentTransformCache::evict() const
+{
+    QDir directory(_directory);
+    auto fileInfos = directory.entryInfoList({QStringLiteral("*.gtc")}, QDir::Files, QDir::Time);
+
+    qint64 totalSize = 0;
+    for(const auto& fileInfo : fileInfos)
+        totalSize += fileInfo.size();
+
+    // Most recently used first, so remove from the back
+    while(totalSize > _maximumSize && !fileInfos.isEmpty())
+    {
+        const auto& fileInfo = fileInfos.last();
+        totalSize -= fileInfo.size();
+        QFile::remove(fileInfo.absoluteFilePath());
+        fileInfos.removeLast();
+    }
+}
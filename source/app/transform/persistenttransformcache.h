@@ -0,0 +1,74 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERSISTENTTRANSFORMCACHE_H
+#define PERSISTENTTRANSFORMCACHE_H
+
+#include "transformcache.h"
+
+#include <QByteArray>
+#include <QString>
+
+class IGraph;
+class Graph;
+class MutableGraph;
+class GraphModel;
+class GraphTransformConfig;
+
+// An opt-in on disk cache of transform results, which persists between sessions. Each
+// step of a transform pipeline is keyed by a hash of the application version, the source
+// graph, every config up to and including its own, and the values of the attributes those
+// configs reference, so that any unchanged prefix of a pipeline can be reloaded instead of
+// recomputed
+class PersistentTransformCache
+{
+private:
+    QString _directory;
+    qint64 _maximumSize = 0;
+
+    QByteArray _key;
+
+    // Set when a step can't be keyed, in which case neither can any that follow it
+    bool _keyValid = false;
+
+    // Results are only loaded while every step so far has come from a cache
+    bool _loading = false;
+
+    QString filePath() const;
+    void evict() const;
+
+public:
+    PersistentTransformCache();
+
+    static bool enabled();
+
+    // Start a new pipeline, from the given source graph
+    void reset(const MutableGraph& source);
+
+    // Move on to the next step of the pipeline, which will be applied to graph
+    void advance(const GraphTransformConfig& config, const GraphModel& graphModel, const Graph& graph);
+
+    // Call when the current step had to be computed, rather than found in a cache
+    void stopLoading() { _loading = false; }
+
+    // Fails if the result isn't cached, or if what is cached can't be applied to graph
+    bool load(TransformCache::Result& result, const IGraph& graph) const;
+    void save(const TransformCache::Result& result, const Graph& graph) const;
+};
+
+#endif // PERSISTENTTRANSFORMCACHE_H
@@ -22,10 +22,239 @@
 #include "graph/mutablegraph.h"
 #include "transform/transformedgraph.h"
 
-#include "shared/utils/iterator_range.h"
 #include "shared/utils/container.h"
 
+#include <QDataStream>
+
 #include <algorithm>
+#include <iterator>
+
+// Reduces a sequence of additions and removals to their net effect
+template<typename Id>
+static void netChanges(std::vector<std::pair<Id, bool>>& changes,
+    std::vector<Id>& removed, std::vector<Id>& added)
+{
+    // Group the changes by element, preserving their order
+    std::stable_sort(changes.begin(), changes.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    for(auto first = changes.begin(); first != changes.end();)
+    {
+        auto last = first;
+        while(std::next(last) != changes.end() && std::next(last)->first == first->first)
+            ++last;
+
+        // If an element's first change was a removal, it existed beforehand, and if its
+        // last change was an addition, it exists afterwards; when both are true it must
+        // be removed and re-added, as it may not be the same element
+        if(!first->second)
+            removed.push_back(first->first);
+
+        if(last->second)
+            added.push_back(first->first);
+
+        first = std::next(last);
+    }
+}
+
+GraphDelta::GraphDelta(std::vector<NodeChange> nodeChanges,
+    std::vector<EdgeChange> edgeChanges, const MutableGraph& graph)
+{
+    netChanges(nodeChanges, _nodesRemoved, _nodesAdded);
+
+    std::vector<EdgeId> edgesAdded;
+    netChanges(edgeChanges, _edgesRemoved, edgesAdded);
+
+    _edgesAdded.reserve(edgesAdded.size());
+    for(auto edgeId : edgesAdded)
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        _edgesAdded.push_back({edgeId, edge.sourceId(), edge.targetId()});
+    }
+}
+
+void GraphDelta::apply(MutableGraph& graph) const
+{
+    graph.performTransaction([this](IMutableGraph& mutableGraph)
+    {
+        // Edges first, as removing a node also removes its edges
+        for(auto edgeId : _edgesRemoved)
+            mutableGraph.removeEdge(edgeId);
+
+        for(auto nodeId : _nodesRemoved)
+            mutableGraph.removeNode(nodeId);
+
+        for(auto nodeId : _nodesAdded)
+        {
+            mutableGraph.reserveNodeId(nodeId);
+            auto addedNodeId = mutableGraph.addNode(nodeId);
+            Q_ASSERT(addedNodeId == nodeId);
+            Q_UNUSED(addedNodeId);
+        }
+
+        for(const auto& edge : _edgesAdded)
+        {
+            mutableGraph.reserveEdgeId(edge._id);
+            auto addedEdgeId = mutableGraph.addEdge(edge._id, edge._sourceId, edge._targetId);
+            Q_ASSERT(addedEdgeId == edge._id);
+            Q_UNUSED(addedEdgeId);
+        }
+    });
+}
+
+template<typename Id>
+static std::vector<Id> sortedUnique(std::vector<Id> ids, bool& unique)
+{
+    std::sort(ids.begin(), ids.end());
+    unique = std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+
+    return ids;
+}
+
+template<typename Id>
+static bool sortedContains(const std::vector<Id>& ids, Id id)
+{
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+bool GraphDelta::validFor(const IGraph& graph) const
+{
+    bool unique = true;
+
+    const auto edgesRemoved = sortedUnique(_edgesRemoved, unique);
+    if(!unique)
+        return false;
+
+    const auto nodesRemoved = sortedUnique(_nodesRemoved, unique);
+    if(!unique)
+        return false;
+
+    const auto nodesAdded = sortedUnique(_nodesAdded, unique);
+    if(!unique)
+        return false;
+
+    std::vector<EdgeId> edgesAdded;
+    edgesAdded.reserve(_edgesAdded.size());
+    for(const auto& edge : _edgesAdded)
+        edgesAdded.push_back(edge._id);
+
+    edgesAdded = sortedUnique(std::move(edgesAdded), unique);
+    if(!unique)
+        return false;
+
+    // Added ids are either reused, or allocated in sequence after the existing ones
+    const auto nodeIdLimit = static_cast<int>(graph.nextNodeId()) + static_cast<int>(_nodesAdded.size());
+    const auto edgeIdLimit = static_cast<int>(graph.nextEdgeId()) + static_cast<int>(_edgesAdded.size());
+
+    auto inRange = [](auto id, int limit) { return static_cast<int>(id) >= 0 && static_cast<int>(id) < limit; };
+
+    for(auto edgeId : edgesRemoved)
+    {
+        if(!inRange(edgeId, edgeIdLimit) || !graph.containsEdgeId(edgeId))
+            return false;
+    }
+
+    for(auto nodeId : nodesRemoved)
+    {
+        if(!inRange(nodeId, nodeIdLimit) || !graph.containsNodeId(nodeId))
+            return false;
+    }
+
+    for(auto nodeId : nodesAdded)
+    {
+        if(!inRange(nodeId, nodeIdLimit) ||
+            (graph.containsNodeId(nodeId) && !sortedContains(nodesRemoved, nodeId)))
+        {
+            return false;
+        }
+    }
+
+    auto nodeExistsAfter = [&](NodeId nodeId)
+    {
+        if(!inRange(nodeId, nodeIdLimit))
+            return false;
+
+        return sortedContains(nodesAdded, nodeId) ||
+            (graph.containsNodeId(nodeId) && !sortedContains(nodesRemoved, nodeId));
+    };
+
+    for(const auto& edge : _edgesAdded)
+    {
+        if(!inRange(edge._id, edgeIdLimit) ||
+            (graph.containsEdgeId(edge._id) && !sortedContains(edgesRemoved, edge._id)))
+        {
+            return false;
+        }
+
+        if(!nodeExistsAfter(edge._sourceId) || !nodeExistsAfter(edge._targetId))
+            return false;
+    }
+
+    return true;
+}
+
+template<typename Id>
+static void writeIds(QDataStream& stream, const std::vector<Id>& ids)
+{
+    stream << static_cast<quint32>(ids.size());
+    for(auto id : ids)
+        stream << static_cast<qint32>(id);
+}
+
+template<typename Id>
+static void readIds(QDataStream& stream, std::vector<Id>& ids)
+{
+    quint32 size = 0;
+    stream >> size;
+
+    ids.clear();
+    for(quint32 i = 0; i < size && stream.status() == QDataStream::Ok; i++)
+    {
+        qint32 id = 0;
+        stream >> id;
+        ids.emplace_back(id);
+    }
+}
+
+QDataStream& operator<<(QDataStream& stream, const GraphDelta& delta)
+{
+    writeIds(stream, delta._edgesRemoved);
+    writeIds(stream, delta._nodesRemoved);
+    writeIds(stream, delta._nodesAdded);
+
+    stream << static_cast<quint32>(delta._edgesAdded.size());
+    for(const auto& edge : delta._edgesAdded)
+    {
+        stream << static_cast<qint32>(edge._id) <<
+            static_cast<qint32>(edge._sourceId) <<
+            static_cast<qint32>(edge._targetId);
+    }
+
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, GraphDelta& delta)
+{
+    readIds(stream, delta._edgesRemoved);
+    readIds(stream, delta._nodesRemoved);
+    readIds(stream, delta._nodesAdded);
+
+    quint32 size = 0;
+    stream >> size;
+
+    delta._edgesAdded.clear();
+    for(quint32 i = 0; i < size && stream.status() == QDataStream::Ok; i++)
+    {
+        qint32 id = 0;
+        qint32 sourceId = 0;
+        qint32 targetId = 0;
+
+        stream >> id >> sourceId >> targetId;
+        delta._edgesAdded.push_back({id, sourceId, targetId});
+    }
+
+    return stream;
+}
 
 TransformCache::TransformCache(GraphModel& graphModel) :
     _graphModel(&graphModel)
@@ -42,7 +271,7 @@ bool TransformCache::lastResultChangesGraph() const
 {
     return std::any_of(_cache.back().begin(), _cache.back().end(), [](const auto& result)
     {
-        return result._graph != nullptr;
+        return result.changesGraph();
     });
 }
 
@@ -110,6 +339,20 @@ void TransformCache::attributeAdded(const QString& attributeName)
     }
 }
 
+bool TransformCache::contains(int index, const GraphTransformConfig& config) const
+{
+    if(_cache.empty())
+        return false;
+
+    const auto& resultSet = _cache.front();
+
+    return std::any_of(resultSet.begin(), resultSet.end(),
+    [&](const auto& cachedResult)
+    {
+        return cachedResult._index == index && cachedResult._config == config;
+    });
+}
+
 TransformCache::Result TransformCache::apply(int index, const GraphTransformConfig& config, TransformedGraph& graph)
 {
     TransformCache::Result result;
@@ -134,10 +377,12 @@ TransformCache::Result TransformCache::apply(int index, const GraphTransformConf
         _graphModel->addAttributes(cachedResult._newAttributes);
         if(cachedResult._graph != nullptr)
             graph = *(cachedResult._graph);
+        else if(cachedResult._delta != nullptr)
+            cachedResult._delta->apply(graph.mutableGraph());
 
         result = std::move(cachedResult);
 
-        if(result._graph != nullptr)
+        if(result.changesGraph())
         {
             // If the graph was changed, remove the entire set...
             _cache.erase(_cache.begin());
@@ -156,23 +401,37 @@ TransformCache::Result TransformCache::apply(int index, const GraphTransformConf
     return result;
 }
 
-const MutableGraph* TransformCache::graph() const
+void TransformCache::restoreGraph(const MutableGraph& source, TransformedGraph& graph) const
 {
-    // Return the last graph in the cache
-    for(const auto& resultSet : make_iterator_range(_cache.rbegin(), _cache.rend()))
+    // Start from the last complete copy, if there is one...
+    const MutableGraph* startGraph = &source;
+    size_t startSet = 0;
+    size_t startResult = 0;
+
+    for(size_t i = 0; i < _cache.size(); i++)
     {
-        const auto& cachedResults = make_iterator_range(resultSet.rbegin(), resultSet.rend());
-        auto it = std::find_if(cachedResults.begin(), cachedResults.end(),
-        [](const auto& cachedResult)
+        for(size_t j = 0; j < _cache[i].size(); j++)
         {
-            return cachedResult._graph != nullptr;
-        });
-
-        if(it != cachedResults.end())
-            return it->_graph.get();
+            if(_cache[i][j]._graph != nullptr)
+            {
+                startGraph = _cache[i][j]._graph.get();
+                startSet = i;
+                startResult = j + 1;
+            }
+        }
     }
 
-    return nullptr;
+    graph = *startGraph;
+
+    // ...then replay the deltas that follow it
+    for(size_t i = startSet; i < _cache.size(); i++)
+    {
+        for(size_t j = (i == startSet ? startResult : 0); j < _cache[i].size(); j++)
+        {
+            if(_cache[i][j]._delta != nullptr)
+                _cache[i][j]._delta->apply(graph.mutableGraph());
+        }
+    }
 }
 
 std::map<QString, Attribute> TransformCache::attributes() const
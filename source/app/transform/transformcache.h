@@ -22,44 +22,66 @@
 #include "graphtransformconfig.h"
 #include "attributes/attribute.h"
 
+#include "shared/graph/elementid.h"
+
 #include <vector>
+#include <map>
+#include <memory>
+#include <utility>
 
+class IGraph;
 class MutableGraph;
 class TransformedGraph;
 class GraphModel;
+class QDataStream;
 
-class TransformCache
+// The changes a transform made to a graph, expressed as element additions and removals
+class GraphDelta
 {
 public:
-    struct Result
+    using NodeChange = std::pair<NodeId, bool>;
+    using EdgeChange = std::pair<EdgeId, bool>;
+
+private:
+    struct AddedEdge
     {
-        Result() = default;
-
-        Result(const Result& other) :
-            _index(other._index),
-            _config(other._config),
-            _graph(other._graph ? std::make_unique<MutableGraph>(*other._graph) : nullptr),
-            _newAttributes(other._newAttributes)
-        {}
-
-        Result(Result&& other) noexcept :
-            _index(other._index),
-            _config(std::move(other._config)),
-            _graph(std::move(other._graph)),
-            _newAttributes(std::move(other._newAttributes))
-        {}
-
-        Result& operator=(Result&& other) noexcept
-        {
-            _index = other._index;
-            _config = std::move(other._config);
-            _graph = std::move(other._graph);
-            _newAttributes = std::move(other._newAttributes);
+        EdgeId _id;
+        NodeId _sourceId;
+        NodeId _targetId;
+    };
 
-            return *this;
-        }
+    std::vector<EdgeId> _edgesRemoved;
+    std::vector<NodeId> _nodesRemoved;
+    std::vector<NodeId> _nodesAdded;
+    std::vector<AddedEdge> _edgesAdded;
+
+public:
+    GraphDelta() = default;
+
+    // Built from the sequence of additions (true) and removals (false) that took
+    // graph from its previous state to its current one
+    GraphDelta(std::vector<NodeChange> nodeChanges,
+        std::vector<EdgeChange> edgeChanges, const MutableGraph& graph);
+
+    void apply(MutableGraph& graph) const;
 
-        bool changesGraph() const { return _graph != nullptr; }
+    // Whether the delta can be applied to graph; one that has been read from
+    // elsewhere may be stale or corrupt, in which case it must not be
+    bool validFor(const IGraph& graph) const;
+
+    size_t numNodesAdded() const { return _nodesAdded.size(); }
+    size_t numEdgesAdded() const { return _edgesAdded.size(); }
+
+    friend QDataStream& operator<<(QDataStream& stream, const GraphDelta& delta);
+    friend QDataStream& operator>>(QDataStream& stream, GraphDelta& delta);
+};
+
+class TransformCache
+{
+public:
+    struct Result
+    {
+        bool changesGraph() const { return _delta != nullptr || _graph != nullptr; }
         bool isApplicable() const { return changesGraph() || !_newAttributes.empty(); }
 
         std::vector<QString> referencedAttributeNames() const
@@ -69,7 +91,13 @@ public:
 
         int _index = -1;
         GraphTransformConfig _config;
-        std::unique_ptr<MutableGraph> _graph;
+
+        // A graph changing result is stored as a delta against the graph that the transform
+        // was applied to, or where that isn't possible, as a complete copy of the result; in
+        // either case it's immutable, so copies of the Result can share it
+        std::shared_ptr<const GraphDelta> _delta;
+        std::shared_ptr<const MutableGraph> _graph;
+
         std::map<QString, Attribute> _newAttributes;
     };
 
@@ -93,9 +121,11 @@ public:
     void clear() { _cache.clear(); }
     void add(Result&& result);
     void attributeAdded(const QString& attributeName);
+    bool contains(int index, const GraphTransformConfig& config) const;
     Result apply(int index, const GraphTransformConfig& config, TransformedGraph& graph);
 
-    const MutableGraph* graph() const;
+    // Reproduces the graph that results from the cached transforms, starting from source
+    void restoreGraph(const MutableGraph& source, TransformedGraph& graph) const;
     std::map<QString, Attribute> attributes() const;
 };
 
@@ -25,12 +25,15 @@
 #include "shared/utils/container.h"
 
 #include <functional>
+#include <algorithm>
+#include <thread>
 
 TransformedGraph::TransformedGraph(GraphModel& graphModel, const MutableGraph& source) :
     _graphModel(&graphModel),
     _source(&source),
     _cache(graphModel),
     _cancelled(false),
+    _applyingConcurrently(false),
     _nodesState(source),
     _edgesState(source),
     _previousNodesState(source),
@@ -58,6 +61,12 @@ TransformedGraph::TransformedGraph(GraphModel& graphModel, const MutableGraph& s
     connect(&_target, &Graph::edgeRemoved, [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].remove(); });
     connect(&_target, &Graph::edgeAdded,   [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].add(); });
 
+    // Record the changes each transform makes, so that they can be cached as a delta
+    connect(&_target, &Graph::nodeRemoved, [this](const Graph*, NodeId nodeId) { if(_recordingChanges) _nodeChanges.emplace_back(nodeId, false); });
+    connect(&_target, &Graph::nodeAdded,   [this](const Graph*, NodeId nodeId) { if(_recordingChanges) _nodeChanges.emplace_back(nodeId, true); });
+    connect(&_target, &Graph::edgeRemoved, [this](const Graph*, EdgeId edgeId) { if(_recordingChanges) _edgeChanges.emplace_back(edgeId, false); });
+    connect(&_target, &Graph::edgeAdded,   [this](const Graph*, EdgeId edgeId) { if(_recordingChanges) _edgeChanges.emplace_back(edgeId, true); });
+
     addTransform(std::make_unique<IdentityTransform>());
 }
 
@@ -66,12 +75,17 @@ void TransformedGraph::cancelRebuild()
     std::unique_lock<std::mutex> lock(_currentTransformMutex);
     _cancelled = true;
 
-    if(_currentTransform != nullptr)
-        _currentTransform->cancel();
+    for(auto* currentTransform : _currentTransforms)
+        currentTransform->cancel();
 }
 
 void TransformedGraph::setProgress(int progress)
 {
+    // The progress of any one concurrently applied transform says little
+    // about the overall progress, so only aggregate progress is reported
+    if(_applyingConcurrently)
+        return;
+
     if(_command != nullptr)
         _command->setProgress(progress);
 }
@@ -129,20 +143,48 @@ void TransformedGraph::rebuild()
         CreatedAttributeNamesMap newCreatedAttributeNames;
         *this = *_source;
 
-        // Save previous state in case we get cancelled
+        // Save previous state in case we get cancelled; the cached graphs
+        // are immutable and shared, so this doesn't copy them
         auto oldCache = _cache;
         auto oldCreatedAttributeNames = _createdAttributeNames;
 
         // Save attributes of current graph so we can remove ones added if cancelled
         auto fixedAttributeNames = _graphModel->attributeNames();
 
-        for(auto& transform : _transforms)
+        _persistentCache.reset(*_source);
+
+        // Adds the attributes a transform has created to the result, then caches it
+        auto addResult = [&](const GraphTransform& transform, TransformCache::Result& result,
+            const std::vector<QString>& newAttributeNames)
         {
+            for(const auto& newAttributeName : newAttributeNames)
+            {
+                _graphModel->calculateAttributeRange(newAttributeName);
+                _graphModel->updateSharedAttributeValues(newAttributeName);
+
+                result._newAttributes.emplace(newAttributeName, _graphModel->attributeValueByName(newAttributeName));
+                _cache.attributeAdded(newAttributeName);
+                updatedAttributeNames.append(newAttributeName);
+            }
+
+            result._index = transform.index();
+            _persistentCache.save(result, *this);
+
+            newCreatedAttributeNames[transform.index()] = newAttributeNames;
+            newCache.add(std::move(result));
+        };
+
+        for(size_t i = 0; i < _transforms.size(); i++)
+        {
+            auto& transform = _transforms.at(i);
+
             setProgress(-1); // Indeterminate by default
 
             TransformCache::Result result;
             result._config = transform->config();
 
+            _persistentCache.advance(result._config, *_graphModel, *this);
+
             result = _cache.apply(transform->index(), result._config, *this);
             if(result.isApplicable())
             {
@@ -151,6 +193,66 @@ void TransformedGraph::rebuild()
                 continue;
             }
 
+            if(_persistentCache.load(result, _target))
+            {
+                if(result._delta != nullptr)
+                {
+                    result._delta->apply(_target);
+
+                    // Graph has changed, so the cache is now invalid
+                    _cache.clear();
+                }
+
+                _graphModel->addAttributes(result._newAttributes);
+                for(const auto& newAttributeName : u::keysFor(result._newAttributes))
+                {
+                    _graphModel->calculateAttributeRange(newAttributeName);
+                    _graphModel->updateSharedAttributeValues(newAttributeName);
+                    _cache.attributeAdded(newAttributeName);
+                    updatedAttributeNames.append(newAttributeName);
+                }
+
+                result._index = transform->index();
+
+                newCreatedAttributeNames[transform->index()] = u::keysFor(result._newAttributes);
+                newCache.add(std::move(result));
+                continue;
+            }
+
+            _persistentCache.stopLoading();
+
+            auto concurrentTransforms = concurrentlyApplicableTransforms(i);
+            if(concurrentTransforms.size() > 1)
+            {
+                auto stagedAttributes = applyConcurrently(concurrentTransforms);
+
+                if(_cancelled)
+                    break;
+
+                // Add the results in configuration order, so that they're
+                // identical to those of applying the transforms in sequence
+                for(size_t j = 0; j < concurrentTransforms.size(); j++)
+                {
+                    const auto* concurrentTransform = concurrentTransforms.at(j);
+
+                    TransformCache::Result concurrentResult;
+                    concurrentResult._config = concurrentTransform->config();
+
+                    // The first transform's key was advanced to above
+                    if(j > 0)
+                        _persistentCache.advance(concurrentResult._config, *_graphModel, *this);
+
+                    auto attributeNames = _graphModel->attributeNames();
+                    _graphModel->addStagedAttributes(stagedAttributes.at(j));
+
+                    addResult(*concurrentTransform, concurrentResult,
+                        u::setDifference(_graphModel->attributeNames(), attributeNames));
+                }
+
+                i += concurrentTransforms.size() - 1;
+                continue;
+            }
+
             // Save the attribute names before the transform application
             // so we can see which attributes are created
             auto attributeNames = _graphModel->attributeNames();
@@ -158,9 +260,24 @@ void TransformedGraph::rebuild()
             setCurrentTransform(transform.get());
             transform->uncancel();
 
-            if(transform->applyAndUpdate(*this, *_graphModel))
+            _nodeChanges.clear();
+            _edgeChanges.clear();
+            auto mergeGeneration = _target.mergeGeneration();
+            _recordingChanges = true;
+
+            bool graphChanged = transform->applyAndUpdate(*this, *_graphModel);
+            _recordingChanges = false;
+
+            if(graphChanged)
             {
-                result._graph = std::make_unique<MutableGraph>(_target);
+                // Merges can't be expressed as a delta, so in that case keep a copy instead
+                if(_target.mergeGeneration() == mergeGeneration)
+                {
+                    result._delta = std::make_shared<GraphDelta>(std::move(_nodeChanges),
+                        std::move(_edgeChanges), _target);
+                }
+                else
+                    result._graph = std::make_shared<MutableGraph>(_target);
 
                 // Graph has changed, so the cache is now invalid
                 _cache.clear();
@@ -171,21 +288,7 @@ void TransformedGraph::rebuild()
             if(_cancelled)
                 break;
 
-            auto newAttributeNames = u::setDifference(_graphModel->attributeNames(), attributeNames);
-            for(const auto& newAttributeName : newAttributeNames)
-            {
-                _graphModel->calculateAttributeRange(newAttributeName);
-                _graphModel->updateSharedAttributeValues(newAttributeName);
-
-                result._newAttributes.emplace(newAttributeName, _graphModel->attributeValueByName(newAttributeName));
-                _cache.attributeAdded(newAttributeName);
-                updatedAttributeNames.append(newAttributeName);
-            }
-
-            result._index = transform->index();
-
-            newCreatedAttributeNames[transform->index()] = newAttributeNames;
-            newCache.add(std::move(result));
+            addResult(*transform, result, u::setDifference(_graphModel->attributeNames(), attributeNames));
         }
 
         // Revert to indeterminate in case any more long running work occurs subsequently
@@ -196,8 +299,7 @@ void TransformedGraph::rebuild()
             // We've been cancelled so rollback to our previous state
             _cache = std::move(oldCache);
             _createdAttributeNames = std::move(oldCreatedAttributeNames);
-            const auto* cachedGraph = _cache.graph();
-            *this = (cachedGraph != nullptr ? *cachedGraph : *_source);
+            _cache.restoreGraph(*_source, *this);
 
             // Remove any attributes that were added before the cancel occurred
             for(const auto& attributeName : u::setDifference(_graphModel->attributeNames(), fixedAttributeNames))
@@ -224,10 +326,96 @@ void TransformedGraph::rebuild()
     clearPhase();
 }
 
+std::vector<GraphTransform*> TransformedGraph::concurrentlyApplicableTransforms(size_t index) const
+{
+    std::vector<GraphTransform*> transforms;
+
+    for(size_t i = index; i < _transforms.size(); i++)
+    {
+        auto* transform = _transforms.at(i).get();
+
+        if(!transform->createsAttributesOnly() || transform->repeating())
+            break;
+
+        if(i > index)
+        {
+            // Leave anything that's cached for the cache to deal with
+            if(_cache.contains(transform->index(), transform->config()))
+                break;
+
+            // Created attributes are always given unique names, so the only way a transform
+            // can depend on an earlier one is by referencing an attribute that doesn't exist yet
+            auto referencedAttributeNames = transform->config().referencedAttributeNames();
+            if(!std::all_of(referencedAttributeNames.begin(), referencedAttributeNames.end(),
+                [this](const auto& attributeName) { return _graphModel->attributeExists(attributeName); }))
+            {
+                break;
+            }
+        }
+
+        transforms.push_back(transform);
+    }
+
+    return transforms;
+}
+
+std::vector<GraphModel::StagedAttributes> TransformedGraph::applyConcurrently(
+    const std::vector<GraphTransform*>& transforms)
+{
+    std::vector<GraphModel::StagedAttributes> stagedAttributes(transforms.size());
+    auto numTransforms = static_cast<int>(transforms.size());
+    std::atomic_int numFinished(0);
+
+    setCurrentTransforms(transforms);
+    setPhase(QObject::tr("Applying %1 Transforms").arg(numTransforms));
+    setProgress(0);
+
+    _applyingConcurrently = true;
+
+    std::vector<std::thread> threads;
+    threads.reserve(transforms.size());
+
+    for(size_t i = 0; i < transforms.size(); i++)
+    {
+        auto* transform = transforms.at(i);
+        transform->uncancel();
+
+        // Each transform is given a thread of its own, rather than one from the pool,
+        // so that when it uses concurrent_for internally, that still runs in parallel
+        threads.emplace_back([this, transform, &attributes = stagedAttributes.at(i),
+            &numFinished, numTransforms]
+        {
+            _graphModel->stageCreatedAttributes(&attributes);
+            transform->applyConcurrently(*this, *_graphModel);
+            _graphModel->stageCreatedAttributes(nullptr);
+
+            if(_command != nullptr)
+                _command->setProgress((++numFinished * 100) / numTransforms);
+        });
+    }
+
+    for(auto& thread : threads)
+        thread.join();
+
+    _applyingConcurrently = false;
+    setCurrentTransforms({});
+    clearPhase();
+
+    return stagedAttributes;
+}
+
 void TransformedGraph::setCurrentTransform(GraphTransform* currentTransform)
+{
+    if(currentTransform != nullptr)
+        setCurrentTransforms({currentTransform});
+    else
+        setCurrentTransforms({});
+}
+
+void TransformedGraph::setCurrentTransforms(const std::vector<GraphTransform*>& currentTransforms)
 {
     std::unique_lock<std::mutex> lock(_currentTransformMutex);
-    _currentTransform = currentTransform;
+    _currentTransforms = currentTransforms;
 }
 
 void TransformedGraph::onTargetGraphChanged(const Graph*)
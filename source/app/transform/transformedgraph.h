@@ -21,9 +21,11 @@
 
 #include "graphtransform.h"
 #include "transformcache.h"
+#include "persistenttransformcache.h"
 
 #include "graph/graph.h"
 #include "graph/mutablegraph.h"
+#include "graph/graphmodel.h"
 
 #include "shared/graph/grapharray.h"
 #include "shared/utils/passkey.h"
@@ -38,7 +40,6 @@
 #include <atomic>
 #include <mutex>
 
-class GraphModel;
 class ICommand;
 
 class TransformedGraph : public Graph
@@ -78,8 +79,8 @@ public:
     EdgeId firstEdgeIdBetween(NodeId nodeIdA, NodeId nodeIdB) const override { return _target.firstEdgeIdBetween(nodeIdA, nodeIdB); }
     bool edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const override { return _target.edgeExistsBetween(nodeIdA, nodeIdB); }
 
-    void setPhase(const QString& phase) const override { _source->setPhase(phase); }
-    void clearPhase() const override { _source->clearPhase(); }
+    void setPhase(const QString& phase) const override { if(!_applyingConcurrently) _source->setPhase(phase); }
+    void clearPhase() const override { if(!_applyingConcurrently) _source->clearPhase(); }
     QString phase() const override { return _source->phase(); }
 
     void setProgress(int progress);
@@ -111,6 +112,11 @@ private:
     MutableGraph _target;
 
     TransformCache _cache;
+    PersistentTransformCache _persistentCache;
+
+    bool _recordingChanges = false;
+    std::vector<GraphDelta::NodeChange> _nodeChanges;
+    std::vector<GraphDelta::EdgeChange> _edgeChanges;
 
     using CreatedAttributeNamesMap = std::map<int, std::vector<QString>>;
     CreatedAttributeNamesMap _createdAttributeNames;
@@ -121,9 +127,10 @@ private:
     ICommand* _command = nullptr;
 
     std::atomic_bool _cancelled;
+    std::atomic_bool _applyingConcurrently;
 
     std::mutex _currentTransformMutex;
-    GraphTransform* _currentTransform = nullptr;
+    std::vector<GraphTransform*> _currentTransforms;
 
     class State
     {
@@ -146,7 +153,12 @@ private:
 
     void rebuild();
 
+    // Returns the run of transforms starting at index that can be applied concurrently
+    std::vector<GraphTransform*> concurrentlyApplicableTransforms(size_t index) const;
+    std::vector<GraphModel::StagedAttributes> applyConcurrently(const std::vector<GraphTransform*>& transforms);
+
     void setCurrentTransform(GraphTransform* currentTransform);
+    void setCurrentTransforms(const std::vector<GraphTransform*>& currentTransforms);
 
 private slots:
     void onTargetGraphChanged(const Graph* graph);
@@ -31,6 +31,7 @@ public:
     {}
 
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
 private:
     GraphModel* _graphModel = nullptr;
@@ -25,8 +25,6 @@
 #include "shared/utils/threadpool.h"
 
 #include <cstdint>
-#include <stack>
-#include <queue>
 #include <map>
 #include <thread>
 
@@ -43,11 +41,23 @@ void BetweennessTransform::apply(TransformedGraph& target) const
     {
         explicit BetweennessArrays(TransformedGraph& graph) :
             nodeBetweenness(graph, 0.0),
-            edgeBetweenness(graph, 0.0)
+            edgeBetweenness(graph, 0.0),
+            predecessorEdges(graph),
+            sigma(graph, 0),
+            distance(graph, -1),
+            delta(graph, 0.0)
         {}
 
         NodeArray<double> nodeBetweenness;
         EdgeArray<double> edgeBetweenness;
+
+        // Per source scratch space, reset after each traversal so
+        // that it can be reused without reallocating
+        NodeArray<std::vector<EdgeId>> predecessorEdges;
+        NodeArray<int64_t> sigma;
+        NodeArray<int64_t> distance;
+        NodeArray<double> delta;
+        std::vector<NodeId> visitOrder;
     };
 
     std::vector<BetweennessArrays> betweennessArrays(
@@ -62,66 +72,71 @@ void BetweennessTransform::apply(TransformedGraph& target) const
         auto& _edgeBetweenness = arrays.edgeBetweenness;
 
         // Brandes algorithm
-        NodeArray<std::vector<NodeId>> predecessors(target);
-        NodeArray<int64_t> sigma(target, 0);
-        NodeArray<int64_t> distance(target, -1);
-        NodeArray<double> delta(target, 0.0);
+        auto& predecessorEdges = arrays.predecessorEdges;
+        auto& sigma = arrays.sigma;
+        auto& distance = arrays.distance;
+        auto& delta = arrays.delta;
 
-        std::stack<NodeId> stack;
-        std::queue<NodeId> queue;
+        // The breadth first visit order doubles as the queue (read from the
+        // front) and the stack (read from the back)
+        auto& visitOrder = arrays.visitOrder;
+        visitOrder.clear();
 
-        sigma[nodeId] = 1.0;
+        sigma[nodeId] = 1;
         distance[nodeId] = 0;
-        queue.push(nodeId);
+        visitOrder.push_back(nodeId);
 
-        while(!queue.empty() && !cancelled())
+        for(size_t head = 0; head < visitOrder.size() && !cancelled(); head++)
         {
-            auto other = queue.front();
-            queue.pop();
-            stack.push(other);
+            auto other = visitOrder.at(head);
 
-            for(auto neighbour : target.neighboursOf(other))
+            target.nodeById(other).forEachEdgeId([&](EdgeId edgeId)
             {
+                auto neighbour = target.edgeById(edgeId).oppositeId(other);
+
                 if(distance[neighbour] < 0)
                 {
-                    queue.push(neighbour);
+                    visitOrder.push_back(neighbour);
                     distance[neighbour] = distance[other] + 1;
                 }
 
                 if(distance[neighbour] == distance[other] + 1)
                 {
                     sigma[neighbour] += sigma[other];
-                    predecessors[neighbour].push_back(other);
+                    predecessorEdges[neighbour].push_back(edgeId);
                 }
-            }
+            });
         }
 
-        while(!stack.empty() && !cancelled())
+        for(auto it = visitOrder.rbegin(); it != visitOrder.rend(); ++it)
         {
-            auto other = stack.top();
-            stack.pop();
+            auto other = *it;
 
-            for(auto predecessor : predecessors[other])
+            if(!cancelled())
             {
-                auto d = (static_cast<double>(sigma[predecessor]) /
-                    static_cast<double>(sigma[other])) * (1.0 + delta[other]);
+                for(auto edgeId : predecessorEdges[other])
+                {
+                    auto predecessor = target.edgeById(edgeId).oppositeId(other);
+                    auto d = (static_cast<double>(sigma[predecessor]) /
+                        static_cast<double>(sigma[other])) * (1.0 + delta[other]);
 
-                auto edgeIds = target.edgeIdsBetween(predecessor, other);
-                for(auto edgeId : edgeIds)
                     _edgeBetweenness[edgeId] += d;
+                    delta[predecessor] += d;
+                }
 
-                delta[predecessor] += d;
+                if(other != nodeId)
+                    _nodeBetweenness[other] += delta[other];
             }
 
-            if(other != nodeId)
-                _nodeBetweenness[other] += delta[other];
+            // Nothing visited after this point refers to other, so it can be reset
+            predecessorEdges[other].clear();
+            sigma[other] = 0;
+            distance[other] = -1;
+            delta[other] = 0.0;
         }
 
         progress++;
         target.setProgress(progress.load() * 100 / static_cast<int>(target.numNodes()));
-
-        if(cancelled())
-            return;
     });
 
     target.setProgress(-1);
@@ -29,6 +29,7 @@ class BetweennessTransform : public GraphTransform
 public:
     explicit BetweennessTransform(GraphModel* graphModel) : _graphModel(graphModel) {}
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
 private:
     GraphModel* _graphModel = nullptr;
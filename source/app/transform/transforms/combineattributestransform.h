@@ -29,6 +29,7 @@ public:
     {}
 
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
 private:
     GraphModel* _graphModel = nullptr;
@@ -34,6 +34,7 @@ public:
     {}
 
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
 private:
     ElementType _elementType;
@@ -27,6 +27,7 @@ class EccentricityTransform : public GraphTransform
 public:
     explicit EccentricityTransform(GraphModel* graphModel) : _graphModel(graphModel) {}
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
 private:
     GraphModel* _graphModel = nullptr;
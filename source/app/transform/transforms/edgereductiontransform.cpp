@@ -34,10 +34,14 @@ void EdgeReductionTransform::apply(TransformedGraph& target) const
 
     EdgeArray<bool> removees(target, true);
 
+    // Reused for each node to avoid reallocating
+    std::vector<EdgeId> edgeIds;
+
     uint64_t progress = 0;
     for(auto nodeId : target.nodeIds())
     {
-        auto edgeIds = target.nodeById(nodeId).edgeIds();
+        edgeIds.clear();
+        target.nodeById(nodeId).forEachEdgeId([&edgeIds](EdgeId edgeId) { edgeIds.push_back(edgeId); });
 
         if(edgeIds.empty())
             continue;
@@ -53,10 +53,14 @@ void KNNTransform::apply(TransformedGraph& target) const
     EdgeArray<KnnRank> ranks(target);
     EdgeArray<bool> removees(target, true);
 
+    // Reused for each node to avoid reallocating
+    std::vector<EdgeId> edgeIds;
+
     uint64_t progress = 0;
     for(auto nodeId : target.nodeIds())
     {
-        auto edgeIds = target.nodeById(nodeId).edgeIds();
+        edgeIds.clear();
+        target.nodeById(nodeId).forEachEdgeId([&edgeIds](EdgeId edgeId) { edgeIds.push_back(edgeId); });
         auto kthPlus1 = edgeIds.begin() + std::min(k, edgeIds.size());
 
         if(ascending)
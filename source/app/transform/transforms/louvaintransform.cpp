@@ -173,7 +173,7 @@ void LouvainTransform::apply(TransformedGraph& target) const
             if(graph.typeOf(nodeId) == MultiElementType::Tail)
                 continue;
 
-            for(auto edgeId : graph.nodeById(nodeId).edgeIds())
+            for(auto edgeId : graph.edgeIdsForNodeId(nodeId))
                 weightedDegrees[nodeId] += weights[edgeId];
 
             add(nextCommunityId++, nodeId);
@@ -199,7 +199,7 @@ void LouvainTransform::apply(TransformedGraph& target) const
                     continue;
 
                 std::map<CommunityId, double> neighbourCommunityWeights;
-                for(auto edgeId : graph.nodeById(nodeId).edgeIds())
+                for(auto edgeId : graph.edgeIdsForNodeId(nodeId))
                 {
                     auto neighbourNodeId = graph.edgeById(edgeId).oppositeId(nodeId);
 
@@ -29,6 +29,7 @@ class PageRankTransform : public GraphTransform
 public:
     explicit PageRankTransform(GraphModel* graphModel) : _graphModel(graphModel) {}
     void apply(TransformedGraph& target) const override;
+    bool createsAttributesOnly() const override { return true; }
 
     void enableDebug() { _debug = true; }
     void disableDebug() { _debug = false; }
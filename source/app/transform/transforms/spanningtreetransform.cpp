@@ -22,20 +22,25 @@
 
 #include "graph/componentmanager.h"
 #include "graph/graphcomponent.h"
+#include "graph/graphmodel.h"
 
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <deque>
+#include <numeric>
 
 #include <QObject>
 
-void SpanningTreeTransform::apply(TransformedGraph& target) const
+std::vector<EdgeId> SpanningTreeTransform::traversalForest(const TransformedGraph& target) const
 {
     bool dfs = config().parameterHasValue(QStringLiteral("Traversal Order"), QStringLiteral("Depth First"));
 
-    target.setPhase(QObject::tr("Spanning Tree"));
-    target.setProgress(-1);
-
-    EdgeArray<bool> removees(target, true);
+    std::vector<EdgeId> treeEdgeIds;
     NodeArray<bool> visitedNodes(target, false);
 
     ComponentManager componentManager(target);
@@ -75,33 +80,176 @@ void SpanningTreeTransform::apply(TransformedGraph& target) const
             visitedNodes.set(nodeId, true);
 
             if(!traversedEdgeId.isNull())
-                removees.set(traversedEdgeId, false);
+                treeEdgeIds.push_back(traversedEdgeId);
 
-            for(auto edgeId : target.nodeById(nodeId).edgeIds())
+            target.nodeById(nodeId).forEachEdgeId([&](EdgeId edgeId)
             {
                 auto oppositeId = target.edgeById(edgeId).oppositeId(nodeId);
 
                 if(!visitedNodes.get(oppositeId))
                     deque.push_back({oppositeId, edgeId});
-            }
+            });
         }
     }
 
-    uint64_t progress = 0;
+    return treeEdgeIds;
+}
 
-    for(const auto& edgeId : target.edgeIds())
+std::vector<EdgeId> SpanningTreeTransform::weightedForest(const TransformedGraph& target) const
+{
+    bool minimum = config().parameterHasValue(QStringLiteral("Weighting"), QStringLiteral("Minimum"));
+
+    auto attribute = _graphModel->attributeValueByName(config().attributeNames().front());
+
+    NodeArray<int> nodeIndices(target, -1);
+    int numNodes = 0;
+    for(auto nodeId : target.nodeIds())
+        nodeIndices[nodeId] = numNodes++;
+
+    // Compact edge list, with weights arranged so that lower is always better
+    struct WeightedEdge
     {
-        if(removees.get(edgeId))
-            target.mutableGraph().removeEdge(edgeId);
+        int _source;
+        int _target;
+        double _weight;
+        EdgeId _edgeId;
+    };
+
+    std::vector<WeightedEdge> edges;
+    edges.reserve(static_cast<size_t>(target.numEdges()));
+
+    for(auto edgeId : target.edgeIds())
+    {
+        const auto& edge = target.edgeById(edgeId);
+        if(edge.isLoop())
+            continue;
+
+        auto weight = attribute.numericValueOf(edgeId);
 
-        target.setProgress(static_cast<int>((progress++ * 100u) /
-            static_cast<uint64_t>(target.numEdges())));
+        if(std::isnan(weight))
+            weight = std::numeric_limits<double>::infinity();
+        else if(!minimum)
+            weight = -weight;
+
+        edges.push_back({nodeIndices[edge.sourceId()], nodeIndices[edge.targetId()], weight, edgeId});
     }
 
-    target.setProgress(-1);
+    // Ties are broken by position, giving a strict total order and hence
+    // ensuring that concurrently chosen edges can never form a cycle
+    auto lighter = [&edges](size_t a, size_t b)
+    {
+        const auto& edgeA = edges[a];
+        const auto& edgeB = edges[b];
+
+        return edgeA._weight < edgeB._weight || (edgeA._weight == edgeB._weight && a < b);
+    };
+
+    std::vector<int> parents(static_cast<size_t>(numNodes));
+    std::iota(parents.begin(), parents.end(), 0);
+
+    auto find = [&parents](int index)
+    {
+        while(parents[static_cast<size_t>(index)] != index)
+        {
+            auto& parent = parents[static_cast<size_t>(index)];
+            parent = parents[static_cast<size_t>(parent)];
+            index = parent;
+        }
+
+        return index;
+    };
+
+    // Each node's component, as of the end of the previous round
+    std::vector<int> components = parents;
+
+    const auto NoEdge = std::numeric_limits<size_t>::max();
+    std::vector<std::atomic<size_t>> lightestEdges(static_cast<size_t>(numNodes));
+
+    std::vector<EdgeId> treeEdgeIds;
+
+    // Borůvka; each round at least halves the number of components
+    while(!edges.empty())
+    {
+        for(auto& lightestEdge : lightestEdges)
+            lightestEdge.store(NoEdge, std::memory_order_relaxed);
+
+        const auto& constEdges = edges;
+        concurrent_for(constEdges.cbegin(), constEdges.cend(),
+        [&](std::vector<WeightedEdge>::const_iterator it)
+        {
+            auto index = static_cast<size_t>(std::distance(constEdges.cbegin(), it));
+
+            for(auto component : {components[static_cast<size_t>(it->_source)],
+                components[static_cast<size_t>(it->_target)]})
+            {
+                auto& lightestEdge = lightestEdges[static_cast<size_t>(component)];
+                auto current = lightestEdge.load(std::memory_order_relaxed);
+
+                while((current == NoEdge || lighter(index, current)) &&
+                    !lightestEdge.compare_exchange_weak(current, index, std::memory_order_relaxed)) {}
+            }
+        });
+
+        if(cancelled())
+            return {};
+
+        for(const auto& lightestEdge : lightestEdges)
+        {
+            auto index = lightestEdge.load(std::memory_order_relaxed);
+            if(index == NoEdge)
+                continue;
+
+            const auto& edge = edges[index];
+            auto sourceRoot = find(edge._source);
+            auto targetRoot = find(edge._target);
+
+            // Already joined, when the edge was lightest for both of its components
+            if(sourceRoot == targetRoot)
+                continue;
+
+            parents[static_cast<size_t>(sourceRoot)] = targetRoot;
+            treeEdgeIds.push_back(edge._edgeId);
+        }
+
+        for(int i = 0; i < numNodes; i++)
+            components[static_cast<size_t>(i)] = find(i);
+
+        edges.erase(std::remove_if(edges.begin(), edges.end(), [&components](const auto& edge)
+        {
+            return components[static_cast<size_t>(edge._source)] ==
+                components[static_cast<size_t>(edge._target)];
+        }), edges.end());
+    }
+
+    return treeEdgeIds;
 }
 
-std::unique_ptr<GraphTransform> SpanningTreeTransformFactory::create(const GraphTransformConfig&) const
+void SpanningTreeTransform::apply(TransformedGraph& target) const
 {
-    return std::make_unique<SpanningTreeTransform>();
+    target.setPhase(QObject::tr("Spanning Tree"));
+    target.setProgress(-1);
+
+    if(_weighted && config().attributeNames().empty())
+    {
+        addAlert(AlertType::Error, QObject::tr("Invalid parameter"));
+        return;
+    }
+
+    auto treeEdgeIds = _weighted ? weightedForest(target) : traversalForest(target);
+
+    if(cancelled())
+        return;
+
+    EdgeArray<bool> removees(target, true);
+    for(auto edgeId : treeEdgeIds)
+        removees.set(edgeId, false);
+
+    std::vector<EdgeId> removeeEdgeIds;
+    for(auto edgeId : target.edgeIds())
+    {
+        if(removees.get(edgeId))
+            removeeEdgeIds.push_back(edgeId);
+    }
+
+    target.mutableGraph().removeEdges(removeeEdgeIds);
 }
@@ -22,6 +22,7 @@
 #include "transform/graphtransform.h"
 #include "attributes/attribute.h"
 
+#include "shared/graph/elementid.h"
 #include "shared/utils/redirects.h"
 
 #include <vector>
@@ -29,7 +30,16 @@
 class SpanningTreeTransform : public GraphTransform
 {
 public:
+    explicit SpanningTreeTransform(GraphModel* graphModel, bool weighted) :
+        _graphModel(graphModel), _weighted(weighted) {}
     void apply(TransformedGraph& target) const override;
+
+private:
+    GraphModel* _graphModel = nullptr;
+    bool _weighted = false;
+
+    std::vector<EdgeId> traversalForest(const TransformedGraph& target) const;
+    std::vector<EdgeId> weightedForest(const TransformedGraph& target) const;
 };
 
 class SpanningTreeTransformFactory : public GraphTransformFactory
@@ -60,7 +70,52 @@ public:
         };
     }
 
-    std::unique_ptr<GraphTransform> create(const GraphTransformConfig& graphTransformConfig) const override;
+    std::unique_ptr<GraphTransform> create(const GraphTransformConfig&) const override
+    {
+        return std::make_unique<SpanningTreeTransform>(graphModel(), false);
+    }
+};
+
+class WeightedSpanningTreeTransformFactory : public SpanningTreeTransformFactory
+{
+public:
+    using SpanningTreeTransformFactory::SpanningTreeTransformFactory;
+
+    QString description() const override
+    {
+        return QObject::tr("Find a minimum or maximum weight %1 for each component.")
+            .arg(u::redirectLink("spanning_tree", QObject::tr("spanning tree")));
+    }
+
+    GraphTransformAttributeParameters attributeParameters() const override
+    {
+        return
+        {
+            {
+                "Weighting Attribute",
+                ElementType::Edge, ValueType::Numerical,
+                QObject::tr("The attribute whose value is used to weight edges.")
+            }
+        };
+    }
+
+    GraphTransformParameters parameters() const override
+    {
+        return
+        {
+            {
+                "Weighting",
+                ValueType::StringList,
+                QObject::tr("Whether to keep the edges with the largest or smallest total weight."),
+                QStringList{"Maximum", "Minimum"}
+            }
+        };
+    }
+
+    std::unique_ptr<GraphTransform> create(const GraphTransformConfig&) const override
+    {
+        return std::make_unique<SpanningTreeTransform>(graphModel(), true);
+    }
 };
 
 #endif // SPANNINGTREETRANSFORM_H
@@ -38,6 +38,7 @@
 #include "loading/isaver.h"
 
 #include "layout/forcedirectedlayout.h"
+#include "layout/multilevellayout.h"
 #include "layout/layout.h"
 #include "layout/collision.h"
 
@@ -794,7 +795,14 @@ void Document::onLoadComplete(const QUrl&, bool success)
     if(!_bookmarks.empty())
         emit bookmarksChanged();
 
-    _layoutThread = std::make_unique<LayoutThread>(*_graphModel, std::make_unique<ForceDirectedLayoutFactory>(_graphModel.get()));
+    std::unique_ptr<LayoutFactory> layoutFactory;
+
+    if(u::pref("misc/multilevelLayout").toBool())
+        layoutFactory = std::make_unique<MultilevelForceDirectedLayoutFactory>(_graphModel.get());
+    else
+        layoutFactory = std::make_unique<ForceDirectedLayoutFactory>(_graphModel.get());
+
+    _layoutThread = std::make_unique<LayoutThread>(*_graphModel, std::move(layoutFactory));
 
     for(const auto& layoutSetting : _loadedLayoutSettings)
         _layoutThread->setSettingValue(layoutSetting._name, layoutSetting._value);
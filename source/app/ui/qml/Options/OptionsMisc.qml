@@ -38,6 +38,9 @@ Item
         property alias focusFoundComponents: focusFoundComponentsCheckbox.checked
         property alias stayInComponentMode: stayInComponentModeCheckbox.checked
         property alias disableHubbles: disableHubblesCheckbox.checked
+        property alias multilevelLayout: multilevelLayoutCheckbox.checked
+        property alias persistentTransformCache: persistentTransformCacheCheckbox.checked
+        property alias persistentTransformCacheSize: persistentTransformCacheSizeSpinBox.value
         property alias webSearchEngineUrl: webSearchEngineField.text
         property alias maxUndoLevels: maxUndoSpinBox.value
         property alias autoBackgroundUpdateCheck: autoBackgroundUpdateCheckCheckbox.checked
@@ -56,6 +59,7 @@ Item
         id: visuals
         section: "visuals"
         property alias disableMultisampling: disableMultisamplingCheckbox.checked
+        property alias softwareScreenshots: softwareScreenshotsCheckbox.checked
     }
 
     Component.onCompleted:
@@ -117,6 +121,20 @@ Item
                 text: qsTr("…But Not From Component Mode")
             }
 
+            Label
+            {
+                Layout.topMargin: Constants.margin * 2
+
+                font.bold: true
+                text: qsTr("Layout")
+            }
+
+            CheckBox
+            {
+                id: multilevelLayoutCheckbox
+                text: qsTr("Use Multilevel Layout For Large Components")
+            }
+
             Label
             {
                 Layout.topMargin: Constants.margin * 2
@@ -223,6 +241,12 @@ Item
                 text: qsTr("Disable Multisampling (Restart Required)")
             }
 
+            CheckBox
+            {
+                id: softwareScreenshotsCheckbox
+                text: qsTr("Render Screenshots Using The CPU")
+            }
+
             Text
             {
                 Layout.preferredWidth: parent.width
@@ -241,6 +265,31 @@ Item
                 onLinkActivated: { QmlUtils.showAppInFileManager(); }
             }
 
+            CheckBox
+            {
+                id: persistentTransformCacheCheckbox
+                text: qsTr("Cache Transform Results On Disk")
+            }
+
+            RowLayout
+            {
+                Layout.leftMargin: Constants.margin * 2
+
+                enabled: persistentTransformCacheCheckbox.checked
+
+                Label { text: qsTr("Maximum Cache Size (MiB):") }
+
+                SpinBox
+                {
+                    id: persistentTransformCacheSizeSpinBox
+
+                    Layout.preferredWidth: 80
+                    minimumValue: 64
+                    maximumValue: 65536
+                    stepSize: 64
+                }
+            }
+
             Label
             {
                 Layout.topMargin: Constants.margin * 2
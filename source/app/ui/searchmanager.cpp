@@ -147,7 +147,7 @@ void SearchManager::findNodes(QString term, Flags<FindOptions> options,
         }
     }
 
-    bool changed = u::setsDiffer(_foundNodeIds, foundNodeIds);
+    bool changed = _foundNodeIds != foundNodeIds;
 
     _foundNodeIds = std::move(foundNodeIds);
 
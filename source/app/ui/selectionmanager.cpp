@@ -47,7 +47,7 @@ SelectionManager::SelectionManager(const GraphModel& graphModel) :
     });
 }
 
-NodeIdSet SelectionManager::selectedNodes() const
+const NodeIdSet& SelectionManager::selectedNodes() const
 {
 #ifdef EXPENSIVE_DEBUG_CHECKS
     // Assertion that our selection doesn't contain things that aren't in the graph
@@ -66,16 +66,16 @@ NodeIdSet SelectionManager::unselectedNodes() const
 {
     const auto& nodeIds = _graphModel->graph().nodeIds();
     auto unselectedNodeIds = NodeIdSet(nodeIds.begin(), nodeIds.end());
-    unselectedNodeIds.erase(_selectedNodeIds.begin(), _selectedNodeIds.end());
+    unselectedNodeIds.subtract(_selectedNodeIds);
 
     return unselectedNodeIds;
 }
 
-//FIXME http://en.cppreference.com/w/cpp/container/unordered_set/merge will be useful here
 template<typename C> bool _selectNodes(const GraphModel& graphModel, NodeIdSet& selectedNodeIds,
     NodeIdSet& mask, const C& nodeIds, bool selectMergedNodes = true)
 {
-    NodeIdSet newSelectedNodeIds;
+    // Collect into a vector first so that the set can insert them in bulk
+    std::vector<NodeId> newSelectedNodeIds;
 
     if(selectMergedNodes)
     {
@@ -89,7 +89,7 @@ template<typename C> bool _selectNodes(const GraphModel& graphModel, NodeIdSet&
             for(auto mergedNodeId : mergedNodeIds)
             {
                 if(mask.empty() || u::contains(mask, mergedNodeId))
-                    newSelectedNodeIds.insert(mergedNodeId);
+                    newSelectedNodeIds.push_back(mergedNodeId);
             }
         }
     }
@@ -98,7 +98,7 @@ template<typename C> bool _selectNodes(const GraphModel& graphModel, NodeIdSet&
         for(auto nodeId : nodeIds)
         {
             if(mask.empty() || u::contains(mask, nodeId))
-                newSelectedNodeIds.insert(nodeId);
+                newSelectedNodeIds.push_back(nodeId);
         }
     }
 
@@ -185,15 +185,11 @@ bool SelectionManager::deselectNodes(const std::vector<NodeId>& nodeIds)
 
 template<typename C> void _toggleNodes(NodeIdSet& selectedNodeIds, NodeIdSet& mask, const C& nodeIds)
 {
-    NodeIdSet difference;
-    for(auto nodeId : nodeIds)
-    {
-        if(!u::contains(selectedNodeIds, nodeId))
-        {
-            if(mask.empty() || u::contains(mask, nodeId))
-                difference.insert(nodeId);
-        }
-    }
+    NodeIdSet difference(nodeIds.begin(), nodeIds.end());
+    difference.subtract(selectedNodeIds);
+
+    if(!mask.empty())
+        difference.intersect(mask);
 
     selectedNodeIds = std::move(difference);
 }
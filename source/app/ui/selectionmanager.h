@@ -34,7 +34,7 @@ class SelectionManager : public QObject, public ISelectionManager
 public:
     explicit SelectionManager(const GraphModel& graphModel);
 
-    NodeIdSet selectedNodes() const override;
+    const NodeIdSet& selectedNodes() const override;
     NodeIdSet unselectedNodes() const override;
 
     bool selectNode(NodeId nodeId) override;
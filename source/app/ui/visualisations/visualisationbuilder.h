@@ -33,53 +33,83 @@
 #include <vector>
 #include <array>
 #include <type_traits>
+#include <utility>
+#include <algorithm>
 
 #include <QCollator>
 #include <QtGlobal>
 
+// Each visualisation is built into its own layer, so that the result can be cached
+// and reused whilst other visualisations change; the layers are subsequently
+// composited, in order, to produce the final mapped visuals
 template<typename ElementId>
 class VisualisationsBuilder
 {
 public:
-    VisualisationsBuilder(const Graph& graph,
-        ElementIdArray<ElementId, ElementVisual>& visuals) :
-        _graph(&graph), _visuals(&visuals)
+    using Visuals = ElementIdArray<ElementId, ElementVisual>;
+
+    // Only the channel values a visualisation actually produces are kept,
+    // each ordered by ElementId
+    struct Layer
+    {
+        std::vector<std::pair<ElementId, float>> _sizes;
+        std::vector<std::pair<ElementId, QColor>> _colors;
+        std::vector<std::pair<ElementId, QString>> _texts;
+    };
+
+    using Layers = std::vector<std::pair<int, const Layer*>>;
+
+    explicit VisualisationsBuilder(const Graph& graph) :
+        _graph(&graph)
     {}
 
 private:
     const Graph* _graph;
-    ElementIdArray<ElementId, ElementVisual>* _visuals;
-    int _numAppliedVisualisations = 0;
-
-    static const int NumChannels = 3;
 
-    struct Applied
+    static void addTo(Layer& layer, ElementId elementId, const ElementVisual& visual)
     {
-        Applied(int index, const IGraphArrayClient& graph) :
-            _index(index), _array(graph)
-        {}
+        if(visual._size >= 0.0f)
+            layer._sizes.emplace_back(elementId, visual._size);
 
-        int _index;
-        ElementIdArray<ElementId, bool> _array;
-    };
+        if(visual._outerColor.isValid())
+            layer._colors.emplace_back(elementId, visual._outerColor);
+
+        if(!visual._text.isEmpty())
+            layer._texts.emplace_back(elementId, visual._text);
+    }
 
-    std::array<std::vector<Applied>, NumChannels> _applications;
+    static void sortByElementId(Layer& layer)
+    {
+        auto byElementId = [](const auto& a, const auto& b) { return a.first < b.first; };
+
+        std::sort(layer._sizes.begin(), layer._sizes.end(), byElementId);
+        std::sort(layer._colors.begin(), layer._colors.end(), byElementId);
+        std::sort(layer._texts.begin(), layer._texts.end(), byElementId);
+    }
 
-    template<typename T>
-    void apply(T value, const VisualisationChannel& channel,
-               ElementId elementId, int index)
+    template<typename T, typename U>
+    static int numCommonElements(const std::vector<std::pair<ElementId, T>>& a,
+        const std::vector<std::pair<ElementId, U>>& b)
     {
-        auto& visual = (*_visuals)[elementId];
-        auto oldVisual = visual;
-        channel.apply(value, visual);
+        int count = 0;
+        auto aIt = a.begin();
+        auto bIt = b.begin();
 
-        Q_ASSERT(index < static_cast<int>(_applications[0].size()));
+        while(aIt != a.end() && bIt != b.end())
+        {
+            if(aIt->first < bIt->first)
+                ++aIt;
+            else if(bIt->first < aIt->first)
+                ++bIt;
+            else
+            {
+                count++;
+                ++aIt;
+                ++bIt;
+            }
+        }
 
-        // Must not exceed NumChannels
-        _applications[0].at(index)._array.set(elementId, oldVisual._size  != visual._size);
-        _applications[1].at(index)._array.set(elementId, oldVisual._innerColor != visual._innerColor ||
-                oldVisual._outerColor != visual._outerColor);
-        _applications[2].at(index)._array.set(elementId, oldVisual._text  != visual._text);
+        return count;
     }
 
     template<typename G>
@@ -99,61 +129,79 @@ private:
         return elementIds(_graph);
     }
 
-public:
-    void findOverrideAlerts(VisualisationInfosMap& infos)
+    template<typename ChannelValuesFn>
+    static void findOverrideAlerts(const Layers& layers, VisualisationInfosMap& infos,
+        const ChannelValuesFn& channelValues)
     {
-        for(int c = 0; c < NumChannels; c++)
+        for(size_t i = 0; i + 1 < layers.size(); i++)
         {
-            for(int i = 0; i < _numAppliedVisualisations - 1; i++)
-            {
-                const auto& iv = _applications.at(c).at(i);
+            const auto& iv = channelValues(*layers.at(i).second);
 
-                for(int j = i + 1; j < _numAppliedVisualisations; j++)
-                {
-                    const auto& jv = _applications.at(c).at(j);
-                    int bothSet = 0, sourceSet = 0;
+            if(iv.empty())
+                continue;
 
-                    for(auto elementId : elementIds())
-                    {
-                        if(iv._array.get(elementId))
-                        {
-                            sourceSet++;
+            for(size_t j = i + 1; j < layers.size(); j++)
+            {
+                const auto& jv = channelValues(*layers.at(j).second);
+                auto bothSet = numCommonElements(iv, jv);
 
-                            if(jv._array.get(elementId))
-                                bothSet++;
-                        }
-                    }
+                if(bothSet == 0)
+                    continue;
 
-                    if(bothSet > 0)
-                    {
-                        if(bothSet != sourceSet)
-                        {
-                            infos[iv._index].addAlert(AlertType::Warning,
-                                QObject::tr("Partially overriden by subsequent visualisations"));
-                        }
-                        else
-                        {
-                            infos[iv._index].addAlert(AlertType::Error,
-                                QObject::tr("Overriden by subsequent visualisations"));
-                        }
-                    }
+                auto& info = infos[layers.at(i).first];
+
+                if(bothSet != static_cast<int>(iv.size()))
+                {
+                    info.addAlert(AlertType::Warning,
+                        QObject::tr("Partially overriden by subsequent visualisations"));
+                }
+                else
+                {
+                    info.addAlert(AlertType::Error,
+                        QObject::tr("Overriden by subsequent visualisations"));
                 }
             }
         }
     }
 
-    void build(const Attribute& attribute,
+public:
+    // Overlays each layer in turn onto visuals, and determines
+    // which layers are (partially) overriden by subsequent layers
+    void composite(const Layers& layers, Visuals& visuals, VisualisationInfosMap& infos) const
+    {
+        visuals.resetElements();
+
+        for(const auto& [index, layer] : layers)
+        {
+            for(const auto& [elementId, size] : layer->_sizes)
+                visuals[elementId]._size = size;
+
+            for(const auto& [elementId, color] : layer->_colors)
+                visuals[elementId]._outerColor = color;
+
+            for(const auto& [elementId, text] : layer->_texts)
+                visuals[elementId]._text = text;
+        }
+
+        findOverrideAlerts(layers, infos, [](const Layer& layer) -> const auto& { return layer._sizes; });
+        findOverrideAlerts(layers, infos, [](const Layer& layer) -> const auto& { return layer._colors; });
+        findOverrideAlerts(layers, infos, [](const Layer& layer) -> const auto& { return layer._texts; });
+    }
+
+    // Returns true if the visualisation was applied to any elements
+    bool build(const Attribute& attribute,
                const VisualisationChannel& channel,
                const VisualisationConfig& config,
-               int index, VisualisationInfo& visualisationInfo)
+               Layer& layer, VisualisationInfo& visualisationInfo) const
     {
-        for(int c = 0; c < NumChannels; c++)
-            _applications.at(c).emplace_back(index, *_graph);
+        layer = {};
 
-        if(elementIds().empty())
+        const auto allElementIds = elementIds();
+
+        if(allElementIds.empty())
         {
             visualisationInfo.addAlert(AlertType::Error, QObject::tr("No elements to visualise"));
-            return;
+            return false;
         }
 
         switch(attribute.valueType())
@@ -166,7 +214,9 @@ public:
 
             int numApplications = 0;
 
-            auto applyTo = [&](const auto& graph, const u::Statistics& statistics)
+            // The statistics store the values of the elements they were found for,
+            // so there is no need to reevaluate the attribute when applying
+            auto applyTo = [&](const std::vector<ElementId>& ids, const u::Statistics& statistics)
             {
                 if(channel.requiresRange() && statistics._range == 0.0)
                 {
@@ -175,14 +225,16 @@ public:
                     return;
                 }
 
+                Q_ASSERT(statistics._values.size() == ids.size());
+
                 VisualisationMapping mapping(statistics, config.parameterValue("mapping"));
 
                 visualisationInfo.setMappedMinimum(mapping.min());
                 visualisationInfo.setMappedMaximum(mapping.max());
 
-                for(auto elementId : elementIds(graph))
+                for(size_t i = 0; i < ids.size(); i++)
                 {
-                    double value = attribute.numericValueOf(elementId);
+                    double value = statistics._values.at(i);
 
                     if(channel.allowsMapping())
                     {
@@ -192,50 +244,58 @@ public:
                         value = mapping.map(value);
                     }
 
-                    apply(value, channel, elementId, _numAppliedVisualisations);
+                    ElementVisual visual;
+                    channel.apply(value, visual);
+                    addTo(layer, ids.at(i), visual);
                 }
 
                 numApplications++;
             };
 
-            auto statistics = attribute.findStatisticsforElements(elementIds(), true);
+            auto statistics = attribute.findStatisticsforElements(allElementIds, true);
 
             if(perComponent)
             {
                 for(auto componentId : _graph->componentIds())
                 {
                     const auto* component = _graph->componentById(componentId);
-                    auto componentStatistics = attribute.findStatisticsforElements(elementIds(component));
-                    applyTo(component, componentStatistics);
+                    auto componentElementIds = elementIds(component);
+                    auto componentStatistics = attribute.findStatisticsforElements(componentElementIds, true);
+                    applyTo(componentElementIds, componentStatistics);
                 }
             }
             else
-                applyTo(_graph, statistics);
+                applyTo(allElementIds, statistics);
+
+            sortByElementId(layer);
 
             visualisationInfo.setStatistics(statistics);
             visualisationInfo.setNumApplications(numApplications);
 
-            if(numApplications > 0)
-                _numAppliedVisualisations++;
-
-            break;
+            return numApplications > 0;
         }
 
         case ValueType::String:
         {
-            for(auto elementId : elementIds())
+            for(auto elementId : allElementIds)
             {
                 auto stringValue = attribute.stringValueOf(elementId);
-                apply(stringValue, channel, elementId, _numAppliedVisualisations);
+
+                ElementVisual visual;
+                channel.apply(stringValue, visual);
+                addTo(layer, elementId, visual);
             }
 
-            _numAppliedVisualisations++;
-            break;
+            sortByElementId(layer);
+
+            return true;
         }
 
         default:
             break;
         }
+
+        return false;
     }
 };
 
@@ -0,0 +1,151 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "approximatecorrelation.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
+
+ApproximateCorrelationSearch::ApproximateCorrelationSearch(
+    const std::vector<const CorrelationDataRow*>& rows,
+    int effort, bool anticorrelated, Cancellable* cancellable) :
+    _anticorrelated(anticorrelated)
+{
+    if(rows.empty())
+        return;
+
+    effort = std::clamp(effort, MinimumEffort, MaximumEffort);
+
+    const auto numRows = rows.size();
+    const auto numColumns = rows.front()->numColumns();
+    const auto numTables = static_cast<size_t>(2 * effort);
+    _windowSize = static_cast<size_t>(2 * effort);
+
+    // Roughly enough bits to give each row a bucket of its own; any more
+    // than this only serves to order rows within the same window
+    size_t numBits = 8;
+    while(numBits < 32 && (size_t{1} << numBits) < numRows)
+        numBits++;
+
+    _signatureMask = numBits < 32 ? (uint32_t{1} << numBits) - 1 : ~uint32_t{0};
+
+    // Random ±1 hyperplanes work as well as Gaussian ones for this purpose,
+    // and unlike std::normal_distribution give the same results everywhere
+    std::mt19937 generator(0x5eed);
+    std::vector<double> hyperplanes(numTables * numBits * numColumns);
+    std::generate(hyperplanes.begin(), hyperplanes.end(),
+        [&generator] { return (generator() & 1u) != 0 ? 1.0 : -1.0; });
+
+    // Centring the rows is equivalent to subtracting mean * ∑h from each projection
+    std::vector<double> hyperplaneSums(numTables * numBits);
+    for(size_t i = 0; i < hyperplaneSums.size(); i++)
+    {
+        auto hyperplane = hyperplanes.begin() + static_cast<std::ptrdiff_t>(i * numColumns);
+        hyperplaneSums[i] = std::accumulate(hyperplane,
+            hyperplane + static_cast<std::ptrdiff_t>(numColumns), 0.0);
+    }
+
+    _tables.resize(numTables);
+    for(auto& table : _tables)
+        table._signatures.resize(numRows);
+
+    concurrent_for(rows.begin(), rows.end(),
+    [&](std::vector<const CorrelationDataRow*>::const_iterator rowIt)
+    {
+        if(cancellable != nullptr && cancellable->cancelled())
+            return;
+
+        auto index = static_cast<size_t>(std::distance(rows.begin(), rowIt));
+        const auto* row = *rowIt;
+
+        size_t hyperplaneIndex = 0;
+        for(auto& table : _tables)
+        {
+            uint32_t signature = 0;
+
+            for(size_t bit = 0; bit < numBits; bit++, hyperplaneIndex++)
+            {
+                auto hyperplane = hyperplanes.begin() +
+                    static_cast<std::ptrdiff_t>(hyperplaneIndex * numColumns);
+                auto projection = std::inner_product(row->begin(), row->end(), hyperplane, 0.0) -
+                    (row->mean() * hyperplaneSums[hyperplaneIndex]);
+
+                if(projection > 0.0)
+                    signature |= uint32_t{1} << bit;
+            }
+
+            table._signatures[index] = signature;
+        }
+    });
+
+    concurrent_for(_tables.begin(), _tables.end(),
+    [numRows](std::vector<Table>::iterator tableIt)
+    {
+        auto& table = *tableIt;
+
+        table._sorted.resize(numRows);
+        for(size_t row = 0; row < numRows; row++)
+            table._sorted[row] = {table._signatures[row], static_cast<uint32_t>(row)};
+
+        std::sort(table._sorted.begin(), table._sorted.end());
+
+        table._positions.resize(numRows);
+        for(size_t position = 0; position < numRows; position++)
+            table._positions[table._sorted[position].second] = static_cast<uint32_t>(position);
+    });
+}
+
+void ApproximateCorrelationSearch::candidatesFor(size_t index, std::vector<size_t>& candidates) const
+{
+    candidates.clear();
+
+    for(const auto& table : _tables)
+    {
+        auto addWindow = [&](size_t centre)
+        {
+            auto first = centre > _windowSize ? centre - _windowSize : 0;
+            auto last = std::min(centre + _windowSize + 1, table._sorted.size());
+
+            for(auto position = first; position < last; position++)
+            {
+                auto row = static_cast<size_t>(table._sorted[position].second);
+
+                if(row != index)
+                    candidates.push_back(row);
+            }
+        };
+
+        addWindow(table._positions[index]);
+
+        if(_anticorrelated)
+        {
+            auto invertedSignature = ~table._signatures[index] & _signatureMask;
+            auto it = std::lower_bound(table._sorted.begin(), table._sorted.end(),
+                std::make_pair(invertedSignature, uint32_t{0}));
+
+            addWindow(static_cast<size_t>(std::distance(table._sorted.begin(), it)));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
@@ -0,0 +1,70 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef APPROXIMATECORRELATION_H
+#define APPROXIMATECORRELATION_H
+
+#include "correlationdatarow.h"
+
+#include "shared/utils/cancellable.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Suggests pairs of rows that are likely to be strongly correlated, without
+// comparing every pair. Each row is hashed using the signs of random projections
+// of its mean centred values, so that rows pointing in similar directions (i.e.
+// with a high Pearson correlation) tend to share signature bits. Sorting the rows
+// by signature then brings similar rows close together, and the candidates for a
+// row are those within a small window of it, in each of several independent tables.
+class ApproximateCorrelationSearch
+{
+public:
+    static constexpr int MinimumEffort = 1;
+    static constexpr int DefaultEffort = 4;
+    static constexpr int MaximumEffort = 10;
+
+    // A higher effort finds more of the correlated pairs, at the expense of speed.
+    // If anticorrelated is set, rows pointing in opposite directions are also
+    // suggested, by additionally probing each table at the inverted signature.
+    ApproximateCorrelationSearch(const std::vector<const CorrelationDataRow*>& rows,
+        int effort, bool anticorrelated, Cancellable* cancellable = nullptr);
+
+    // Replaces the contents of candidates with the unique indices of the
+    // rows that may be correlated with the row at index, excluding itself
+    void candidatesFor(size_t index, std::vector<size_t>& candidates) const;
+
+private:
+    struct Table
+    {
+        // Indexed by row
+        std::vector<uint32_t> _signatures;
+        std::vector<uint32_t> _positions;
+
+        // Pairs of signature and row, in signature order
+        std::vector<std::pair<uint32_t, uint32_t>> _sorted;
+    };
+
+    size_t _windowSize = 0;
+    bool _anticorrelated = false;
+    uint32_t _signatureMask = 0;
+    std::vector<Table> _tables;
+};
+
+#endif // APPROXIMATECORRELATION_H
@@ -19,6 +19,7 @@
 #ifndef CORRELATION_H
 #define CORRELATION_H
 
+#include "approximatecorrelation.h"
 #include "correlationdatarow.h"
 
 #include "shared/utils/qmlenum.h"
@@ -31,6 +32,10 @@
 
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <tuple>
 
 #include <QObject>
 #include <QString>
@@ -49,6 +54,11 @@ DEFINE_QML_ENUM(
     Negative,
     Both);
 
+DEFINE_QML_ENUM(
+    Q_GADGET, CorrelationSearchType,
+    Exhaustive,
+    Approximate);
+
 class Correlation
 {
 public:
@@ -61,7 +71,43 @@ public:
     virtual QString attributeName() const = 0;
     virtual QString attributeDescription() const = 0;
 
+    // Only evaluate the pairs of rows suggested by an ApproximateCorrelationSearch,
+    // instead of all of them; when maxNeighbours is non-zero, each row then keeps
+    // only that many of its strongest correlations
+    void setApproximateSearch(int effort, size_t maxNeighbours = 0)
+    {
+        _approximateSearchEffort = effort;
+        _maxNeighbours = maxNeighbours;
+    }
+
+    // Exclude correlations at least as strong as this, typically because they are
+    // already known, so that only the band between the thresholds is returned
+    void setMaximumThreshold(double maximumThreshold) { _maximumThreshold = maximumThreshold; }
+
     static std::unique_ptr<Correlation> create(CorrelationType correlationType);
+
+    // How strong a correlation is, with respect to the threshold, given a polarity
+    static double strength(double r, CorrelationPolarity polarity)
+    {
+        switch(polarity)
+        {
+        default:
+        case CorrelationPolarity::Positive: return r;
+        case CorrelationPolarity::Negative: return -r;
+        case CorrelationPolarity::Both:     return std::abs(r);
+        }
+    }
+
+protected:
+    int _approximateSearchEffort = 0;
+    size_t _maxNeighbours = 0;
+    double _maximumThreshold = std::numeric_limits<double>::infinity();
+
+    bool withinThresholds(double r, double minimumThreshold, CorrelationPolarity polarity) const
+    {
+        auto s = strength(r, polarity);
+        return s >= minimumThreshold && s < _maximumThreshold;
+    }
 };
 
 enum class RowType
@@ -86,6 +132,12 @@ public:
         if(progressable != nullptr)
             progressable->setProgress(-1);
 
+        if(_approximateSearchEffort > 0)
+        {
+            return approximateProcess(rows, numColumns, minimumThreshold,
+                polarity, cancellable, progressable);
+        }
+
         uint64_t totalCost = 0;
         for(const auto& row : rows)
         {
@@ -97,7 +149,9 @@ public:
 
         std::atomic<uint64_t> cost(0);
 
-        auto results = ThreadPool(QStringLiteral("Correlation")).concurrent_for(rows.begin(), rows.end(),
+        ThreadPool::TaskGroup taskGroup(QStringLiteral("Correlation"));
+
+        auto results = concurrent_for(rows.begin(), rows.end(),
         [&](std::vector<CorrelationDataRow>::const_iterator rowAIt)
         {
             const auto* rowA = &(*rowAIt);
@@ -108,7 +162,11 @@ public:
             EdgeList edges;
 
             if(cancellable != nullptr && cancellable->cancelled())
+            {
+                // Don't start on any more rows
+                taskGroup.cancel();
                 return edges;
+            }
 
             for(auto rowBIt = rowAIt + 1; rowBIt != rows.end(); ++rowBIt)
             {
@@ -122,17 +180,7 @@ public:
                 if(!std::isfinite(r))
                     continue;
 
-                bool createEdge = false;
-
-                switch(polarity)
-                {
-                default:
-                case CorrelationPolarity::Positive: createEdge = (r >= minimumThreshold); break;
-                case CorrelationPolarity::Negative: createEdge = (r <= -minimumThreshold); break;
-                case CorrelationPolarity::Both:     createEdge = (std::abs(r) >= minimumThreshold); break;
-                }
-
-                if(createEdge)
+                if(withinThresholds(r, minimumThreshold, polarity))
                     edges.push_back({rowA->nodeId(), rowB->nodeId(), r});
             }
 
@@ -157,6 +205,109 @@ public:
 
         return edges;
     }
+
+private:
+    EdgeList approximateProcess(const std::vector<CorrelationDataRow>& rows, size_t numColumns,
+        double minimumThreshold, CorrelationPolarity polarity,
+        Cancellable* cancellable, Progressable* progressable) const
+    {
+        std::vector<const CorrelationDataRow*> searchRows;
+        searchRows.reserve(rows.size());
+
+        for(const auto& row : rows)
+        {
+            if constexpr(rowType == RowType::Ranking)
+            {
+                row.generateRanking();
+                searchRows.push_back(row.ranking());
+            }
+            else
+                searchRows.push_back(&row);
+        }
+
+        ApproximateCorrelationSearch search(searchRows, _approximateSearchEffort,
+            polarity != CorrelationPolarity::Positive, cancellable);
+
+        std::atomic<size_t> numRowsProcessed(0);
+
+        ThreadPool::TaskGroup taskGroup(QStringLiteral("Correlation"));
+
+        auto results = concurrent_for(searchRows.cbegin(), searchRows.cend(),
+        [&](std::vector<const CorrelationDataRow*>::const_iterator rowAIt)
+        {
+            EdgeList edges;
+
+            if(cancellable != nullptr && cancellable->cancelled())
+            {
+                taskGroup.cancel();
+                return edges;
+            }
+
+            auto indexA = static_cast<size_t>(std::distance(searchRows.cbegin(), rowAIt));
+            const auto* rowA = *rowAIt;
+
+            std::vector<size_t> candidates;
+            search.candidatesFor(indexA, candidates);
+
+            for(auto indexB : candidates)
+            {
+                const auto* rowB = searchRows[indexB];
+                double r = Algorithm::evaluate(numColumns, rowA, rowB);
+
+                if(!std::isfinite(r) || !withinThresholds(r, minimumThreshold, polarity))
+                    continue;
+
+                // Orient the edges as the exhaustive search would, so duplicates can be found
+                if(indexA < indexB)
+                    edges.push_back({rowA->nodeId(), rowB->nodeId(), r});
+                else
+                    edges.push_back({rowB->nodeId(), rowA->nodeId(), r});
+            }
+
+            if(_maxNeighbours > 0 && edges.size() > _maxNeighbours)
+            {
+                auto nth = edges.begin() + static_cast<std::ptrdiff_t>(_maxNeighbours);
+                std::nth_element(edges.begin(), nth, edges.end(),
+                [polarity](const auto& a, const auto& b)
+                {
+                    return strength(a._weight, polarity) > strength(b._weight, polarity);
+                });
+
+                edges.erase(nth, edges.end());
+            }
+
+            numRowsProcessed++;
+
+            if(progressable != nullptr)
+            {
+                progressable->setProgress(static_cast<int>(
+                    (numRowsProcessed * 100) / searchRows.size()));
+            }
+
+            return edges;
+        });
+
+        if(progressable != nullptr)
+            progressable->setProgress(-1);
+
+        EdgeList edges;
+        edges.reserve(std::distance(results.begin(), results.end()));
+        edges.insert(edges.end(), std::make_move_iterator(results.begin()),
+            std::make_move_iterator(results.end()));
+
+        // The same pair may have been suggested to both of its rows
+        std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b)
+        {
+            return std::tie(a._source, a._target) < std::tie(b._source, b._target);
+        });
+
+        edges.erase(std::unique(edges.begin(), edges.end(), [](const auto& a, const auto& b)
+        {
+            return a._source == b._source && a._target == b._target;
+        }), edges.end());
+
+        return edges;
+    }
 };
 
 struct PearsonAlgorithm
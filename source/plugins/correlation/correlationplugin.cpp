@@ -22,6 +22,8 @@
 #include "correlationplotitem.h"
 #include "graphsizeestimateplotitem.h"
 
+#include "shared/commands/icommandmanager.h"
+
 #include "shared/graph/grapharray_json.h"
 
 #include "shared/utils/threadpool.h"
@@ -39,7 +41,12 @@
 
 #include <json_helper.h>
 
+#include <QDataStream>
+#include <QByteArray>
+
 #include <map>
+#include <cmath>
+#include <limits>
 
 CorrelationPluginInstance::CorrelationPluginInstance()
 {
@@ -95,8 +102,6 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
             uint64_t dataPoint = columnIndex + rowOffset;
             parser.setProgress(static_cast<int>((dataPoint * 100) / numDataPoints));
 
-            const auto& value = tabularData.valueAt(columnIndex, rowIndex);
-
             size_t dataColumnIndex = columnIndex - dataRect.x();
             size_t dataRowIndex = rowIndex - dataRect.y();
             bool isColumnInDataRect = left <= columnIndex && columnIndex < right;
@@ -115,6 +120,10 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
                 continue;
             }
 
+            // Data values are read numerically, so there is no need for their string form
+            bool isDataValue = rowIndex > 0 && !isColumnAnnotation && isColumnInDataRect;
+            auto value = !isDataValue ? tabularData.valueAt(columnIndex, rowIndex) : QString();
+
             if(rowIndex == 0)
             {
                 if(isColumnInDataRect)
@@ -131,30 +140,32 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
             }
             else if(isColumnInDataRect)
             {
-                double transformedValue = 0.0;
+                // Missing values are marked as NaN, then imputed below, once all the data is known
+                double numericValue = std::numeric_limits<double>::quiet_NaN();
 
-                if(!value.isEmpty())
+                if(!tabularData.isEmptyAt(columnIndex, rowIndex))
                 {
-                    bool success = false;
-                    transformedValue = value.toDouble(&success);
-                    Q_ASSERT(success);
+                    numericValue = tabularData.numericValueAt(columnIndex, rowIndex);
+                    Q_ASSERT(!std::isnan(numericValue));
                 }
                 else
-                {
-                    transformedValue = CorrelationFileParser::imputeValue(_missingDataType, _missingDataReplacementValue,
-                        tabularData, dataRect, columnIndex, rowIndex);
                     _imputedValues = true;
-                }
-
-                transformedValue = CorrelationFileParser::scaleValue(_scalingType, transformedValue);
 
-                setData(dataColumnIndex, dataRowIndex, transformedValue);
+                setData(dataColumnIndex, dataRowIndex, numericValue);
             }
             else if(isRowAttribute)
                 _userNodeData.setValue(dataRowIndex, tabularData.valueAt(columnIndex, 0), value);
         }
     }
 
+    if(_imputedValues)
+    {
+        CorrelationFileParser::imputeMissingValues(_missingDataType,
+            _missingDataReplacementValue, _data, _numColumns, &parser, &parser);
+    }
+
+    CorrelationFileParser::scaleValues(_scalingType, _data);
+
     makeDataColumnNamesUnique();
     setNodeAttributeTableModelDataColumns();
     parser.setProgress(-1);
@@ -328,12 +339,30 @@ QStringList CorrelationPluginInstance::numericalAttributeNames() const
 EdgeList CorrelationPluginInstance::correlation(double minimumThreshold, IParser& parser)
 {
     auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
+
+    if(_correlationSearchType == CorrelationSearchType::Approximate)
+        correlation->setApproximateSearch(_searchEffort, _maxNeighbours);
+
     return correlation->process(_dataRows, minimumThreshold,
         static_cast<CorrelationPolarity>(_correlationPolarity), &parser, &parser);
 }
 
-bool CorrelationPluginInstance::createEdges(const EdgeList& edges, IParser& parser)
+bool CorrelationPluginInstance::createEdges(EdgeList edges, IParser& parser)
 {
+    auto polarity = _correlationPolarity;
+    auto reservedIt = std::partition(edges.begin(), edges.end(), [this, polarity](const auto& edge)
+    {
+        return Correlation::strength(edge._weight, polarity) >= _minimumCorrelationValue;
+    });
+
+    _reservedEdges.assign(std::make_move_iterator(reservedIt), std::make_move_iterator(edges.end()));
+    edges.erase(reservedIt, edges.end());
+
+    std::sort(_reservedEdges.begin(), _reservedEdges.end(), [polarity](const auto& a, const auto& b)
+    {
+        return Correlation::strength(a._weight, polarity) < Correlation::strength(b._weight, polarity);
+    });
+
     parser.setProgress(-1);
     for(auto edgeIt = edges.begin(); edgeIt != edges.end(); ++edgeIt)
     {
@@ -351,6 +380,122 @@ bool CorrelationPluginInstance::createEdges(const EdgeList& edges, IParser& pars
     return true;
 }
 
+double CorrelationPluginInstance::correlationFloor() const
+{
+    if(std::isnan(_correlationFloor))
+        return _minimumCorrelationValue;
+
+    return std::min(_correlationFloor, _minimumCorrelationValue);
+}
+
+bool CorrelationPluginInstance::rethreshold(double minimumCorrelation,
+    Cancellable& cancellable, Progressable& progressable)
+{
+    auto polarity = _correlationPolarity;
+    auto weaker = [polarity](const auto& a, const auto& b)
+    {
+        return Correlation::strength(a._weight, polarity) < Correlation::strength(b._weight, polarity);
+    };
+
+    auto floor = correlationFloor();
+
+    if(minimumCorrelation < floor)
+    {
+        // Everything at or above the floor is already known, so only the band beneath it needs computing
+        auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
+
+        if(_correlationSearchType == CorrelationSearchType::Approximate)
+            correlation->setApproximateSearch(_searchEffort, _maxNeighbours);
+
+        correlation->setMaximumThreshold(floor);
+
+        auto band = correlation->process(_dataRows, minimumCorrelation,
+            polarity, &cancellable, &progressable);
+
+        if(cancellable.cancelled())
+            return false;
+
+        std::sort(band.begin(), band.end(), weaker);
+        band.insert(band.end(), std::make_move_iterator(_reservedEdges.begin()),
+            std::make_move_iterator(_reservedEdges.end()));
+        _reservedEdges = std::move(band);
+    }
+
+    progressable.setProgress(-1);
+
+    graphModel()->mutableGraph().performTransaction([&](IMutableGraph& graph)
+    {
+        if(minimumCorrelation < _minimumCorrelationValue)
+        {
+            // Admit the strongest of the reserved edges
+            auto admittedIt = std::partition_point(_reservedEdges.begin(), _reservedEdges.end(),
+            [minimumCorrelation, polarity](const auto& edge)
+            {
+                return Correlation::strength(edge._weight, polarity) < minimumCorrelation;
+            });
+
+            for(auto it = admittedIt; it != _reservedEdges.end(); ++it)
+            {
+                auto edgeId = graph.addEdge(it->_source, it->_target);
+                _correlationValues->set(edgeId, it->_weight);
+            }
+
+            _reservedEdges.erase(admittedIt, _reservedEdges.end());
+        }
+        else
+        {
+            // Move the edges that are now too weak back into the reserve; they're
+            // all stronger than those already reserved, so the order is kept
+            EdgeList removedEdges;
+            std::vector<EdgeId> removedEdgeIds;
+
+            for(auto edgeId : graph.edgeIds())
+            {
+                auto r = _correlationValues->get(edgeId);
+                if(Correlation::strength(r, polarity) >= minimumCorrelation)
+                    continue;
+
+                const auto& edge = graph.edgeById(edgeId);
+                removedEdges.push_back({edge.sourceId(), edge.targetId(), r});
+                removedEdgeIds.push_back(edgeId);
+            }
+
+            graph.removeEdges(removedEdgeIds);
+
+            std::sort(removedEdges.begin(), removedEdges.end(), weaker);
+            _reservedEdges.insert(_reservedEdges.end(), std::make_move_iterator(removedEdges.begin()),
+                std::make_move_iterator(removedEdges.end()));
+        }
+    });
+
+    _correlationFloor = std::min(floor, minimumCorrelation);
+    _minimumCorrelationValue = minimumCorrelation;
+    emit minimumCorrelationChanged();
+
+    return true;
+}
+
+void CorrelationPluginInstance::setMinimumCorrelation(double minimumCorrelation)
+{
+    auto previousMinimumCorrelation = _minimumCorrelationValue;
+
+    commandManager()->execute(ExecutePolicy::Add, std::make_unique<Command>(
+        Command::CommandDescription
+        {
+            tr("Set Minimum Correlation"),
+            tr("Setting Minimum Correlation"),
+            tr("Set Minimum Correlation to %1").arg(u::formatNumberScientific(minimumCorrelation))
+        },
+        [this, minimumCorrelation](Command& command)
+        {
+            return rethreshold(minimumCorrelation, command, command);
+        },
+        [this, previousMinimumCorrelation](Command& command)
+        {
+            rethreshold(previousMinimumCorrelation, command, command);
+        }));
+}
+
 void CorrelationPluginInstance::setDimensions(size_t numColumns, size_t numRows)
 {
     Q_ASSERT(_dataColumnNames.empty());
@@ -498,6 +643,8 @@ void CorrelationPluginInstance::applyParameter(const QString& name, const QVaria
 {
     if(name == QStringLiteral("minimumCorrelation"))
         _minimumCorrelationValue = value.toDouble();
+    else if(name == QStringLiteral("correlationFloor"))
+        _correlationFloor = value.toDouble();
     else if(name == QStringLiteral("initialThreshold"))
         _initialCorrelationThreshold = value.toDouble();
     else if(name == QStringLiteral("transpose"))
@@ -506,6 +653,12 @@ void CorrelationPluginInstance::applyParameter(const QString& name, const QVaria
         _correlationType = static_cast<CorrelationType>(value.toInt());
     else if(name == QStringLiteral("correlationPolarity"))
         _correlationPolarity = static_cast<CorrelationPolarity>(value.toInt());
+    else if(name == QStringLiteral("correlationSearchType"))
+        _correlationSearchType = static_cast<CorrelationSearchType>(value.toInt());
+    else if(name == QStringLiteral("searchEffort"))
+        _searchEffort = value.toInt();
+    else if(name == QStringLiteral("maxNeighbours"))
+        _maxNeighbours = static_cast<size_t>(std::max(0, value.toInt()));
     else if(name == QStringLiteral("scaling"))
         _scalingType = static_cast<ScalingType>(value.toInt());
     else if(name == QStringLiteral("normalise"))
@@ -667,6 +820,28 @@ QByteArray CorrelationPluginInstance::save(IMutableGraph& graph, Progressable& p
     jsonObject["transpose"] = _transpose;
     jsonObject["correlationType"] = static_cast<int>(_correlationType);
     jsonObject["correlationPolarity"] = static_cast<int>(_correlationPolarity);
+    jsonObject["correlationSearchType"] = static_cast<int>(_correlationSearchType);
+    jsonObject["searchEffort"] = _searchEffort;
+    jsonObject["maxNeighbours"] = static_cast<int>(_maxNeighbours);
+
+    // The floor is only meaningful alongside the edges reserved above it
+    if(!std::isnan(_correlationFloor))
+    {
+        jsonObject["correlationFloor"] = _correlationFloor;
+
+        // There may be millions of these, so they're packed rather than stored as JSON
+        QByteArray reservedEdges;
+        QDataStream stream(&reservedEdges, QIODevice::WriteOnly);
+
+        stream << static_cast<quint32>(_reservedEdges.size());
+        for(const auto& edge : _reservedEdges)
+        {
+            stream << static_cast<qint32>(edge._source) <<
+                static_cast<qint32>(edge._target) << edge._weight;
+        }
+
+        jsonObject["reservedEdges"] = qCompress(reservedEdges).toBase64().toStdString();
+    }
     jsonObject["scaling"] = static_cast<int>(_scalingType);
     jsonObject["normalisation"] = static_cast<int>(_normaliseType);
     jsonObject["missingDataType"] = static_cast<int>(_missingDataType);
@@ -798,6 +973,48 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
         _correlationPolarity = static_cast<CorrelationPolarity>(jsonObject["correlationPolarity"]);
     }
 
+    if(dataVersion >= 7)
+    {
+        if(!u::containsAllOf(jsonObject, {"correlationSearchType", "searchEffort", "maxNeighbours"}))
+            return false;
+
+        _correlationSearchType = static_cast<CorrelationSearchType>(jsonObject["correlationSearchType"]);
+        _searchEffort = jsonObject["searchEffort"];
+        _maxNeighbours = static_cast<size_t>(std::max(0, jsonObject["maxNeighbours"].get<int>()));
+    }
+
+    if(dataVersion >= 8 && u::contains(jsonObject, "correlationFloor"))
+    {
+        if(!u::contains(jsonObject, "reservedEdges"))
+            return false;
+
+        auto reservedEdges = qUncompress(QByteArray::fromBase64(
+            QByteArray::fromStdString(jsonObject["reservedEdges"].get<std::string>())));
+        QDataStream stream(reservedEdges);
+
+        quint32 numReservedEdges = 0;
+        stream >> numReservedEdges;
+
+        for(quint32 j = 0; j < numReservedEdges && stream.status() == QDataStream::Ok; j++)
+        {
+            qint32 source = -1;
+            qint32 target = -1;
+            double weight = 0.0;
+
+            stream >> source >> target >> weight;
+
+            if(source < 0 || target < 0 || !graph.containsNodeId(source) || !graph.containsNodeId(target))
+                return false;
+
+            _reservedEdges.push_back({source, target, weight});
+        }
+
+        if(stream.status() != QDataStream::Ok)
+            return false;
+
+        _correlationFloor = jsonObject["correlationFloor"];
+    }
+
     createAttributes();
     makeDataColumnNamesUnique();
     setNodeAttributeTableModelDataColumns();
@@ -832,9 +1049,23 @@ QString CorrelationPluginInstance::log() const
     case CorrelationPolarity::Both: text.append(tr("Both")); break;
     }
 
+    if(_correlationSearchType == CorrelationSearchType::Approximate)
+    {
+        text.append(tr("\nApproximate Search: Effort %1").arg(_searchEffort));
+
+        if(_maxNeighbours > 0)
+            text.append(tr(", Maximum Neighbours %1").arg(_maxNeighbours));
+    }
+
     text.append(tr("\nMinimum Correlation Value: %1").arg(
         u::formatNumberScientific(_minimumCorrelationValue)));
 
+    if(correlationFloor() < _minimumCorrelationValue)
+    {
+        text.append(tr("\nCorrelation Floor: %1").arg(
+            u::formatNumberScientific(correlationFloor())));
+    }
+
     switch(_scalingType)
     {
     default:
@@ -867,6 +1098,7 @@ QString CorrelationPluginInstance::log() const
             .arg(u::formatNumberScientific(_missingDataReplacementValue))); break;
         case MissingDataType::ColumnAverage: text.append(tr("Column Mean")); break;
         case MissingDataType::RowInterpolation: text.append(tr("Row Interpolate")); break;
+        case MissingDataType::KNN: text.append(tr("k-NN")); break;
         }
     }
 
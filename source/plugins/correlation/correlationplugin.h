@@ -38,6 +38,7 @@
 #include <functional>
 #include <algorithm>
 #include <utility>
+#include <limits>
 
 #include <QString>
 #include <QStringList>
@@ -64,6 +65,9 @@ class CorrelationPluginInstance : public BasePluginInstance
     Q_PROPERTY(QVector<int> highlightedRows MEMBER _highlightedRows
         WRITE setHighlightedRows NOTIFY highlightedRowsChanged)
 
+    Q_PROPERTY(double minimumCorrelation READ minimumCorrelation NOTIFY minimumCorrelationChanged)
+    Q_PROPERTY(double correlationFloor READ correlationFloor NOTIFY minimumCorrelationChanged)
+
 public:
     CorrelationPluginInstance();
 
@@ -87,12 +91,20 @@ private:
 
     std::unique_ptr<EdgeArray<double>> _correlationValues;
     double _minimumCorrelationValue = 0.7;
+    double _correlationFloor = std::numeric_limits<double>::quiet_NaN();
+
+    // Correlations at or above the floor, but below the minimum value,
+    // and therefore not in the graph; ordered weakest first
+    EdgeList _reservedEdges;
     double _initialCorrelationThreshold = 0.85;
     bool _transpose = false;
     TabularData _tabularData;
     QRect _dataRect;
     CorrelationType _correlationType = CorrelationType::Pearson;
     CorrelationPolarity _correlationPolarity = CorrelationPolarity::Positive;
+    CorrelationSearchType _correlationSearchType = CorrelationSearchType::Exhaustive;
+    int _searchEffort = ApproximateCorrelationSearch::DefaultEffort;
+    size_t _maxNeighbours = 0;
     ScalingType _scalingType = ScalingType::None;
     NormaliseType _normaliseType = NormaliseType::None;
     MissingDataType _missingDataType = MissingDataType::Constant;
@@ -128,6 +140,8 @@ private:
 
     void setHighlightedRows(const QVector<int>& highlightedRows);
 
+    bool rethreshold(double minimumCorrelation, Cancellable& cancellable, Progressable& progressable);
+
     QStringList sharedValuesAttributeNames() const;
     QStringList numericalAttributeNames() const;
 
@@ -142,9 +156,11 @@ public:
     EdgeList correlation(double minimumThreshold, IParser& parser);
 
     double minimumCorrelation() const { return _minimumCorrelationValue; }
+    double correlationFloor() const;
+    Q_INVOKABLE void setMinimumCorrelation(double minimumCorrelation);
     bool transpose() const { return _transpose; }
 
-    bool createEdges(const EdgeList& edges, IParser& parser);
+    bool createEdges(EdgeList edges, IParser& parser);
 
     std::unique_ptr<IParser> parserForUrlTypeName(const QString& urlTypeName) override;
     void applyParameter(const QString& name, const QVariant& value) override;
@@ -176,6 +192,7 @@ signals:
     void numericalAttributeNamesChanged();
     void nodeColorsChanged();
     void highlightedRowsChanged();
+    void minimumCorrelationChanged();
 };
 
 class CorrelationPlugin : public BasePlugin, public PluginInstanceProvider<CorrelationPluginInstance>
@@ -195,7 +212,7 @@ public:
 
     QString imageSource() const override { return QStringLiteral("qrc:///plots.svg"); }
 
-    int dataVersion() const override { return 6; }
+    int dataVersion() const override { return 8; }
 
     QStringList identifyUrl(const QUrl& url) const override;
     QString failureReason(const QUrl& url) const override;
@@ -37,7 +37,13 @@
 
 #include <vector>
 #include <stack>
+#include <cmath>
 #include <utility>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <atomic>
 
 CorrelationFileParser::CorrelationFileParser(CorrelationPluginInstance* plugin, QString urlTypeName,
                                              TabularData& tabularData, QRect dataRect) :
@@ -53,8 +59,7 @@ static QRect findLargestDataRect(const TabularData& tabularData, size_t startCol
     {
         for(size_t row = tabularData.numRows(); row-- > startRow; )
         {
-            const auto& value = tabularData.valueAt(column, row);
-            if(u::isNumeric(value) || value.isEmpty())
+            if(tabularData.isNumericAt(column, row) || tabularData.valueAt(column, row).isEmpty())
                 heightHistogram.at(column)++;
             else
                 break;
@@ -127,10 +132,7 @@ static bool dataRectHasMissingValues(const TabularData& tabularData, const QRect
     {
         for(auto row = dataRect.top(); row <= dataRect.bottom(); row++)
         {
-            const auto& value = tabularData.valueAt(
-                static_cast<size_t>(column), static_cast<size_t>(row));
-
-            if(value.isEmpty())
+            if(tabularData.isEmptyAt(static_cast<size_t>(column), static_cast<size_t>(row)))
                 return true;
         }
     }
@@ -138,99 +140,232 @@ static bool dataRectHasMissingValues(const TabularData& tabularData, const QRect
     return false;
 }
 
-double CorrelationFileParser::imputeValue(MissingDataType missingDataType,
-    double replacementValue, const TabularData& tabularData,
-    const QRect& dataRect, size_t columnIndex, size_t rowIndex)
+// Missing values are marked as NaN in data, which is numRows x numColumns and row major
+static std::vector<double> columnMeans(const std::vector<double>& data, size_t numColumns)
 {
-    double imputedValue = 0.0;
+    auto numRows = data.size() / numColumns;
+    std::vector<double> means(numColumns, 0.0);
 
-    size_t left = dataRect.x();
-    size_t right = dataRect.x() + dataRect.width();
+    std::vector<size_t> columns(numColumns);
+    std::iota(columns.begin(), columns.end(), 0);
 
-    switch(missingDataType)
-    {
-    case MissingDataType::Constant:
-    {
-        imputedValue = replacementValue;
-        break;
-    }
-    case MissingDataType::ColumnAverage:
+    concurrent_for(columns.begin(), columns.end(),
+    [&](size_t column)
     {
-        // Calculate column averages
-        double averageValue = 0.0;
-        size_t rowCount = 0;
-        for(size_t avgRowIndex = left; avgRowIndex < right; avgRowIndex++)
+        double sum = 0.0;
+        size_t count = 0;
+
+        for(size_t row = 0; row < numRows; row++)
         {
-            const auto& value = tabularData.valueAt(columnIndex, avgRowIndex);
-            if(!value.isEmpty())
+            auto value = data[(row * numColumns) + column];
+            if(!std::isnan(value))
             {
-                averageValue += value.toDouble();
-                rowCount++;
+                sum += value;
+                count++;
             }
         }
 
-        if(rowCount > 0)
-            averageValue /= rowCount;
+        if(count > 0)
+            means[column] = sum / static_cast<double>(count);
+    });
 
-        imputedValue = averageValue;
-        break;
-    }
-    case MissingDataType::RowInterpolation:
+    return means;
+}
+
+static void interpolateRow(double* row, size_t numColumns)
+{
+    // The column of the last value seen, or numColumns if there wasn't one
+    auto left = numColumns;
+
+    for(size_t column = 0; column <= numColumns; column++)
     {
-        double rightValue = 0.0;
-        double leftValue = 0.0;
-        size_t leftDistance = 0;
-        size_t rightDistance = 0;
-        bool rightValueFound = false;
-        bool leftValueFound = false;
+        if(column < numColumns && std::isnan(row[column]))
+            continue;
 
-        // Find right value
-        for(size_t rightColumn = columnIndex; rightColumn < right; rightColumn++)
+        // Fill the gap between the previous value and this one
+        for(auto gapColumn = (left < numColumns ? left + 1 : 0); gapColumn < column; gapColumn++)
         {
-            const auto& value = tabularData.valueAt(rightColumn, rowIndex);
-            if(!value.isEmpty())
+            if(left < numColumns && column < numColumns)
             {
-                rightValue = value.toDouble();
-                rightValueFound = true;
-                rightDistance = (rightColumn > columnIndex) ? rightColumn - columnIndex : columnIndex - rightColumn;
-                break;
+                double tween = static_cast<double>(gapColumn - left) / static_cast<double>(column - left);
+                // https://devblogs.nvidia.com/lerp-faster-cuda/
+                row[gapColumn] = std::fma(tween, row[column], std::fma(-tween, row[left], row[left]));
             }
+            else if(left < numColumns)
+                row[gapColumn] = row[left];
+            else if(column < numColumns)
+                row[gapColumn] = row[column];
+            else // Nothing on the row, just zero it
+                row[gapColumn] = 0.0;
+        }
+
+        left = column;
+    }
+}
+
+static void imputeFromNearestNeighbours(std::vector<double>& data, size_t numColumns,
+    Cancellable* cancellable, Progressable* progressable)
+{
+    // The number of most similar rows whose values are averaged
+    const size_t K = 10;
+
+    auto numRows = data.size() / numColumns;
+
+    // Rows are compared on data whose gaps are provisionally filled with column means,
+    // so that the usual correlation algorithm can measure their similarity
+    auto means = columnMeans(data, numColumns);
+    auto imputedData = data;
+    for(size_t index = 0; index < imputedData.size(); index++)
+    {
+        if(std::isnan(imputedData[index]))
+            imputedData[index] = means[index % numColumns];
+    }
+
+    std::vector<CorrelationDataRow> rows;
+    rows.reserve(numRows);
+    for(size_t row = 0; row < numRows; row++)
+        rows.emplace_back(imputedData, row, numColumns, NodeId(static_cast<int>(row)));
+
+    std::vector<size_t> incompleteRows;
+    for(size_t row = 0; row < numRows; row++)
+    {
+        auto first = data.begin() + static_cast<std::ptrdiff_t>(row * numColumns);
+        if(std::any_of(first, first + static_cast<std::ptrdiff_t>(numColumns),
+            [](double value) { return std::isnan(value); }))
+        {
+            incompleteRows.push_back(row);
         }
-        // Find left value
-        for(size_t leftColumn = columnIndex; leftColumn-- != left;)
+    }
+
+    std::atomic<size_t> numRowsImputed(0);
+
+    ThreadPool::TaskGroup taskGroup(QStringLiteral("Imputation"));
+
+    concurrent_for(incompleteRows.begin(), incompleteRows.end(),
+    [&](size_t row)
+    {
+        if(cancellable != nullptr && cancellable->cancelled())
         {
-            const auto& value = tabularData.valueAt(leftColumn, rowIndex);
-            if(!value.isEmpty())
+            // Don't start on any more rows
+            taskGroup.cancel();
+            return;
+        }
+
+        std::vector<std::pair<double, size_t>> neighbours;
+        neighbours.reserve(numRows - 1);
+
+        for(size_t otherRow = 0; otherRow < numRows; otherRow++)
+        {
+            if(otherRow == row)
+                continue;
+
+            double r = PearsonAlgorithm::evaluate(numColumns, &rows[row], &rows[otherRow]);
+            if(std::isfinite(r))
+                neighbours.emplace_back(r, otherRow);
+        }
+
+        // Usually only the first K or so neighbours are needed, so rather than sorting them
+        // all, the sorted prefix is extended on demand, when a column needs more of them
+        size_t numSorted = 0;
+        auto sortNeighboursTo = [&](size_t n)
+        {
+            n = std::min(n, neighbours.size());
+            if(n <= numSorted)
+                return;
+
+            std::partial_sort(neighbours.begin() + static_cast<std::ptrdiff_t>(numSorted),
+                neighbours.begin() + static_cast<std::ptrdiff_t>(n),
+                neighbours.end(), std::greater<>());
+            numSorted = n;
+        };
+
+        sortNeighboursTo(2 * K);
+
+        for(size_t column = 0; column < numColumns; column++)
+        {
+            auto index = (row * numColumns) + column;
+            if(!std::isnan(data[index]))
+                continue;
+
+            // Average the column's values from the most similar rows that have one
+            double sum = 0.0;
+            size_t count = 0;
+            for(size_t i = 0; i < neighbours.size(); i++)
             {
-                leftValue = value.toDouble();
-                leftValueFound = true;
-                leftDistance = (leftColumn > columnIndex) ? leftColumn - columnIndex : columnIndex - leftColumn;
-                break;
+                if(i == numSorted)
+                    sortNeighboursTo(2 * numSorted);
+
+                auto value = data[(neighbours[i].second * numColumns) + column];
+                if(std::isnan(value))
+                    continue;
+
+                sum += value;
+                if(++count == K)
+                    break;
             }
+
+            // Only imputedData is written, and only at indices that are missing
+            // in data, so the reads from data above don't race with this
+            if(count > 0)
+                imputedData[index] = sum / static_cast<double>(count);
         }
 
-        // Lerp the result if possible, otherwise just set to found value
-        if(leftValueFound && rightValueFound)
+        if(progressable != nullptr)
+            progressable->setProgress(static_cast<int>((++numRowsImputed * 100) / incompleteRows.size()));
+    });
+
+    data = std::move(imputedData);
+}
+
+void CorrelationFileParser::imputeMissingValues(MissingDataType missingDataType,
+    double replacementValue, std::vector<double>& data, size_t numColumns,
+    Cancellable* cancellable, Progressable* progressable)
+{
+    if(numColumns == 0 || data.empty())
+        return;
+
+    auto numRows = data.size() / numColumns;
+    auto isMissing = [](double value) { return std::isnan(value); };
+
+    switch(missingDataType)
+    {
+    default:
+    case MissingDataType::Constant:
+        std::replace_if(data.begin(), data.end(), isMissing, replacementValue);
+        break;
+
+    case MissingDataType::ColumnAverage:
+    {
+        auto means = columnMeans(data, numColumns);
+
+        for(size_t index = 0; index < data.size(); index++)
         {
-            size_t totalDistance = leftDistance + rightDistance;
-            double tween = leftDistance / static_cast<double>(totalDistance);
-            // https://devblogs.nvidia.com/lerp-faster-cuda/
-            double lerpedValue = std::fma(tween, rightValue, std::fma(-tween, leftValue, leftValue));
-            imputedValue = lerpedValue;
+            if(isMissing(data[index]))
+                data[index] = means[index % numColumns];
         }
-        else if(leftValueFound && !rightValueFound)
-            imputedValue = leftValue;
-        else if(!leftValueFound && rightValueFound)
-            imputedValue = rightValue;
-        else // Nothing on the row, just zero it
-            imputedValue = 0.0;
         break;
     }
-    default:
+
+    case MissingDataType::RowInterpolation:
+    {
+        std::vector<size_t> rows(numRows);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        concurrent_for(rows.begin(), rows.end(),
+        [&](size_t row)
+        {
+            interpolateRow(&data[row * numColumns], numColumns);
+        });
+        break;
+    }
+
+    case MissingDataType::KNN:
+        imputeFromNearestNeighbours(data, numColumns, cancellable, progressable);
         break;
     }
 
-    return imputedValue;
+    if(progressable != nullptr)
+        progressable->setProgress(-1);
 }
 
 double CorrelationFileParser::scaleValue(ScalingType scalingType, double value)
@@ -259,6 +394,15 @@ double CorrelationFileParser::scaleValue(ScalingType scalingType, double value)
     return value;
 }
 
+void CorrelationFileParser::scaleValues(ScalingType scalingType, std::vector<double>& data)
+{
+    if(scalingType == ScalingType::None)
+        return;
+
+    for(auto& value : data)
+        value = scaleValue(scalingType, value);
+}
+
 void CorrelationFileParser::normalise(NormaliseType normaliseType,
     std::vector<CorrelationDataRow>& dataRows, IParser* parser)
 {
@@ -347,7 +491,7 @@ bool CorrelationFileParser::parse(const QUrl&, IGraphModel* graphModel)
     setProgress(-1);
 
     graphModel->mutableGraph().setPhase(QObject::tr("Correlation"));
-    auto edges = _plugin->correlation(_plugin->minimumCorrelation(), *this);
+    auto edges = _plugin->correlation(_plugin->correlationFloor(), *this);
 
     if(cancelled())
         return false;
@@ -355,7 +499,7 @@ bool CorrelationFileParser::parse(const QUrl&, IGraphModel* graphModel)
     _plugin->createAttributes();
 
     graphModel->mutableGraph().setPhase(QObject::tr("Building Graph"));
-    if(!_plugin->createEdges(edges, *this))
+    if(!_plugin->createEdges(std::move(edges), *this))
         return false;
 
     graphModel->mutableGraph().clearPhase();
@@ -522,64 +666,75 @@ std::vector<CorrelationDataRow> CorrelationTabularDataParser::sampledDataRows(si
     if(_dataRect.isEmpty())
         return {};
 
-    std::vector<CorrelationDataRow> dataRows;
-
     Q_ASSERT(static_cast<size_t>(_dataRect.x() + _dataRect.width() - 1) < _dataPtr->numColumns());
     Q_ASSERT(static_cast<size_t>(_dataRect.y() + _dataRect.height() - 1) < _dataPtr->numRows());
 
-    std::vector<double> rowData;
-    rowData.reserve(_dataPtr->numColumns() - _dataRect.x());
-
     // Choose numSamples random row indices from tabularData
     std::vector<size_t> rowIndices(_dataPtr->numRows() - _dataRect.y());
     std::iota(rowIndices.begin(), rowIndices.end(), _dataRect.y());
     rowIndices = u::randomSample(rowIndices, numSamples);
     std::sort(rowIndices.begin(), rowIndices.end());
 
-    NodeId nodeId(0);
+    auto startColumn = static_cast<size_t>(_dataRect.x());
+    auto numColumns = static_cast<size_t>(_dataRect.width());
+
+    std::vector<double> data;
+    data.reserve(rowIndices.size() * numColumns);
+    bool hasMissingValues = false;
 
     for(size_t rowIndex : rowIndices)
     {
-        rowData.clear();
-
-        auto startColumn = static_cast<size_t>(_dataRect.x());
-        auto finishColumn = startColumn + _dataRect.width();
-        for(auto columnIndex = startColumn; columnIndex < finishColumn; columnIndex++)
+        for(auto columnIndex = startColumn; columnIndex < startColumn + numColumns; columnIndex++)
         {
             if(_graphSizeEstimateCancellable.cancelled())
                 return {};
 
-            const auto& value = _dataPtr->valueAt(columnIndex, rowIndex);
-            double transformedValue = 0.0;
-
-            if(!value.isEmpty())
+            if(_dataPtr->isEmptyAt(columnIndex, rowIndex))
             {
-                bool success = false;
-                transformedValue = value.toDouble(&success);
-
-                if(!success)
-                {
-                    qDebug() << QStringLiteral("WARNING: non-numeric value at (%1, %2): %3")
-                        .arg(columnIndex).arg(rowIndex).arg(value);
-                }
+                data.push_back(std::numeric_limits<double>::quiet_NaN());
+                hasMissingValues = true;
+                continue;
             }
-            else
+
+            auto numericValue = _dataPtr->numericValueAt(columnIndex, rowIndex);
+
+            if(std::isnan(numericValue))
             {
-                transformedValue = CorrelationFileParser::imputeValue(
-                    static_cast<MissingDataType>(_missingDataType), _replacementValue,
-                    *_dataPtr, _dataRect, columnIndex, rowIndex);
-            }
+                qDebug() << QStringLiteral("WARNING: non-numeric value at (%1, %2): %3")
+                    .arg(columnIndex).arg(rowIndex).arg(_dataPtr->valueAt(columnIndex, rowIndex));
 
-            transformedValue = CorrelationFileParser::scaleValue(
-                static_cast<ScalingType>(_scalingType), transformedValue);
+                numericValue = 0.0;
+            }
 
-            rowData.emplace_back(transformedValue);
+            data.push_back(numericValue);
         }
+    }
 
-        dataRows.emplace_back(rowData, nodeId);
-        ++nodeId;
+    // Note that statistics used by imputation are those of the sample, rather than the whole
+    if(hasMissingValues)
+    {
+        auto missingDataType = static_cast<MissingDataType>(_missingDataType);
+
+        // k-NN imputation is a brute force search, far too costly to repeat on every parameter
+        // change, and column averages are a close enough stand in for the purposes of an estimate
+        if(missingDataType == MissingDataType::KNN)
+            missingDataType = MissingDataType::ColumnAverage;
+
+        CorrelationFileParser::imputeMissingValues(missingDataType,
+            _replacementValue, data, numColumns, &_graphSizeEstimateCancellable);
+
+        if(_graphSizeEstimateCancellable.cancelled())
+            return {};
     }
 
+    CorrelationFileParser::scaleValues(static_cast<ScalingType>(_scalingType), data);
+
+    std::vector<CorrelationDataRow> dataRows;
+    dataRows.reserve(rowIndices.size());
+
+    for(size_t row = 0; row < rowIndices.size(); row++)
+        dataRows.emplace_back(data, row, numColumns, NodeId(static_cast<int>(row)));
+
     CorrelationFileParser::normalise(static_cast<NormaliseType>(_normaliseType), dataRows);
 
     return dataRows;
@@ -604,7 +759,11 @@ void CorrelationTabularDataParser::estimateGraphSize()
         if(_dataPtr->numRows() == 0)
             return QVariantMap();
 
-        const size_t maxSampleRows = 1400;
+        bool approximate = static_cast<CorrelationSearchType>(_correlationSearchType) ==
+            CorrelationSearchType::Approximate;
+
+        // An approximate search is cheap enough to afford a much larger sample
+        const size_t maxSampleRows = approximate ? 20000 : 1400;
         const auto numSampleRows = std::min(maxSampleRows, _dataPtr->numRows());
 
         auto dataRows = sampledDataRows(numSampleRows);
@@ -613,11 +772,21 @@ void CorrelationTabularDataParser::estimateGraphSize()
             return QVariantMap();
 
         auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
+
+        if(approximate)
+        {
+            correlation->setApproximateSearch(_searchEffort,
+                static_cast<size_t>(std::max(0, _maxNeighbours)));
+        }
+
         auto sampleEdges = correlation->process(dataRows, _minimumCorrelation,
             static_cast<CorrelationPolarity>(_correlationPolarity), &_graphSizeEstimateCancellable);
 
         auto nodesScale = static_cast<double>(_dataPtr->numRows() / numSampleRows);
-        auto edgesScale = nodesScale * nodesScale;
+
+        // An approximate search only ever considers a bounded number of candidates
+        // for each row, so its edges grow linearly with the nodes
+        auto edgesScale = approximate ? nodesScale : nodesScale * nodesScale;
         auto maxNodes = static_cast<double>(_dataPtr->numRows());
         auto maxEdges = maxNodes * maxNodes;
 
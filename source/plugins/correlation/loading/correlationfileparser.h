@@ -63,7 +63,8 @@ DEFINE_QML_ENUM(
     Q_GADGET, MissingDataType,
     Constant,
     ColumnAverage,
-    RowInterpolation);
+    RowInterpolation,
+    KNN);
 
 // (...although not these ones:)
 
@@ -93,9 +94,12 @@ public:
     explicit CorrelationFileParser(CorrelationPluginInstance* plugin, QString urlTypeName,
         TabularData& tabularData, QRect dataRect);
 
-    static double imputeValue(MissingDataType missingDataType, double replacementValue,
-        const TabularData& tabularData, const QRect& dataRect, size_t columnIndex, size_t rowIndex);
+    // Replaces the NaNs in data, a row major matrix of numColumns columns
+    static void imputeMissingValues(MissingDataType missingDataType, double replacementValue,
+        std::vector<double>& data, size_t numColumns,
+        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr);
     static double scaleValue(ScalingType scalingType, double value);
+    static void scaleValues(ScalingType scalingType, std::vector<double>& data);
     static void normalise(NormaliseType normaliseType,
         std::vector<CorrelationDataRow>& dataRows,
         IParser* parser = nullptr);
@@ -128,6 +132,9 @@ class CorrelationTabularDataParser : public QObject, public Cancellable
     Q_PROPERTY(double minimumCorrelation MEMBER _minimumCorrelation NOTIFY parameterChanged)
     Q_PROPERTY(int correlationType MEMBER _correlationType NOTIFY parameterChanged)
     Q_PROPERTY(int correlationPolarity MEMBER _correlationPolarity NOTIFY parameterChanged)
+    Q_PROPERTY(int correlationSearchType MEMBER _correlationSearchType NOTIFY parameterChanged)
+    Q_PROPERTY(int searchEffort MEMBER _searchEffort NOTIFY parameterChanged)
+    Q_PROPERTY(int maxNeighbours MEMBER _maxNeighbours NOTIFY parameterChanged)
     Q_PROPERTY(int scalingType MEMBER _scalingType NOTIFY parameterChanged)
     Q_PROPERTY(int normaliseType MEMBER _normaliseType NOTIFY parameterChanged)
     Q_PROPERTY(int missingDataType MEMBER _missingDataType NOTIFY parameterChanged)
@@ -154,6 +161,9 @@ private:
     double _minimumCorrelation = 0.0;
     int _correlationType = static_cast<int>(CorrelationType::Pearson);
     int _correlationPolarity = static_cast<int>(CorrelationPolarity::Positive);
+    int _correlationSearchType = static_cast<int>(CorrelationSearchType::Exhaustive);
+    int _searchEffort = ApproximateCorrelationSearch::DefaultEffort;
+    int _maxNeighbours = 0;
     int _scalingType = static_cast<int>(ScalingType::None);
     int _normaliseType = static_cast<int>(NormaliseType::None);
     int _missingDataType = static_cast<int>(MissingDataType::Constant);
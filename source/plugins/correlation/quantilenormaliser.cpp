@@ -20,9 +20,13 @@
 
 #include "shared/loading/iparser.h"
 #include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
 
-#include <set>
 #include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 
 #include <QtGlobal>
 
@@ -31,91 +35,114 @@ bool QuantileNormaliser::process(std::vector<CorrelationDataRow>& dataRows, IPar
     if(dataRows.empty())
         return true;
 
+    auto numRows = dataRows.size();
     auto numColumns = dataRows.at(0).numColumns();
 
-    std::vector<std::vector<double>> sortedColumnValues(numColumns);
-    std::vector<size_t> ranking(dataRows.size() * numColumns);
+    Q_ASSERT(numRows <= std::numeric_limits<uint32_t>::max());
 
-    size_t row = 0;
+    // Column major copies of the data, and of the order in which each column's values sort
+    std::vector<double> values(numRows * numColumns);
+    std::vector<uint32_t> order(numRows * numColumns);
 
-    for(size_t column = 0; column < numColumns; column++)
-    {
-        if(parser != nullptr && parser->cancelled())
-            return false;
+    std::vector<size_t> columns(numColumns);
+    std::iota(columns.begin(), columns.end(), 0);
 
-        std::vector<double> columnValues;
-        columnValues.reserve(dataRows.size());
+    ThreadPool::TaskGroup taskGroup(QStringLiteral("Quantile"));
 
-        // Get column values
-        std::transform(dataRows.begin(), dataRows.end(), std::back_inserter(columnValues),
-        [column](const auto& dataRow)
-        {
-            return dataRow.valueAt(column);
-        });
+    // Once cancelled, don't start on any more columns
+    auto cancelled = [parser, &taskGroup]
+    {
+        if(parser == nullptr || !parser->cancelled())
+            return false;
 
-        // Sort
-        auto sortedValues = columnValues;
-        std::sort(sortedValues.begin(), sortedValues.end());
-        auto uniqueSortedValues = sortedValues;
-        uniqueSortedValues.erase(std::unique(uniqueSortedValues.begin(), uniqueSortedValues.end()),
-            uniqueSortedValues.end());
+        taskGroup.cancel();
+        return true;
+    };
+    std::atomic<size_t> numColumnsSorted(0);
 
-        row = 0;
-        for(const auto& dataRow : dataRows)
-        {
-            auto index = (row * numColumns) + column;
+    concurrent_for(columns.begin(), columns.end(),
+    [&](size_t column)
+    {
+        if(cancelled())
+            return;
 
-            // Set the ranking
-            size_t i = 0;
-            for(auto uniqueValue : uniqueSortedValues)
-            {
-                if(uniqueValue == dataRow.valueAt(column))
-                    ranking[index] = i;
+        auto columnValues = values.begin() + static_cast<std::ptrdiff_t>(column * numRows);
+        auto columnOrder = order.begin() + static_cast<std::ptrdiff_t>(column * numRows);
 
-                i++;
-            }
+        for(size_t row = 0; row < numRows; row++)
+            columnValues[row] = dataRows[row].valueAt(column);
 
-            row++;
-        }
+        std::iota(columnOrder, columnOrder + numRows, 0);
+        std::stable_sort(columnOrder, columnOrder + numRows,
+        [&columnValues](uint32_t a, uint32_t b)
+        {
+            return columnValues[a] < columnValues[b];
+        });
 
         if(parser != nullptr)
-            parser->setProgress(static_cast<int>((column * 100) / numColumns));
-
-        // Copy Result to sortedColumns
-        sortedColumnValues[column] = sortedValues;
-    }
+            parser->setProgress(static_cast<int>((++numColumnsSorted * 100) / numColumns));
+    });
 
     if(parser != nullptr)
         parser->setProgress(-1);
 
-    std::vector<double> rowMeans(dataRows.size());
+    if(cancelled())
+        return false;
 
-    // Populate row means
-    for(row = 0; row < rowMeans.size(); row++)
+    // The mean of each rank's values, across every column
+    std::vector<double> rankMeans(numRows, 0.0);
+
+    for(size_t column = 0; column < numColumns; column++)
     {
-        double meanValue = 0.0;
-        for(size_t column = 0; column < numColumns; column++)
-            meanValue += sortedColumnValues[column][row];
+        const auto* columnValues = &values[column * numRows];
+        const auto* columnOrder = &order[column * numRows];
 
-        rowMeans[row] = meanValue / static_cast<double>(numColumns);
+        for(size_t rank = 0; rank < numRows; rank++)
+            rankMeans[rank] += columnValues[columnOrder[rank]];
     }
 
-    row = 0;
-    for(auto& dataRow : dataRows)
+    for(auto& rankMean : rankMeans)
+        rankMean /= static_cast<double>(numColumns);
+
+    concurrent_for(columns.begin(), columns.end(),
+    [&](size_t column)
     {
-        if(parser != nullptr && parser->cancelled())
-            return false;
+        if(cancelled())
+            return;
 
-        for(size_t column = 0; column < numColumns; column++)
+        auto* columnValues = &values[column * numRows];
+        const auto* columnOrder = &order[column * numRows];
+
+        // Tied values share the mean of the ranks they span; each value is overwritten
+        // only once its tie group is known, so this can be done in place
+        for(size_t first = 0; first < numRows;)
         {
-            auto index = (row * numColumns) + column;
-            auto rank = ranking[index];
-            Q_ASSERT(rank < rowMeans.size());
+            auto value = columnValues[columnOrder[first]];
 
-            dataRow.setValueAt(column, rowMeans[rank]);
+            auto last = first + 1;
+            while(last < numRows && columnValues[columnOrder[last]] == value)
+                last++;
+
+            auto tiedMean = std::accumulate(rankMeans.begin() + static_cast<std::ptrdiff_t>(first),
+                rankMeans.begin() + static_cast<std::ptrdiff_t>(last), 0.0) /
+                static_cast<double>(last - first);
+
+            for(auto rank = first; rank < last; rank++)
+                columnValues[columnOrder[rank]] = tiedMean;
+
+            first = last;
         }
+    });
+
+    if(cancelled())
+        return false;
 
-        row++;
+    for(size_t row = 0; row < numRows; row++)
+    {
+        auto& dataRow = dataRows[row];
+
+        for(size_t column = 0; column < numColumns; column++)
+            dataRow.setValueAt(column, values[(column * numRows) + row]);
     }
 
     return true;
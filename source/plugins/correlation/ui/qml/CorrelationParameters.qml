@@ -61,6 +61,9 @@ BaseParameterDialog
         minimumCorrelation: minimumCorrelationSpinBox.value
         correlationType: { return algorithm.model.get(algorithm.currentIndex).value; }
         correlationPolarity: { return polarity.model.get(polarity.currentIndex).value; }
+        correlationSearchType: { return searchType.model.get(searchType.currentIndex).value; }
+        searchEffort: searchEffortSpinBox.value
+        maxNeighbours: maxNeighboursSpinBox.value
         scalingType: { return scaling.model.get(scaling.currentIndex).value; }
         normaliseType: { return normalise.model.get(normalise.currentIndex).value; }
         missingDataType: { return missingDataType.model.get(missingDataType.currentIndex).value; }
@@ -749,6 +752,7 @@ BaseParameterDialog
                                     ListElement { text: qsTr("Constant");           value: MissingDataType.Constant }
                                     ListElement { text: qsTr("Row Interpolate");    value: MissingDataType.RowInterpolation }
                                     ListElement { text: qsTr("Column Mean");        value: MissingDataType.ColumnAverage }
+                                    ListElement { text: qsTr("k-NN");               value: MissingDataType.KNN }
                                 }
                                 textRole: "text"
 
@@ -841,6 +845,22 @@ BaseParameterDialog
                                             wrapMode: Text.WordWrap
                                             Layout.fillWidth: true
                                         }
+
+                                        Text
+                                        {
+                                            text: qsTr("<b>k-NN:</b>")
+                                            textFormat: Text.StyledText
+                                            Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                        }
+
+                                        Text
+                                        {
+                                            text: qsTr("Replace missing values with the mean value of the same column in the" +
+                                                       " 10 most correlated rows that have one. This is suited to sparse data," +
+                                                       " but takes as long again as the correlation itself.");
+                                            wrapMode: Text.WordWrap
+                                            Layout.fillWidth: true
+                                        }
                                     }
                                 }
                             }
@@ -1043,6 +1063,114 @@ BaseParameterDialog
                                     }
                                 }
                             }
+
+                            Text
+                            {
+                                text: qsTr("Search:")
+                                Layout.alignment: Qt.AlignRight
+                            }
+
+                            ComboBox
+                            {
+                                id: searchType
+
+                                model: ListModel
+                                {
+                                    ListElement { text: qsTr("Exhaustive");     value: CorrelationSearchType.Exhaustive }
+                                    ListElement { text: qsTr("Approximate");    value: CorrelationSearchType.Approximate }
+                                }
+                                textRole: "text"
+
+                                onCurrentIndexChanged:
+                                {
+                                    parameters.correlationSearchType = model.get(currentIndex).value;
+                                }
+
+                                property int value: { return model.get(currentIndex).value; }
+                            }
+
+                            RowLayout
+                            {
+                                Layout.columnSpan: 4
+
+                                Text
+                                {
+                                    visible: searchType.value === CorrelationSearchType.Approximate
+                                    text: qsTr("Effort:")
+                                }
+
+                                SpinBox
+                                {
+                                    id: searchEffortSpinBox
+                                    visible: searchType.value === CorrelationSearchType.Approximate
+
+                                    minimumValue: 1
+                                    maximumValue: 10
+                                    value: 4
+
+                                    onValueChanged: { parameters.searchEffort = value; }
+                                }
+
+                                Text
+                                {
+                                    visible: searchType.value === CorrelationSearchType.Approximate
+                                    text: qsTr("Maximum Neighbours:")
+                                }
+
+                                SpinBox
+                                {
+                                    id: maxNeighboursSpinBox
+                                    visible: searchType.value === CorrelationSearchType.Approximate
+
+                                    minimumValue: 0
+                                    maximumValue: 1000
+                                    value: 0
+
+                                    onValueChanged: { parameters.maxNeighbours = value; }
+                                }
+
+                                HelpTooltip
+                                {
+                                    title: qsTr("Search")
+                                    GridLayout
+                                    {
+                                        columns: 2
+                                        Text
+                                        {
+                                            text: qsTr("<b>Exhaustive:</b>")
+                                            textFormat: Text.StyledText
+                                            Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                        }
+
+                                        Text
+                                        {
+                                            text: qsTr("Every pair of rows is compared. The time taken grows " +
+                                                       "with the square of the number of rows.");
+                                            wrapMode: Text.WordWrap
+                                            Layout.fillWidth: true
+                                        }
+
+                                        Text
+                                        {
+                                            text: qsTr("<b>Approximate:</b>")
+                                            textFormat: Text.StyledText
+                                            Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                        }
+
+                                        Text
+                                        {
+                                            text: qsTr("Only rows that are likely to be similar are compared, " +
+                                                       "which is much faster for large datasets, but may miss " +
+                                                       "some correlations. A higher <b>Effort</b> finds more of " +
+                                                       "them, but takes longer. If <b>Maximum Neighbours</b> is " +
+                                                       "non-zero, only each row's strongest correlations are kept.");
+                                            wrapMode: Text.WordWrap
+                                            textFormat: Text.StyledText
+                                            Layout.fillWidth: true
+                                        }
+                                    }
+                                }
+                            }
                         }
                     }
 
@@ -1050,6 +1178,38 @@ BaseParameterDialog
                     {
                         Layout.fillWidth: true
 
+                        Text { text: qsTr("Floor:") }
+
+                        SpinBox
+                        {
+                            id: correlationFloorSpinBox
+
+                            implicitWidth: 70
+
+                            minimumValue: 0.0
+                            maximumValue: minimumCorrelationSpinBox.value
+
+                            decimals: 3
+                            stepSize: Utils.incrementForRange(minimumValue, maximumValue);
+
+                            onValueChanged: { parameters.correlationFloor = value; }
+                        }
+
+                        HelpTooltip
+                        {
+                            Layout.rightMargin: Constants.spacing * 2
+
+                            title: qsTr("Correlation Floor")
+                            Text
+                            {
+                                wrapMode: Text.WordWrap
+                                text: qsTr("Correlations between the floor and the minimum value are kept " +
+                                           "in memory, without being added to the graph. This allows the " +
+                                           "minimum value to be lowered to the floor later, without " +
+                                           "recomputing the correlation.")
+                            }
+                        }
+
                         Text { text: qsTr("Minimum:") }
 
                         SpinBox
@@ -1545,13 +1705,17 @@ BaseParameterDialog
                 ((1.0 - DEFAULT_MINIMUM_CORRELATION) * 0.5);
 
         parameters = { minimumCorrelation: DEFAULT_MINIMUM_CORRELATION,
+            correlationFloor: DEFAULT_MINIMUM_CORRELATION,
             initialThreshold: DEFAULT_INITIAL_CORRELATION, transpose: false,
             correlationType: CorrelationType.Pearson,
             correlationPolarity: CorrelationPolarity.Positive,
+            correlationSearchType: CorrelationSearchType.Exhaustive,
+            searchEffort: 4, maxNeighbours: 0,
             scaling: ScalingType.None, normalise: NormaliseType.None,
             missingDataType: MissingDataType.Constant };
 
         minimumCorrelationSpinBox.value = DEFAULT_MINIMUM_CORRELATION;
+        correlationFloorSpinBox.value = DEFAULT_MINIMUM_CORRELATION;
         initialCorrelationSpinBox.value = DEFAULT_INITIAL_CORRELATION;
         transposeCheckBox.checked = false;
     }
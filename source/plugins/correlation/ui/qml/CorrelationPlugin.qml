@@ -403,6 +403,62 @@ PluginContent
         onAccepted: plot.yAxisLabel = yAxisTextField.text;
     }
 
+    Action
+    {
+        id: setMinimumCorrelationAction
+        text: qsTr("Set Minimum Correlation…")
+        onTriggered:
+        {
+            minimumCorrelationSpinBox.value = plugin.model.minimumCorrelation;
+            minimumCorrelationDialog.open();
+        }
+    }
+
+    Dialog
+    {
+        id: minimumCorrelationDialog
+        visible: false
+        title: qsTr("Minimum Correlation")
+
+        standardButtons: StandardButton.Ok | StandardButton.Cancel
+
+        ColumnLayout
+        {
+            RowLayout
+            {
+                Text
+                {
+                    text: qsTr("Minimum Correlation:")
+                }
+
+                SpinBox
+                {
+                    id: minimumCorrelationSpinBox
+
+                    implicitWidth: 70
+
+                    minimumValue: 0.0
+                    maximumValue: 1.0
+
+                    decimals: 3
+                    stepSize: Utils.incrementForRange(minimumValue, maximumValue);
+                }
+            }
+
+            Text
+            {
+                Layout.bottomMargin: 12
+                Layout.maximumWidth: 300
+                wrapMode: Text.WordWrap
+                text: qsTr("Values down to %1 are available immediately. Lower values " +
+                    "require the correlation to be computed for the additional edges.")
+                    .arg(plugin.model.correlationFloor)
+            }
+        }
+
+        onAccepted: { plugin.model.setMinimumCorrelation(minimumCorrelationSpinBox.value); }
+    }
+
     Connections
     {
         target: plugin.model
@@ -434,6 +490,8 @@ PluginContent
         {
         case 0:
             tableView.populateTableMenu(menu);
+            menu.addSeparator();
+            menu.addItem("").action = setMinimumCorrelationAction;
             return true;
 
         case 1:
@@ -20,8 +20,8 @@
 #define ELEMENTID_CONTAINERS_H
 
 #include "elementid.h"
+#include "elementidset.h"
 
-#include <unordered_set>
 #include <unordered_map>
 #include <functional>
 
@@ -33,7 +33,6 @@ template<typename T> struct ElementIdHash
     }
 };
 
-template<typename T> using ElementIdSet = std::unordered_set<T, ElementIdHash<T>>;
 template<typename K, typename V> using ElementIdMap = std::unordered_map<K, V, ElementIdHash<K>>;
 
 using NodeIdSet = ElementIdSet<NodeId>;
@@ -0,0 +1,546 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELEMENTIDSET_H
+#define ELEMENTIDSET_H
+
+#include "elementid.h"
+
+#include <vector>
+#include <bitset>
+#include <type_traits>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// A set of ElementIds that starts out as a small sorted vector and switches to
+// a dense bitset, indexed by the ElementId, once it becomes large and dense
+// enough for that to be worthwhile. In dense form membership tests are a single
+// bit test, and the set operations work a word at a time. Iteration is always
+// in ascending order of ElementId. The null ElementId may also be stored.
+template<typename T> class ElementIdSet
+{
+    static_assert(std::is_base_of_v<ElementId<T>, T>, "T must be an ElementId");
+
+private:
+    using Word = uint64_t;
+    static constexpr size_t BitsPerWord = 64;
+
+    // Below this size the set is always sparse
+    static constexpr size_t MaxSparseSize = 64;
+
+    // When larger, the set becomes dense if the bitset would use no more than
+    // this many times the memory of the equivalent sorted vector
+    static constexpr size_t MaxDenseOverhead = 4;
+
+    bool _dense = false;
+    size_t _size = 0;
+
+    // Sparse storage, sorted
+    std::vector<T> _elementIds;
+
+    // Dense storage; bit n represents ElementId n - 1, so that null is bit 0
+    std::vector<Word> _words;
+
+    static size_t bitFor(T elementId) { return static_cast<size_t>(static_cast<int>(elementId) + 1); }
+    static T elementIdFor(size_t bit) { return T(static_cast<int>(bit) - 1); }
+
+    static size_t numWordsFor(size_t bit) { return (bit / BitsPerWord) + 1; }
+
+    static size_t countTrailingZeros(Word word)
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward64(&index, word);
+        return static_cast<size_t>(index);
+#else
+        return static_cast<size_t>(__builtin_ctzll(word));
+#endif
+    }
+
+    static size_t popCount(Word word) { return std::bitset<BitsPerWord>(word).count(); }
+
+    bool testBit(size_t bit) const
+    {
+        auto wordIndex = bit / BitsPerWord;
+        return wordIndex < _words.size() &&
+            (_words[wordIndex] & (Word(1) << (bit % BitsPerWord))) != 0;
+    }
+
+    // Returns the first set bit at or after bit, or npos
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    size_t nextBit(size_t bit) const
+    {
+        auto wordIndex = bit / BitsPerWord;
+        if(wordIndex >= _words.size())
+            return npos;
+
+        auto word = _words[wordIndex] & (~Word(0) << (bit % BitsPerWord));
+
+        while(word == 0)
+        {
+            if(++wordIndex >= _words.size())
+                return npos;
+
+            word = _words[wordIndex];
+        }
+
+        return (wordIndex * BitsPerWord) + countTrailingZeros(word);
+    }
+
+    void trimWords()
+    {
+        while(!_words.empty() && _words.back() == 0)
+            _words.pop_back();
+    }
+
+    void makeDense()
+    {
+        if(_dense)
+            return;
+
+        _words.clear();
+        if(!_elementIds.empty())
+            _words.resize(numWordsFor(bitFor(_elementIds.back())), 0);
+
+        for(auto elementId : _elementIds)
+        {
+            auto bit = bitFor(elementId);
+            _words[bit / BitsPerWord] |= Word(1) << (bit % BitsPerWord);
+        }
+
+        _elementIds.clear();
+        _elementIds.shrink_to_fit();
+        _dense = true;
+    }
+
+    void maybeMakeDense()
+    {
+        if(_dense || _size <= MaxSparseSize)
+            return;
+
+        auto denseBytes = numWordsFor(bitFor(_elementIds.back())) * sizeof(Word);
+        auto sparseBytes = _size * sizeof(T);
+
+        if(denseBytes <= sparseBytes * MaxDenseOverhead)
+            makeDense();
+    }
+
+public:
+    using value_type = T;
+    using key_type = T;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = const T&;
+    using const_reference = const T&;
+
+    class const_iterator
+    {
+        friend class ElementIdSet;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+    private:
+        const ElementIdSet* _set = nullptr;
+
+        // Sparse: index into _elementIds, dense: bit index; npos at the end
+        size_t _position = npos;
+
+        const_iterator(const ElementIdSet* set, size_t position) :
+            _set(set), _position(position)
+        {}
+
+    public:
+        const_iterator() = default;
+
+        T operator*() const
+        {
+            return _set->_dense ? elementIdFor(_position) : _set->_elementIds[_position];
+        }
+
+        const_iterator& operator++()
+        {
+            if(_set->_dense)
+                _position = _set->nextBit(_position + 1);
+            else if(++_position >= _set->_elementIds.size())
+                _position = npos;
+
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const { return _position == other._position; }
+        bool operator!=(const const_iterator& other) const { return _position != other._position; }
+    };
+
+    using iterator = const_iterator;
+
+    ElementIdSet() = default;
+
+    template<typename It>
+    ElementIdSet(It first, It last) { insert(first, last); }
+
+    ElementIdSet(std::initializer_list<T> elementIds) { insert(elementIds.begin(), elementIds.end()); }
+
+    const_iterator begin() const
+    {
+        if(_dense)
+            return {this, nextBit(0)};
+
+        return {this, !_elementIds.empty() ? 0 : npos};
+    }
+
+    const_iterator end() const { return {this, npos}; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool isDense() const { return _dense; }
+
+    void clear()
+    {
+        _dense = false;
+        _size = 0;
+        _elementIds.clear();
+        _words.clear();
+        _words.shrink_to_fit();
+    }
+
+    void reserve(size_t size)
+    {
+        if(!_dense)
+            _elementIds.reserve(size);
+    }
+
+    const_iterator find(T elementId) const
+    {
+        if(_dense)
+        {
+            auto bit = bitFor(elementId);
+            return testBit(bit) ? const_iterator(this, bit) : end();
+        }
+
+        auto it = std::lower_bound(_elementIds.begin(), _elementIds.end(), elementId);
+        if(it != _elementIds.end() && *it == elementId)
+            return {this, static_cast<size_t>(std::distance(_elementIds.begin(), it))};
+
+        return end();
+    }
+
+    bool contains(T elementId) const
+    {
+        if(_dense)
+            return testBit(bitFor(elementId));
+
+        return std::binary_search(_elementIds.begin(), _elementIds.end(), elementId);
+    }
+
+    size_t count(T elementId) const { return contains(elementId) ? 1 : 0; }
+
+    std::pair<const_iterator, bool> insert(T elementId)
+    {
+        if(_dense)
+        {
+            auto bit = bitFor(elementId);
+            auto wordIndex = bit / BitsPerWord;
+            auto mask = Word(1) << (bit % BitsPerWord);
+
+            if(wordIndex >= _words.size())
+                _words.resize(wordIndex + 1, 0);
+
+            bool inserted = (_words[wordIndex] & mask) == 0;
+            if(inserted)
+            {
+                _words[wordIndex] |= mask;
+                _size++;
+            }
+
+            return {const_iterator(this, bit), inserted};
+        }
+
+        auto it = std::lower_bound(_elementIds.begin(), _elementIds.end(), elementId);
+        if(it != _elementIds.end() && *it == elementId)
+            return {const_iterator(this, static_cast<size_t>(std::distance(_elementIds.begin(), it))), false};
+
+        _elementIds.insert(it, elementId);
+        _size++;
+
+        maybeMakeDense();
+
+        return {find(elementId), true};
+    }
+
+    // For compatibility with std::inserter
+    const_iterator insert(const_iterator, T elementId) { return insert(elementId).first; }
+
+    template<typename It> void insert(It first, It last)
+    {
+        if(_dense)
+        {
+            for(auto it = first; it != last; ++it)
+                insert(static_cast<T>(*it));
+
+            return;
+        }
+
+        // Append then sort once, rather than inserting each element in order
+        auto oldSize = _elementIds.size();
+        for(auto it = first; it != last; ++it)
+            _elementIds.emplace_back(*it);
+
+        if(_elementIds.size() == oldSize)
+            return;
+
+        auto middle = _elementIds.begin() + static_cast<std::ptrdiff_t>(oldSize);
+        std::sort(middle, _elementIds.end());
+        std::inplace_merge(_elementIds.begin(), middle, _elementIds.end());
+        _elementIds.erase(std::unique(_elementIds.begin(), _elementIds.end()), _elementIds.end());
+        _size = _elementIds.size();
+
+        maybeMakeDense();
+    }
+
+    void insert(std::initializer_list<T> elementIds) { insert(elementIds.begin(), elementIds.end()); }
+
+    template<typename... Args> std::pair<const_iterator, bool> emplace(Args&&... args)
+    {
+        return insert(T(std::forward<Args>(args)...));
+    }
+
+    size_t erase(T elementId)
+    {
+        if(_dense)
+        {
+            auto bit = bitFor(elementId);
+            if(!testBit(bit))
+                return 0;
+
+            _words[bit / BitsPerWord] &= ~(Word(1) << (bit % BitsPerWord));
+            _size--;
+            return 1;
+        }
+
+        auto it = std::lower_bound(_elementIds.begin(), _elementIds.end(), elementId);
+        if(it == _elementIds.end() || *it != elementId)
+            return 0;
+
+        _elementIds.erase(it);
+        _size--;
+        return 1;
+    }
+
+    const_iterator erase(const_iterator it)
+    {
+        auto next = std::next(it);
+        auto elementId = *it;
+        erase(elementId);
+
+        // Removing from the vector shifts the remaining elements down by one
+        return _dense || next == end() ? next : const_iterator(this, it._position);
+    }
+
+    // Word parallel set operations; these fall back to element-wise
+    // operations when the other set is sparse
+    ElementIdSet& unite(const ElementIdSet& other)
+    {
+        if(!_dense || !other._dense)
+        {
+            if(other._dense && other._size > _size)
+            {
+                auto result = other;
+                result.unite(*this);
+                *this = std::move(result);
+            }
+            else
+                insert(other.begin(), other.end());
+
+            return *this;
+        }
+
+        if(other._words.size() > _words.size())
+            _words.resize(other._words.size(), 0);
+
+        _size = 0;
+        for(size_t i = 0; i < _words.size(); i++)
+        {
+            if(i < other._words.size())
+                _words[i] |= other._words[i];
+
+            _size += popCount(_words[i]);
+        }
+
+        return *this;
+    }
+
+    ElementIdSet& intersect(const ElementIdSet& other)
+    {
+        if(!_dense || !other._dense)
+        {
+            ElementIdSet result;
+            const auto& smaller = _size < other._size ? *this : other;
+            const auto& larger = _size < other._size ? other : *this;
+
+            for(auto elementId : smaller)
+            {
+                if(larger.contains(elementId))
+                    result._elementIds.push_back(elementId);
+            }
+
+            result._size = result._elementIds.size();
+            result.maybeMakeDense();
+            *this = std::move(result);
+
+            return *this;
+        }
+
+        _words.resize(std::min(_words.size(), other._words.size()));
+
+        _size = 0;
+        for(size_t i = 0; i < _words.size(); i++)
+        {
+            _words[i] &= other._words[i];
+            _size += popCount(_words[i]);
+        }
+
+        trimWords();
+
+        return *this;
+    }
+
+    ElementIdSet& subtract(const ElementIdSet& other)
+    {
+        if(!_dense || !other._dense)
+        {
+            if(!_dense)
+            {
+                _elementIds.erase(std::remove_if(_elementIds.begin(), _elementIds.end(),
+                    [&other](T elementId) { return other.contains(elementId); }), _elementIds.end());
+                _size = _elementIds.size();
+            }
+            else
+            {
+                for(auto elementId : other)
+                    erase(elementId);
+            }
+
+            return *this;
+        }
+
+        auto numWords = std::min(_words.size(), other._words.size());
+
+        _size = 0;
+        for(size_t i = 0; i < _words.size(); i++)
+        {
+            if(i < numWords)
+                _words[i] &= ~other._words[i];
+
+            _size += popCount(_words[i]);
+        }
+
+        trimWords();
+
+        return *this;
+    }
+
+    // The elements that are in exactly one of a and b
+    friend ElementIdSet symmetricDifference(const ElementIdSet& a, const ElementIdSet& b)
+    {
+        if(!a._dense || !b._dense)
+        {
+            ElementIdSet result;
+
+            std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(),
+                std::back_inserter(result._elementIds));
+
+            result._size = result._elementIds.size();
+            result.maybeMakeDense();
+
+            return result;
+        }
+
+        ElementIdSet result;
+        result._dense = true;
+        result._words.resize(std::max(a._words.size(), b._words.size()), 0);
+
+        for(size_t i = 0; i < result._words.size(); i++)
+        {
+            auto aWord = i < a._words.size() ? a._words[i] : 0;
+            auto bWord = i < b._words.size() ? b._words[i] : 0;
+            result._words[i] = aWord ^ bWord;
+            result._size += popCount(result._words[i]);
+        }
+
+        result.trimWords();
+
+        return result;
+    }
+
+    bool operator==(const ElementIdSet& other) const
+    {
+        if(_size != other._size)
+            return false;
+
+        if(_dense && other._dense)
+        {
+            auto numWords = std::min(_words.size(), other._words.size());
+            if(!std::equal(_words.begin(), _words.begin() + static_cast<std::ptrdiff_t>(numWords),
+                other._words.begin()))
+            {
+                return false;
+            }
+
+            // Any remaining words must be empty
+            const auto& longer = _words.size() > other._words.size() ? _words : other._words;
+            return std::all_of(longer.begin() + static_cast<std::ptrdiff_t>(numWords), longer.end(),
+                [](Word word) { return word == 0; });
+        }
+
+        return std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const ElementIdSet& other) const { return !(*this == other); }
+
+    void swap(ElementIdSet& other) noexcept
+    {
+        std::swap(_dense, other._dense);
+        std::swap(_size, other._size);
+        _elementIds.swap(other._elementIds);
+        _words.swap(other._words);
+    }
+};
+
+#endif // ELEMENTIDSET_H
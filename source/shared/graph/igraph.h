@@ -22,6 +22,8 @@
 #include "shared/graph/elementid.h"
 #include "igrapharrayclient.h"
 
+#include "shared/utils/function_ref.h"
+
 #include <vector>
 
 class QString;
@@ -45,6 +47,11 @@ public:
     virtual std::vector<EdgeId> inEdgeIds() const = 0;
     virtual std::vector<EdgeId> outEdgeIds() const = 0;
     virtual std::vector<EdgeId> edgeIds() const = 0;
+
+    // Non-allocating alternatives to the above, for use in inner loops
+    virtual void forEachInEdgeId(function_ref<void(EdgeId)> fn) const = 0;
+    virtual void forEachOutEdgeId(function_ref<void(EdgeId)> fn) const = 0;
+    virtual void forEachEdgeId(function_ref<void(EdgeId)> fn) const = 0;
 };
 
 class IEdge
@@ -93,6 +100,12 @@ public:
     virtual std::vector<NodeId> targetsOf(NodeId nodeId) const = 0;
     virtual std::vector<NodeId> neighboursOf(NodeId nodeId) const = 0;
 
+    // As above, but without building a vector; each adjacent node is visited
+    // once per connecting edge, in the same order as the vector versions
+    virtual void forEachSourceOf(NodeId nodeId, function_ref<void(NodeId)> fn) const = 0;
+    virtual void forEachTargetOf(NodeId nodeId, function_ref<void(NodeId)> fn) const = 0;
+    virtual void forEachNeighbourOf(NodeId nodeId, function_ref<void(NodeId)> fn) const = 0;
+
     virtual std::vector<EdgeId> edgeIdsBetween(NodeId nodeIdA, NodeId nodeIdB) const = 0;
     virtual EdgeId firstEdgeIdBetween(NodeId nodeIdA, NodeId nodeIdB) const = 0;
     virtual bool edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const = 0;
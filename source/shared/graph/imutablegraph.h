@@ -33,6 +33,11 @@ public:
 
     virtual void reserveNodeId(NodeId nodeId) = 0;
 
+    // Makes room for numNodes further nodes and numEdges further edges, which subsequent
+    // calls to addNode() and addEdge(NodeId, NodeId) then use in order; this avoids growing
+    // the graph one element at a time when the final size is known up front
+    virtual void reserve(int numNodes, int numEdges) = 0;
+
     virtual NodeId addNode() = 0;
     virtual NodeId addNode(NodeId nodeId) = 0;
     virtual NodeId addNode(const INode& node) = 0;
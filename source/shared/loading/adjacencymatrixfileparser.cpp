@@ -72,7 +72,7 @@ bool parseAdjacencyMatrix(const TabularData& tabularData, Progressable& progress
     for(size_t rowIndex = 0; rowIndex < tabularData.numRows(); rowIndex++)
     {
         const auto& value = tabularData.valueAt(0, rowIndex);
-        if(rowIndex > 0 && !value.isEmpty() && !u::isNumeric(value))
+        if(rowIndex > 0 && !value.isEmpty() && !tabularData.isNumericAt(0, rowIndex))
         {
             hasRowHeaders = true;
             break;
@@ -83,7 +83,7 @@ bool parseAdjacencyMatrix(const TabularData& tabularData, Progressable& progress
     for(size_t columnIndex = 0; columnIndex < tabularData.numColumns(); columnIndex++)
     {
         const auto& value = tabularData.valueAt(columnIndex, 0);
-        if(columnIndex > 0 && !value.isEmpty() && !u::isNumeric(value))
+        if(columnIndex > 0 && !value.isEmpty() && !tabularData.isNumericAt(columnIndex, 0))
         {
             hasColumnHeaders = true;
             break;
@@ -112,8 +112,7 @@ bool parseAdjacencyMatrix(const TabularData& tabularData, Progressable& progress
         {
             QString columnHeader = hasColumnHeaders ? tabularData.valueAt(columnIndex, 0) : QString();
 
-            const auto& value = tabularData.valueAt(columnIndex, rowIndex);
-            double edgeWeight = u::toNumber(value);
+            double edgeWeight = tabularData.numericValueAt(columnIndex, rowIndex);
 
             if(std::isnan(edgeWeight) || !std::isfinite(edgeWeight))
                 edgeWeight = 0.0;
@@ -165,7 +164,7 @@ bool parseEdgeList(const TabularData& tabularData, Progressable& progressable,
         const auto& firstCell = tabularData.valueAt(0, rowIndex);
         const auto& secondCell = tabularData.valueAt(1, rowIndex);
 
-        auto edgeWeight = u::toNumber(tabularData.valueAt(2, rowIndex));
+        auto edgeWeight = tabularData.numericValueAt(2, rowIndex);
         if(std::isnan(edgeWeight) || !std::isfinite(edgeWeight))
             edgeWeight = 0.0;
 
@@ -224,9 +223,9 @@ bool AdjacencyMatrixTabularDataParser::onParseComplete()
     {
         for(size_t rowIndex = 0; rowIndex < data.numRows(); rowIndex++)
         {
-            NodeId source = data.valueAt(0, rowIndex).toInt();
-            NodeId target = data.valueAt(1, rowIndex).toInt();
-            double weight = data.valueAt(2, rowIndex).toDouble();
+            NodeId source = static_cast<int>(data.numericValueAt(0, rowIndex));
+            NodeId target = static_cast<int>(data.numericValueAt(1, rowIndex));
+            double weight = data.numericValueAt(2, rowIndex);
             EdgeListEdge edge{source, target, weight};
 
             edgeList.emplace_back(edge);
@@ -240,9 +239,9 @@ bool AdjacencyMatrixTabularDataParser::onParseComplete()
         {
             for(size_t columnIndex = static_cast<size_t>(topLeft.x()); columnIndex < data.numColumns(); columnIndex++)
             {
-                double weight = data.valueAt(columnIndex, rowIndex).toDouble();
+                double weight = data.numericValueAt(columnIndex, rowIndex);
 
-                if(weight == 0.0)
+                if(std::isnan(weight) || weight == 0.0)
                     continue;
 
                 edgeList.emplace_back(EdgeListEdge{NodeId(rowIndex), NodeId(columnIndex), weight});
@@ -296,7 +295,7 @@ bool AdjacencyMatrixTabularDataParser::isAdjacencyMatrix(const TabularData& tabu
 
             if(rowIndex == 0)
             {
-                if(!u::isNumeric(value) && !value.isEmpty() && columnIndex > 0)
+                if(!tabularData.isNumericAt(columnIndex, rowIndex) && !value.isEmpty() && columnIndex > 0)
                     firstRowAllDouble = false;
 
                 potentialColumnHeaders.push_back(value);
@@ -313,7 +312,7 @@ bool AdjacencyMatrixTabularDataParser::isAdjacencyMatrix(const TabularData& tabu
                 // The first entry could be headers so don't enforce check for a double
                 if(rowIndex > 0)
                 {
-                    if(!u::isNumeric(value) && !value.isEmpty())
+                    if(!tabularData.isNumericAt(columnIndex, rowIndex) && !value.isEmpty())
                         firstColumnAllDouble = false;
                 }
             }
@@ -322,7 +321,7 @@ bool AdjacencyMatrixTabularDataParser::isAdjacencyMatrix(const TabularData& tabu
                 // Check non header elements are doubles
                 // This will prevent loading obviously non-matrix files
                 // We could handle non-double matrix symbols in future (X, -, I, O etc)
-                if(!u::isNumeric(value) && !value.isEmpty())
+                if(!tabularData.isNumericAt(columnIndex, rowIndex) && !value.isEmpty())
                     return false;
             }
         }
@@ -357,7 +356,7 @@ bool AdjacencyMatrixTabularDataParser::isEdgeList(const TabularData& tabularData
         if(!u::isInteger(tabularData.valueAt(1, rowIndex)))
             return false;
 
-        if(!u::isNumeric(tabularData.valueAt(2, rowIndex)))
+        if(!tabularData.isNumericAt(2, rowIndex))
             return false;
     }
 
@@ -0,0 +1,231 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "binaryedgelistfileparser.h"
+
+#include "shared/graph/igraphmodel.h"
+#include "shared/graph/imutablegraph.h"
+
+#include <QFile>
+#include <QUrl>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+const char* const MAGIC = "BINEDGES";
+const size_t MAGIC_SIZE = 8;
+const uint64_t HEADER_SIZE = 32;
+const quint32 VERSION = 1;
+
+const quint32 INT64_INDICES_FLAG = 1u << 0;
+const quint32 HAS_WEIGHTS_FLAG = 1u << 1;
+const quint32 HAS_NAMES_FLAG = 1u << 2;
+} // namespace
+
+BinaryEdgeListFileParser::BinaryEdgeListFileParser(UserNodeData* userNodeData, UserEdgeData* userEdgeData) :
+    _userNodeData(userNodeData), _userEdgeData(userEdgeData)
+{
+    // Add this up front, so that it appears first in the attribute table
+    userNodeData->add(QObject::tr("Node Name"));
+}
+
+bool BinaryEdgeListFileParser::parse(const QUrl& url, IGraphModel* graphModel)
+{
+    Q_ASSERT(graphModel != nullptr);
+    if(graphModel == nullptr)
+        return false;
+
+    QFile file(url.toLocalFile());
+
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    auto fileSize = static_cast<uint64_t>(file.size());
+
+    if(fileSize < HEADER_SIZE)
+    {
+        setFailureReason(QObject::tr("The file is too small to be a binary edge list."));
+        return false;
+    }
+
+    setProgress(-1);
+
+    // The file is mapped and read in place; nothing is copied other than into the graph itself
+    const auto* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+
+    if(data == nullptr)
+        return false;
+
+    if(std::memcmp(data, MAGIC, MAGIC_SIZE) != 0)
+    {
+        setFailureReason(QObject::tr("The file is not a binary edge list."));
+        return false;
+    }
+
+    auto version = qFromLittleEndian<quint32>(data + 8);
+    if(version != VERSION)
+    {
+        setFailureReason(QObject::tr("Binary edge list version %1 is not supported.").arg(version));
+        return false;
+    }
+
+    auto flags = qFromLittleEndian<quint32>(data + 12);
+    auto numNodes = qFromLittleEndian<quint64>(data + 16);
+    auto numEdges = qFromLittleEndian<quint64>(data + 24);
+
+    const uint64_t indexSize = (flags & INT64_INDICES_FLAG) != 0 ? sizeof(qint64) : sizeof(qint32);
+    const bool hasWeights = (flags & HAS_WEIGHTS_FLAG) != 0;
+    const bool hasNames = (flags & HAS_NAMES_FLAG) != 0;
+
+    const auto maxElements = static_cast<uint64_t>(std::numeric_limits<int>::max());
+    if(numNodes > maxElements || numEdges > maxElements)
+    {
+        setFailureReason(QObject::tr("The binary edge list has too many nodes or edges."));
+        return false;
+    }
+
+    // With the counts bounded as above, none of these can overflow
+    const uint64_t sourcesOffset = HEADER_SIZE;
+    const uint64_t targetsOffset = sourcesOffset + (numEdges * indexSize);
+    const uint64_t weightsOffset = targetsOffset + (numEdges * indexSize);
+    const uint64_t nameOffsetsOffset = weightsOffset + (hasWeights ? numEdges * sizeof(float) : 0);
+    const uint64_t namesOffset = nameOffsetsOffset + (hasNames ? (numNodes + 1) * sizeof(quint64) : 0);
+
+    uint64_t namesSize = 0;
+    if(hasNames && namesOffset <= fileSize)
+        namesSize = qFromLittleEndian<quint64>(data + nameOffsetsOffset + (numNodes * sizeof(quint64)));
+
+    if(namesOffset > fileSize || namesSize > fileSize - namesOffset)
+    {
+        setFailureReason(QObject::tr("The binary edge list is truncated."));
+        return false;
+    }
+
+    int percent = -1;
+    auto updateProgress = [this, &percent](uint64_t position, uint64_t total)
+    {
+        auto newPercent = static_cast<int>((position * 100) / total);
+        if(newPercent != percent)
+        {
+            percent = newPercent;
+            setProgress(percent);
+        }
+    };
+
+    auto& graph = graphModel->mutableGraph();
+    graph.reserve(static_cast<int>(numNodes), static_cast<int>(numEdges));
+
+    graph.setPhase(QObject::tr("Nodes"));
+    std::vector<NodeId> nodeIds;
+    nodeIds.reserve(numNodes);
+
+    for(uint64_t index = 0; index < numNodes; index++)
+    {
+        if(cancelled())
+            return false;
+
+        auto nodeId = graph.addNode();
+        nodeIds.push_back(nodeId);
+
+        QString nodeName;
+
+        if(hasNames)
+        {
+            const auto* nameOffsets = data + nameOffsetsOffset + (index * sizeof(quint64));
+            auto start = qFromLittleEndian<quint64>(nameOffsets);
+            auto end = qFromLittleEndian<quint64>(nameOffsets + sizeof(quint64));
+
+            if(start > end || end > namesSize)
+            {
+                setFailureReason(QObject::tr("Node %1 has an invalid name.").arg(index));
+                return false;
+            }
+
+            nodeName = QString::fromUtf8(data + namesOffset + start, static_cast<int>(end - start));
+        }
+        else
+            nodeName = QString::number(index);
+
+        _userNodeData->setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
+        graphModel->setNodeName(nodeId, nodeName);
+
+        updateProgress(index, numNodes);
+    }
+
+    auto readIndex = [data, indexSize](uint64_t offset) -> int64_t
+    {
+        if(indexSize == sizeof(qint64))
+            return qFromLittleEndian<qint64>(data + offset);
+
+        return qFromLittleEndian<qint32>(data + offset);
+    };
+
+    graph.setPhase(QObject::tr("Edges"));
+    percent = -1;
+
+    for(uint64_t index = 0; index < numEdges; index++)
+    {
+        if(cancelled())
+            return false;
+
+        auto source = readIndex(sourcesOffset + (index * indexSize));
+        auto target = readIndex(targetsOffset + (index * indexSize));
+
+        if(source < 0 || static_cast<uint64_t>(source) >= numNodes ||
+            target < 0 || static_cast<uint64_t>(target) >= numNodes)
+        {
+            setFailureReason(QObject::tr("Edge %1 refers to a node that doesn't exist.").arg(index));
+            return false;
+        }
+
+        auto edgeId = graph.addEdge(nodeIds.at(source), nodeIds.at(target));
+
+        if(hasWeights)
+        {
+            auto bits = qFromLittleEndian<quint32>(data + weightsOffset + (index * sizeof(float)));
+            float weight = 0.0f;
+            std::memcpy(&weight, &bits, sizeof(weight));
+
+            _userEdgeData->setValueBy(edgeId, QObject::tr("Edge Weight"), QString::number(weight));
+            _userEdgeData->setValueBy(edgeId, QObject::tr("Absolute Edge Weight"),
+                QString::number(std::abs(weight)));
+        }
+
+        updateProgress(index, numEdges);
+    }
+
+    setProgress(-1);
+
+    return true;
+}
+
+bool BinaryEdgeListFileParser::canLoad(const QUrl& url)
+{
+    QFile file(url.toLocalFile());
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return file.read(MAGIC_SIZE) == QByteArray(MAGIC, MAGIC_SIZE);
+}
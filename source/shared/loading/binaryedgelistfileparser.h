@@ -0,0 +1,59 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARYEDGELISTFILEPARSER_H
+#define BINARYEDGELISTFILEPARSER_H
+
+#include "shared/loading/iparser.h"
+#include "shared/loading/userelementdata.h"
+
+// A compact binary edge list, designed to be written directly from numerical
+// code and loaded without any parsing. All values are little endian.
+//
+//  Offset  Size        Content
+//  0       8           Magic: "BINEDGES"
+//  8       4           uint32 version, currently 1
+//  12      4           uint32 flags:
+//                          bit 0: node indices are int64, otherwise int32
+//                          bit 1: edge weights are present
+//                          bit 2: node names are present
+//  16      8           uint64 number of nodes, N
+//  24      8           uint64 number of edges, E
+//  32      E * I       Source node indices, where I is 4 or 8 (see flags)
+//          E * I       Target node indices
+//          E * 4       float32 edge weights (optional)
+//          (N + 1) * 8 uint64 offsets of each node's name within the name
+//                      data, the last being the total length (optional)
+//          ...         UTF-8 node name data, not NUL terminated (optional)
+//
+// Node indices are in the range [0, N).
+
+class BinaryEdgeListFileParser : public IParser
+{
+private:
+    UserNodeData* _userNodeData;
+    UserEdgeData* _userEdgeData;
+
+public:
+    BinaryEdgeListFileParser(UserNodeData* userNodeData, UserEdgeData* userEdgeData);
+
+    bool parse(const QUrl& url, IGraphModel* graphModel) override;
+    static bool canLoad(const QUrl& url);
+};
+
+#endif // BINARYEDGELISTFILEPARSER_H
@@ -24,9 +24,11 @@
 #include <QXmlStreamReader>
 #include <QFile>
 #include <QUrl>
+#include <QHash>
 
 #include <stack>
-#include <map>
+#include <utility>
+#include <vector>
 
 // http://www.biopax.org/owldoc/Level3/
 // Effectively, Entity and all subclasses are Nodes.
@@ -100,15 +102,108 @@ BiopaxFileParser::BiopaxFileParser(UserNodeData* userNodeData) : _userNodeData(u
     userNodeData->add(QObject::tr("Node Name"));
 }
 
-struct TempEdge
+namespace
+{
+// Maps each rdf:ID (or rdf:resource) to a dense index, so that the rest of
+// the parser deals in integers, and each identifier is only stored once
+class IdentifierTable
 {
-    QStringList _sources;
-    QStringList _targets;
-    friend bool operator<(const TempEdge& l, const TempEdge& r)
+public:
+    static constexpr int NoEdge = -1;
+
+    struct PendingEdge
+    {
+        NodeId _sourceId;
+        int _next;
+    };
+
+    int intern(const QString& identifier)
     {
-        return std::tie(l._sources, l._targets) < std::tie(r._sources, r._targets);
+        auto it = _indices.find(identifier);
+        if(it != _indices.end())
+            return it.value();
+
+        auto index = static_cast<int>(_nodeIds.size());
+        _indices.insert(identifier, index);
+        _nodeIds.emplace_back();
+        _pendingEdgeHeads.push_back(NoEdge);
+
+        return index;
     }
+
+    NodeId nodeIdFor(int index) const { return _nodeIds.at(static_cast<size_t>(index)); }
+
+    // Returns the sources of the edges that were waiting for the node to be defined; these
+    // are copied out, as adding their edges may compact() the storage they came from
+    std::vector<NodeId> define(int index, NodeId nodeId)
+    {
+        auto i = static_cast<size_t>(index);
+
+        // If an identifier is defined more than once, edges refer to the first
+        if(_nodeIds[i].isNull())
+            _nodeIds[i] = nodeId;
+
+        std::vector<NodeId> sourceIds;
+        for(auto edgeIndex = _pendingEdgeHeads[i]; edgeIndex != NoEdge;
+            edgeIndex = pendingEdge(edgeIndex)._next)
+        {
+            sourceIds.push_back(pendingEdge(edgeIndex)._sourceId);
+        }
+
+        _pendingEdgeHeads[i] = NoEdge;
+        _numPendingEdges -= sourceIds.size();
+
+        return sourceIds;
+    }
+
+    void addPendingEdge(int targetIndex, NodeId sourceId)
+    {
+        auto i = static_cast<size_t>(targetIndex);
+        auto edgeIndex = static_cast<int>(_pendingEdges.size());
+
+        _pendingEdges.push_back({sourceId, _pendingEdgeHeads[i]});
+        _pendingEdgeHeads[i] = edgeIndex;
+        _numPendingEdges++;
+    }
+
+    const PendingEdge& pendingEdge(int edgeIndex) const
+    {
+        return _pendingEdges.at(static_cast<size_t>(edgeIndex));
+    }
+
+    // Pending edges are only ever appended, so once none remain the
+    // space they took can be reclaimed
+    void compact()
+    {
+        if(_numPendingEdges == 0)
+            _pendingEdges.clear();
+    }
+
+    // The first identifier that has been referred to by an edge, but never defined
+    template<typename Fn>
+    bool firstUnresolved(Fn&& fn) const
+    {
+        for(auto it = _indices.begin(); it != _indices.end(); ++it)
+        {
+            auto head = _pendingEdgeHeads[static_cast<size_t>(it.value())];
+            if(head != NoEdge)
+            {
+                fn(_pendingEdges.at(static_cast<size_t>(head))._sourceId, it.key());
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    QHash<QString, int> _indices;
+    std::vector<NodeId> _nodeIds;
+    std::vector<int> _pendingEdgeHeads;
+    std::vector<PendingEdge> _pendingEdges;
+    size_t _numPendingEdges = 0;
 };
+} // namespace
 
 bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 {
@@ -128,22 +223,40 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
     QXmlStreamReader xsr(&file);
 
-    std::map<QString, NodeId> nodes;
-    std::stack<std::pair<NodeId, QString>> activeNodes;
+    IdentifierTable identifiers;
+    std::stack<NodeId> activeNodes;
     std::stack<QString> activeElements;
 
-    std::vector<TempEdge> tempEdges;
+    // Edges whose endpoints are both known, waiting to be added to the graph
+    std::vector<std::pair<NodeId, NodeId>> edgeBatch;
+    const size_t maxEdgeBatchSize = 1u << 16u;
+
+    auto addEdges = [&]
+    {
+        graphModel->mutableGraph().performTransaction([&edgeBatch](IMutableGraph& graph)
+        {
+            for(const auto& [sourceId, targetId] : edgeBatch)
+                graph.addEdge(sourceId, targetId);
+        });
+
+        edgeBatch.clear();
+        identifiers.compact();
+    };
+
+    auto addEdge = [&](NodeId sourceId, NodeId targetId)
+    {
+        edgeBatch.emplace_back(sourceId, targetId);
+
+        if(edgeBatch.size() >= maxEdgeBatchSize)
+            addEdges();
+    };
 
     auto processToken = [&](QXmlStreamReader::TokenType tokenType)
     {
         NodeId activeNodeId;
-        QString activeNodeName;
 
         if(!activeNodes.empty())
-        {
-            activeNodeId = activeNodes.top().first;
-            activeNodeName = activeNodes.top().second;
-        }
+            activeNodeId = activeNodes.top();
 
         switch(tokenType)
         {
@@ -164,8 +277,12 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
                 auto rdfId = attributes.value(QStringLiteral("rdf:ID")).toString();
 
                 auto nodeId = graphModel->mutableGraph().addNode();
-                nodes.emplace(rdfId, nodeId);
-                activeNodes.emplace(nodeId, rdfId);
+                auto pendingSourceIds = identifiers.define(identifiers.intern(rdfId), nodeId);
+                activeNodes.push(nodeId);
+
+                // Resolve any edges that referred to this node before it was defined
+                for(auto sourceId : pendingSourceIds)
+                    addEdge(sourceId, nodeId);
 
                 if(_userNodeData != nullptr)
                 {
@@ -186,15 +303,20 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
                     auto rdfResource = attributes.value(QStringLiteral("rdf:resource"))
                         .toString().remove(QStringLiteral("#"));
 
-                    auto& tempEdge = tempEdges.emplace_back();
+                    // These have always produced their edge four times over
+                    // (a pair of sources by a pair of targets), so continue to
+                    int multiplicity = (elementName == QStringLiteral("right") ||
+                        elementName == QStringLiteral("controlled")) ? 4 : 1;
 
-                    tempEdge._sources.push_back(activeNodeName);
-                    tempEdge._targets.push_back(rdfResource);
+                    auto targetIndex = identifiers.intern(rdfResource);
+                    auto targetNodeId = identifiers.nodeIdFor(targetIndex);
 
-                    if(elementName == QStringLiteral("right") || elementName == QStringLiteral("controlled"))
+                    for(int i = 0; i < multiplicity; i++)
                     {
-                        tempEdge._targets.push_back(rdfResource);
-                        tempEdge._sources.push_back(activeNodeName);
+                        if(!targetNodeId.isNull())
+                            addEdge(activeNodeId, targetNodeId);
+                        else
+                            identifiers.addPendingEdge(targetIndex, activeNodeId);
                     }
                 }
             }
@@ -259,32 +381,19 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
         case QXmlStreamReader::EndDocument:
         {
-            for(const auto& tempEdge : tempEdges)
-            {
-                for(const auto& sourceNode : tempEdge._sources)
-                {
-                    auto sourceNodeId = nodes.find(sourceNode);
-                    if(sourceNodeId == nodes.end())
-                    {
-                        setFailureReason(QObject::tr("Invalid Edge Source: %1").arg(sourceNode));
-                        return false;
-                    }
+            addEdges();
 
-                    for(const auto& targetNode : tempEdge._targets)
-                    {
-                        auto targetNodeId = nodes.find(targetNode);
-                        if(targetNodeId == nodes.end())
-                        {
-                            setFailureReason(QObject::tr(
-                                "Invalid Edge Target. source node: %1, target node: %2")
-                                .arg(sourceNode, targetNode));
-                            return false;
-                        }
-
-                        graphModel->mutableGraph().addEdge(sourceNodeId->second, targetNodeId->second);
-                    }
-                }
-            }
+            bool unresolved = identifiers.firstUnresolved([&](NodeId sourceId, const QString& target)
+            {
+                auto source = _userNodeData != nullptr ?
+                    _userNodeData->valueBy(sourceId, QObject::tr("ID")).toString() :
+                    QString::number(static_cast<int>(sourceId));
+                setFailureReason(QObject::tr("Invalid Edge Target. source node: %1, target node: %2")
+                    .arg(source, target));
+            });
+
+            if(unresolved)
+                return false;
 
             break;
         }
@@ -2,11 +2,8 @@
 
 #include <boost/spirit/home/x3.hpp>
 #include <boost/fusion/include/adapt_struct.hpp>
-#include <boost/spirit/home/support/iterators/istream_iterator.hpp>
 #include <boost/boost_spirit_qstring_adapter.h>
 
-#include "progress_iterator.h"
-
 #include "shared/graph/elementid.h"
 #include "shared/graph/igraphmodel.h"
 
@@ -14,9 +11,8 @@
 #include "shared/utils/visitor.h"
 
 #include <QUrl>
-#include <QFileInfo>
+#include <QFile>
 
-#include <fstream>
 #include <variant>
 #include <type_traits>
 #include <functional>
@@ -78,12 +74,6 @@ struct DotSubGraph
     StatementList _statementList;
 };
 
-struct DotGraph
-{
-    QString _id;
-    StatementList _statementList;
-};
-
 } // namespace SpiritDotParser
 
 BOOST_FUSION_ADAPT_STRUCT(
@@ -124,12 +114,6 @@ BOOST_FUSION_ADAPT_STRUCT(
     _statementList
 )
 
-BOOST_FUSION_ADAPT_STRUCT(
-    SpiritDotParser::DotGraph,
-    _id,
-    _statementList
-)
-
 namespace SpiritDotParser
 {
 namespace x3 = boost::spirit::x3;
@@ -201,11 +185,13 @@ const auto statementList_def = *(statement >> -lit(";"));
 const auto dotSubGraph_def = -(lit("subgraph") >> -identifier) >>
     lit("{") >> statementList >> lit("}");
 
-const x3::rule<class DG, DotGraph> dotGraph = "dotGraph";
-const auto dotGraph_def = -lit("strict") >> (lit("graph") | lit("digraph")) >> -identifier >>
-    lit("{") >> statementList >> lit("}");
+// The graph's statements are parsed individually, so only the header is
+// described here, c.f. SpiritDotParser::parse
+const x3::rule<class DGH, QString> dotGraphHeader = "dotGraphHeader";
+const auto dotGraphHeader_def = -lit("strict") >> (lit("graph") | lit("digraph")) >>
+    -identifier >> lit("{");
 
-BOOST_SPIRIT_DEFINE(dotGraph, dotSubGraph, keyValue, keyValueList,
+BOOST_SPIRIT_DEFINE(dotGraphHeader, dotSubGraph, keyValue, keyValueList,
     dotNode, edgeEnd,
     nodeStatement, edgeStatement, attributeStatement,
     statement, statementList,
@@ -219,48 +205,47 @@ const auto comment = lexeme[
 
 const auto skipper = comment | ascii::space;
 
-bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
-    UserNodeData& userNodeData, UserEdgeData& userEdgeData)
+class GraphBuilder
 {
-    std::vector<NodeId> nodeIds;
-    std::vector<EdgeId> edgeIds;
-    std::map<QString, NodeId> dotNodeToNodeId;
-    std::vector<AttributeStatement> attributeStatements;
+private:
+    IGraphModel* _graphModel;
+    UserNodeData* _userNodeData;
+    UserEdgeData* _userEdgeData;
+
+    std::vector<NodeId> _nodeIds;
+    std::vector<EdgeId> _edgeIds;
+    std::map<QString, NodeId> _dotNodeToNodeId;
+    std::vector<AttributeStatement> _attributeStatements;
 
-    auto addNode = [&](const QString& nodeName)
+    NodeId addNode(const QString& nodeName)
     {
-        if(!u::contains(dotNodeToNodeId, nodeName))
+        if(!u::contains(_dotNodeToNodeId, nodeName))
         {
-            auto nodeId = graphModel.mutableGraph().addNode();
+            auto nodeId = _graphModel->mutableGraph().addNode();
 
-            dotNodeToNodeId[nodeName] = nodeId;
-            userNodeData.setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
-            graphModel.setNodeName(nodeId, nodeName);
-            nodeIds.emplace_back(nodeId);
+            _dotNodeToNodeId[nodeName] = nodeId;
+            _userNodeData->setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
+            _graphModel->setNodeName(nodeId, nodeName);
+            _nodeIds.emplace_back(nodeId);
         }
 
-        return dotNodeToNodeId.at(nodeName);
-    };
-
-    std::function<std::vector<QString>(const Statement& s)> processStatement;
+        return _dotNodeToNodeId.at(nodeName);
+    }
 
-    auto processStatementList = [&](const StatementList& l)
+    std::vector<QString> processStatementList(const StatementList& l)
     {
         std::vector<QString> nodes;
-        size_t i = 0;
 
         for(const auto& s : l)
         {
-            for(const auto& nodeId : processStatement(s))
+            for(const auto& nodeId : process(s))
                 nodes.emplace_back(nodeId);
-
-            parser.setProgress(static_cast<int>((i++ * 100) / l.size()));
         }
 
         return nodes;
-    };
+    }
 
-    auto processEdgeEnd = [&](const EdgeEnd& e)
+    std::vector<QString> processEdgeEnd(const EdgeEnd& e)
     {
         return std::visit(Visitor
         {
@@ -269,9 +254,15 @@ bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
             [&](const DotNode& node)
                 { return std::vector<QString>({node._text}); }
         }, e);
-    };
+    }
 
-    processStatement = [&](const Statement& s)
+public:
+    GraphBuilder(IGraphModel& graphModel, UserNodeData& userNodeData, UserEdgeData& userEdgeData) :
+        _graphModel(&graphModel), _userNodeData(&userNodeData), _userEdgeData(&userEdgeData)
+    {}
+
+    // Called for each top level statement, as soon as it is parsed
+    std::vector<QString> process(const Statement& s)
     {
         return std::visit(Visitor
         {
@@ -279,7 +270,7 @@ bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
                 { return processStatementList(subGraph.get()._statementList); },
             [&](const AttributeStatement& attribute)
             {
-                attributeStatements.emplace_back(attribute);
+                _attributeStatements.emplace_back(attribute);
                 return std::vector<QString>{};
             },
             [&](const EdgeStatement& edge)
@@ -305,11 +296,11 @@ bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
                     {
                         for(auto targetNodeId : targetNodeIds)
                         {
-                            auto edgeId = graphModel.mutableGraph().addEdge(
+                            auto edgeId = _graphModel->mutableGraph().addEdge(
                                 sourceNodeId, targetNodeId);
 
                             addedEdgeIds.emplace_back(edgeId);
-                            edgeIds.emplace_back(edgeId);
+                            _edgeIds.emplace_back(edgeId);
                         }
                     }
 
@@ -321,7 +312,7 @@ bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
                     for(const auto& attribute : edge._attributeList)
                     {
                         QString attributeName = QObject::tr("Edge ") + attribute._key;
-                        userEdgeData.setValueBy(edgeId, attributeName, attribute._value);
+                        _userEdgeData->setValueBy(edgeId, attributeName, attribute._value);
                     }
                 }
 
@@ -334,44 +325,75 @@ bool build(DotFileParser& parser, const DotGraph& dot, IGraphModel& graphModel,
                 for(const auto& attribute : node._attributeList)
                 {
                     QString attributeName = QObject::tr("Node ") + attribute._key;
-                    userNodeData.setValueBy(nodeId, attributeName, attribute._value);
+                    _userNodeData->setValueBy(nodeId, attributeName, attribute._value);
                 }
 
                 return std::vector<QString>({node._node._text});
             },
             [](auto&&) { return std::vector<QString>(); } // Ignore everything else
         }, s);
-    };
-
-    processStatementList(dot._statementList);
-
-    parser.setProgress(-1);
+    }
 
-    for(const auto& s : attributeStatements)
+    // Attribute statements apply to every node or edge, regardless of
+    // where they appear, so can only be applied once the graph is complete
+    void applyAttributeStatements()
     {
-        if(s._type == "node")
+        for(const auto& s : _attributeStatements)
         {
-            for(const auto& attribute : s._attributeList)
+            if(s._type == "node")
             {
-                for(auto nodeId : nodeIds)
+                for(const auto& attribute : s._attributeList)
                 {
-                    QString attributeName = QObject::tr("Node ") + attribute._key;
-                    userNodeData.setValueBy(nodeId, attributeName, attribute._value);
+                    for(auto nodeId : _nodeIds)
+                    {
+                        QString attributeName = QObject::tr("Node ") + attribute._key;
+                        _userNodeData->setValueBy(nodeId, attributeName, attribute._value);
+                    }
                 }
             }
-        }
-        else if(s._type == "edge")
-        {
-            for(const auto& attribute : s._attributeList)
+            else if(s._type == "edge")
             {
-                for(auto edgeId : edgeIds)
+                for(const auto& attribute : s._attributeList)
                 {
-                    QString attributeName = QObject::tr("Edge ") + attribute._key;
-                    userEdgeData.setValueBy(edgeId, attributeName, attribute._value);
+                    for(auto edgeId : _edgeIds)
+                    {
+                        QString attributeName = QObject::tr("Edge ") + attribute._key;
+                        _userEdgeData->setValueBy(edgeId, attributeName, attribute._value);
+                    }
                 }
             }
         }
     }
+};
+
+// Rather than parsing the entire file into a DotGraph before building the graph,
+// each top level statement is parsed and added to the graph in turn, so that no
+// more than a single statement's worth of AST exists at any one time
+template<typename It, typename ProgressFn>
+bool parse(It& it, It end, GraphBuilder& builder, ProgressFn&& progressFn)
+{
+    QString id;
+
+    if(!x3::phrase_parse(it, end, dotGraphHeader, skipper, id))
+        return false;
+
+    while(!x3::phrase_parse(it, end, lit("}"), skipper))
+    {
+        Statement s;
+
+        if(!x3::phrase_parse(it, end, statement >> -lit(";"), skipper, s))
+            return false;
+
+        builder.process(s);
+
+        if(!progressFn(it))
+            return false;
+    }
+
+    // Skip any trailing whitespace or comments
+    x3::phrase_parse(it, end, x3::eps, skipper);
+
+    builder.applyAttributeStatements();
 
     return true;
 }
@@ -391,51 +413,41 @@ bool DotFileParser::parse(const QUrl& url, IGraphModel* graphModel)
     if(graphModel == nullptr)
         return false;
 
-    QString localFile = url.toLocalFile();
-    QFileInfo fileInfo(localFile);
+    QFile file(url.toLocalFile());
 
-    if(!fileInfo.exists())
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
         return false;
 
-    auto fileSize = fileInfo.size();
+    auto fileSize = file.size();
 
-    setProgress(-1);
+    if(fileSize == 0)
+        return false;
 
-    std::ifstream stream(localFile.toStdString());
-    stream.unsetf(std::ios::skipws);
+    setProgress(-1);
 
-    boost::spirit::istream_iterator istreamIt(stream);
-    using DotIterator = progress_iterator<decltype(istreamIt)>;
-    DotIterator it(istreamIt);
-    DotIterator end;
+    // Map the file rather than reading it, so that memory usage
+    // is bounded by the graph and not the size of the file
+    const auto* data = file.map(0, fileSize);
 
-    it.onPositionChanged(
-    [this, &fileSize](size_t position)
-    {
-        setProgress(static_cast<int>((position * 100) / fileSize));
-    });
+    if(data == nullptr)
+        return false;
 
-    auto cancelledFn = [this] { return cancelled(); };
-    it.setCancelledFn(cancelledFn);
+    const auto* begin = reinterpret_cast<const char*>(data);
+    const auto* end = begin + fileSize;
+    const auto* it = begin;
 
     graphModel->mutableGraph().setPhase(QObject::tr("Parsing"));
 
-    SpiritDotParser::DotGraph dot;
-    bool success = false;
+    SpiritDotParser::GraphBuilder builder(*graphModel, *_userNodeData, *_userEdgeData);
 
-    try
+    bool success = SpiritDotParser::parse(it, end, builder,
+    [this, begin, fileSize](const char* position)
     {
-        success = SpiritDotParser::x3::phrase_parse(it, end,
-            SpiritDotParser::dotGraph, SpiritDotParser::skipper, dot);
-    }
-    catch(DotIterator::cancelled_exception&) {}
-
-    if(cancelled() || !success || it != end)
-        return false;
+        setProgress(static_cast<int>(((position - begin) * 100) / fileSize));
+        return !cancelled();
+    });
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Building Graph"));
     setProgress(-1);
 
-    return SpiritDotParser::build(*this, dot, *graphModel,
-        *_userNodeData, *_userEdgeData);
+    return !cancelled() && success && it == end;
 }
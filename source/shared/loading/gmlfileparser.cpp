@@ -20,19 +20,17 @@
 
 #include <boost/spirit/home/x3.hpp>
 #include <boost/fusion/include/adapt_struct.hpp>
-#include <boost/spirit/home/support/iterators/istream_iterator.hpp>
 #include <boost/boost_spirit_qstring_adapter.h>
 
-#include "progress_iterator.h"
-
 #include "shared/graph/elementid.h"
 #include "shared/graph/igraphmodel.h"
 
+#include "shared/utils/container.h"
+
 #include <QUrl>
-#include <QFileInfo>
+#include <QFile>
 #include <QTextDocumentFragment>
 
-#include <fstream>
 #include <variant>
 #include <map>
 
@@ -134,10 +132,16 @@ AttributeVector processAttribute(const KeyValue& attribute)
     return std::visit(Visitor(attribute._key), attribute._value);
 }
 
-bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
-    UserNodeData& userNodeData, UserEdgeData& userEdgeData)
+class GraphBuilder
 {
-    auto findIntValue = [](const List& list, const QString& key) -> const int*
+private:
+    IGraphModel* _graphModel;
+    UserNodeData* _userNodeData;
+    UserEdgeData* _userEdgeData;
+
+    std::map<int, NodeId> _gmlIdToNodeId;
+
+    static const int* findIntValue(const List& list, const QString& key)
     {
         auto keyValue = std::find_if(list.begin(), list.end(), [&](auto& item)
         {
@@ -148,18 +152,16 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
             return std::get_if<int>(&keyValue->get()._value);
 
         return nullptr;
-    };
-
-    std::map<int, NodeId> gmlIdToNodeId;
+    }
 
-    auto processNode = [&](const List& node)
+    bool processNode(const List& node)
     {
         const auto* id = findIntValue(node, QStringLiteral("id"));
         if(id == nullptr)
             return false;
 
-        auto nodeId = graphModel.mutableGraph().addNode();
-        gmlIdToNodeId[*id] = nodeId;
+        auto nodeId = _graphModel->mutableGraph().addNode();
+        _gmlIdToNodeId[*id] = nodeId;
 
         auto nodeName = QString::number(*id);
 
@@ -183,18 +185,18 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
                 for(const auto& attribute : attributes)
                 {
                     QString attributeName = QObject::tr("Node ") + attribute._name;
-                    userNodeData.setValueBy(nodeId, attributeName, attribute._value);
+                    _userNodeData->setValueBy(nodeId, attributeName, attribute._value);
                 }
             }
         }
 
-        userNodeData.setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
-        graphModel.setNodeName(nodeId, nodeName);
+        _userNodeData->setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
+        _graphModel->setNodeName(nodeId, nodeName);
 
         return true;
-    };
+    }
 
-    auto processEdge = [&](const List& edge)
+    bool processEdge(const List& edge)
     {
         const auto* sourceId = findIntValue(edge, QStringLiteral("source"));
         const auto* targetId = findIntValue(edge, QStringLiteral("target"));
@@ -202,12 +204,12 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
         if(sourceId == nullptr || targetId == nullptr)
             return false;
 
-        if(!u::contains(gmlIdToNodeId, *sourceId) || !u::contains(gmlIdToNodeId, *targetId))
+        if(!u::contains(_gmlIdToNodeId, *sourceId) || !u::contains(_gmlIdToNodeId, *targetId))
             return false;
 
-        auto sourceNodeId = gmlIdToNodeId[*sourceId];
-        auto targetNodeId = gmlIdToNodeId[*targetId];
-        auto edgeId = graphModel.mutableGraph().addEdge(sourceNodeId, targetNodeId);
+        auto sourceNodeId = _gmlIdToNodeId[*sourceId];
+        auto targetNodeId = _gmlIdToNodeId[*targetId];
+        auto edgeId = _graphModel->mutableGraph().addEdge(sourceNodeId, targetNodeId);
 
         for(const auto& attributeWrapper : edge)
         {
@@ -220,48 +222,77 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
             for(const auto& attribute : attributes)
             {
                 QString attributeName = QObject::tr("Edge ") + attribute._name;
-                userEdgeData.setValueBy(edgeId, attributeName, attribute._value);
+                _userEdgeData->setValueBy(edgeId, attributeName, attribute._value);
             }
         }
 
         return true;
-    };
+    }
 
-    for(const auto& keyValue : gml)
+public:
+    GraphBuilder(IGraphModel& graphModel, UserNodeData& userNodeData, UserEdgeData& userEdgeData) :
+        _graphModel(&graphModel), _userNodeData(&userNodeData), _userEdgeData(&userEdgeData)
+    {}
+
+    // Called for each element of the top level graph list, as soon as it is parsed
+    bool process(const KeyValue& element)
     {
-        const auto& key = keyValue.get()._key;
+        const auto* value = std::get_if<List>(&element._value);
 
-        if(key == QStringLiteral("graph"))
-        {
-            const auto* graph = std::get_if<List>(&keyValue.get()._value);
+        if(value == nullptr)
+            return true;
 
-            if(graph == nullptr)
-                return false;
+        if(element._key == QStringLiteral("node"))
+            return processNode(*value);
 
-            uint64_t i = 0;
-            for(const auto& element : *graph)
-            {
-                parser.setProgress(static_cast<int>((i++ * 100) / graph->size()));
+        if(element._key == QStringLiteral("edge"))
+            return processEdge(*value);
 
-                const auto& type = element.get()._key;
-                const auto* value = std::get_if<List>(&element.get()._value);
+        return true;
+    }
+};
 
-                if(value == nullptr)
-                    continue;
+// Rather than parsing the entire file into a List before building the graph,
+// the elements of the graph list are parsed and added to the graph one by one,
+// so that no more than a single element's worth of AST exists at any one time
+template<typename It, typename ProgressFn>
+bool parse(It& it, It end, GraphBuilder& builder, ProgressFn&& progressFn)
+{
+    QString key;
 
-                bool success = true;
+    while(x3::phrase_parse(it, end, gmlKey, ascii::space, key))
+    {
+        if(key != QStringLiteral("graph"))
+        {
+            // Some other top level value, which we have no use for
+            Value value;
+            if(!x3::phrase_parse(it, end, gmlValue, ascii::space, value))
+                return false;
 
-                if(type == QStringLiteral("node"))
-                    success = processNode(*value);
-                else if(type == QStringLiteral("edge"))
-                    success = processEdge(*value);
+            key.clear();
+            continue;
+        }
 
-                if(!success || parser.cancelled())
-                    return false;
-            }
+        if(!x3::phrase_parse(it, end, lit('['), ascii::space))
+            return false;
+
+        while(!x3::phrase_parse(it, end, lit(']'), ascii::space))
+        {
+            KeyValue element;
+
+            if(!x3::phrase_parse(it, end, gmlKeyValue, ascii::space, element))
+                return false;
+
+            if(!builder.process(element) || !progressFn(it))
+                return false;
         }
+
+        key.clear();
     }
 
+    // Skip any trailing whitespace
+    x3::phrase_parse(it, end, x3::eps, ascii::space);
+
     return true;
 }
 
@@ -280,55 +311,42 @@ bool GmlFileParser::parse(const QUrl& url, IGraphModel* graphModel)
     if(graphModel == nullptr)
         return false;
 
-    QString localFile = url.toLocalFile();
-    QFileInfo fileInfo(localFile);
+    QFile file(url.toLocalFile());
 
-    if(!fileInfo.exists())
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
         return false;
 
-    auto fileSize = fileInfo.size();
+    auto fileSize = file.size();
+
+    // An empty file is a valid (empty) GML document
+    if(fileSize == 0)
+        return true;
 
     setProgress(-1);
 
-    std::ifstream stream(localFile.toStdString());
+    // Map the file rather than reading it, so that memory usage
+    // is bounded by the graph and not the size of the file
+    const auto* data = file.map(0, fileSize);
 
-    if(!stream)
+    if(data == nullptr)
         return false;
 
-    stream.unsetf(std::ios::skipws);
-
-    boost::spirit::istream_iterator istreamIt(stream);
-    using GmlIterator = progress_iterator<decltype(istreamIt)>;
-    GmlIterator it(istreamIt);
-    GmlIterator end;
-
-    it.onPositionChanged(
-    [this, &fileSize](size_t position)
-    {
-        setProgress(static_cast<int>((position * 100) / fileSize));
-    });
-
-    auto cancelledFn = [this] { return cancelled(); };
-    it.setCancelledFn(cancelledFn);
+    const auto* begin = reinterpret_cast<const char*>(data);
+    const auto* end = begin + fileSize;
+    const auto* it = begin;
 
     graphModel->mutableGraph().setPhase(QObject::tr("Parsing"));
 
-    SpiritGmlParser::List gml;
-    bool success = false;
+    SpiritGmlParser::GraphBuilder builder(*graphModel, *_userNodeData, *_userEdgeData);
 
-    try
+    bool success = SpiritGmlParser::parse(it, end, builder,
+    [this, begin, fileSize](const char* position)
     {
-        success = SpiritGmlParser::x3::phrase_parse(it, end,
-            SpiritGmlParser::gmlList, SpiritGmlParser::ascii::space, gml);
-    }
-    catch(GmlIterator::cancelled_exception&) {}
-
-    if(cancelled() || !success || it != end)
-        return false;
+        setProgress(static_cast<int>(((position - begin) * 100) / fileSize));
+        return !cancelled();
+    });
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Building Graph"));
     setProgress(-1);
 
-    return SpiritGmlParser::build(*this, gml, *graphModel,
-        *_userNodeData, *_userEdgeData);
+    return !cancelled() && success && it == end;
 }
@@ -23,14 +23,15 @@
 #include "shared/graph/igraphmodel.h"
 #include "shared/graph/imutablegraph.h"
 
-#include <QDataStream>
 #include <QFile>
 #include <QUrl>
 
+#include <functional>
+#include <map>
+
 bool JsonGraphParser::parse(const QUrl &url, IGraphModel *graphModel)
 {
     QFile file(url.toLocalFile());
-    QByteArray byteArray;
 
     if(!file.open(QIODevice::ReadOnly))
         return false;
@@ -40,67 +41,121 @@ bool JsonGraphParser::parse(const QUrl &url, IGraphModel *graphModel)
     if(totalBytes == 0)
         return false;
 
-    qint64 bytesRead = 0;
-    QDataStream input(&file);
+    // Map the file rather than reading it, so that memory usage
+    // is bounded by the graph and not the size of the file
+    const auto* data = file.map(0, totalBytes);
+
+    if(data == nullptr)
+        return false;
+
+    const auto* begin = reinterpret_cast<const char*>(data);
+    JsonStreamReader reader(begin, begin + totalBytes);
 
-    do
+    if(!reader.beginObject())
     {
-        const int ChunkSize = 2 << 16;
-        std::vector<unsigned char> buffer(ChunkSize);
+        setFailureReason(QObject::tr("Body is empty, or not an object."));
+        return false;
+    }
+
+    bool graphFound = false;
+    const char* graphPosition = nullptr;
+    std::string key;
+
+    while(!graphFound && reader.nextKey(key))
+    {
+        if(key == "graphs" && reader.nextIsArray())
+        {
+            reader.beginArray();
 
-        auto numBytes = input.readRawData(reinterpret_cast<char*>(buffer.data()), ChunkSize);
-        byteArray.append(reinterpret_cast<char*>(buffer.data()), numBytes);
+            if(reader.nextElement())
+            {
+                if(reader.nextIsObject())
+                {
+                    if(!parseGraphObject(reader, graphModel, *this, false, _userNodeData, _userEdgeData))
+                        return false;
+
+                    graphFound = true;
+                }
+                else
+                {
+                    // Not a graph, so ignore the array entirely
+                    reader.skipValue();
+                    while(reader.nextElement())
+                        reader.skipValue();
+                }
+            }
+        }
+        else if(key == "graph" && reader.nextIsObject() && graphPosition == nullptr)
+        {
+            // "graphs" takes precedence wherever it appears, so
+            // only come back to this if there turns out to be none
+            graphPosition = reader.position();
+            reader.skipValue();
+        }
+        else
+            reader.skipValue();
 
-        bytesRead += numBytes;
+        if(cancelled())
+            return false;
+    }
 
-        setProgress(static_cast<int>((bytesRead * 100) / totalBytes));
-    } while(!input.atEnd());
+    if(!graphFound && graphPosition != nullptr && !reader.failed())
+    {
+        reader.seek(graphPosition);
 
-    auto jsonBody = parseJsonFrom(byteArray, this);
+        if(!parseGraphObject(reader, graphModel, *this, false, _userNodeData, _userEdgeData))
+            return false;
 
-    if(cancelled())
-        return false;
+        graphFound = true;
+    }
 
-    if(jsonBody.is_null() || !jsonBody.is_object())
+    if(!graphFound)
     {
-        setFailureReason(QObject::tr("Body is empty, or not an object."));
+        setFailureReason(reader.failed() ?
+            QObject::tr("Body is not valid JSON.") :
+            QObject::tr("Body doesn't contain a graph object."));
         return false;
     }
 
-    const json* graph = nullptr;
+    // Note that once a graph has been found, the remainder of the document
+    // is ignored, and so is not validated
+    return true;
+}
 
-    if(u::contains(jsonBody, "graphs") && jsonBody["graphs"].is_array() && !jsonBody["graphs"].empty())
-        graph = &jsonBody["graphs"].at(0);
-    else if(u::contains(jsonBody, "graph") && jsonBody["graph"].is_object())
-        graph = &jsonBody["graph"];
-    else
+static void parseMetadata(const json& metadata, QString& key, QString& value,
+    const std::function<void(const QString&, const QString&)>& setFn)
+{
+    for(auto it = metadata.begin(); it != metadata.end(); ++it)
     {
-        setFailureReason(QObject::tr("Body doesn't contain a graph object."));
-        return false;
-    }
+        key = QString::fromStdString(it.key());
+        value.clear();
+
+        if(it.value().is_string())
+            value = QString::fromStdString(it.value().get<std::string>());
+        else if(it.value().is_number_integer())
+            value = QString::number(it.value().get<int>());
+        else if(it.value().is_number_float())
+            value = QString::number(it.value().get<double>());
 
-    return parseGraphObject(*graph, graphModel, *this, false, _userNodeData, _userEdgeData);
+        setFn(key, value);
+    }
 }
 
-bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel* graphModel,
+bool JsonGraphParser::parseGraphObject(JsonStreamReader& reader, IGraphModel* graphModel,
                                        IParser& parser, bool useElementIdsLiterally,
                                        UserNodeData* userNodeData, UserEdgeData* userEdgeData)
 {
-    if(!u::contains(jsonGraphObject, "nodes") || !u::contains(jsonGraphObject, "edges"))
+    auto setProgress = [&reader, &parser]
     {
-        parser.setFailureReason(QObject::tr("Graph doesn't contain nodes or edges arrays."));
-        return false;
-    }
-
-    const auto& jsonNodes = jsonGraphObject["nodes"];
-    const auto& jsonEdges = jsonGraphObject["edges"];
-
-    uint64_t i = 0;
+        parser.setProgress(static_cast<int>((reader.offset() * 100) / reader.size()));
+    };
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
+    QString key;
+    QString value;
 
     std::map<std::string, NodeId> stringNodeIdToNodeId;
-    for(const auto& jsonNode : jsonNodes)
+
+    auto processNode = [&](const json& jsonNode)
     {
         if(!u::contains(jsonNode, "id") || !jsonNode["id"].is_string())
         {
@@ -131,32 +186,14 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
 
         if(u::contains(jsonNode, "metadata") && userNodeData != nullptr)
         {
-            auto metadata = jsonNode["metadata"];
-            for(auto it = metadata.begin(); it != metadata.end(); ++it)
-            {
-                auto key = QString::fromStdString(it.key());
-                QString value;
-
-                if(it.value().is_string())
-                    value = QString::fromStdString(it.value().get<std::string>());
-                else if(it.value().is_number_integer())
-                    value = QString::number(it.value().get<int>());
-                else if(it.value().is_number_float())
-                    value = QString::number(it.value().get<double>());
-
-                userNodeData->setValueBy(nodeId, key, value);
-            }
+            parseMetadata(jsonNode["metadata"], key, value,
+            [&](const QString& k, const QString& v) { userNodeData->setValueBy(nodeId, k, v); });
         }
 
-        parser.setProgress(static_cast<int>((i++ * 100) / jsonNodes.size()));
-    }
-
-    parser.setProgress(-1);
-
-    i = 0;
+        return true;
+    };
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
-    for(const auto& jsonEdge : jsonEdges)
+    auto processEdge = [&](const json& jsonEdge)
     {
         if(!u::contains(jsonEdge, "source") || !u::contains(jsonEdge, "target"))
         {
@@ -165,7 +202,10 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
         }
 
         if(!jsonEdge["source"].is_string() || !jsonEdge["target"].is_string())
+        {
+            parser.setFailureReason(QObject::tr("Edge source or target is not a string."));
             return false;
+        }
 
         auto sourceIdString = jsonEdge["source"].get<std::string>();
         auto targetIdString = jsonEdge["target"].get<std::string>();
@@ -173,6 +213,7 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
         if(!u::contains(stringNodeIdToNodeId, sourceIdString) ||
             !u::contains(stringNodeIdToNodeId, targetIdString))
         {
+            parser.setFailureReason(QObject::tr("Edge refers to a node that doesn't exist."));
             return false;
         }
 
@@ -192,25 +233,101 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
 
         if(u::contains(jsonEdge, "metadata") && userEdgeData != nullptr)
         {
-            auto metadata = jsonEdge["metadata"];
-            for(auto it = metadata.begin(); it != metadata.end(); ++it)
-            {
-                QString key = QString::fromStdString(it.key());
-                QString value;
+            parseMetadata(jsonEdge["metadata"], key, value,
+            [&](const QString& k, const QString& v) { userEdgeData->setValueBy(edgeId, k, v); });
+        }
 
-                if(it.value().is_string())
-                    value = QString::fromStdString(it.value().get<std::string>());
-                else if(it.value().is_number_integer())
-                    value = QString::number(it.value().get<int>());
-                else if(it.value().is_number_float())
-                    value = QString::number(it.value().get<double>());
+        return true;
+    };
 
-                userEdgeData->setValueBy(edgeId, key, value);
-            }
+    auto malformed = [&parser]
+    {
+        parser.setFailureReason(QObject::tr("Graph contains malformed JSON."));
+        return false;
+    };
+
+    // Each element of the array is parsed, and added to the graph, in isolation
+    auto processArray = [&](const auto& processFn)
+    {
+        if(!reader.beginArray())
+            return malformed();
+
+        while(reader.nextElement())
+        {
+            auto element = reader.readValue();
+
+            if(reader.failed())
+                return malformed();
+
+            if(!processFn(element) || parser.cancelled())
+                return false;
+
+            setProgress();
+        }
+
+        parser.setProgress(-1);
+        return !reader.failed() || malformed();
+    };
+
+    if(!reader.beginObject())
+        return false;
+
+    bool nodesFound = false;
+    bool edgesFound = false;
+    const char* deferredEdges = nullptr;
+    std::string objectKey;
+
+    while(reader.nextKey(objectKey))
+    {
+        if(objectKey == "nodes")
+        {
+            graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
+
+            if(!processArray(processNode))
+                return false;
 
+            nodesFound = true;
         }
+        else if(objectKey == "edges")
+        {
+            edgesFound = true;
+
+            if(nodesFound)
+            {
+                graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
+
+                if(!processArray(processEdge))
+                    return false;
+            }
+            else
+            {
+                // The edges can't be added until all the nodes are known, so
+                // remember where they are and come back to them later
+                deferredEdges = reader.position();
+                reader.skipValue();
+            }
+        }
+        else
+            reader.skipValue();
+    }
+
+    if(reader.failed() || !nodesFound || !edgesFound)
+    {
+        parser.setFailureReason(QObject::tr("Graph doesn't contain nodes or edges arrays."));
+        return false;
+    }
+
+    if(deferredEdges != nullptr)
+    {
+        const auto* graphObjectEnd = reader.position();
+        reader.seek(deferredEdges);
+
+        graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
+
+        if(!processArray(processEdge))
+            return false;
 
-        parser.setProgress(static_cast<int>((i++ * 100) / jsonEdges.size()));
+        reader.seek(graphObjectEnd);
     }
 
     parser.setProgress(-1);
@@ -21,7 +21,7 @@
 
 #include "shared/loading/iparser.h"
 #include "shared/loading/userelementdata.h"
-#include "json_helper.h"
+#include "shared/loading/jsonstreamreader.h"
 
 class JsonGraphParser : public IParser
 {
@@ -35,7 +35,9 @@ public:
 
     bool parse(const QUrl &url, IGraphModel *graphModel) override;
     static bool canLoad(const QUrl &) { return true; }
-    static bool parseGraphObject(const json& jsonGraphObject, IGraphModel *graphModel,
+    // The reader must be positioned at the start of the graph object, which is
+    // then read an element at a time, rather than as a whole
+    static bool parseGraphObject(JsonStreamReader& reader, IGraphModel *graphModel,
                                  IParser& parser, bool useElementIdsLiterally = false,
                                  UserNodeData* userNodeData = nullptr,
                                  UserEdgeData* userEdgeData = nullptr);
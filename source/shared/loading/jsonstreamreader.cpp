@@ -0,0 +1,270 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jsonstreamreader.h"
+
+#include <QtGlobal>
+
+#include <cstring>
+
+static bool isWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isDelimiter(char c)
+{
+    return isWhitespace(c) || c == ',' || c == ':' || c == ']' || c == '}';
+}
+
+JsonStreamReader::JsonStreamReader(const char* begin, const char* end) :
+    _begin(begin), _end(end), _position(begin)
+{}
+
+void JsonStreamReader::skipWhitespace()
+{
+    while(_position != _end && isWhitespace(*_position))
+        _position++;
+}
+
+bool JsonStreamReader::consume(char c)
+{
+    skipWhitespace();
+
+    if(_position == _end || *_position != c)
+        return false;
+
+    _position++;
+    return true;
+}
+
+bool JsonStreamReader::fail()
+{
+    _failed = true;
+    return false;
+}
+
+bool JsonStreamReader::skipString(std::string* value)
+{
+    if(!consume('"'))
+        return fail();
+
+    const char* start = _position;
+    bool escaped = false;
+
+    while(_position != _end)
+    {
+        if(escaped)
+            escaped = false;
+        else if(*_position == '\\')
+            escaped = true;
+        else if(*_position == '"')
+        {
+            if(value != nullptr)
+            {
+                // Keys are generally simple, so only invoke the
+                // full parser when there are escape sequences present
+                if(std::memchr(start, '\\', static_cast<size_t>(_position - start)) != nullptr)
+                {
+                    auto parsed = json::parse(start - 1, _position + 1, nullptr, false);
+
+                    if(!parsed.is_string())
+                        return fail();
+
+                    *value = parsed.get<std::string>();
+                }
+                else
+                    value->assign(start, _position);
+            }
+
+            _position++;
+            return true;
+        }
+
+        _position++;
+    }
+
+    return fail();
+}
+
+bool JsonStreamReader::skipLiteral()
+{
+    // Numbers, true, false and null
+    const char* start = _position;
+
+    while(_position != _end && !isDelimiter(*_position))
+        _position++;
+
+    if(_position == start)
+        return fail();
+
+    return true;
+}
+
+bool JsonStreamReader::atEnd()
+{
+    skipWhitespace();
+    return _position == _end;
+}
+
+void JsonStreamReader::seek(const char* position)
+{
+    Q_ASSERT(position >= _begin && position <= _end);
+    _position = position;
+}
+
+bool JsonStreamReader::nextIsObject()
+{
+    skipWhitespace();
+    return _position != _end && *_position == '{';
+}
+
+bool JsonStreamReader::nextIsArray()
+{
+    skipWhitespace();
+    return _position != _end && *_position == '[';
+}
+
+bool JsonStreamReader::beginObject()
+{
+    if(!consume('{'))
+        return fail();
+
+    _expectComma = false;
+    return true;
+}
+
+bool JsonStreamReader::beginArray()
+{
+    if(!consume('['))
+        return fail();
+
+    _expectComma = false;
+    return true;
+}
+
+bool JsonStreamReader::nextKey(std::string& key)
+{
+    if(_failed)
+        return false;
+
+    if(consume('}'))
+    {
+        _expectComma = true;
+        return false;
+    }
+
+    if(_expectComma && !consume(','))
+        return fail();
+
+    if(!skipString(&key) || !consume(':'))
+        return fail();
+
+    _expectComma = true;
+    return true;
+}
+
+bool JsonStreamReader::nextElement()
+{
+    if(_failed)
+        return false;
+
+    if(consume(']'))
+    {
+        _expectComma = true;
+        return false;
+    }
+
+    if(_expectComma && !consume(','))
+        return fail();
+
+    _expectComma = true;
+    return true;
+}
+
+bool JsonStreamReader::skipValue()
+{
+    if(_failed)
+        return false;
+
+    skipWhitespace();
+
+    if(_position == _end)
+        return fail();
+
+    if(*_position == '"')
+        return skipString();
+
+    if(*_position != '{' && *_position != '[')
+        return skipLiteral();
+
+    // Objects and arrays; the structure within has no bearing on
+    // where the value ends, so all that matters is the nesting depth
+    size_t depth = 0;
+    bool inString = false;
+    bool escaped = false;
+
+    while(_position != _end)
+    {
+        auto c = *_position++;
+
+        if(inString)
+        {
+            if(escaped)
+                escaped = false;
+            else if(c == '\\')
+                escaped = true;
+            else if(c == '"')
+                inString = false;
+
+            continue;
+        }
+
+        switch(c)
+        {
+        case '"': inString = true; break;
+        case '{': case '[': depth++; break;
+        case '}': case ']':
+            if(--depth == 0)
+                return true;
+            break;
+        default: break;
+        }
+    }
+
+    return fail();
+}
+
+json JsonStreamReader::readValue()
+{
+    skipWhitespace();
+    const char* start = _position;
+
+    if(!skipValue())
+        return {};
+
+    auto value = json::parse(start, _position, nullptr, false);
+
+    if(value.is_discarded())
+    {
+        fail();
+        return {};
+    }
+
+    return value;
+}
@@ -0,0 +1,89 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include "json_helper.h"
+
+#include <string>
+#include <cstddef>
+
+// Walks a JSON document held in a contiguous buffer, without building a DOM
+// for the whole thing. Callers navigate the structure they are interested in,
+// skipping anything else, and only parse the (small) values they need into json
+// objects. In this way, the memory required to read a large document is bounded
+// by the size of the largest value parsed, rather than the size of the document.
+class JsonStreamReader
+{
+private:
+    const char* _begin = nullptr;
+    const char* _end = nullptr;
+    const char* _position = nullptr;
+
+    bool _failed = false;
+
+    // true when the next token within the current object or
+    // array must be preceded by a comma
+    bool _expectComma = false;
+
+    void skipWhitespace();
+    bool consume(char c);
+    bool skipString(std::string* value = nullptr);
+    bool skipLiteral();
+    bool fail();
+
+public:
+    JsonStreamReader(const char* begin, const char* end);
+
+    bool failed() const { return _failed; }
+    bool atEnd();
+
+    const char* position() const { return _position; }
+    size_t offset() const { return static_cast<size_t>(_position - _begin); }
+    size_t size() const { return static_cast<size_t>(_end - _begin); }
+
+    // Repositions the reader, such that a value that was previously
+    // skipped over can be revisited; the caller is responsible for ensuring
+    // the position is consistent with the current nesting state
+    void seek(const char* position);
+
+    bool nextIsObject();
+    bool nextIsArray();
+
+    // Consume the opening bracket of an object or array
+    bool beginObject();
+    bool beginArray();
+
+    // Advance to the next key of the current object, returning false (and
+    // consuming the closing brace) when there are no more; the reader is
+    // then positioned at the key's value
+    bool nextKey(std::string& key);
+
+    // Advance to the next element of the current array, returning false (and
+    // consuming the closing bracket) when there are no more
+    bool nextElement();
+
+    // Skip over the value at the current position
+    bool skipValue();
+
+    // Parse the value at the current position into a DOM
+    json readValue();
+};
+
+#endif // JSONSTREAMREADER_H
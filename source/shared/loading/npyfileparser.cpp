@@ -0,0 +1,347 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "npyfileparser.h"
+
+#include "shared/graph/igraphmodel.h"
+#include "shared/graph/imutablegraph.h"
+
+#include <QFile>
+#include <QUrl>
+#include <QRegularExpression>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+const char* const MAGIC = "\x93NUMPY";
+const size_t MAGIC_SIZE = 6;
+
+using ReadFn = double(*)(const char*);
+
+template<typename T>
+double readInteger(const char* p)
+{
+    if constexpr(sizeof(T) == 1)
+        return static_cast<double>(static_cast<T>(*p));
+    else
+        return static_cast<double>(qFromLittleEndian<T>(p));
+}
+
+double readFloat32(const char* p)
+{
+    auto bits = qFromLittleEndian<quint32>(p);
+    float value = 0.0f;
+    std::memcpy(&value, &bits, sizeof(value));
+    return static_cast<double>(value);
+}
+
+double readFloat64(const char* p)
+{
+    auto bits = qFromLittleEndian<quint64>(p);
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+ReadFn readFnFor(char kind, int size)
+{
+    switch(kind)
+    {
+    case 'f':
+        if(size == 4) return &readFloat32;
+        if(size == 8) return &readFloat64;
+        break;
+
+    case 'i':
+        if(size == 1) return &readInteger<qint8>;
+        if(size == 2) return &readInteger<qint16>;
+        if(size == 4) return &readInteger<qint32>;
+        if(size == 8) return &readInteger<qint64>;
+        break;
+
+    case 'u':
+        if(size == 1) return &readInteger<quint8>;
+        if(size == 2) return &readInteger<quint16>;
+        if(size == 4) return &readInteger<quint32>;
+        if(size == 8) return &readInteger<quint64>;
+        break;
+
+    case 'b':
+        if(size == 1) return &readInteger<quint8>;
+        break;
+
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+} // namespace
+
+NpyFileParser::NpyFileParser(UserNodeData* userNodeData, UserEdgeData* userEdgeData) :
+    _userNodeData(userNodeData), _userEdgeData(userEdgeData)
+{
+    // Add this up front, so that it appears first in the attribute table
+    userNodeData->add(QObject::tr("Node Name"));
+}
+
+bool NpyFileParser::parse(const QUrl& url, IGraphModel* graphModel)
+{
+    Q_ASSERT(graphModel != nullptr);
+    if(graphModel == nullptr)
+        return false;
+
+    QFile file(url.toLocalFile());
+
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    auto fileSize = static_cast<uint64_t>(file.size());
+
+    setProgress(-1);
+
+    const auto* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+
+    if(data == nullptr || fileSize < MAGIC_SIZE + 4 || std::memcmp(data, MAGIC, MAGIC_SIZE) != 0)
+    {
+        setFailureReason(QObject::tr("The file is not a NumPy array."));
+        return false;
+    }
+
+    uint64_t headerStart = 0;
+    uint64_t headerLength = 0;
+
+    auto majorVersion = static_cast<uchar>(data[6]);
+    if(majorVersion == 1)
+    {
+        headerStart = 10;
+        headerLength = qFromLittleEndian<quint16>(data + 8);
+    }
+    else if((majorVersion == 2 || majorVersion == 3) && fileSize >= 12)
+    {
+        headerStart = 12;
+        headerLength = qFromLittleEndian<quint32>(data + 8);
+    }
+    else
+    {
+        setFailureReason(QObject::tr("NumPy format version %1 is not supported.").arg(majorVersion));
+        return false;
+    }
+
+    if(headerStart + headerLength > fileSize)
+    {
+        setFailureReason(QObject::tr("The NumPy array is truncated."));
+        return false;
+    }
+
+    auto header = QString::fromLatin1(data + headerStart, static_cast<int>(headerLength));
+
+    auto descrMatch = QRegularExpression(QStringLiteral(
+        R"('descr'\s*:\s*'([<>|=])([a-zA-Z])(\d+)')")).match(header);
+    auto fortranOrderMatch = QRegularExpression(QStringLiteral(
+        R"('fortran_order'\s*:\s*(True|False))")).match(header);
+    auto shapeMatch = QRegularExpression(QStringLiteral(
+        R"('shape'\s*:\s*\(\s*(\d+)\s*,\s*(\d+)\s*,?\s*\))")).match(header);
+
+    if(!descrMatch.hasMatch() || !fortranOrderMatch.hasMatch() || !shapeMatch.hasMatch())
+    {
+        setFailureReason(QObject::tr("Only two dimensional NumPy arrays of numbers are supported."));
+        return false;
+    }
+
+    auto byteOrder = descrMatch.captured(1);
+    auto kind = descrMatch.captured(2).at(0).toLatin1();
+    auto itemSize = descrMatch.captured(3).toInt();
+    auto fortranOrder = fortranOrderMatch.captured(1) == QStringLiteral("True");
+    auto numRows = shapeMatch.captured(1).toULongLong();
+    auto numColumns = shapeMatch.captured(2).toULongLong();
+
+    auto read = readFnFor(kind, itemSize);
+
+    if(read == nullptr || (byteOrder == QStringLiteral(">") && itemSize > 1))
+    {
+        setFailureReason(QObject::tr("NumPy data type %1 is not supported.")
+            .arg(descrMatch.captured(0)));
+        return false;
+    }
+
+    // A 2x2 or 3x3 array is far more likely to be a short list of edges than a matrix
+    const bool isCoordinateList = numColumns == 2 || numColumns == 3;
+    const bool isMatrix = !isCoordinateList && numRows == numColumns;
+
+    if(!isMatrix && !isCoordinateList)
+    {
+        setFailureReason(QObject::tr("A NumPy array of shape (%1, %2) is neither a square "
+            "adjacency matrix, nor a list of edges.").arg(numRows).arg(numColumns));
+        return false;
+    }
+
+    const auto maxElements = static_cast<uint64_t>(std::numeric_limits<int>::max());
+    const uint64_t dataOffset = headerStart + headerLength;
+
+    if(numRows > maxElements || numColumns > maxElements ||
+        (numRows * numColumns) > (fileSize - dataOffset) / itemSize)
+    {
+        setFailureReason(QObject::tr("The NumPy array is truncated."));
+        return false;
+    }
+
+    auto valueAt = [&](uint64_t row, uint64_t column)
+    {
+        auto index = fortranOrder ? (column * numRows) + row : (row * numColumns) + column;
+        return read(data + dataOffset + (index * itemSize));
+    };
+
+    int percent = -1;
+    auto updateProgress = [this, &percent](uint64_t position, uint64_t total)
+    {
+        auto newPercent = static_cast<int>((position * 100) / total);
+        if(newPercent != percent)
+        {
+            percent = newPercent;
+            setProgress(percent);
+        }
+    };
+
+    uint64_t numNodes = 0;
+    uint64_t numEdges = 0;
+
+    // Size everything up front, so that the graph can be allocated in one go
+    graphModel->mutableGraph().setPhase(QObject::tr("Scanning"));
+    for(uint64_t row = 0; row < numRows; row++)
+    {
+        if(cancelled())
+            return false;
+
+        if(isMatrix)
+        {
+            for(uint64_t column = 0; column < numColumns; column++)
+            {
+                auto value = valueAt(row, column);
+                if(value != 0.0 && !std::isnan(value))
+                    numEdges++;
+            }
+        }
+        else
+        {
+            for(uint64_t column = 0; column < 2; column++)
+            {
+                auto index = valueAt(row, column);
+                if(index < 0.0 || index >= static_cast<double>(maxElements) || index != std::floor(index))
+                {
+                    setFailureReason(QObject::tr("Row %1 has an invalid node index.").arg(row));
+                    return false;
+                }
+
+                numNodes = std::max(numNodes, static_cast<uint64_t>(index) + 1);
+            }
+        }
+
+        updateProgress(row, numRows);
+    }
+
+    if(isMatrix)
+        numNodes = numRows;
+    else
+        numEdges = numRows;
+
+    if(numEdges > maxElements)
+    {
+        setFailureReason(QObject::tr("The NumPy array has too many edges."));
+        return false;
+    }
+
+    auto& graph = graphModel->mutableGraph();
+    graph.reserve(static_cast<int>(numNodes), static_cast<int>(numEdges));
+
+    graph.setPhase(QObject::tr("Nodes"));
+    std::vector<NodeId> nodeIds;
+    nodeIds.reserve(numNodes);
+
+    for(uint64_t index = 0; index < numNodes; index++)
+    {
+        auto nodeId = graph.addNode();
+        nodeIds.push_back(nodeId);
+
+        auto nodeName = QObject::tr("Node %1").arg(index + 1);
+        _userNodeData->setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
+        graphModel->setNodeName(nodeId, nodeName);
+    }
+
+    auto addEdge = [&](NodeId sourceNodeId, NodeId targetNodeId, double weight)
+    {
+        auto edgeId = graph.addEdge(sourceNodeId, targetNodeId);
+
+        _userEdgeData->setValueBy(edgeId, QObject::tr("Edge Weight"), QString::number(weight));
+        _userEdgeData->setValueBy(edgeId, QObject::tr("Absolute Edge Weight"),
+            QString::number(std::abs(weight)));
+    };
+
+    graph.setPhase(QObject::tr("Edges"));
+    percent = -1;
+
+    for(uint64_t row = 0; row < numRows; row++)
+    {
+        if(cancelled())
+            return false;
+
+        if(isMatrix)
+        {
+            for(uint64_t column = 0; column < numColumns; column++)
+            {
+                auto value = valueAt(row, column);
+                if(value == 0.0 || std::isnan(value))
+                    continue;
+
+                // Columns are sources, rows are targets, as for tabular adjacency matrices
+                addEdge(nodeIds.at(column), nodeIds.at(row), value);
+            }
+        }
+        else
+        {
+            auto source = static_cast<uint64_t>(valueAt(row, 0));
+            auto target = static_cast<uint64_t>(valueAt(row, 1));
+            auto weight = numColumns == 3 ? valueAt(row, 2) : 1.0;
+
+            addEdge(nodeIds.at(source), nodeIds.at(target), weight);
+        }
+
+        updateProgress(row, numRows);
+    }
+
+    setProgress(-1);
+
+    return true;
+}
+
+bool NpyFileParser::canLoad(const QUrl& url)
+{
+    QFile file(url.toLocalFile());
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return file.read(MAGIC_SIZE) == QByteArray(MAGIC, MAGIC_SIZE);
+}
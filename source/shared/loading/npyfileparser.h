@@ -0,0 +1,44 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPYFILEPARSER_H
+#define NPYFILEPARSER_H
+
+#include "shared/loading/iparser.h"
+#include "shared/loading/userelementdata.h"
+
+// Loads a two dimensional NumPy array (https://numpy.org/neps/nep-0001-npy-format.html).
+// An array of 2 or 3 columns is treated as a coordinate list of source, target and
+// optional weight, i.e. a sparse matrix; this includes 2x2 and 3x3 arrays. Any other
+// square array is treated as a dense adjacency matrix, where each non-zero value is
+// an edge.
+
+class NpyFileParser : public IParser
+{
+private:
+    UserNodeData* _userNodeData;
+    UserEdgeData* _userEdgeData;
+
+public:
+    NpyFileParser(UserNodeData* userNodeData, UserEdgeData* userEdgeData);
+
+    bool parse(const QUrl& url, IGraphModel* graphModel) override;
+    static bool canLoad(const QUrl& url);
+};
+
+#endif // NPYFILEPARSER_H
@@ -39,6 +39,79 @@
 #include <iostream>
 #include <fstream>
 #include <cctype>
+#include <algorithm>
+
+namespace
+{
+struct AsciiDecoder
+{
+    template<typename It> static uint32_t next(It& it, It) { return static_cast<unsigned char>(*it++); }
+    template<typename It> static uint32_t peekNext(It it, It) { return static_cast<unsigned char>(*it); }
+    template<typename It> static void advance(It& it, It) { ++it; }
+    static void append(uint32_t codePoint, std::string& s) { s.push_back(static_cast<char>(codePoint)); }
+};
+
+struct Utf8Decoder
+{
+    template<typename It> static uint32_t next(It& it, It end) { return utf8::next(it, end); }
+    template<typename It> static uint32_t peekNext(It it, It end) { return utf8::peek_next(it, end); }
+    template<typename It> static void advance(It& it, It end) { utf8::advance(it, 1, end); }
+    static void append(uint32_t codePoint, std::string& s) { utf8::unchecked::append(codePoint, std::back_inserter(s)); }
+};
+
+// Returns true if the line is a comment
+template<typename Decoder, typename It>
+bool tokenise(It it, It end, std::vector<std::string>& tokens)
+{
+    std::string token;
+    bool inQuotes = false;
+    bool isComment = false;
+
+    while(it < end)
+    {
+        uint32_t codePoint = Decoder::next(it, end);
+
+        if(it < end && it < (end - 1) &&
+           codePoint == '/' && Decoder::peekNext(it, end) == '/')
+        {
+            isComment = true;
+
+            // Skip the second /
+            Decoder::advance(it, end);
+            codePoint = Decoder::next(it, end);
+        }
+
+        if(codePoint == '"')
+        {
+            if(inQuotes)
+            {
+                tokens.emplace_back(std::move(token));
+                token.clear();
+            }
+
+            inQuotes = !inQuotes;
+        }
+        else
+        {
+            bool space = (codePoint < 0xFF) && (std::isspace(codePoint) != 0);
+            bool trailingSpace = space && !token.empty();
+
+            if(trailingSpace && !inQuotes)
+            {
+                tokens.emplace_back(std::move(token));
+                token.clear();
+            }
+            else if(!space || inQuotes)
+                Decoder::append(codePoint, token);
+        }
+    }
+
+    if(!token.empty())
+        tokens.emplace_back(std::move(token));
+
+    return isComment;
+}
+} // namespace
 
 PairwiseTxtFileParser::PairwiseTxtFileParser(UserNodeData* userNodeData, UserEdgeData* userEdgeData) :
     _userNodeData(userNodeData), _userEdgeData(userEdgeData)
@@ -62,7 +135,6 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
     std::unordered_map<std::string, NodeId> nodeIdMap;
 
     std::string line;
-    std::string token;
     std::vector<std::string> tokens;
 
     setProgress(-1);
@@ -75,56 +147,19 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
         tokens.clear();
 
-        bool inQuotes = false;
         bool isComment = false;
 
-        std::string validatedLine;
-        utf8::replace_invalid(line.begin(), line.end(), std::back_inserter(validatedLine));
-        auto it = validatedLine.begin();
-        auto end = validatedLine.end();
-        while(it < end)
-        {
-            uint32_t codePoint = utf8::next(it, end);
-
-            if(it < end && it < (end - 1) &&
-               codePoint == '/' && utf8::peek_next(it, end) == '/')
-            {
-                isComment = true;
-
-                // Skip the second /
-                utf8::advance(it, 1, end);
-                codePoint = utf8::next(it, end);
-            }
-
-            if(codePoint == '"')
-            {
-                if(inQuotes)
-                {
-                    tokens.emplace_back(std::move(token));
-                    token.clear();
-                }
-
-                inQuotes = !inQuotes;
-            }
-            else
-            {
-                bool space = (codePoint < 0xFF) && (std::isspace(codePoint) != 0);
-                bool trailingSpace = space && !token.empty();
-
-                if(trailingSpace && !inQuotes)
-                {
-                    tokens.emplace_back(std::move(token));
-                    token.clear();
-                }
-                else if(!space || inQuotes)
-                    utf8::unchecked::append(codePoint, std::back_inserter(token));
-            }
-        }
+        // Most files are plain ASCII, in which case decoding UTF-8 is unnecessary
+        bool isAscii = std::all_of(line.begin(), line.end(),
+            [](char c) { return (static_cast<unsigned char>(c) & 0x80) == 0; });
 
-        if(!token.empty())
+        if(isAscii)
+            isComment = tokenise<AsciiDecoder>(line.begin(), line.end(), tokens);
+        else
         {
-            tokens.emplace_back(std::move(token));
-            token.clear();
+            std::string validatedLine;
+            utf8::replace_invalid(line.begin(), line.end(), std::back_inserter(validatedLine));
+            isComment = tokenise<Utf8Decoder>(validatedLine.begin(), validatedLine.end(), tokens);
         }
 
         if(isComment)
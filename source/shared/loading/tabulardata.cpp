@@ -19,16 +19,26 @@
 #include "tabulardata.h"
 
 #include "shared/utils/progressable.h"
+#include "shared/utils/threadpool.h"
+
+#include <QLocale>
 
 #include <set>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
 
 TabularData::TabularData(TabularData&& other) noexcept :
     _data(std::move(other._data)),
     _columns(other._columns),
     _rows(other._rows),
-    _transposed(other._transposed)
-
+    _transposed(other._transposed),
+    _numericValues(std::move(other._numericValues)),
+    _hasNumericCells(other._hasNumericCells),
+    _numericValuesCached(other._numericValuesCached),
+    _columnTypeIdentities(std::move(other._columnTypeIdentities))
 {
     other.reset();
 }
@@ -41,6 +51,10 @@ TabularData& TabularData::operator=(TabularData&& other) noexcept
         _columns = other._columns;
         _rows = other._rows;
         _transposed = other._transposed;
+        _numericValues = std::move(other._numericValues);
+        _hasNumericCells = other._hasNumericCells;
+        _numericValuesCached = other._numericValuesCached;
+        _columnTypeIdentities = std::move(other._columnTypeIdentities);
 
         other.reset();
     }
@@ -51,6 +65,9 @@ TabularData& TabularData::operator=(TabularData&& other) noexcept
 void TabularData::reserve(size_t columns, size_t rows)
 {
     _data.reserve(columns * rows);
+
+    if(_hasNumericCells)
+        _numericValues.reserve(columns * rows);
 }
 
 bool TabularData::empty() const
@@ -80,8 +97,66 @@ size_t TabularData::numRows() const
     return !_transposed ? _rows : _columns;
 }
 
-void TabularData::setValueAt(size_t column, size_t row, QString&& value, int progressHint)
+bool TabularData::isNumericCell(size_t index) const
+{
+    return _hasNumericCells && _data[index].isNull();
+}
+
+void TabularData::invalidateCache()
+{
+    // When there are numeric cells, _numericValues is their storage and must be retained
+    if(!_hasNumericCells && !_numericValues.empty())
+        _numericValues.clear();
+
+    _numericValuesCached = false;
+
+    if(!_columnTypeIdentities.empty())
+        _columnTypeIdentities.clear();
+}
+
+void TabularData::setTransposed(bool transposed)
+{
+    // The numeric values are indexed by storage order, so remain valid
+    if(_transposed != transposed)
+        _columnTypeIdentities.clear();
+
+    _transposed = transposed;
+}
+
+template<typename T>
+static void relayoutRows(std::vector<T>& values, size_t oldColumns, size_t columns,
+    size_t rows, size_t newSize, const T& emptyValue)
+{
+    values.resize(newSize, emptyValue);
+
+    for(size_t offset = rows - 1; offset > 0; offset--)
+    {
+        auto oldPosition = values.begin() + (offset * oldColumns);
+        auto newPosition = values.begin() + (offset * columns);
+
+        std::move_backward(oldPosition,
+            oldPosition + oldColumns,
+            newPosition + oldColumns);
+    }
+
+    // Clear the new cells at the end of each existing row
+    for(size_t offset = 0; offset < rows; offset++)
+    {
+        auto position = values.begin() + (offset * columns);
+        std::fill(position + oldColumns, position + columns, emptyValue);
+    }
+}
+
+size_t TabularData::resizeFor(size_t column, size_t row, int progressHint)
 {
+    invalidateCache();
+
+    const auto NaN = std::numeric_limits<double>::quiet_NaN();
+
+    // Covers the case where the first numeric cell is set after some string cells
+    if(_hasNumericCells && _numericValues.size() < _data.size())
+        _numericValues.resize(_data.size(), NaN);
+
     size_t columns = column >= _columns ? column + 1 : _columns;
     size_t rows = row >= _rows ? row + 1 : _rows;
     auto newSize = columns * rows;
@@ -90,17 +165,10 @@ void TabularData::setValueAt(size_t column, size_t row, QString&& value, int pro
     // taking into account the new row width
     if(_rows > 0 && rows > 1 && columns > _columns)
     {
-        _data.resize(newSize);
-
-        for(size_t offset = _rows - 1; offset > 0; offset--)
-        {
-            auto oldPosition = _data.begin() + (offset * _columns);
-            auto newPosition = _data.begin() + (offset * columns);
+        relayoutRows(_data, _columns, columns, _rows, newSize, QString());
 
-            std::move_backward(oldPosition,
-                oldPosition + _columns,
-                newPosition + _columns);
-        }
+        if(_hasNumericCells)
+            relayoutRows(_numericValues, _columns, columns, _rows, newSize, NaN);
     }
 
     _columns = columns;
@@ -133,7 +201,35 @@ void TabularData::setValueAt(size_t column, size_t row, QString&& value, int pro
     }
 
     _data.resize(newSize);
-    _data.at(index(column, row)) = value.trimmed();
+
+    if(_hasNumericCells)
+    {
+        if(_numericValues.capacity() < _data.capacity())
+            _numericValues.reserve(_data.capacity());
+
+        _numericValues.resize(newSize, NaN);
+    }
+
+    return index(column, row);
+}
+
+void TabularData::setValueAt(size_t column, size_t row, QString&& value, int progressHint)
+{
+    auto i = resizeFor(column, row, progressHint);
+
+    _data.at(i) = value.trimmed();
+
+    if(_hasNumericCells)
+        _numericValues.at(i) = std::numeric_limits<double>::quiet_NaN();
+}
+
+void TabularData::setNumericValueAt(size_t column, size_t row, double value, int progressHint)
+{
+    _hasNumericCells = true;
+    auto i = resizeFor(column, row, progressHint);
+
+    _data.at(i) = QString();
+    _numericValues.at(i) = value;
 }
 
 void TabularData::shrinkToFit()
@@ -141,7 +237,7 @@ void TabularData::shrinkToFit()
     auto lastRowIsEmpty = [this]
     {
         size_t column = 0;
-        while(column < _columns && valueAt(column, _rows - 1).isEmpty())
+        while(column < _columns && isEmptyAt(column, _rows - 1))
             column++;
 
         return column >= _columns;
@@ -151,10 +247,19 @@ void TabularData::shrinkToFit()
     while(_rows > 0 && lastRowIsEmpty())
     {
         _data.resize(_data.size() - _columns);
+
+        if(_hasNumericCells)
+            _numericValues.resize(_data.size(), std::numeric_limits<double>::quiet_NaN());
+
         _rows--;
+
+        invalidateCache();
     }
 
     _data.shrink_to_fit();
+
+    if(_hasNumericCells)
+        _numericValues.shrink_to_fit();
 }
 
 void TabularData::reset()
@@ -163,42 +268,128 @@ void TabularData::reset()
     _columns = 0;
     _rows = 0;
     _transposed = false;
+    _hasNumericCells = false;
+
+    invalidateCache();
 }
 
 TypeIdentity TabularData::typeIdentity(size_t columnIndex) const
 {
+    if(_columnTypeIdentities.size() == numColumns())
+        return _columnTypeIdentities.at(columnIndex);
+
     TypeIdentity identity;
 
     for(size_t rowIndex = 1; rowIndex < numRows(); rowIndex++)
     {
-        const auto& value = valueAt(columnIndex, rowIndex);
-        identity.updateType(value);
+        auto i = index(columnIndex, rowIndex);
+
+        if(isNumericCell(i))
+            identity.updateType(_numericValues[i]);
+        else
+            identity.updateType(_data[i]);
     }
 
     return identity;
 }
 
-const QString& TabularData::valueAt(size_t column, size_t row) const
+QString TabularData::valueAt(size_t column, size_t row) const
+{
+    auto i = index(column, row);
+
+    if(isNumericCell(i))
+    {
+        auto value = _numericValues.at(i);
+
+        if(std::isnan(value))
+            return {};
+
+        return QString::number(value, 'g', QLocale::FloatingPointShortest);
+    }
+
+    return _data.at(i);
+}
+
+bool TabularData::isEmptyAt(size_t column, size_t row) const
+{
+    auto i = index(column, row);
+
+    if(isNumericCell(i))
+        return std::isnan(_numericValues[i]);
+
+    return _data.at(i).isEmpty();
+}
+
+double TabularData::numericValueAt(size_t column, size_t row) const
 {
-    return _data.at(index(column, row));
+    auto i = index(column, row);
+
+    if(_numericValuesCached || isNumericCell(i))
+        return _numericValues[i];
+
+    return u::toNumber(_data.at(i));
+}
+
+bool TabularData::isNumericAt(size_t column, size_t row) const
+{
+    return !std::isnan(numericValueAt(column, row));
 }
 
 std::vector<TypeIdentity> TabularData::typeIdentities(Progressable* progressable) const
 {
-    std::vector<TypeIdentity> t;
+    if(!empty() && _columnTypeIdentities.size() == numColumns())
+        return _columnTypeIdentities;
 
-    t.resize(numColumns());
+    std::vector<TypeIdentity> t(numColumns());
 
     if(progressable != nullptr)
         progressable->setProgress(-1);
 
-    for(size_t columnIndex = 0; columnIndex < numColumns(); columnIndex++)
+    if(numColumns() == 0)
+        return t;
+
+    _numericValues.resize(_data.size(), std::numeric_limits<double>::quiet_NaN());
+
+    std::vector<size_t> columnIndices(numColumns());
+    std::iota(columnIndices.begin(), columnIndices.end(), 0);
+    std::atomic<size_t> numColumnsTyped(0);
+
+    concurrent_for(columnIndices.begin(), columnIndices.end(),
+    [&](size_t columnIndex)
     {
+        auto& identity = t.at(columnIndex);
+
+        // Columns are disjoint, so each thread writes to its own set of _numericValues
+        for(size_t rowIndex = 0; rowIndex < numRows(); rowIndex++)
+        {
+            auto i = index(columnIndex, rowIndex);
+
+            if(isNumericCell(i))
+            {
+                if(rowIndex > 0)
+                    identity.updateType(_numericValues[i]);
+
+                continue;
+            }
+
+            const auto& value = _data[i];
+
+            // The first row is a header, so isn't considered for the type
+            if(rowIndex == 0)
+                _numericValues[i] = u::toNumber(value);
+            else
+                identity.updateType(value, _numericValues[i]);
+        }
+
         if(progressable != nullptr)
-            progressable->setProgress(static_cast<int>((columnIndex * 100) / numColumns()));
+        {
+            progressable->setProgress(static_cast<int>(
+                (++numColumnsTyped * 100) / numColumns()));
+        }
+    });
 
-        t.at(columnIndex) = typeIdentity(columnIndex);
-    }
+    _columnTypeIdentities = t;
+    _numericValuesCached = true;
 
     if(progressable != nullptr)
         progressable->setProgress(-1);
@@ -49,7 +49,18 @@ private:
     size_t _rows = 0;
     bool _transposed = false;
 
+    // Indexed in the same way as _data; cells set using setNumericValueAt are stored here,
+    // with a null QString in their place in _data, and typeIdentities() additionally
+    // caches the parsed values of the remaining cells
+    mutable std::vector<double> _numericValues;
+    bool _hasNumericCells = false;
+    mutable bool _numericValuesCached = false;
+    mutable std::vector<TypeIdentity> _columnTypeIdentities;
+
     size_t index(size_t column, size_t row) const;
+    bool isNumericCell(size_t index) const;
+    void invalidateCache();
+    size_t resizeFor(size_t column, size_t row, int progressHint);
 
 public:
     TabularData() = default;
@@ -66,15 +77,27 @@ public:
     size_t numColumns() const;
     size_t numRows() const;
     bool transposed() const { return _transposed; }
-    const QString& valueAt(size_t column, size_t row) const;
+    QString valueAt(size_t column, size_t row) const;
+    bool isEmptyAt(size_t column, size_t row) const;
+
+    // NaN if the value is empty or not a number
+    double numericValueAt(size_t column, size_t row) const;
+    bool isNumericAt(size_t column, size_t row) const;
 
-    void setTransposed(bool transposed) { _transposed = transposed; }
+    void setTransposed(bool transposed);
     void setValueAt(size_t column, size_t row, QString&& value, int progressHint = -1);
 
+    // Stores the value without retaining a string representation of it
+    void setNumericValueAt(size_t column, size_t row, double value, int progressHint = -1);
+
     void shrinkToFit();
     void reset();
 
     TypeIdentity typeIdentity(size_t columnIndex) const;
+
+    // Determines the types of all the columns in parallel, caching the results along with
+    // the parsed numeric values, which numericValueAt then returns without re-parsing;
+    // this is not thread safe with respect to concurrent access to the TabularData
     std::vector<TypeIdentity> typeIdentities(Progressable* progressable = nullptr) const;
 
     int columnMatchPercentage(size_t columnIndex, const QStringList& referenceValues) const;
@@ -18,6 +18,8 @@
 
 #include "xlsxtabulardataparser.h"
 
+#include "shared/utils/string.h"
+
 #include <xlsxio/include/xlsxio_read.h>
 
 XlsxTabularDataParser::XlsxTabularDataParser(IParser* parent)
@@ -26,6 +28,58 @@ XlsxTabularDataParser::XlsxTabularDataParser(IParser* parent)
         setProgressFn([parent](int percent) { parent->setProgress(percent); });
 }
 
+// Whether string is a number written in the plain decimal form XLSX uses for numeric cells,
+// i.e. an optional '-', digits with an optional fraction, then an optional exponent; a
+// redundant leading zero (e.g. "007") suggests text, such as an identifier, so it's excluded
+static bool isPlainDecimal(const QString& string)
+{
+    const auto* it = string.constData();
+    const auto* end = it + string.size();
+
+    auto isDigit = [](QChar c) { return c.unicode() >= '0' && c.unicode() <= '9'; };
+
+    auto skipDigits = [&]
+    {
+        const auto* start = it;
+        while(it != end && isDigit(*it))
+            ++it;
+
+        return it - start;
+    };
+
+    if(it != end && *it == QLatin1Char('-'))
+        ++it;
+
+    const auto* integerStart = it;
+    auto numIntegerDigits = skipDigits();
+
+    if(numIntegerDigits > 1 && *integerStart == QLatin1Char('0'))
+        return false;
+
+    decltype(numIntegerDigits) numFractionDigits = 0;
+    if(it != end && *it == QLatin1Char('.'))
+    {
+        ++it;
+        numFractionDigits = skipDigits();
+    }
+
+    if(numIntegerDigits == 0 && numFractionDigits == 0)
+        return false;
+
+    if(it != end && (*it == QLatin1Char('e') || *it == QLatin1Char('E')))
+    {
+        ++it;
+
+        if(it != end && (*it == QLatin1Char('-') || *it == QLatin1Char('+')))
+            ++it;
+
+        if(skipDigits() == 0)
+            return false;
+    }
+
+    return it == end;
+}
+
 static int cellCallback(size_t row, size_t column, const XLSXIOCHAR* value, void* cbData)
 {
     if(value == nullptr)
@@ -33,20 +87,39 @@ static int cellCallback(size_t row, size_t column, const XLSXIOCHAR* value, void
 
     auto* xlsxTabularDataParser = reinterpret_cast<XlsxTabularDataParser*>(cbData);
 
-    auto rowLimit = xlsxTabularDataParser->rowLimit();
-
-    if(rowLimit > 0 && (row - 1) > rowLimit)
-        return 1;
-
     if(xlsxTabularDataParser->cancelled())
         return 1;
 
     // XLSXIO is some kind of deviant library that indexes from 1
-    xlsxTabularDataParser->tabularData().setValueAt(column - 1, row - 1, value);
+    column--;
+    row--;
+
+    auto& tabularData = xlsxTabularDataParser->tabularData();
+    auto string = QString::fromUtf8(value);
+    double numericValue = 0.0;
+
+    // Numeric cells are stored as such, rather than retaining their string form; XLSXIO
+    // doesn't tell us the type of the cell, so only plain decimals are treated as numbers
+    if(row > 0 && isPlainDecimal(string) && u::parseNumber(string, numericValue))
+        tabularData.setNumericValueAt(column, row, numericValue);
+    else
+        tabularData.setValueAt(column, row, std::move(string));
 
     return 0;
 }
 
+static int rowCallback(size_t row, size_t, void* cbData)
+{
+    auto* xlsxTabularDataParser = reinterpret_cast<XlsxTabularDataParser*>(cbData);
+
+    // Stop reading as soon as we have the header plus rowLimit rows
+    auto rowLimit = xlsxTabularDataParser->rowLimit();
+    if(rowLimit > 0 && row > rowLimit)
+        return 1;
+
+    return xlsxTabularDataParser->cancelled() ? 1 : 0;
+}
+
 bool XlsxTabularDataParser::parse(const QUrl& url, IGraphModel* graphModel)
 {
     if(graphModel != nullptr)
@@ -59,7 +132,7 @@ bool XlsxTabularDataParser::parse(const QUrl& url, IGraphModel* graphModel)
         return false;
 
     xlsxioread_process(xlsxioread, nullptr, XLSXIOREAD_SKIP_NONE,
-        cellCallback, nullptr, this);
+        cellCallback, rowCallback, this);
     xlsxioread_close(xlsxioread);
 
     // Free up any over-allocation
@@ -25,6 +25,8 @@
 #include "shared/loading/graphmlparser.h"
 #include "shared/loading/adjacencymatrixfileparser.h"
 #include "shared/loading/jsongraphparser.h"
+#include "shared/loading/binaryedgelistfileparser.h"
+#include "shared/loading/npyfileparser.h"
 
 #include "shared/attributes/iattribute.h"
 
@@ -104,6 +106,12 @@ std::unique_ptr<IParser> BaseGenericPluginInstance::parserForUrlTypeName(const Q
     if(urlTypeName == QStringLiteral("JSONGraph"))
         return std::make_unique<JsonGraphParser>(&_userNodeData, &_userEdgeData);
 
+    if(urlTypeName == QStringLiteral("BinaryEdgeList"))
+        return std::make_unique<BinaryEdgeListFileParser>(&_userNodeData, &_userEdgeData);
+
+    if(urlTypeName == QStringLiteral("NumPy"))
+        return std::make_unique<NpyFileParser>(&_userNodeData, &_userEdgeData);
+
     return nullptr;
 }
 
@@ -237,6 +245,8 @@ BaseGenericPlugin::BaseGenericPlugin()
     registerUrlType(QStringLiteral("BiopaxOWL"), QObject::tr("Biopax OWL File"), QObject::tr("Biopax OWL Files"), {"owl"});
     registerUrlType(QStringLiteral("MatrixMatLab"), QObject::tr("Matlab Data File"), QObject::tr("Matlab Data Files"), {"mat"});
     registerUrlType(QStringLiteral("JSONGraph"), QObject::tr("JSON Graph File"), QObject::tr("JSON Graph Files"), {"json"});
+    registerUrlType(QStringLiteral("BinaryEdgeList"), QObject::tr("Binary Edge List File"), QObject::tr("Binary Edge List Files"), {"bel"});
+    registerUrlType(QStringLiteral("NumPy"), QObject::tr("NumPy Array File"), QObject::tr("NumPy Array Files"), {"npy"});
 }
 
 QStringList BaseGenericPlugin::identifyUrl(const QUrl& url) const
@@ -261,7 +271,9 @@ QStringList BaseGenericPlugin::identifyUrl(const QUrl& url) const
             (urlType == QStringLiteral("MatrixXLSX") && AdjacencyMatrixXLSXFileParser::canLoad(url)) ||
             (urlType == QStringLiteral("MatrixMatLab") && AdjacencyMatrixMatLabFileParser::canLoad(url)) ||
             (urlType == QStringLiteral("BiopaxOWL") && BiopaxFileParser::canLoad(url)) ||
-            (urlType == QStringLiteral("JSONGraph") && JsonGraphParser::canLoad(url));
+            (urlType == QStringLiteral("JSONGraph") && JsonGraphParser::canLoad(url)) ||
+            (urlType == QStringLiteral("BinaryEdgeList") && BinaryEdgeListFileParser::canLoad(url)) ||
+            (urlType == QStringLiteral("NumPy") && NpyFileParser::canLoad(url));
 
         if(canLoad)
             result.push_back(urlType);
@@ -27,7 +27,7 @@ class ISelectionManager
 public:
     virtual ~ISelectionManager() = default;
 
-    virtual NodeIdSet selectedNodes() const = 0;
+    virtual const NodeIdSet& selectedNodes() const = 0;
     virtual NodeIdSet unselectedNodes() const = 0;
 
     virtual bool selectNode(NodeId nodeId) = 0;
@@ -0,0 +1,56 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUNCTION_REF_H
+#define FUNCTION_REF_H
+
+#include <type_traits>
+#include <utility>
+#include <memory>
+
+// A non-owning reference to a callable; unlike std::function it never allocates,
+// so it is suitable for passing visitors across virtual interfaces in hot loops.
+// The referenced callable must outlive the function_ref.
+template<typename Fn> class function_ref;
+
+template<typename R, typename... Args> class function_ref<R(Args...)>
+{
+private:
+    void* _callable = nullptr;
+    R (*_invoke)(void*, Args...) = nullptr;
+
+public:
+    template<typename F, typename = std::enable_if_t<
+        !std::is_same_v<std::decay_t<F>, function_ref> &&
+        std::is_invocable_r_v<R, F&, Args...>>>
+    function_ref(F&& f) noexcept : // NOLINT google-explicit-constructor
+        _callable(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+        _invoke([](void* callable, Args... args) -> R
+        {
+            return (*static_cast<std::remove_reference_t<F>*>(callable))(
+                std::forward<Args>(args)...);
+        })
+    {}
+
+    R operator()(Args... args) const
+    {
+        return _invoke(_callable, std::forward<Args>(args)...);
+    }
+};
+
+#endif // FUNCTION_REF_H
@@ -22,8 +22,10 @@
 #include <QRegularExpression>
 #include <QLocale>
 
+#include <array>
 #include <vector>
 #include <cmath>
+#include <cstdint>
 #include <sstream>
 #include <limits>
 
@@ -43,12 +45,8 @@ bool u::isNumeric(const std::string& string)
 
 bool u::isNumeric(const QString& string)
 {
-    bool success = false;
-
-    // cppcheck-suppress ignoredReturnValue
-    string.toDouble(&success);
-
-    return success;
+    double value = 0.0;
+    return u::parseNumber(string, value);
 }
 
 bool u::isInteger(const std::string& string)
@@ -67,12 +65,11 @@ bool u::isInteger(const std::string& string)
 
 bool u::isInteger(const QString& string)
 {
-    bool success = false;
-
-    // cppcheck-suppress ignoredReturnValue
-    string.toInt(&success);
+    double value = 0.0;
+    bool isInteger = false;
+    u::parseNumber(string, value, &isInteger);
 
-    return success;
+    return isInteger;
 }
 
 double u::toNumber(const std::string& string)
@@ -94,15 +91,155 @@ double u::toNumber(const std::string& string)
 
 double u::toNumber(const QString& string)
 {
-    bool success = false;
-    auto value = string.toDouble(&success);
+    double value = 0.0;
 
-    if(success)
+    if(u::parseNumber(string, value))
         return value;
 
     return std::numeric_limits<double>::quiet_NaN();
 }
 
+bool u::parseNumber(const QString& string, double& value, bool* isInteger)
+{
+    auto slowParse = [&]
+    {
+        bool success = false;
+        value = string.toDouble(&success);
+
+        if(isInteger != nullptr)
+        {
+            bool intSuccess = false;
+
+            // cppcheck-suppress ignoredReturnValue
+            string.toInt(&intSuccess);
+            *isInteger = intSuccess;
+        }
+
+        return success;
+    };
+
+    if(isInteger != nullptr)
+        *isInteger = false;
+
+    const auto* it = string.constData();
+    const auto* end = it + string.size();
+
+    if(it == end)
+        return false;
+
+    auto isDigit = [](QChar c) { return c.unicode() >= '0' && c.unicode() <= '9'; };
+
+    // Anything that QString::toDouble might accept must start with one of these,
+    // so we can reject the majority of non-numeric strings without further ado
+    auto first = it->unicode();
+    if(!isDigit(*it) && first != '-' && first != '+' && first != '.' &&
+        first != 'i' && first != 'I' && first != 'n' && first != 'N' &&
+        !it->isSpace())
+    {
+        return false;
+    }
+
+    bool negative = false;
+    if(first == '-' || first == '+')
+    {
+        negative = (first == '-');
+        ++it;
+    }
+
+    const uint64_t maxMantissa = (std::numeric_limits<uint64_t>::max() - 9) / 10;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool integral = true;
+
+    for(; it != end && isDigit(*it); ++it)
+    {
+        if(mantissa > maxMantissa)
+            return slowParse();
+
+        mantissa = (mantissa * 10) + (it->unicode() - '0');
+        hasDigits = true;
+    }
+
+    if(it != end && it->unicode() == '.')
+    {
+        integral = false;
+
+        for(++it; it != end && isDigit(*it); ++it)
+        {
+            if(mantissa > maxMantissa)
+                return slowParse();
+
+            mantissa = (mantissa * 10) + (it->unicode() - '0');
+            exponent--;
+            hasDigits = true;
+        }
+    }
+
+    if(hasDigits && it != end && (it->unicode() == 'e' || it->unicode() == 'E'))
+    {
+        integral = false;
+        ++it;
+
+        bool negativeExponent = false;
+        if(it != end && (it->unicode() == '-' || it->unicode() == '+'))
+        {
+            negativeExponent = (it->unicode() == '-');
+            ++it;
+        }
+
+        if(it == end || !isDigit(*it))
+            return slowParse();
+
+        int explicitExponent = 0;
+        for(; it != end && isDigit(*it); ++it)
+        {
+            if(explicitExponent > 9999)
+                return slowParse();
+
+            explicitExponent = (explicitExponent * 10) + (it->unicode() - '0');
+        }
+
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    // Trailing garbage, whitespace, inf, nan, etc.
+    if(!hasDigits || it != end)
+        return slowParse();
+
+    // Powers of 10 up to 22 and integers up to 2^53 are exactly representable,
+    // so in that range a single multiply or divide is correctly rounded
+    const uint64_t maxExactMantissa = uint64_t(1) << 53;
+    const int maxExactExponent = 22;
+    static const std::array<double, maxExactExponent + 1> powersOf10 =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    if(mantissa == 0)
+        value = 0.0;
+    else if(mantissa <= maxExactMantissa && std::abs(exponent) <= maxExactExponent)
+    {
+        value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / powersOf10.at(-exponent) : value * powersOf10.at(exponent);
+    }
+    else
+        return slowParse();
+
+    if(negative)
+        value = -value;
+
+    if(isInteger != nullptr && integral)
+    {
+        const uint64_t maxInt = std::numeric_limits<int>::max();
+        *isInteger = mantissa <= (negative ? maxInt + 1 : maxInt);
+    }
+
+    return true;
+}
+
 std::vector<QString> u::toQStringVector(const QStringList& stringList)
 {
     std::vector<QString> v;
@@ -44,6 +44,10 @@ namespace u
     double toNumber(const std::string& string);
     double toNumber(const QString& string);
 
+    // Locale independent conversion with the same semantics as QString::toDouble, but
+    // much quicker for plain decimal input; isInteger is set if QString::toInt would succeed
+    bool parseNumber(const QString& string, double& value, bool* isInteger = nullptr);
+
     std::vector<QString> toQStringVector(const QStringList& stringList);
     QStringList toQStringList(const std::vector<QString>& qStringVector);
 
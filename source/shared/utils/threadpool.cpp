@@ -20,32 +20,43 @@
 
 #include "thread.h"
 
+// The pool that owns the current thread, if any, and the thread's index within it
+static thread_local const ThreadPool* currentThreadPool = nullptr;
+static thread_local int currentWorkerIndex = -1;
+
 ThreadPool::ThreadPool(const QString& threadNamePrefix, unsigned int numThreads) :
-    _stop(false), _activeThreads(0)
+    _numQueuedTasks(0), _stop(false), _activeThreads(0)
 {
+    numThreads = std::max(numThreads, 1U);
+
+    for(unsigned int i = 0U; i < numThreads; i++)
+        _workers.emplace_back(std::make_unique<Worker>());
+
     for(unsigned int i = 0U; i < numThreads; i++)
     {
         _threads.emplace_back([threadNamePrefix, i, this]
             {
                 u::setCurrentThreadName(QStringLiteral("%1%2").arg(threadNamePrefix).arg(i + 1));
+                currentThreadPool = this;
+                currentWorkerIndex = static_cast<int>(i);
+
+                std::function<void()> task;
 
                 while(!_stop)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-
-                    if(!_tasks.empty())
+                    if(takeTask(task, currentWorkerIndex))
                     {
-                        auto task = _tasks.front();
-                        _tasks.pop();
-                        lock.unlock();
+                        _activeThreads++;
                         task();
+                        task = nullptr;
                         _activeThreads--;
+                        continue;
                     }
-                    else if(!_stop)
-                    {
-                        // Block until a new task is queued
-                        _waitForNewTask.wait(lock);
-                    }
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+
+                    // Block until a new task is queued
+                    _waitForNewTask.wait(lock, [this] { return _stop || _numQueuedTasks > 0; });
                 }
             });
     }
@@ -56,10 +67,15 @@ ThreadPool::~ThreadPool()
     // Cancel all pending tasks
     std::unique_lock<std::mutex> lock(_mutex);
     _stop = true;
-    while(!_tasks.empty())
-        _tasks.pop();
+    _tasks.clear();
     lock.unlock();
 
+    for(auto& worker : _workers)
+    {
+        std::unique_lock<std::mutex> workerLock(worker->_mutex);
+        worker->_tasks.clear();
+    }
+
     // Tell all idle threads to unblock
     _waitForNewTask.notify_all();
 
@@ -70,3 +86,119 @@ ThreadPool::~ThreadPool()
             thread.join();
     }
 }
+
+bool ThreadPool::isWorkerThread() const
+{
+    return currentThreadPool == this;
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    if(_stop)
+        return;
+
+    if(isWorkerThread())
+    {
+        // Tasks created by a worker are likely to be related to what it's
+        // currently doing, so keep them local, where they're cache warm
+        auto& worker = *_workers.at(static_cast<size_t>(currentWorkerIndex));
+        std::unique_lock<std::mutex> workerLock(worker._mutex);
+        worker._tasks.push_back(std::move(task));
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+
+    {
+        // Incrementing under the lock ensures a worker can't miss the wake up
+        std::unique_lock<std::mutex> lock(_mutex);
+        _numQueuedTasks++;
+    }
+
+    // Wake a thread up
+    _waitForNewTask.notify_one();
+}
+
+bool ThreadPool::takeTask(std::function<void()>& task, int workerIndex)
+{
+    auto taken = [this, &task](std::deque<std::function<void()>>& tasks, bool fromBack)
+    {
+        if(tasks.empty())
+            return false;
+
+        if(fromBack)
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        _numQueuedTasks--;
+        return true;
+    };
+
+    const auto numWorkers = static_cast<int>(_workers.size());
+
+    // Our own most recently queued task first...
+    if(workerIndex >= 0)
+    {
+        auto& worker = *_workers.at(static_cast<size_t>(workerIndex));
+        std::unique_lock<std::mutex> workerLock(worker._mutex);
+        if(taken(worker._tasks, true))
+            return true;
+    }
+
+    // ...then anything queued from outside the pool...
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(taken(_tasks, false))
+            return true;
+    }
+
+    // ...then steal the oldest task of another worker
+    for(int i = 1; i < numWorkers; i++)
+    {
+        auto& victim = *_workers.at(static_cast<size_t>((workerIndex + i) % numWorkers));
+        std::unique_lock<std::mutex> victimLock(victim._mutex);
+        if(taken(victim._tasks, false))
+            return true;
+    }
+
+    return false;
+}
+
+static thread_local std::shared_ptr<ThreadPool::TaskGroup::State> currentTaskGroup;
+
+ThreadPool::TaskGroup::TaskGroup(const QString& name) :
+    _state(std::make_shared<State>()), _previous(currentTaskGroup)
+{
+    _state->_name = name;
+    _state->_parent = _previous;
+    currentTaskGroup = _state;
+}
+
+ThreadPool::TaskGroup::~TaskGroup()
+{
+    currentTaskGroup = _previous;
+}
+
+std::shared_ptr<ThreadPool::TaskGroup::State> ThreadPool::TaskGroup::current()
+{
+    return currentTaskGroup;
+}
+
+void ThreadPool::TaskGroup::setCurrent(std::shared_ptr<State> state)
+{
+    currentTaskGroup = std::move(state);
+}
+
+bool ThreadPool::TaskGroup::currentCancelled()
+{
+    return currentTaskGroup != nullptr && currentTaskGroup->cancelled();
+}
@@ -29,26 +29,94 @@
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
 #include <utility>
 #include <type_traits>
 
+// A work stealing thread pool. Each worker has its own deque of tasks; it pushes and
+// pops at the back, whilst idle workers steal from the front of everyone else's. Tasks
+// queued from outside the pool go to a shared injection queue.
+//
+// concurrent_for hands out its range in chunks that get progressively smaller as the
+// range is consumed, so that the work stays balanced even when the cost of elements
+// varies. The calling thread takes part too, and when waiting for the results it keeps
+// taking chunks until there are none left, only blocking on those already in progress.
+// As a result, a concurrent_for nested inside another's tasks can neither deadlock nor
+// end up serialised behind its parent.
 class ThreadPool
 {
+public:
+    // Any concurrent work started on a thread while a TaskGroup is in scope belongs to the
+    // group, as does any work that is in turn started by that work. Cancelling a group
+    // (or any group it is nested within) stops the remainder of its concurrent_for ranges
+    // from being started.
+    class TaskGroup
+    {
+    public:
+        struct State
+        {
+            QString _name;
+            std::atomic<bool> _cancelled{false};
+            std::shared_ptr<State> _parent;
+
+            bool cancelled() const
+            {
+                return _cancelled || (_parent != nullptr && _parent->cancelled());
+            }
+        };
+
+    private:
+        std::shared_ptr<State> _state;
+        std::shared_ptr<State> _previous;
+
+    public:
+        explicit TaskGroup(const QString& name);
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup(TaskGroup&&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        TaskGroup& operator=(TaskGroup&&) = delete;
+
+        const QString& name() const { return _state->_name; }
+
+        void cancel() { _state->_cancelled = true; }
+        bool cancelled() const { return _state->cancelled(); }
+
+        // The group the calling thread's work belongs to, if any
+        static std::shared_ptr<State> current();
+        static void setCurrent(std::shared_ptr<State> state);
+
+        // True if the calling thread's work belongs to a group that has been cancelled
+        static bool currentCancelled();
+    };
+
 private:
+    struct Worker
+    {
+        std::mutex _mutex;
+        std::deque<std::function<void()>> _tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers;
     std::vector<std::thread> _threads;
     std::mutex _mutex;
     std::condition_variable _waitForNewTask;
-    std::queue<std::function<void()>> _tasks;
+    std::deque<std::function<void()>> _tasks;
+    std::atomic<int> _numQueuedTasks;
     std::atomic<bool> _stop;
     std::atomic<int> _activeThreads;
 
+    void enqueue(std::function<void()> task);
+    bool takeTask(std::function<void()>& task, int workerIndex);
+
 public:
     explicit ThreadPool(const QString& threadNamePrefix = QStringLiteral("Worker"),
         unsigned int numThreads = std::thread::hardware_concurrency());
@@ -59,8 +127,12 @@ public:
     ThreadPool& operator=(const ThreadPool& other) = delete;
     ThreadPool& operator=(ThreadPool&& other) = delete;
 
+    size_t numThreads() const { return _threads.size(); }
     bool saturated() const { return _activeThreads >= static_cast<int>(_threads.size()); }
-    bool idle() const { return _activeThreads == 0; }
+
+    // True if the calling thread is one of this pool's workers
+    bool isWorkerThread() const;
+    bool idle() const { return _activeThreads == 0 && _numQueuedTasks == 0; }
 
     template<typename Fn, typename... Args> using ReturnType = typename std::invoke_result_t<Fn, Args...>;
 
@@ -71,24 +143,17 @@ public:
 
         auto taskPtr = std::make_shared<std::packaged_task<ReturnType<Fn, Args...>(Args...)>>(f);
 
+        enqueue([taskPtr, args...]() mutable
         {
-            std::unique_lock<std::mutex> lock(_mutex);
-            _tasks.push(
-                [taskPtr, args...]() mutable
-                {
-                    (*taskPtr)(std::forward<Args>(args)...);
-                });
-        }
+            (*taskPtr)(std::forward<Args>(args)...);
+        });
 
-        // Wake a thread up
-        _waitForNewTask.notify_one();
-        _activeThreads++;
         return taskPtr->get_future();
     }
 
 private:
     // If the concurrent function returns a value, give the ResultsType class a std::vector _values
-    // member, which contains the results from each thread
+    // member, which contains the results from each chunk of the range, in order
     template<typename ResultsVectorOrVoid, bool = std::is_void_v<ResultsVectorOrVoid>>
     class ResultMember;
 
@@ -102,27 +167,75 @@ private:
         mutable std::vector<ResultsVectorOrVoid> _values;
     };
 
+    // Similarly, the chunk results of a loop in progress
+    template<typename ResultsVectorOrVoid, bool = std::is_void_v<ResultsVectorOrVoid>>
+    class LoopResults;
+
+    template<typename ResultsVectorOrVoid>
+    class LoopResults<ResultsVectorOrVoid, true> {};
+
+    template<typename ResultsVectorOrVoid>
+    class LoopResults<ResultsVectorOrVoid, false>
+    {
+    private:
+        std::vector<std::pair<size_t, ResultsVectorOrVoid>> _chunkResults;
+
+    protected:
+        void addResults(size_t chunkIndex, ResultsVectorOrVoid&& results, std::mutex& mutex)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            _chunkResults.emplace_back(chunkIndex, std::move(results));
+        }
+
+    public:
+        std::vector<ResultsVectorOrVoid> takeResults()
+        {
+            std::sort(_chunkResults.begin(), _chunkResults.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            std::vector<ResultsVectorOrVoid> values;
+            values.reserve(_chunkResults.size());
+
+            for(auto& chunkResult : _chunkResults)
+                values.emplace_back(std::move(chunkResult.second));
+
+            _chunkResults.clear();
+            return values;
+        }
+    };
+
+    template<typename ResultsVectorOrVoid>
+    class LoopBase : public LoopResults<ResultsVectorOrVoid>
+    {
+    public:
+        virtual ~LoopBase() = default;
+
+        // Take part in the loop until no work remains, then wait for any still in progress
+        virtual void wait() = 0;
+    };
+
     template<typename ResultsVectorOrVoid> class ResultsType : public ResultMember<ResultsVectorOrVoid>
     {
         friend class ThreadPool;
 
     private:
-        mutable std::vector<std::future<ResultsVectorOrVoid>> _futures;
+        mutable std::shared_ptr<LoopBase<ResultsVectorOrVoid>> _loop;
 
-        explicit ResultsType(std::vector<std::future<ResultsVectorOrVoid>>&& futures) :
-            _futures(std::move(futures))
+        explicit ResultsType(std::shared_ptr<LoopBase<ResultsVectorOrVoid>> loop) :
+            _loop(std::move(loop))
         {}
 
     public:
         void wait() const
         {
-            for(auto& future : _futures)
-            {
-                future.wait();
+            if(_loop == nullptr)
+                return;
 
-                if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
-                    this->_values.emplace_back(std::move(future.get()));
-            }
+            auto loop = std::move(_loop);
+            loop->wait();
+
+            if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+                this->_values = loop->takeResults();
         }
 
         // This iterator allows the results to be iterated over in a single pass
@@ -333,6 +446,7 @@ private:
             }
         };
 
+
         template<typename T = ResultsVectorOrVoid>
         typename std::enable_if_t<!std::is_void_v<T>, iterator>
         begin() { return iterator(this, false); }
@@ -354,22 +468,16 @@ private:
     template<typename It, typename Fn>
     class IteratorExecutor
     {
-    private:
-        size_t _index = 0;
-
-    public:
-        IteratorExecutor() = default;
-
-        void setIndex(size_t index) { _index = index; }
-
     protected:
-        auto execute(Fn& f, It& it) const
+        auto execute(Fn& f, It& it, size_t index) const
         {
+            Q_UNUSED(index);
+
             // Fn argument is an iterator
             if constexpr(std::is_convertible_v<FirstArgumentType<Fn>, It>)
             {
                 if constexpr(HasThreadIndexArgument<Fn>)
-                    return f(it, _index);
+                    return f(it, index);
                 else
                     return f(it);
             }
@@ -378,7 +486,7 @@ private:
             if constexpr(std::is_convertible_v<FirstArgumentType<Fn>, typename It::value_type>)
             {
                 if constexpr(HasThreadIndexArgument<Fn>)
-                    return f(*it, _index);
+                    return f(*it, index);
                 else
                     return f(*it);
             }
@@ -391,13 +499,13 @@ private:
     public:
         using ResultsVectorOrVoid = std::vector<Result>;
 
-        ResultsVectorOrVoid operator()(It it, It last, Fn& f) const
+        ResultsVectorOrVoid operator()(It it, It last, Fn& f, size_t index) const
         {
             ResultsVectorOrVoid values;
             values.reserve(std::distance(it, last));
 
             for(; it != last; ++it)
-                values.emplace_back(std::move(this->execute(f, it)));
+                values.emplace_back(std::move(this->execute(f, it, index)));
 
             return values;
         }
@@ -409,10 +517,10 @@ private:
     public:
         using ResultsVectorOrVoid = void;
 
-        ResultsVectorOrVoid operator()(It it, It last, Fn& f) const
+        ResultsVectorOrVoid operator()(It it, It last, Fn& f, size_t index) const
         {
             for(; it != last; ++it)
-                this->execute(f, it);
+                this->execute(f, it, index);
         }
     };
 
@@ -467,6 +575,198 @@ private:
         }
     };
 
+    template<typename It, typename Fn>
+    class Loop : public LoopBase<typename Executor<It, Fn>::ResultsVectorOrVoid>,
+        public std::enable_shared_from_this<Loop<It, Fn>>
+    {
+    private:
+        using ResultsVectorOrVoid = typename Executor<It, Fn>::ResultsVectorOrVoid;
+
+        // Each chunk is at most this fraction of the remaining cost, divided between
+        // the participants; small enough that there are always chunks left over for
+        // any participant that finishes early, but large enough that claiming
+        // them is a negligible overhead
+        static constexpr uint64_t ChunkDivisor = 2;
+
+        std::mutex _mutex;
+        std::condition_variable _chunkFinished;
+
+        Coster<It> _coster;
+        It _next;
+        It _last;
+        uint64_t _remainingCost;
+
+        size_t _numChunks = 0;
+        size_t _numChunksInProgress = 0;
+        size_t _numParticipants = 0;
+        size_t _numHelpers = 0;
+        const size_t _maxParticipants;
+        std::exception_ptr _exception;
+
+        ThreadPool& _threadPool;
+
+        const Fn _f;
+        const std::shared_ptr<TaskGroup::State> _taskGroup;
+
+        bool stopped() const
+        {
+            return _exception != nullptr || (_taskGroup != nullptr && _taskGroup->cancelled());
+        }
+
+        bool claim(It& first, It& last, size_t& chunkIndex)
+        {
+            bool addHelper = false;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                if(!claimLocked(first, last, chunkIndex))
+                    return false;
+
+                // Helpers are only added while there is work left over for them and
+                // there are threads free to take them, so small ranges and loops nested
+                // in busy pools don't pay for queueing tasks that would find nothing
+                if(_next != _last && _numHelpers + 1 < _maxParticipants && !_threadPool.saturated())
+                {
+                    _numHelpers++;
+                    addHelper = true;
+                }
+            }
+
+            if(addHelper)
+                addHelperTask();
+
+            return true;
+        }
+
+        bool claimLocked(It& first, It& last, size_t& chunkIndex)
+        {
+            if(_next == _last || stopped())
+                return false;
+
+            const auto chunkCost = std::max<uint64_t>(1,
+                _remainingCost / (ChunkDivisor * _maxParticipants));
+
+            first = _next;
+            uint64_t cost = 0;
+            do
+            {
+                // Elements with no cost still count for something, otherwise the first
+                // chunk of a range of such elements would end up being all of it
+                cost += std::max<uint64_t>(_coster(_next), 1);
+                ++_next;
+            }
+            while(_next != _last && cost < chunkCost);
+
+            last = _next;
+            _remainingCost -= std::min(cost, _remainingCost);
+            chunkIndex = _numChunks++;
+            _numChunksInProgress++;
+
+            return true;
+        }
+
+        void finishChunk(std::exception_ptr exception = nullptr)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            if(exception != nullptr && _exception == nullptr)
+                _exception = exception;
+
+            _numChunksInProgress--;
+
+            if(_numChunksInProgress == 0)
+                _chunkFinished.notify_all();
+        }
+
+    public:
+        Loop(ThreadPool& threadPool, It first, It last, Fn f, size_t maxParticipants) :
+            _coster(first, last), _next(first), _last(last),
+            _remainingCost(_coster.total()),
+            _maxParticipants(std::max<size_t>(maxParticipants, 1)),
+            _threadPool(threadPool),
+            _f(std::move(f)), _taskGroup(TaskGroup::current())
+        {}
+
+        void addHelperTask()
+        {
+            _threadPool.enqueue([loop = this->shared_from_this()] { loop->run(); });
+        }
+
+        // When the results aren't waited upon immediately, there must be
+        // a helper to get things started, as the caller isn't taking part
+        void start()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                if(_maxParticipants < 2)
+                    return;
+
+                _numHelpers++;
+            }
+
+            addHelperTask();
+        }
+
+        void run()
+        {
+            It first;
+            It last;
+            size_t chunkIndex = 0;
+
+            if(!claim(first, last, chunkIndex))
+                return;
+
+            // Each participant gets its own index, for use as an index into
+            // per thread storage, and its own copy of the function, in case
+            // it's mutable
+            size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                index = _numParticipants++;
+            }
+            Q_ASSERT(index < _maxParticipants);
+
+            auto f = _f;
+            Executor<It, Fn> executor;
+
+            auto previousTaskGroup = TaskGroup::current();
+            TaskGroup::setCurrent(_taskGroup);
+
+            do
+            {
+                try
+                {
+                    if constexpr(std::is_void_v<ResultsVectorOrVoid>)
+                        executor(first, last, f, index);
+                    else
+                        this->addResults(chunkIndex, executor(first, last, f, index), _mutex);
+
+                    finishChunk();
+                }
+                catch(...)
+                {
+                    finishChunk(std::current_exception());
+                }
+            }
+            while(claim(first, last, chunkIndex));
+
+            TaskGroup::setCurrent(previousTaskGroup);
+        }
+
+        void wait() override
+        {
+            run();
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _chunkFinished.wait(lock, [this] { return _numChunksInProgress == 0; });
+
+            if(_exception != nullptr)
+                std::rethrow_exception(_exception);
+        }
+    };
+
 public:
     template<typename It, typename Fn> using Results =
         ResultsType<typename Executor<It, Fn>::ResultsVectorOrVoid>;
@@ -480,13 +780,6 @@ public:
     template<typename It, typename Fn>
     auto concurrent_for(It first, It last, Fn f, ResultsPolicy resultsPolicy = Blocking)
     {
-        Coster<It> coster(first, last);
-
-        const auto totalCost = coster.total(); Q_ASSERT(totalCost > 0);
-        const auto numThreads = static_cast<int>(_threads.size());
-        const auto costPerThread = totalCost / numThreads +
-                ((totalCost % numThreads) ? 1 : 0);
-
         static_assert(std::is_convertible_v<FirstArgumentType<Fn>, It> ||
             std::is_convertible_v<FirstArgumentType<Fn>, typename It::value_type>,
             "Fn's argument must be an It or an It::value_type");
@@ -494,34 +787,23 @@ public:
         static_assert(function_traits<Fn>::arity == 1 || HasThreadIndexArgument<Fn>,
             "Fn's (optional) second index argument must be size_t");
 
-        Executor<It, Fn> executor;
-        std::vector<std::future<typename Executor<It, Fn>::ResultsVectorOrVoid>> futures;
-        size_t threadIndex = 0;
+        using ResultsVectorOrVoid = typename Executor<It, Fn>::ResultsVectorOrVoid;
 
-        for(It it = first; it != last;)
-        {
-            It threadLast = it;
-            uint64_t cost = 0;
-            do
-            {
-                cost += coster(threadLast);
-                ++threadLast;
-            }
-            while(threadLast != last && cost < costPerThread);
+        if(first == last)
+            return Results<It, Fn>(nullptr);
 
-            Q_ASSERT(threadIndex < _threads.size());
+        // The calling thread makes up the numbers when it waits, so the
+        // total number of participants never exceeds the number of threads;
+        // helpers are added as chunks are claimed, rather than all up front
+        const auto numElements = static_cast<size_t>(std::distance(first, last));
+        const auto maxParticipants = std::min(numThreads(), numElements);
 
-            futures.emplace_back(makeFuture([executor, it, threadLast, f, threadIndex]() mutable
-            {
-                executor.setIndex(threadIndex);
-                return executor(it, threadLast, f);
-            }));
+        auto loop = std::make_shared<Loop<It, Fn>>(*this, first, last, std::move(f), maxParticipants);
 
-            it = threadLast;
-            threadIndex++;
-        }
+        if(resultsPolicy == NonBlocking)
+            loop->start();
 
-        auto results = Results<It, Fn>(std::move(futures));
+        auto results = Results<It, Fn>(std::shared_ptr<LoopBase<ResultsVectorOrVoid>>(std::move(loop)));
 
         if(resultsPolicy == Blocking)
             results.wait();
@@ -530,7 +812,11 @@ public:
     }
 };
 
-class ThreadPoolSingleton : public ThreadPool, public Singleton<ThreadPoolSingleton> {};
+class ThreadPoolSingleton : public ThreadPool, public Singleton<ThreadPoolSingleton>
+{
+public:
+    using ThreadPool::ThreadPool;
+};
 
 template<typename Fn, typename... Args>
 auto execute_on_threadpool(Fn&& f, Args&&... args)
@@ -18,24 +18,50 @@
 
 #include "typeidentity.h"
 
+#include "shared/utils/string.h"
+
 #include <QString>
 
+#include <cmath>
+#include <limits>
+
 void TypeIdentity::updateType(const QString& value)
 {
+    double numericValue = 0.0;
+    updateType(value, numericValue);
+}
+
+void TypeIdentity::updateType(const QString& value, double& numericValue)
+{
+    numericValue = std::numeric_limits<double>::quiet_NaN();
+
     // If the value is empty we can't determine its type
     if(value.isEmpty())
         return;
 
-    bool conversionSucceeded = false;
+    bool isInt = false;
+    bool isFloat = u::parseNumber(value, numericValue, &isInt);
+
+    if(!isFloat)
+        numericValue = std::numeric_limits<double>::quiet_NaN();
 
-    auto intValue = value.toInt(&conversionSucceeded);
-    Q_UNUSED(intValue); // Keep cppcheck happy
-    bool isInt = conversionSucceeded;
+    updateType(isInt, isFloat);
+}
+
+void TypeIdentity::updateType(double numericValue)
+{
+    if(std::isnan(numericValue))
+        return;
 
-    auto doubleValue = value.toDouble(&conversionSucceeded);
-    Q_UNUSED(doubleValue); // Keep cppcheck happy
-    bool isFloat = conversionSucceeded;
+    bool isInt = std::trunc(numericValue) == numericValue &&
+        numericValue >= static_cast<double>(std::numeric_limits<int>::min()) &&
+        numericValue <= static_cast<double>(std::numeric_limits<int>::max());
 
+    updateType(isInt, true);
+}
+
+void TypeIdentity::updateType(bool isInt, bool isFloat)
+{
     switch(_type)
     {
     default:
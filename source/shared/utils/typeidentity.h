@@ -35,9 +35,17 @@ public:
 private:
     Type _type = Type::Unknown;
 
+    void updateType(bool isInt, bool isFloat);
+
 public:
     void updateType(const QString& value);
 
+    // As above, but also provides the numeric value, or NaN if there isn't one
+    void updateType(const QString& value, double& numericValue);
+
+    // For values that are already numeric; NaN is treated as an empty value
+    void updateType(double numericValue);
+
     template<typename C>
     void updateType(const C& values)
     {